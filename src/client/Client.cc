@@ -119,11 +119,13 @@ Client::Client(Messenger *m, MonClient *mc)
     initialized(false), mounted(false), unmounting(false),
     local_osd(-1), local_osd_epoch(0),
     unsafe_sync_write(0),
+    aio_inflight(0),
     file_stripe_unit(0),
     file_stripe_count(0),
     object_size(0),
     file_replication(0),
-    client_lock("Client::client_lock")
+    client_lock("Client::client_lock"),
+    async_finisher(m->cct)
 {
   monclient->set_messenger(m);
 
@@ -281,6 +283,7 @@ int Client::init()
   timer.init();
 
   objectcacher->start();
+  async_finisher.start();
 
   // ok!
   messenger->add_dispatcher_head(this);
@@ -313,6 +316,16 @@ void Client::shutdown()
 {
   ldout(cct, 1) << "shutdown" << dendl;
 
+  // let outstanding aio complete, and its callbacks run
+  client_lock.Lock();
+  while (aio_inflight > 0) {
+    ldout(cct, 2) << "waiting for " << aio_inflight << " aio requests" << dendl;
+    aio_cond.Wait(client_lock);
+  }
+  client_lock.Unlock();
+  async_finisher.wait_for_empty();
+  async_finisher.stop();
+
   objectcacher->stop();  // outside of client_lock! this does a join.
 
   client_lock.Lock();
@@ -4307,6 +4320,8 @@ int Client::_readdir_get_frag(dir_result_t *dirp)
   req->set_filepath(path); 
   req->inode = diri;
   req->head.args.readdir.frag = fg;
+  req->head.args.readdir.max_entries = cct->_conf->client_readdir_max_entries;
+  req->head.args.readdir.max_bytes = cct->_conf->client_readdir_max_bytes;
   if (dirp->last_name.length()) {
     req->path2.set_path(dirp->last_name.c_str());
     req->readdir_start = dirp->last_name;
@@ -5247,6 +5262,12 @@ void Client::sync_write_commit(Inode *in)
 
 int Client::write(int fd, const char *buf, loff_t size, loff_t offset) 
 {
+  // copy into a fresh buffer (our write may be resent, async) before
+  // we take client_lock.
+  bufferlist bl;
+  if (size > 0)
+    bl.push_back(buffer::copy(buf, size));
+
   Mutex::Locker lock(client_lock);
   tout(cct) << "write" << std::endl;
   tout(cct) << fd << std::endl;
@@ -5255,14 +5276,16 @@ int Client::write(int fd, const char *buf, loff_t size, loff_t offset)
 
   assert(fd_map.count(fd));
   Fh *fh = fd_map[fd];
-  int r = _write(fh, offset, size, buf);
+  int r = _write(fh, offset, bl);
   ldout(cct, 3) << "write(" << fd << ", \"...\", " << size << ", " << offset << ") = " << r << dendl;
   return r;
 }
 
 
-int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
+int Client::_write(Fh *f, int64_t offset, bufferlist& bl)
 {
+  uint64_t size = bl.length();
+
   if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
     return -EFBIG;
 
@@ -5299,12 +5322,6 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
   // time it.
   utime_t start = ceph_clock_now(cct);
     
-  // copy into fresh buffer (since our write may be resub, async)
-  bufferptr bp;
-  if (size > 0) bp = buffer::copy(buf, size);
-  bufferlist bl;
-  bl.push_back( bp );
-
   uint64_t endoff = offset + size;
   int got;
   int r = get_caps(in, CEPH_CAP_FILE_WR, CEPH_CAP_FILE_BUFFER, &got, endoff);
@@ -5353,29 +5370,281 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
     
   // assume success for now.  FIXME.
   uint64_t totalwritten = size;
+  _write_update(in, offset, totalwritten);
+
+  put_cap_ref(in, CEPH_CAP_FILE_WR);
   
+  // ok!
+  return totalwritten;  
+}
+
+/*
+ * file size and mtime after a write of offset~size
+ */
+void Client::_write_update(Inode *in, uint64_t offset, uint64_t size)
+{
   // extend file?
-  if (totalwritten + offset > in->size) {
-    in->size = totalwritten + offset;
+  if (size + offset > in->size) {
+    in->size = size + offset;
     mark_caps_dirty(in, CEPH_CAP_FILE_WR);
     
     if ((in->size << 1) >= in->max_size &&
 	(in->reported_size << 1) < in->max_size)
       check_caps(in, false);
       
-    ldout(cct, 7) << "wrote to " << totalwritten+offset << ", extending file size" << dendl;
+    ldout(cct, 7) << "wrote to " << size+offset << ", extending file size" << dendl;
   } else {
-    ldout(cct, 7) << "wrote to " << totalwritten+offset << ", leaving file size at " << in->size << dendl;
+    ldout(cct, 7) << "wrote to " << size+offset << ", leaving file size at " << in->size << dendl;
   }
 
   // mtime
   in->mtime = ceph_clock_now(cct);
   mark_caps_dirty(in, CEPH_CAP_FILE_WR);
+}
+
+int Client::preadv(int fd, const struct iovec *iov, int iovcnt, loff_t offset)
+{
+  if (iovcnt < 0)
+    return -EINVAL;
+  loff_t len = 0;
+  for (int i = 0; i < iovcnt; i++)
+    len += iov[i].iov_len;
+
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "preadv" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << len << std::endl;
+  tout(cct) << offset << std::endl;
+
+  assert(fd_map.count(fd));
+  Fh *f = fd_map[fd];
+  bufferlist bl;
+  int r = _read(f, offset, len, &bl);
+  ldout(cct, 3) << "preadv(" << fd << ", " << iovcnt << " iovs, " << len << ", " << offset << ") = " << r << dendl;
+  if (r < 0)
+    return r;
+
+  // scatter
+  unsigned pos = 0;
+  for (int i = 0; i < iovcnt && pos < bl.length(); i++) {
+    unsigned n = MIN(iov[i].iov_len, bl.length() - pos);
+    bl.copy(pos, n, (char *)iov[i].iov_base);
+    pos += n;
+  }
+  return bl.length();
+}
+
+int Client::pwritev(int fd, const struct iovec *iov, int iovcnt, loff_t offset)
+{
+  if (iovcnt < 0)
+    return -EINVAL;
+  bufferlist bl;
+  for (int i = 0; i < iovcnt; i++)
+    if (iov[i].iov_len)
+      bl.append((const char *)iov[i].iov_base, iov[i].iov_len);
+
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "pwritev" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << bl.length() << std::endl;
+  tout(cct) << offset << std::endl;
+
+  assert(fd_map.count(fd));
+  Fh *fh = fd_map[fd];
+  int r = _write(fh, offset, bl);
+  ldout(cct, 3) << "pwritev(" << fd << ", " << iovcnt << " iovs, " << offset << ") = " << r << dendl;
+  return r;
+}
+
+
+// -----------
+// async i/o
+//
+// the cache or the osds complete these under client_lock; we copy read
+// data out and drop our references there, and pass the result to
+// async_finisher, which calls the caller's context without the lock.
 
+class C_Client_AioRead : public Context {
+  Client *client;
+  Inode *in;
+  int got;
+  uint64_t len;
+  char *buf;
+  Context *onfinish;
+public:
+  bufferlist bl;
+  C_Client_AioRead(Client *c, Inode *i, int g, uint64_t l, char *b, Context *fin)
+    : client(c), in(i), got(g), len(l), buf(b), onfinish(fin) {
+    in->get();
+  }
+  void finish(int r) {
+    client->_aio_read_finish(in, got, len, bl, buf, onfinish, r);
+  }
+};
+
+void Client::_aio_read_finish(Inode *in, int got, uint64_t len, bufferlist& bl,
+			      char *buf, Context *onfinish, int r)
+{
+  ldout(cct, 10) << "_aio_read_finish " << *in << " got " << bl.length()
+		 << " of " << len << " r=" << r << dendl;
+  if (r >= 0) {
+    // short objects and holes within the file read as zeros
+    unsigned have = MIN(bl.length(), len);
+    bl.copy(0, have, buf);
+    if (have < len)
+      memset(buf + have, 0, len - have);
+    r = len;
+  }
+  put_cap_ref(in, got);
+  put_inode(in);
+  async_finisher.queue(onfinish, r);
+  if (--aio_inflight == 0)
+    aio_cond.Signal();
+}
+
+int Client::aio_read(int fd, loff_t offset, loff_t len, char *buf, Context *onfinish)
+{
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "aio_read" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << len << std::endl;
+  tout(cct) << offset << std::endl;
+
+  if (offset < 0 || len < 0)
+    return -EINVAL;
+  assert(fd_map.count(fd));
+  Fh *f = fd_map[fd];
+  Inode *in = f->inode;
+
+  // this may block for caps
+  int got;
+  int r = get_caps(in, CEPH_CAP_FILE_RD, CEPH_CAP_FILE_CACHE, &got, -1);
+  if (r < 0)
+    return r;
+
+  ldout(cct, 10) << "aio_read " << *in << " " << offset << "~" << len << dendl;
+
+  if (offset >= (loff_t)in->size) {
+    put_cap_ref(in, got);
+    async_finisher.queue(onfinish, 0);
+    return 0;
+  }
+  if (offset + len > (loff_t)in->size)
+    len = in->size - offset;
+
+  C_Client_AioRead *fin = new C_Client_AioRead(this, in, got, len, buf, onfinish);
+  aio_inflight++;
+  if (got & CEPH_CAP_FILE_CACHE) {
+    if (in->cap_refs[CEPH_CAP_FILE_CACHE] == 0)
+      in->get_cap_ref(CEPH_CAP_FILE_CACHE);
+    r = objectcacher->file_read(&in->oset, &in->layout, in->snapid,
+				offset, len, &fin->bl, 0, fin);
+    if (r != 0)
+      fin->complete(r);   // cached, or failed
+  } else {
+    filer->read_trunc(in->ino, &in->layout, in->snapid,
+		      offset, len, &fin->bl, 0,
+		      in->truncate_size, in->truncate_seq,
+		      fin);
+  }
+  return 0;
+}
+
+class C_Client_AioWrite : public Context {
+  Client *client;
+  Inode *in;
+  uint64_t size;
+  Context *onfinish;
+public:
+  C_Client_AioWrite(Client *c, Inode *i, uint64_t s, Context *fin)
+    : client(c), in(i), size(s), onfinish(fin) {
+    in->get();
+  }
+  void finish(int r) {
+    client->_aio_write_finish(in, size, onfinish, r);
+  }
+};
+
+void Client::_aio_write_finish(Inode *in, uint64_t size, Context *onfinish, int r)
+{
+  ldout(cct, 10) << "_aio_write_finish " << *in << " " << size << " r=" << r << dendl;
   put_cap_ref(in, CEPH_CAP_FILE_WR);
-  
-  // ok!
-  return totalwritten;  
+  put_inode(in);
+  async_finisher.queue(onfinish, r < 0 ? r : (int)size);
+  if (--aio_inflight == 0)
+    aio_cond.Signal();
+}
+
+int Client::aio_write(int fd, loff_t offset, bufferlist& bl, Context *onfinish)
+{
+  Mutex::Locker lock(client_lock);
+  tout(cct) << "aio_write" << std::endl;
+  tout(cct) << fd << std::endl;
+  tout(cct) << bl.length() << std::endl;
+  tout(cct) << offset << std::endl;
+
+  uint64_t size = bl.length();
+  if (offset < 0)
+    return -EINVAL;
+  if (osdmap->test_flag(CEPH_OSDMAP_FULL))
+    return -ENOSPC;
+
+  assert(fd_map.count(fd));
+  Fh *f = fd_map[fd];
+  Inode *in = f->inode;
+  assert(in->snapid == CEPH_NOSNAP);
+  if ((f->mode & CEPH_FILE_MODE_WR) == 0)
+    return -EINVAL;
+
+  // O_APPEND: write at the end, as _write() does
+  if (f->append) {
+    lock_fh_pos(f);
+    loff_t end = _lseek(f, 0, SEEK_END);
+    if (end >= 0) {
+      offset = end;
+      f->pos = offset + size;
+    }
+    unlock_fh_pos(f);
+    if (end < 0)
+      return end;
+  }
+  if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
+    return -EFBIG;
+
+  // this may block for caps
+  int got;
+  int r = get_caps(in, CEPH_CAP_FILE_WR, CEPH_CAP_FILE_BUFFER, &got, offset + size);
+  if (r < 0)
+    return r;
+
+  ldout(cct, 10) << "aio_write " << *in << " " << offset << "~" << size << dendl;
+
+  if (cct->_conf->client_oc && (got & CEPH_CAP_FILE_BUFFER)) {
+    // buffered: done once the cache has it, as with _write()
+    if (!in->oset.dirty_or_tx)
+      get_cap_ref(in, CEPH_CAP_FILE_BUFFER);
+    get_cap_ref(in, CEPH_CAP_FILE_BUFFER);
+    objectcacher->file_write(&in->oset, &in->layout, in->snaprealm->get_snap_context(),
+			     offset, size, bl, ceph_clock_now(cct), 0,
+			     client_lock);
+    put_cap_ref(in, CEPH_CAP_FILE_BUFFER);
+    _write_update(in, offset, size);
+    put_cap_ref(in, CEPH_CAP_FILE_WR);
+    async_finisher.queue(onfinish, size);
+    return 0;
+  }
+
+  // unbuffered: done when the osds ack.  our FILE_WR ref goes with the ack.
+  Context *onsafe = new C_Client_SyncCommit(this, in);
+  unsafe_sync_write++;
+  aio_inflight++;
+  get_cap_ref(in, CEPH_CAP_FILE_BUFFER);  // released by onsafe callback
+  filer->write_trunc(in->ino, &in->layout, in->snaprealm->get_snap_context(),
+		     offset, size, bl, ceph_clock_now(cct), 0,
+		     in->truncate_size, in->truncate_seq,
+		     new C_Client_AioWrite(this, in, size, onfinish), onsafe);
+  _write_update(in, offset, size);
+  return 0;
 }
 
 int Client::_flush(Fh *f)
@@ -6702,6 +6971,10 @@ int Client::ll_read(Fh *fh, loff_t off, loff_t len, bufferlist *bl)
 
 int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
 {
+  bufferlist bl;
+  if (len > 0)
+    bl.push_back(buffer::copy(data, len));
+
   Mutex::Locker lock(client_lock);
   ldout(cct, 3) << "ll_write " << fh << " " << fh->inode->ino << " " << off << "~" << len << dendl;
   tout(cct) << "ll_write" << std::endl;
@@ -6709,7 +6982,7 @@ int Client::ll_write(Fh *fh, loff_t off, loff_t len, const char *data)
   tout(cct) << off << std::endl;
   tout(cct) << len << std::endl;
 
-  int r = _write(fh, off, len, data);
+  int r = _write(fh, off, bl);
   ldout(cct, 3) << "ll_write " << fh << " " << off << "~" << len << " = " << r << dendl;
   return r;
 }
@@ -23,6 +23,7 @@
 #include <set>
 #include <map>
 #include <fstream>
+#include <sys/uio.h>
 using std::set;
 using std::map;
 using std::fstream;
@@ -42,6 +43,7 @@ using namespace __gnu_cxx;
 
 #include "common/Mutex.h"
 #include "common/Timer.h"
+#include "common/Finisher.h"
 
 #include "osdc/ObjectCacher.h"
 
@@ -250,6 +252,7 @@ public:
   epoch_t local_osd_epoch;
 
   int unsafe_sync_write;
+  int aio_inflight;  // aio_read/aio_write not yet handed to async_finisher
 
   int file_stripe_unit;
   int file_stripe_count;
@@ -258,6 +261,9 @@ public:
 public:
   entity_name_t get_myname() { return messenger->get_myname(); } 
   void sync_write_commit(Inode *in);
+  void _aio_read_finish(Inode *in, int got, uint64_t len, bufferlist& bl,
+			char *buf, Context *onfinish, int r);
+  void _aio_write_finish(Inode *in, uint64_t size, Context *onfinish, int r);
 
 protected:
   Filer                 *filer;     
@@ -303,6 +309,9 @@ protected:
   //  - protects Client and buffer cache both!
   Mutex                  client_lock;
 
+  // aio completions are called from here, without client_lock
+  Finisher               async_finisher;
+
   // helpers
   void wake_inode_waiters(int mds);
   void wait_on_list(list<Cond*>& ls);
@@ -345,7 +354,7 @@ protected:
   ofstream traceout;
 
 
-  Cond mount_cond, sync_cond;
+  Cond mount_cond, sync_cond, aio_cond;
 
 
   // friends
@@ -496,7 +505,8 @@ private:
   int _create(Inode *in, const char *name, int flags, mode_t mode, Inode **inp, Fh **fhp, int uid=-1, int gid=-1);
   loff_t _lseek(Fh *fh, loff_t offset, int whence);
   int _read(Fh *fh, int64_t offset, uint64_t size, bufferlist *bl);
-  int _write(Fh *fh, int64_t offset, uint64_t size, const char *buf);
+  int _write(Fh *fh, int64_t offset, bufferlist& bl);
+  void _write_update(Inode *in, uint64_t offset, uint64_t size);
   int _flush(Fh *fh);
   int _fsync(Fh *fh, bool syncdataonly);
   int _sync_fs();
@@ -584,6 +594,12 @@ public:
   loff_t lseek(int fd, loff_t offset, int whence);
   int read(int fd, char *buf, loff_t size, loff_t offset=-1);
   int write(int fd, const char *buf, loff_t size, loff_t offset=-1);
+  int preadv(int fd, const struct iovec *iov, int iovcnt, loff_t offset=-1);
+  int pwritev(int fd, const struct iovec *iov, int iovcnt, loff_t offset=-1);
+  // onfinish is called with the byte count or an error, from a separate
+  // thread and without client_lock.  aio_read fills buf before that.
+  int aio_read(int fd, loff_t offset, loff_t len, char *buf, Context *onfinish);
+  int aio_write(int fd, loff_t offset, bufferlist& bl, Context *onfinish);
   int fake_write_size(int fd, loff_t size);
   int ftruncate(int fd, loff_t size);
   int fsync(int fd, bool syncdataonly);
@@ -19,6 +19,8 @@ using namespace std;
 
 #include "common/config.h"
 #include "SyntheticClient.h"
+#include "Inode.h"
+#include "MetaRequest.h"
 #include "osdc/Objecter.h"
 #include "osdc/Filer.h"
 
@@ -247,6 +249,11 @@ void parse_syn_options(vector<const char*>& args)
       } else if (strcmp(args[i], "lookupino") == 0) {
 	syn_modes.push_back(SYNCLIENT_MODE_LOOKUPINO);
 	syn_sargs.push_back(args[++i]);
+      } else if (strcmp(args[i], "statbench") == 0) {
+	syn_modes.push_back(SYNCLIENT_MODE_STATBENCH);
+	syn_sargs.push_back(args[++i]);
+	syn_iargs.push_back(atoi(args[++i]));
+	syn_iargs.push_back(atoi(args[++i]));
 
       } else if (strcmp(args[i], "chunkfile") == 0) {
 	syn_modes.push_back(SYNCLIENT_MODE_CHUNK);
@@ -895,6 +902,18 @@ int SyntheticClient::run()
 	}
       }
       break;
+
+    case SYNCLIENT_MODE_STATBENCH:
+      {
+	string base = get_sarg(0);
+	int files = iargs.front();  iargs.pop_front();
+	int seconds = iargs.front();  iargs.pop_front();
+	if (run_me()) {
+	  stat_bench(base.c_str(), files, seconds);
+	}
+	did_run_me();
+      }
+      break;
       
     case SYNCLIENT_MODE_MKSNAP:
       {
@@ -1748,6 +1767,94 @@ int SyntheticClient::stat_dirs(const char *basedir, int dirs, int files, int dep
   
   return 0;
 }
+/*
+ * lookup + getattr throughput against the mds.  unlike stat_dirs we
+ * send every request to the mds even if we hold caps or leases, so
+ * this measures the mds and not our cache.  run several clients
+ * (--num-client) to see how the mds scales with concurrent requests,
+ * e.g.
+ *
+ *   ceph-syn --num-client 8 --syn statbench ~ 1000 30
+ */
+int SyntheticClient::stat_bench(const char *basedir, int files, int seconds)
+{
+  char d[500];
+  int r = client->mkdir(basedir, 0755);
+  if (r < 0 && r != -EEXIST) {
+    dout(0) << "stat_bench can't make " << basedir << ": " << r << dendl;
+    return r;
+  }
+  for (int i=0; i<files; i++) {
+    snprintf(d, sizeof(d), "%s/file.%d", basedir, i);
+    int fd = client->open(d, O_CREAT|O_RDWR, 0644);
+    if (fd < 0) {
+      dout(0) << "stat_bench can't create " << d << ": " << fd << dendl;
+      return fd;
+    }
+    client->close(fd);
+  }
+
+  client->client_lock.Lock();
+  Inode *dir = 0;
+  r = client->path_walk(filepath(basedir), &dir);
+  if (r < 0) {
+    client->client_lock.Unlock();
+    return r;
+  }
+  dir->get();
+  client->client_lock.Unlock();
+
+  uint64_t lookups = 0, getattrs = 0, errors = 0;
+  double lookup_lat = 0, getattr_lat = 0;
+  utime_t start = ceph_clock_now(g_ceph_context);
+  utime_t end = start;
+  end += (double)seconds;
+  int i = 0;
+  while (ceph_clock_now(g_ceph_context) < end && !time_to_stop()) {
+    snprintf(d, sizeof(d), "file.%d", i);
+    i = (i + 1) % files;
+
+    Mutex::Locker l(client->client_lock);
+    Inode *target = 0;
+    utime_t s = ceph_clock_now(g_ceph_context);
+    r = client->_do_lookup(dir, d, &target);
+    utime_t m = ceph_clock_now(g_ceph_context);
+    if (r < 0 || !target) {
+      errors++;
+      continue;
+    }
+    lookups++;
+    lookup_lat += (double)(m - s);
+
+    MetaRequest *req = new MetaRequest(CEPH_MDS_OP_GETATTR);
+    filepath path;
+    target->make_nosnap_relative_path(path);
+    req->set_filepath(path);
+    req->inode = target;
+    req->head.args.getattr.mask = CEPH_STAT_CAP_INODE_ALL;
+    r = client->make_request(req, -1, -1);
+    if (r < 0) {
+      errors++;
+      continue;
+    }
+    getattrs++;
+    getattr_lat += (double)(ceph_clock_now(g_ceph_context) - m);
+  }
+  double elapsed = ceph_clock_now(g_ceph_context) - start;
+
+  client->client_lock.Lock();
+  client->put_inode(dir);
+  client->client_lock.Unlock();
+
+  dout(0) << "stat_bench " << basedir << " " << elapsed << "s: "
+	  << lookups << " lookups (" << (double)lookups / elapsed << "/s, avg "
+	  << (lookups ? lookup_lat / (double)lookups : 0) << "s), "
+	  << getattrs << " getattrs (" << (double)getattrs / elapsed << "/s, avg "
+	  << (getattrs ? getattr_lat / (double)getattrs : 0) << "s), "
+	  << errors << " errors" << dendl;
+  return 0;
+}
+
 int SyntheticClient::read_dirs(const char *basedir, int dirs, int files, int depth)
 {
   if (time_to_stop()) return 0;
@@ -75,6 +75,7 @@
 
 #define SYNCLIENT_MODE_LOOKUPHASH     70
 #define SYNCLIENT_MODE_LOOKUPINO     71
+#define SYNCLIENT_MODE_STATBENCH     72   // dir files seconds
 
 #define SYNCLIENT_MODE_TRUNCATE     200
 
@@ -228,6 +229,7 @@ class SyntheticClient {
 
   int make_dirs(const char *basedir, int dirs, int files, int depth);
   int stat_dirs(const char *basedir, int dirs, int files, int depth);
+  int stat_bench(const char *basedir, int files, int seconds);
   int read_dirs(const char *basedir, int dirs, int files, int depth);
   int make_files(int num, int count, int priv, bool more);
   int link_test();
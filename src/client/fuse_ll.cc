@@ -609,7 +609,12 @@ int ceph_fuse_ll_main(Client *c, int argc, const char *argv[], int fd)
   if (g_conf->fuse_use_invalidate_cb)
     client->ll_register_ino_invalidate_cb(invalidate_cb, ch);
 
-  ret = fuse_session_loop(se);
+  // several fuse threads still take turns on client_lock; what overlaps
+  // is only their time waiting on the mds and osds.
+  if (g_conf->fuse_multithreaded)
+    ret = fuse_session_loop_mt(se);
+  else
+    ret = fuse_session_loop(se);
 
   client->ll_register_ino_invalidate_cb(NULL, NULL);
 
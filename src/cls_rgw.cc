@@ -31,6 +31,9 @@ cls_method_handle_t h_rgw_user_usage_log_trim;
 
 #define ROUND_BLOCK_SIZE 4096
 
+/* entries read after skipping past a common prefix */
+#define PREFIX_JUMP_BATCH 8
+
 static uint64_t get_rounded_size(uint64_t size)
 {
   return (size + ROUND_BLOCK_SIZE - 1) & ~(ROUND_BLOCK_SIZE - 1);
@@ -62,33 +65,74 @@ int rgw_bucket_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
     return -EINVAL;
   }
 
-  bufferlist bl;
+  std::map<string, struct rgw_bucket_dir_entry>& m = new_dir.m;
+  string start = op.start_obj;
+  uint32_t count = 0;
+  bool done = false;
+
+  /*
+   * with a delimiter, all of the entries under a common prefix come back
+   * as that prefix, and we skip the rest of them by reading on from past
+   * it.  a prefix that start_obj is in was returned by an earlier call.
+   * often the next key is under another prefix, so after a jump we
+   * only read a few entries, and double that while they are used.
+   */
+  uint32_t batch = 0;  // 0: all we still need
+  while (!done) {
+    map<string, bufferlist> keys;
+    uint32_t want = op.num_entries - count + 1;
+    if (batch && batch < want)
+      want = batch;
+    rc = cls_cxx_map_get_vals(hctx, start, op.filter_prefix, want, &keys);
+    if (rc < 0)
+      return rc;
+    done = (keys.size() < want);
+
+    std::map<string, bufferlist>::iterator kiter;
+    for (kiter = keys.begin(); kiter != keys.end(); ++kiter) {
+      const string& key = kiter->first;
+      if (count == op.num_entries) {
+        ret.is_truncated = true;
+        done = true;
+        break;
+      }
 
-  map<string, bufferlist> keys;
-  rc = cls_cxx_map_get_vals(hctx, op.start_obj, op.filter_prefix, op.num_entries + 1, &keys);
-  if (rc < 0)
-    return rc;
+      if (!op.delimiter.empty()) {
+        size_t pos = key.find(op.delimiter, op.filter_prefix.size());
+        if (pos != string::npos) {
+          string prefix = key.substr(0, pos + op.delimiter.size());
+          if (op.start_obj.compare(0, prefix.size(), prefix) != 0 &&
+              (ret.common_prefixes.empty() || ret.common_prefixes.back() != prefix)) {
+            ret.common_prefixes.push_back(prefix);
+            count++;
+          }
+          // names are utf-8, so none under prefix sort past this
+          start = prefix;
+          start.append(1, (char)0xff);
+          done = false;
+          batch = PREFIX_JUMP_BATCH;
+          break;
+        }
+      }
 
-  std::map<string, struct rgw_bucket_dir_entry>& m = new_dir.m;
-  std::map<string, bufferlist>::iterator kiter = keys.begin();
-  uint32_t i;
+      struct rgw_bucket_dir_entry entry;
+      bufferlist& entrybl = kiter->second;
+      bufferlist::iterator eiter = entrybl.begin();
+      try {
+        ::decode(entry, eiter);
+      } catch (buffer::error& err) {
+        CLS_LOG(1, "ERROR: rgw_bucket_list(): failed to decode entry, key=%s\n", key.c_str());
+        return -EINVAL;
+      }
 
-  for (i = 0; i < op.num_entries && kiter != keys.end(); ++i, ++kiter) {
-    struct rgw_bucket_dir_entry entry;
-    bufferlist& entrybl = kiter->second;
-    bufferlist::iterator eiter = entrybl.begin();
-    try {
-      ::decode(entry, eiter);
-    } catch (buffer::error& err) {
-      CLS_LOG(1, "ERROR: rgw_bucket_list(): failed to decode entry, key=%s\n", kiter->first.c_str());
-      return -EINVAL;
+      m[key] = entry;
+      count++;
+      start = key;
     }
-    
-    m[kiter->first] = entry;
+    if (kiter == keys.end() && batch && batch < op.num_entries)
+      batch *= 2;
   }
 
-  ret.is_truncated = (kiter != keys.end());
-
   ::encode(ret, *out);
   return 0;
 }
@@ -339,10 +383,10 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx, bufferlist *in, bufferlis
   bufferlist::iterator in_iter = in->begin();
   __u8 op;
   rgw_bucket_dir_entry cur_change;
-  rgw_bucket_dir_entry cur_disk;
   bufferlist op_bl;
 
   while (!in_iter.end()) {
+    rgw_bucket_dir_entry cur_disk;
     try {
       ::decode(op, in_iter);
       ::decode(cur_change, in_iter);
@@ -377,12 +421,12 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx, bufferlist *in, bufferlis
     }
 
     if (cur_disk.pending_map.empty()) {
-      struct rgw_bucket_category_stats& stats =
-          header.stats[cur_disk.meta.category];
       if (cur_disk.exists) {
-        stats.num_entries--;
-        stats.total_size -= cur_disk.meta.size;
-        stats.total_size_rounded -= get_rounded_size(cur_disk.meta.size);
+        struct rgw_bucket_category_stats& old_stats =
+            header.stats[cur_disk.meta.category];
+        old_stats.num_entries--;
+        old_stats.total_size -= cur_disk.meta.size;
+        old_stats.total_size_rounded -= get_rounded_size(cur_disk.meta.size);
         header_changed = true;
       }
       switch(op) {
@@ -392,14 +436,19 @@ int rgw_dir_suggest_changes(cls_method_context_t hctx, bufferlist *in, bufferlis
 	  return ret;
         break;
       case CEPH_RGW_UPDATE:
-        stats.num_entries++;
-        stats.total_size += cur_change.meta.size;
-        stats.total_size_rounded += get_rounded_size(cur_change.meta.size);
-        bufferlist cur_state_bl;
-        ::encode(cur_change, cur_state_bl);
-        ret = cls_cxx_map_set_val(hctx, cur_change.name, &cur_state_bl);
-        if (ret < 0)
-	  return ret;
+        {
+          struct rgw_bucket_category_stats& stats =
+              header.stats[cur_change.meta.category];
+          stats.num_entries++;
+          stats.total_size += cur_change.meta.size;
+          stats.total_size_rounded += get_rounded_size(cur_change.meta.size);
+          header_changed = true;
+          bufferlist cur_state_bl;
+          ::encode(cur_change, cur_state_bl);
+          ret = cls_cxx_map_set_val(hctx, cur_change.name, &cur_state_bl);
+          if (ret < 0)
+            return ret;
+        }
         break;
       }
     }
@@ -109,6 +109,11 @@ OPTION(mon_osd_auto_mark_new_in, OPT_BOOL, true)      // mark booting new osds '
 OPTION(mon_osd_down_out_interval, OPT_INT, 300) // seconds
 OPTION(mon_osd_min_up_ratio, OPT_DOUBLE, .3)    // min osds required to be up to mark things down
 OPTION(mon_osd_min_in_ratio, OPT_DOUBLE, .3)   // min osds required to be in to mark things out
+OPTION(mon_osd_down_batch_interval, OPT_DOUBLE, .5) // gather failure-driven down marks for at least this long before proposing them
+OPTION(mon_osd_flap_window, OPT_DOUBLE, 600)  // down marks closer together than this (seconds) count as flapping
+OPTION(mon_osd_flap_threshold, OPT_INT, 3)    // delay boot of an osd that has been marked down this many times in a row; 0 to disable
+OPTION(mon_osd_flap_backoff, OPT_DOUBLE, 30)  // initial boot delay (seconds) for a flapping osd; doubles with each further flap
+OPTION(mon_osd_flap_backoff_max, OPT_DOUBLE, 900) // max boot delay for a flapping osd
 OPTION(mon_lease, OPT_FLOAT, 5)       // lease interval
 OPTION(mon_lease_renew_interval, OPT_FLOAT, 3) // on leader, to renew the lease
 OPTION(mon_lease_ack_timeout, OPT_FLOAT, 10.0) // on leader, if lease isn't acked by all peons
@@ -133,6 +138,7 @@ OPTION(mon_max_log_entries_per_event, OPT_INT, 4096)
 OPTION(paxos_max_join_drift, OPT_INT, 10)       // max paxos iterations before we must first slurp
 OPTION(paxos_propose_interval, OPT_DOUBLE, 1.0)  // gather updates for this long before proposing a map update
 OPTION(paxos_min_wait, OPT_DOUBLE, 0.05)  // min time to gather updates for after period of inactivity
+OPTION(paxos_pipeline, OPT_BOOL, false)  // leader finishes an update (and may begin the next) once a majority has accepted, instead of waiting for the full quorum
 OPTION(clock_offset, OPT_DOUBLE, 0) // how much to offset the system clock in Clock.cc
 OPTION(auth_supported, OPT_STR, "none")
 OPTION(auth_mon_ticket_ttl, OPT_DOUBLE, 60*60*12)
@@ -144,6 +150,8 @@ OPTION(client_cache_size, OPT_INT, 16384)
 OPTION(client_cache_mid, OPT_FLOAT, .75)
 OPTION(client_cache_stat_ttl, OPT_INT, 0) // seconds until cached stat results become invalid
 OPTION(client_cache_readdir_ttl, OPT_INT, 1)  // 1 second only
+OPTION(client_readdir_max_entries, OPT_INT, 0)  // entries per readdir request (0 = as many as the mds will send)
+OPTION(client_readdir_max_bytes, OPT_INT, 0)    // bytes per readdir reply (0 = mds default)
 OPTION(client_use_random_mds, OPT_BOOL, false)
 OPTION(client_mount_timeout, OPT_DOUBLE, 30.0)
 OPTION(client_unmount_timeout, OPT_DOUBLE, 10.0)
@@ -163,6 +171,7 @@ OPTION(client_oc_max_dirty_age, OPT_DOUBLE, 5.0)      // max age in cache before
 // note: the max amount of "in flight" dirty data is roughly (max - target)
 OPTION(fuse_use_invalidate_cb, OPT_BOOL, false) // use fuse 2.8+ invalidate callback to keep page cache consistent
 OPTION(fuse_big_writes, OPT_BOOL, true)
+OPTION(fuse_multithreaded, OPT_BOOL, false)  // serve fuse requests from several threads; they still serialize on client_lock, only their waits overlap
 OPTION(objecter_tick_interval, OPT_DOUBLE, 5.0)
 OPTION(objecter_mon_retry_interval, OPT_DOUBLE, 5.0)
 OPTION(objecter_timeout, OPT_DOUBLE, 10.0)    // before we ask for a map
@@ -170,10 +179,12 @@ OPTION(objecter_inflight_op_bytes, OPT_U64, 1024*1024*100) // max in-flight data
 OPTION(objecter_inflight_ops, OPT_U64, 1024)               // max in-flight ios
 OPTION(journaler_allow_split_entries, OPT_BOOL, true)
 OPTION(journaler_write_head_interval, OPT_INT, 15)
-OPTION(journaler_prefetch_periods, OPT_INT, 10)   // * journal object size
+OPTION(journaler_prefetch_periods, OPT_INT, 10)   // * journal object size; max readahead window
+OPTION(journaler_prefetch_max_inflight, OPT_INT, 8)  // max journal objects being read at once (0 = no limit)
 OPTION(journaler_prezero_periods, OPT_INT, 5)     // * journal object size
 OPTION(journaler_batch_interval, OPT_DOUBLE, .001)   // seconds.. max add'l latency we artificially incur
 OPTION(journaler_batch_max, OPT_U64, 0)  // max bytes we'll delay flushing; disable, for now....
+OPTION(journaler_group_commit_bytes, OPT_U64, 1<<20)  // with writes in flight, hold flushes until one commits or this much is buffered; 0 = never hold
 OPTION(mds_data, OPT_STR, "/var/lib/ceph/mds/$cluster-$id")
 OPTION(mds_max_file_size, OPT_U64, 1ULL << 40)
 OPTION(mds_cache_size, OPT_INT, 100000)
@@ -194,13 +205,23 @@ OPTION(mds_dirstat_min_interval, OPT_FLOAT, 1)    // try to avoid propagating mo
 OPTION(mds_scatter_nudge_interval, OPT_FLOAT, 5)  // how quickly dirstat changes propagate up the hierarchy
 OPTION(mds_client_prealloc_inos, OPT_INT, 1000)
 OPTION(mds_early_reply, OPT_BOOL, true)
+OPTION(mds_fast_stat, OPT_BOOL, true)       // answer cached getattr/lookup without a full request
 OPTION(mds_use_tmap, OPT_BOOL, true)        // use trivialmap for dir updates
+OPTION(mds_dir_omap, OPT_BOOL, false)       // store dirfrags in omap; converts tmap dirfrags as they are committed.  do not turn off again.
+OPTION(mds_dir_omap_fetch_max, OPT_INT, 10000) // dentries per omap read when fetching a dirfrag
+OPTION(mds_readdir_max_bytes, OPT_INT, 512 << 10)  // readdir reply size when the client doesn't ask for one
+OPTION(mds_readdir_prefetch_frags, OPT_BOOL, true) // fetch the other frags of a fragmented dir along with the one being read
+OPTION(mds_readdir_prefetch_dirs, OPT_INT, 32)     // during a tree walk, subdirs to fetch ahead per readdir reply (0 = off)
+OPTION(mds_readdir_prefetch_window, OPT_DOUBLE, 10) // seconds without a readdir under a dir before a walk of it is considered over
 OPTION(mds_default_dir_hash, OPT_INT, CEPH_STR_HASH_RJENKINS)
 OPTION(mds_log, OPT_BOOL, true)
 OPTION(mds_log_skip_corrupt_events, OPT_BOOL, false)
 OPTION(mds_log_max_events, OPT_INT, -1)
 OPTION(mds_log_max_segments, OPT_INT, 30)  // segment size defined by FileLayout, above
 OPTION(mds_log_max_expiring, OPT_INT, 20)
+OPTION(mds_dentry_name_intern, OPT_BOOL, false)  // share one string per distinct dentry name (read at startup)
+OPTION(mds_replay_threads, OPT_INT, 2)  // threads decoding journal events during replay; 0 = decode in the replay thread
+OPTION(mds_replay_decode_ahead, OPT_INT, 1000)  // max events read and decoded ahead of the one being replayed
 OPTION(mds_log_eopen_size, OPT_INT, 100)   // # open inodes per log entry
 OPTION(mds_bal_sample_interval, OPT_FLOAT, 3.0)  // every 5 seconds
 OPTION(mds_bal_replicate_threshold, OPT_FLOAT, 8000)
@@ -227,6 +248,10 @@ OPTION(mds_bal_midchunk, OPT_FLOAT, .3)       // any sub bigger than this taken
 OPTION(mds_bal_minchunk, OPT_FLOAT, .001)     // never take anything smaller than this
 OPTION(mds_bal_target_removal_min, OPT_INT, 5) // min balance iterations before old target is removed
 OPTION(mds_bal_target_removal_max, OPT_INT, 10) // max balance iterations before old target is removed
+OPTION(mds_bal_max_scan, OPT_INT, 100000)     // dentries to look at when choosing exports, per rebalance
+OPTION(mds_bal_max_exports_inflight, OPT_INT, 5)  // balancer exports in progress at once
+OPTION(mds_bal_export_max_bytes, OPT_LONGLONG, 0) // balancer export bytes per second (0 = no limit)
+OPTION(mds_bal_trace, OPT_STR, "")            // append dirfrag hits here, for test/mds_balancer_sim
 OPTION(mds_replay_interval, OPT_FLOAT, 1.0) // time to wait before starting replay again
 OPTION(mds_shutdown_check, OPT_INT, 0)
 OPTION(mds_thrash_exports, OPT_INT, 0)
@@ -283,6 +308,7 @@ OPTION(osd_pool_default_pg_num, OPT_INT, 8)
 OPTION(osd_pool_default_pgp_num, OPT_INT, 8)
 OPTION(osd_map_dedup, OPT_BOOL, true)
 OPTION(osd_map_cache_size, OPT_INT, 500)
+OPTION(osd_past_mapping_cache_size, OPT_INT, 1000) // epochs of local pg up/acting kept for past_intervals
 OPTION(osd_map_cache_bl_size, OPT_INT, 50)
 OPTION(osd_map_cache_bl_inc_size, OPT_INT, 100)
 OPTION(osd_map_message_max, OPT_INT, 100)  // max maps per MOSDMap message
@@ -391,16 +417,34 @@ OPTION(rbd_cache_max_dirty_age, OPT_FLOAT, 1.0)      // seconds in cache before
 OPTION(rgw_data, OPT_STR, "/var/lib/ceph/radosgw/$cluster-$id")
 OPTION(rgw_cache_enabled, OPT_BOOL, true)   // rgw cache enabled
 OPTION(rgw_cache_lru_size, OPT_INT, 10000)   // num of entries in rgw cache
+OPTION(rgw_cache_max_bytes, OPT_U64, 64 << 20)   // bytes of data and attrs in rgw cache; 0 = only limit entries
+OPTION(rgw_cache_shards, OPT_INT, 16)   // rgw cache is split into this many independently locked shards
+OPTION(rgw_cache_ttl, OPT_INT, 0)   // seconds before a cached entry is refetched; 0 = rely on notifications
+OPTION(rgw_cache_negative_ttl, OPT_INT, 30)   // seconds a cached 'does not exist' is trusted; 0 = don't cache it
+OPTION(rgw_cache_notify_max_batch, OPT_INT, 1)   // cache updates per notification; >1 only once every gateway understands batches
 OPTION(rgw_socket_path, OPT_STR, "")   // path to unix domain socket, if not specified, rgw will not run as external fcgi
+OPTION(rgw_http_port, OPT_INT, 0)   // serve HTTP directly on this port instead of FastCGI; 0 = off
+OPTION(rgw_http_addr, OPT_STR, "")  // address to listen on for rgw_http_port, default all
+OPTION(rgw_http_keepalive_timeout, OPT_INT, 15)  // seconds an idle keep-alive connection stays open
+OPTION(rgw_http_request_timeout, OPT_INT, 60)  // seconds to wait on a client in the middle of a request
 OPTION(rgw_dns_name, OPT_STR, "")
 OPTION(rgw_swift_url, OPT_STR, "")              // 
 OPTION(rgw_swift_url_prefix, OPT_STR, "swift")  // 
 OPTION(rgw_enforce_swift_acls, OPT_BOOL, true)
+OPTION(rgw_auth_cache_ttl, OPT_INT, 30) // seconds a looked up user or a verified swift token is trusted; 0 = no auth cache
+OPTION(rgw_auth_cache_size, OPT_INT, 10000) // users and tokens in the auth cache
 OPTION(rgw_print_continue, OPT_BOOL, true)  // enable if 100-Continue works
 OPTION(rgw_remote_addr_param, OPT_STR, "REMOTE_ADDR")  // e.g. X-Forwarded-For, if you have a reverse proxy
 OPTION(rgw_op_thread_timeout, OPT_INT, 10*60)
 OPTION(rgw_op_thread_suicide_timeout, OPT_INT, 0)
 OPTION(rgw_thread_pool_size, OPT_INT, 100)
+OPTION(rgw_get_obj_window_size, OPT_INT, 4 << 20) // bytes of GET data to read ahead per request; 0 = one read at a time
+OPTION(rgw_put_hash_threads, OPT_INT, 0) // threads computing PUT etags while the data is read and written; 0 = on the request thread
+OPTION(rgw_put_hash_max_pending, OPT_INT, 4) // chunks of a PUT queued for the hash threads before the request waits
+OPTION(rgw_multipart_part_batch, OPT_INT, 1000) // parts looked up per read when completing a multipart upload
+OPTION(rgw_multipart_aio, OPT_INT, 8) // part lookups in flight when completing a multipart upload
+OPTION(rgw_copy_obj_clone, OPT_BOOL, true) // have the osds clone the data of a copy within a pool
+OPTION(rgw_copy_obj_clone_aio, OPT_INT, 16) // part clones in flight for a copy
 OPTION(rgw_maintenance_tick_interval, OPT_DOUBLE, 10.0)
 OPTION(rgw_pools_preallocate_max, OPT_INT, 100)
 OPTION(rgw_pools_preallocate_threshold, OPT_INT, 70)
@@ -409,8 +453,14 @@ OPTION(rgw_log_object_name, OPT_STR, "%Y-%m-%d-%H-%i-%n")      // man date to se
 OPTION(rgw_log_object_name_utc, OPT_BOOL, false)
 OPTION(rgw_usage_max_shards, OPT_INT, 32)
 OPTION(rgw_usage_max_user_shards, OPT_INT, 1)
+OPTION(rgw_bucket_index_shards, OPT_INT, 0) // index objects per new bucket; 0 = a single unsharded index
 OPTION(rgw_enable_ops_log, OPT_BOOL, true) // enable logging every rgw operation
 OPTION(rgw_enable_usage_log, OPT_BOOL, true) // enable logging bandwidth usage
+OPTION(rgw_ops_log_batch_bytes, OPT_INT, 64 << 10) // ops log data a thread buffers before writing it out
+OPTION(rgw_ops_log_flush_interval, OPT_DOUBLE, 1.0) // buffered ops log data is written at least this often (seconds)
+OPTION(rgw_ops_log_max_pending_bytes, OPT_U64, 16 << 20) // ops log data buffered or being written before requests wait
+OPTION(rgw_ops_log_drop_when_full, OPT_BOOL, false) // drop ops log entries instead of waiting past that
+OPTION(rgw_ops_log_shards, OPT_INT, 1) // split each ops log object into this many
 OPTION(rgw_usage_log_flush_threshold, OPT_INT, 1024) // threshold to flush pending log data
 OPTION(rgw_usage_log_tick_interval, OPT_INT, 30) // flush pending log data every X seconds
 OPTION(rgw_intent_log_object_name, OPT_STR, "%Y-%m-%d-%i-%n")  // man date to see codes (a subset are supported)
@@ -137,6 +137,18 @@ public:
     return val;
   }
 
+  /// get references to every value still alive (cached or held elsewhere)
+  void get_all(map<K, VPtr> *out) {
+    Mutex::Locker l(lock);
+    for (typename map<K, WeakVPtr>::iterator i = weak_refs.begin();
+	 i != weak_refs.end();
+	 ++i) {
+      VPtr val = i->second.lock();
+      if (val)
+	(*out)[i->first] = val;
+    }
+  }
+
   VPtr add(K key, V *value) {
     VPtr val(value, Cleanup(this, key));
     list<VPtr> to_release;
@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <sys/statvfs.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 // FreeBSD compatibility
 #ifdef __FreeBSD__
@@ -144,12 +145,42 @@ loff_t ceph_lseek(struct ceph_mount_info *cmount, int fd, loff_t offset, int whe
 int ceph_read(struct ceph_mount_info *cmount, int fd, char *buf, loff_t size, loff_t offset);
 int ceph_write(struct ceph_mount_info *cmount, int fd, const char *buf, loff_t size,
 	       loff_t offset);
+int ceph_preadv(struct ceph_mount_info *cmount, int fd, const struct iovec *iov, int iovcnt,
+		loff_t offset);
+int ceph_pwritev(struct ceph_mount_info *cmount, int fd, const struct iovec *iov, int iovcnt,
+		 loff_t offset);
 int ceph_ftruncate(struct ceph_mount_info *cmount, int fd, loff_t size);
 int ceph_fsync(struct ceph_mount_info *cmount, int fd, int syncdataonly);
 int ceph_fstat(struct ceph_mount_info *cmount, int fd, struct stat *stbuf);
 
 int ceph_sync_fs(struct ceph_mount_info *cmount);
 
+/*
+ * asynchronous i/o
+ *
+ * Submission returns once the request is queued; it may still block
+ * waiting for capabilities from the mds, or for dirty cache to drain.
+ * The completion callback is called from a client thread, without any
+ * client locks held, so it may submit more i/o.  A write's data is
+ * copied at submit time.  Use a new completion for each request; the
+ * return value is the number of bytes read or written, or a negative
+ * error code.  If submission itself fails, the completion is not called.
+ * On a file opened with O_APPEND, a write goes to the end of the file.
+ */
+struct ceph_aio_completion;
+typedef void (*ceph_aio_callback_t)(struct ceph_aio_completion *c, void *arg);
+
+int ceph_aio_create_completion(void *arg, ceph_aio_callback_t cb,
+			       struct ceph_aio_completion **pc);
+int ceph_aio_read(struct ceph_mount_info *cmount, int fd, char *buf, loff_t size,
+		  loff_t offset, struct ceph_aio_completion *c);
+int ceph_aio_write(struct ceph_mount_info *cmount, int fd, const char *buf, loff_t size,
+		   loff_t offset, struct ceph_aio_completion *c);
+int ceph_aio_wait_for_complete(struct ceph_aio_completion *c);
+int ceph_aio_is_complete(struct ceph_aio_completion *c);
+int ceph_aio_get_return_value(struct ceph_aio_completion *c);
+void ceph_aio_release(struct ceph_aio_completion *c);
+
 /* xattr support */
 int ceph_getxattr(struct ceph_mount_info *cmount, const char *path, const char *name, 
 	void *value, size_t size);
@@ -0,0 +1,231 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMPACT_MAP_H
+#define CEPH_COMPACT_MAP_H
+
+#include <map>
+#include <set>
+#include <ostream>
+
+#include "include/types.h"
+
+/*
+ * compact_map, compact_multimap, compact_set: std containers that are
+ * usually empty.
+ *
+ * These hold a single pointer, and only allocate the real container
+ * when the first element goes in.  An empty std::map is 48 bytes on
+ * x86_64; that adds up when every cached inode carries several of them.
+ *
+ * iterators are those of the underlying std container, so existing
+ * loops over map<>::iterator keep working.  an empty instance hands
+ * out iterators into a shared, never modified, empty container.
+ *
+ * notes:
+ *  - erase() never frees the container, so erasing while iterating
+ *    works as it does for the std one.  clear() frees it, and so does
+ *    shrink() once it is empty; call that where no one can be holding
+ *    an iterator, after the last erase.
+ *  - don't insert into an empty instance while holding iterators
+ *    from it.
+ */
+
+template <class C>
+class compact_container_base {
+protected:
+  C *c;
+  static C _empty;
+
+  C *alloc() {
+    if (!c)
+      c = new C;
+    return c;
+  }
+  void free_if_empty() {
+    if (c && c->empty()) {
+      delete c;
+      c = 0;
+    }
+  }
+
+public:
+  typedef typename C::iterator iterator;
+  typedef typename C::const_iterator const_iterator;
+  typedef typename C::reverse_iterator reverse_iterator;
+  typedef typename C::const_reverse_iterator const_reverse_iterator;
+  typedef typename C::key_type key_type;
+  typedef typename C::value_type value_type;
+  typedef typename C::size_type size_type;
+
+  compact_container_base() : c(0) {}
+  compact_container_base(const compact_container_base& o) : c(0) {
+    if (o.c && !o.c->empty())
+      c = new C(*o.c);
+  }
+  compact_container_base(const C& o) : c(0) {
+    if (!o.empty())
+      c = new C(o);
+  }
+  ~compact_container_base() {
+    delete c;
+  }
+  compact_container_base& operator=(const compact_container_base& o) {
+    if (this != &o) {
+      clear();
+      if (o.c && !o.c->empty())
+	c = new C(*o.c);
+    }
+    return *this;
+  }
+  compact_container_base& operator=(const C& o) {
+    clear();
+    if (!o.empty())
+      c = new C(o);
+    return *this;
+  }
+
+  bool empty() const { return !c || c->empty(); }
+  size_type size() const { return c ? c->size() : 0; }
+  void clear() {
+    delete c;
+    c = 0;
+  }
+  void swap(compact_container_base& o) {
+    C *t = c;
+    c = o.c;
+    o.c = t;
+  }
+  bool allocated() const { return c != 0; }
+  /// approximate heap bytes: the container plus one tree node per element
+  size_t mem_usage() const {
+    return c ? sizeof(C) + c->size() * (sizeof(value_type) + 4 * sizeof(void*)) : 0;
+  }
+
+  /// the underlying container (a shared empty one if we have none)
+  const C& get() const { return c ? *c : _empty; }
+
+  iterator begin() { return c ? c->begin() : _empty.begin(); }
+  iterator end() { return c ? c->end() : _empty.end(); }
+  const_iterator begin() const { return get().begin(); }
+  const_iterator end() const { return get().end(); }
+  reverse_iterator rbegin() { return c ? c->rbegin() : _empty.rbegin(); }
+  reverse_iterator rend() { return c ? c->rend() : _empty.rend(); }
+  const_reverse_iterator rbegin() const { return get().rbegin(); }
+  const_reverse_iterator rend() const { return get().rend(); }
+
+  size_type count(const key_type& k) const { return c ? c->count(k) : 0; }
+  iterator find(const key_type& k) { return c ? c->find(k) : _empty.end(); }
+  const_iterator find(const key_type& k) const { return get().find(k); }
+  iterator lower_bound(const key_type& k) { return c ? c->lower_bound(k) : _empty.end(); }
+  const_iterator lower_bound(const key_type& k) const { return get().lower_bound(k); }
+  iterator upper_bound(const key_type& k) { return c ? c->upper_bound(k) : _empty.end(); }
+  const_iterator upper_bound(const key_type& k) const { return get().upper_bound(k); }
+
+  void erase(iterator p) {
+    c->erase(p);
+  }
+  size_type erase(const key_type& k) {
+    return c ? c->erase(k) : 0;
+  }
+  /// free the container if it is empty.  invalidates iterators.
+  void shrink() {
+    free_if_empty();
+  }
+
+  bool operator==(const compact_container_base& o) const { return get() == o.get(); }
+  bool operator!=(const compact_container_base& o) const { return get() != o.get(); }
+
+  void encode(bufferlist& bl) const {
+    ::encode(get(), bl);
+  }
+  void decode(bufferlist::iterator& p) {
+    ::decode(*alloc(), p);
+    free_if_empty();
+  }
+};
+
+template <class C>
+C compact_container_base<C>::_empty;
+
+template <class K, class V, class Cmp = std::less<K> >
+class compact_map : public compact_container_base< std::map<K,V,Cmp> > {
+  typedef compact_container_base< std::map<K,V,Cmp> > base;
+public:
+  typedef typename base::iterator iterator;
+  typedef V mapped_type;
+
+  compact_map() {}
+  compact_map(const std::map<K,V,Cmp>& o) : base(o) {}
+
+  V& operator[](const K& k) { return (*this->alloc())[k]; }
+  std::pair<iterator,bool> insert(const std::pair<const K,V>& v) {
+    return this->alloc()->insert(v);
+  }
+};
+
+template <class K, class V, class Cmp = std::less<K> >
+class compact_multimap : public compact_container_base< std::multimap<K,V,Cmp> > {
+  typedef compact_container_base< std::multimap<K,V,Cmp> > base;
+public:
+  typedef typename base::iterator iterator;
+  typedef V mapped_type;
+
+  compact_multimap() {}
+  compact_multimap(const std::multimap<K,V,Cmp>& o) : base(o) {}
+
+  iterator insert(const std::pair<const K,V>& v) {
+    return this->alloc()->insert(v);
+  }
+};
+
+template <class T, class Cmp = std::less<T> >
+class compact_set : public compact_container_base< std::set<T,Cmp> > {
+  typedef compact_container_base< std::set<T,Cmp> > base;
+public:
+  typedef typename base::iterator iterator;
+
+  compact_set() {}
+  compact_set(const std::set<T,Cmp>& o) : base(o) {}
+
+  std::pair<iterator,bool> insert(const T& v) {
+    return this->alloc()->insert(v);
+  }
+};
+
+template <class K, class V, class Cmp>
+inline void encode(const compact_map<K,V,Cmp>& m, bufferlist& bl) { m.encode(bl); }
+template <class K, class V, class Cmp>
+inline void decode(compact_map<K,V,Cmp>& m, bufferlist::iterator& p) { m.decode(p); }
+template <class K, class V, class Cmp>
+inline void encode(const compact_multimap<K,V,Cmp>& m, bufferlist& bl) { m.encode(bl); }
+template <class K, class V, class Cmp>
+inline void decode(compact_multimap<K,V,Cmp>& m, bufferlist::iterator& p) { m.decode(p); }
+template <class T, class Cmp>
+inline void encode(const compact_set<T,Cmp>& s, bufferlist& bl) { s.encode(bl); }
+template <class T, class Cmp>
+inline void decode(compact_set<T,Cmp>& s, bufferlist::iterator& p) { s.decode(p); }
+
+template <class K, class V, class Cmp>
+inline std::ostream& operator<<(std::ostream& out, const compact_map<K,V,Cmp>& m) {
+  return out << m.get();
+}
+template <class K, class V, class Cmp>
+inline std::ostream& operator<<(std::ostream& out, const compact_multimap<K,V,Cmp>& m) {
+  return out << m.get();
+}
+template <class T, class Cmp>
+inline std::ostream& operator<<(std::ostream& out, const compact_set<T,Cmp>& s) {
+  return out << s.get();
+}
+
+#endif
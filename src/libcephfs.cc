@@ -20,6 +20,7 @@
 #include "client/Client.h"
 #include "include/cephfs/libcephfs.h"
 #include "common/Mutex.h"
+#include "common/Cond.h"
 #include "common/ceph_argparse.h"
 #include "common/common_init.h"
 #include "common/config.h"
@@ -499,6 +500,18 @@ extern "C" int ceph_write(struct ceph_mount_info *cmount, int fd, const char *bu
   return cmount->get_client()->write(fd, buf, size, offset);
 }
 
+extern "C" int ceph_preadv(struct ceph_mount_info *cmount, int fd,
+			   const struct iovec *iov, int iovcnt, loff_t offset)
+{
+  return cmount->get_client()->preadv(fd, iov, iovcnt, offset);
+}
+
+extern "C" int ceph_pwritev(struct ceph_mount_info *cmount, int fd,
+			    const struct iovec *iov, int iovcnt, loff_t offset)
+{
+  return cmount->get_client()->pwritev(fd, iov, iovcnt, offset);
+}
+
 extern "C" int ceph_ftruncate(struct ceph_mount_info *cmount, int fd, loff_t size)
 {
   return cmount->get_client()->ftruncate(fd, size);
@@ -520,6 +533,130 @@ extern "C" int ceph_sync_fs(struct ceph_mount_info *cmount)
 }
 
 
+// ---------------------------------------------------------
+// aio
+
+struct ceph_aio_completion {
+  Mutex lock;
+  Cond cond;
+  int ref, rval;
+  bool complete;
+  ceph_aio_callback_t callback;
+  void *callback_arg;
+
+  ceph_aio_completion(void *arg, ceph_aio_callback_t cb)
+    : lock("ceph_aio_completion::lock", false, false),
+      ref(1), rval(0), complete(false),
+      callback(cb), callback_arg(arg) {}
+
+  void get() {
+    lock.Lock();
+    assert(ref > 0);
+    ref++;
+    lock.Unlock();
+  }
+  void put() {
+    lock.Lock();
+    put_unlock();
+  }
+  void put_unlock() {
+    assert(ref > 0);
+    int n = --ref;
+    lock.Unlock();
+    if (!n)
+      delete this;
+  }
+};
+
+class C_CephAioComplete : public Context {
+  ceph_aio_completion *c;
+public:
+  C_CephAioComplete(ceph_aio_completion *cc) : c(cc) {
+    c->get();
+  }
+  void finish(int r) {
+    c->lock.Lock();
+    c->rval = r;
+    c->complete = true;
+    c->cond.Signal();
+    ceph_aio_callback_t cb = c->callback;
+    void *arg = c->callback_arg;
+    c->lock.Unlock();
+
+    if (cb)
+      cb(c, arg);
+    c->put();
+  }
+};
+
+extern "C" int ceph_aio_create_completion(void *arg, ceph_aio_callback_t cb,
+					  struct ceph_aio_completion **pc)
+{
+  *pc = new ceph_aio_completion(arg, cb);
+  return 0;
+}
+
+extern "C" int ceph_aio_read(struct ceph_mount_info *cmount, int fd, char *buf,
+			     loff_t size, loff_t offset, struct ceph_aio_completion *c)
+{
+  Context *fin = new C_CephAioComplete(c);
+  int r = cmount->get_client()->aio_read(fd, offset, size, buf, fin);
+  if (r < 0) {
+    // never submitted; drop the completion ref fin took
+    delete fin;
+    c->put();
+  }
+  return r;
+}
+
+extern "C" int ceph_aio_write(struct ceph_mount_info *cmount, int fd, const char *buf,
+			      loff_t size, loff_t offset, struct ceph_aio_completion *c)
+{
+  if (size < 0)
+    return -EINVAL;
+  bufferlist bl;
+  bl.append(buf, size);
+  Context *fin = new C_CephAioComplete(c);
+  int r = cmount->get_client()->aio_write(fd, offset, bl, fin);
+  if (r < 0) {
+    // never submitted; drop the completion ref fin took
+    delete fin;
+    c->put();
+  }
+  return r;
+}
+
+extern "C" int ceph_aio_wait_for_complete(struct ceph_aio_completion *c)
+{
+  c->lock.Lock();
+  while (!c->complete)
+    c->cond.Wait(c->lock);
+  c->lock.Unlock();
+  return 0;
+}
+
+extern "C" int ceph_aio_is_complete(struct ceph_aio_completion *c)
+{
+  c->lock.Lock();
+  int r = c->complete;
+  c->lock.Unlock();
+  return r;
+}
+
+extern "C" int ceph_aio_get_return_value(struct ceph_aio_completion *c)
+{
+  c->lock.Lock();
+  int r = c->rval;
+  c->lock.Unlock();
+  return r;
+}
+
+extern "C" void ceph_aio_release(struct ceph_aio_completion *c)
+{
+  c->put();
+}
+
+
 extern "C" int ceph_get_file_stripe_unit(struct ceph_mount_info *cmount, int fh)
 {
   struct ceph_file_layout l;
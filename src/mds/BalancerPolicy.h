@@ -0,0 +1,159 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MDS_BALANCERPOLICY_H
+#define CEPH_MDS_BALANCERPOLICY_H
+
+#include <list>
+#include <map>
+#include <set>
+
+#include "common/config.h"
+
+/*
+ * Choosing which subtrees to export.
+ *
+ * This is the export selection MDBalancer uses, pulled out so that the
+ * offline simulator (test/mds_balancer_sim.cc) runs the very same code
+ * against a tree built from a recorded hit trace.
+ *
+ * T describes the tree:
+ *
+ *   typedef ... node_t;
+ *   double pop(node_t n);        // load of n's auth subtree
+ *   bool is_rep(node_t n);       // n is replicated
+ *   // append n's exportable child dirfrags to ls, return the number
+ *   // of entries looked at to find them.
+ *   int get_subdirs(node_t n, std::list<node_t>& ls);
+ *   void taking(node_t n, double pop, const char *why);
+ *   void descending(node_t n);
+ */
+
+struct bal_export_params_t {
+  double min_start, need_min, need_max, midchunk, minchunk;
+  int max_scan;
+
+  bal_export_params_t(const md_config_t *conf)
+    : min_start(conf->mds_bal_min_start),
+      need_min(conf->mds_bal_need_min),
+      need_max(conf->mds_bal_need_max),
+      midchunk(conf->mds_bal_midchunk),
+      minchunk(conf->mds_bal_minchunk),
+      max_scan(conf->mds_bal_max_scan) {}
+};
+
+/*
+ * look for exports under dir worth about (amount - have).  every entry
+ * looked at is charged to budget; once that runs out we stop
+ * descending and go with what we have, so a huge or deep tree can't
+ * stall the mds on one rebalance.
+ */
+template<class T>
+void bal_find_exports(T& t, typename T::node_t dir,
+		      double amount,
+		      const bal_export_params_t& p,
+		      std::list<typename T::node_t>& exports,
+		      double& have,
+		      std::set<typename T::node_t>& already_exporting,
+		      int& budget)
+{
+  typedef typename T::node_t node_t;
+
+  double need = amount - have;
+  if (need < amount * p.min_start)
+    return;   // good enough!
+  if (budget <= 0)
+    return;
+  double needmax = need * p.need_max;
+  double needmin = need * p.need_min;
+  double midchunk = need * p.midchunk;
+  double minchunk = need * p.minchunk;
+
+  std::list<node_t> bigger_rep, bigger_unrep;
+  std::multimap<double, node_t> smaller;
+
+  std::list<node_t> subdirs;
+  budget -= t.get_subdirs(dir, subdirs);
+  for (typename std::list<node_t>::iterator q = subdirs.begin();
+       q != subdirs.end();
+       ++q) {
+    node_t subdir = *q;
+    if (already_exporting.count(subdir))
+      continue;
+
+    double pop = t.pop(subdir);
+    if (pop < minchunk)
+      continue;
+
+    // lucky find?
+    if (pop > needmin && pop < needmax) {
+      t.taking(subdir, pop, "lucky");
+      exports.push_back(subdir);
+      already_exporting.insert(subdir);
+      have += pop;
+      return;
+    }
+
+    if (pop > need) {
+      if (t.is_rep(subdir))
+	bigger_rep.push_back(subdir);
+      else
+	bigger_unrep.push_back(subdir);
+    } else
+      smaller.insert(std::pair<double,node_t>(pop, subdir));
+  }
+
+  // grab some sufficiently big small items
+  typename std::multimap<double,node_t>::reverse_iterator it;
+  for (it = smaller.rbegin(); it != smaller.rend(); ++it) {
+    if (it->first < midchunk)
+      break;  // try later
+    t.taking(it->second, it->first, "smaller");
+    exports.push_back(it->second);
+    already_exporting.insert(it->second);
+    have += it->first;
+    if (have > needmin)
+      return;
+  }
+
+  // apparently not enough; drill deeper into the hierarchy (if non-replicated)
+  for (typename std::list<node_t>::iterator q = bigger_unrep.begin();
+       q != bigger_unrep.end();
+       ++q) {
+    t.descending(*q);
+    bal_find_exports(t, *q, amount, p, exports, have, already_exporting, budget);
+    if (have > needmin)
+      return;
+  }
+
+  // ok fine, use smaller bits
+  for (; it != smaller.rend(); ++it) {
+    t.taking(it->second, it->first, "much smaller");
+    exports.push_back(it->second);
+    already_exporting.insert(it->second);
+    have += it->first;
+    if (have > needmin)
+      return;
+  }
+
+  // ok fine, drill into replicated dirs
+  for (typename std::list<node_t>::iterator q = bigger_rep.begin();
+       q != bigger_rep.end();
+       ++q) {
+    t.descending(*q);
+    bal_find_exports(t, *q, amount, p, exports, have, already_exporting, budget);
+    if (have > needmin)
+      return;
+  }
+}
+
+#endif
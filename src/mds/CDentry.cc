@@ -26,6 +26,8 @@
 
 #include "messages/MLock.h"
 
+#include "common/Mutex.h"
+
 #define dout_subsys ceph_subsys_mds
 #undef dout_prefix
 #define dout_prefix *_dout << "mds." << dir->cache->mds->get_nodeid() << ".cache.den(" << dir->dirfrag() << " " << name << ") "
@@ -38,6 +40,59 @@ ostream& CDentry::print_db_line_prefix(ostream& out)
 
 boost::pool<> CDentry::pool(sizeof(CDentry));
 
+// -- name interning --
+
+// name -> number of dentries using it.  the keys' string buffers are
+// what the dentries share.  decided once, at the first dentry, so that
+// every dentry is released the same way it was created.  the table is
+// shared by every CDentry in the process, so it has its own lock rather
+// than relying on mds_lock.
+static Mutex dentry_names_lock("CDentry::dentry_names_lock", false, false);
+static hash_map<string, unsigned> dentry_names;
+static int dentry_names_enabled = -1;
+
+bool CDentry::names_interned()
+{
+  Mutex::Locker l(dentry_names_lock);
+  if (dentry_names_enabled < 0)
+    dentry_names_enabled = g_conf->mds_dentry_name_intern;
+  return dentry_names_enabled;
+}
+
+const string& CDentry::intern_name(const string& n)
+{
+  if (!names_interned())
+    return n;
+  Mutex::Locker l(dentry_names_lock);
+  hash_map<string, unsigned>::iterator p = dentry_names.find(n);
+  if (p == dentry_names.end())
+    p = dentry_names.insert(pair<string, unsigned>(n, 0)).first;
+  p->second++;
+  return p->first;
+}
+
+void CDentry::release_name(const string& n)
+{
+  if (!names_interned())
+    return;
+  Mutex::Locker l(dentry_names_lock);
+  hash_map<string, unsigned>::iterator p = dentry_names.find(n);
+  assert(p != dentry_names.end());
+  if (--p->second == 0)
+    dentry_names.erase(p);
+}
+
+void CDentry::get_interned_name_stats(uint64_t *count, uint64_t *bytes)
+{
+  Mutex::Locker l(dentry_names_lock);
+  *count = dentry_names.size();
+  *bytes = 0;
+  for (hash_map<string, unsigned>::iterator p = dentry_names.begin();
+       p != dentry_names.end();
+       ++p)
+    *bytes += p->first.length();
+}
+
 LockType CDentry::lock_type(CEPH_LOCK_DN);
 LockType CDentry::versionlock_type(CEPH_LOCK_DVERSION);
 
@@ -102,7 +102,7 @@ public:
   }
 
 public:
-  string name;
+  const string name;   // interned; see intern_name()
   __u32 hash;
   snapid_t first, last;
 
@@ -173,7 +173,7 @@ public:
   // cons
   CDentry(const string& n, __u32 h,
 	  snapid_t f, snapid_t l) :
-    name(n), hash(h),
+    name(intern_name(n)), hash(h),
     first(f), last(l),
     dir(0),
     version(0), projected_version(0),
@@ -186,7 +186,7 @@ public:
   }
   CDentry(const string& n, __u32 h, inodeno_t ino, unsigned char dt,
 	  snapid_t f, snapid_t l) :
-    name(n), hash(h),
+    name(intern_name(n)), hash(h),
     first(f), last(l),
     dir(0),
     version(0), projected_version(0),
@@ -202,8 +202,17 @@ public:
   ~CDentry() {
     g_num_dn--;
     g_num_dns++;
+    release_name(name);
   }
 
+  // -- name interning --
+  //  with mds_dentry_name_intern, dentries with the same name share a
+  //  single (reference counted) string rather than each holding a copy.
+  static const string& intern_name(const string& n);
+  static void release_name(const string& n);
+  static bool names_interned();
+  static void get_interned_name_stats(uint64_t *count, uint64_t *bytes);
+
 
   CDir *get_dir() const { return dir; }
   const string& get_name() const { return name; }
@@ -366,7 +375,7 @@ public:
   // ---------------------------------------------
   // replicas (on clients)
  public:
-  map<client_t,ClientLease*> client_lease_map;
+  compact_map<client_t,ClientLease*> client_lease_map;
 
   bool is_any_leases() {
     return !client_lease_map.empty();
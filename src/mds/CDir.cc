@@ -1315,6 +1315,44 @@ class C_Dir_Fetch : public Context {
   }
 };
 
+class C_Dir_OMAP_Fetched : public Context {
+ public:
+  CDir *dir;
+  string want_dn;
+  bufferlist hdrbl;
+  bufferlist tmapbl;              // legacy (not yet converted) dirfrag
+  map<string, bufferlist> omap;   // everything read so far
+  map<string, bufferlist> more;   // result of this read
+  int ret1, ret2;
+
+  C_Dir_OMAP_Fetched(CDir *d, const string& w) :
+    dir(d), want_dn(w), ret1(0), ret2(0) { }
+  void finish(int r) {
+    if (r >= 0) r = ret1;
+    if (r >= 0) r = ret2;
+    dir->_omap_fetched(this, r);
+  }
+};
+
+class C_Dir_Fetch_Dentry : public Context {
+ protected:
+  CDir *dir;
+  string dname;
+  Context *fin;
+ public:
+  bufferlist hdrbl;
+  map<string, bufferlist> omap;
+  int ret1, ret2;
+
+  C_Dir_Fetch_Dentry(CDir *d, const string& n, Context *c) :
+    dir(d), dname(n), fin(c), ret1(0), ret2(0) { }
+  void finish(int r) {
+    if (r >= 0) r = ret1;
+    if (r >= 0) r = ret2;
+    dir->_fetched_dentry(hdrbl, omap, dname, r, fin);
+  }
+};
+
 void CDir::fetch(Context *c, bool ignore_authpinnability)
 {
   string want;
@@ -1347,6 +1385,11 @@ void CDir::fetch(Context *c, const string& want_dn, bool ignore_authpinnability)
 
   if (cache->mds->logger) cache->mds->logger->inc(l_mds_dir_f);
 
+  if (g_conf->mds_dir_omap) {
+    _omap_fetch(new C_Dir_OMAP_Fetched(this, want_dn));
+    return;
+  }
+
   // start by reading the first hunk of it
   C_Dir_Fetch *fin = new C_Dir_Fetch(this, want_dn);
   object_t oid = get_ondisk_object();
@@ -1356,6 +1399,170 @@ void CDir::fetch(Context *c, const string& want_dn, bool ignore_authpinnability)
   cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, fin);
 }
 
+/*
+ * read the next mds_dir_omap_fetch_max dentries, starting after the
+ * last one we already have.  the header comes along with the first
+ * chunk, and so does the object data: dirfrags written before we
+ * switched to omap have no header but keep their TMAP there until we
+ * commit them again.  the commit that converts a dirfrag truncates the
+ * data, so for converted ones this reads nothing.
+ *
+ * we still read every chunk before the dir is usable.  a readdir that
+ * continues from an offset could be served from just the chunk it
+ * needs, but CDir only knows complete and incomplete, and readdir and
+ * the rest of the mds need the former; that is left for later.
+ */
+void CDir::_omap_fetch(C_Dir_OMAP_Fetched *fin)
+{
+  string start_after;
+  if (!fin->omap.empty())
+    start_after = fin->omap.rbegin()->first;
+  dout(10) << "_omap_fetch after '" << start_after << "'" << dendl;
+
+  object_t oid = get_ondisk_object();
+  object_locator_t oloc(cache->mds->mdsmap->get_metadata_pg_pool());
+  ObjectOperation rd;
+  if (fin->omap.empty()) {
+    rd.omap_get_header(&fin->hdrbl, &fin->ret1);
+    rd.tmap_get(&fin->tmapbl, NULL);
+  }
+  rd.omap_get_vals(start_after, "", g_conf->mds_dir_omap_fetch_max,
+		   &fin->more, &fin->ret2);
+  cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, fin);
+}
+
+/*
+ * fetch a single (head) dentry.  this is enough to resolve a lookup
+ * miss without reading the whole dirfrag; the dir stays incomplete.
+ * if the dentry does not exist on disk we leave a null dentry behind
+ * so that the retried lookup returns ENOENT.
+ */
+void CDir::fetch_dentry(Context *c, const string& dname)
+{
+  assert(is_auth());
+  assert(!is_complete());
+
+  if (!g_conf->mds_dir_omap ||
+      state_test(CDir::STATE_FETCHING) ||
+      !can_auth_pin()) {
+    fetch(c, dname);
+    return;
+  }
+
+  dout(10) << "fetch_dentry '" << dname << "' on " << *this << dendl;
+  auth_pin(this);
+  if (cache->mds->logger) cache->mds->logger->inc(l_mds_dir_fk);
+
+  C_Dir_Fetch_Dentry *fin = new C_Dir_Fetch_Dentry(this, dname, c);
+  set<string> keys;
+  keys.insert(dentry_key_t(CEPH_NOSNAP, dname.c_str()).str());
+
+  object_t oid = get_ondisk_object();
+  object_locator_t oloc(cache->mds->mdsmap->get_metadata_pg_pool());
+  ObjectOperation rd;
+  rd.omap_get_header(&fin->hdrbl, &fin->ret1);
+  rd.omap_get_vals_by_keys(keys, &fin->omap, &fin->ret2);
+  cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, fin);
+}
+
+void CDir::_fetched_dentry(bufferlist& hdrbl, map<string, bufferlist>& omap,
+			   const string& dname, int r, Context *c)
+{
+  dout(10) << "_fetched_dentry '" << dname << "' r=" << r
+	   << " got " << omap.size() << " on " << *this << dendl;
+  assert(is_auth());
+
+  if (r < 0 || hdrbl.length() == 0) {
+    // let a full fetch sort out (and report) the missing object
+    auth_unpin(this);
+    if (is_complete())
+      c->complete(0);
+    else
+      fetch(c, dname);
+    return;
+  }
+
+  if (!is_complete()) {
+    state_set(STATE_OMAP);
+    fnode_t got_fnode;
+    bufferlist::iterator hp = hdrbl.begin();
+    ::decode(got_fnode, hp);
+    const set<snapid_t> *snaps = _fetched_fnode(got_fnode, false);
+
+    bool purged_any = false;
+    CDentry *dn = 0;
+    for (map<string, bufferlist>::iterator p = omap.begin(); p != omap.end(); ++p)
+      dn = _fetched_one(p->first, p->second, snaps, dname, got_fnode.version,
+			&purged_any);
+    if (purged_any)
+      log_mark_dirty();
+
+    if (!dn && !lookup(dname)) {
+      dn = add_null_dentry(dname);
+      dout(12) << "_fetched_dentry  not on disk, added " << *dn << dendl;
+    }
+  }
+
+  auth_unpin(this);
+  c->complete(0);
+}
+
+void CDir::_omap_fetched(C_Dir_OMAP_Fetched *fin, int r)
+{
+  dout(10) << "_omap_fetched r=" << r << " " << fin->more.size()
+	   << " more keys (have " << fin->omap.size() << ") for " << *this
+	   << " want_dn=" << fin->want_dn
+	   << dendl;
+
+  assert(is_auth());
+  assert(!is_frozen());
+
+  if (r == 0 && fin->hdrbl.length() == 0 && fin->tmapbl.length()) {
+    // not converted yet; our next commit will write it out as omap.
+    dout(10) << "_omap_fetched found tmap dirfrag, will convert" << dendl;
+    _fetched(fin->tmapbl, fin->want_dn);
+    return;
+  }
+  if (r < 0 || fin->hdrbl.length() == 0) {
+    _fetched_missing();
+    return;
+  }
+  state_set(STATE_OMAP);
+
+  bool done = fin->more.size() < (unsigned)g_conf->mds_dir_omap_fetch_max;
+  if (fin->omap.empty())
+    fin->omap.swap(fin->more);
+  else
+    fin->omap.insert(fin->more.begin(), fin->more.end());
+
+  if (!done) {
+    // go get the rest
+    C_Dir_OMAP_Fetched *next = new C_Dir_OMAP_Fetched(this, fin->want_dn);
+    next->hdrbl.claim(fin->hdrbl);
+    next->omap.swap(fin->omap);
+    _omap_fetch(next);
+    return;
+  }
+
+  fnode_t got_fnode;
+  bufferlist::iterator hp = fin->hdrbl.begin();
+  ::decode(got_fnode, hp);
+
+  dout(10) << "_omap_fetched version " << got_fnode.version
+	   << ", " << fin->omap.size() << " keys"
+	   << dendl;
+
+  const set<snapid_t> *snaps = _fetched_fnode(got_fnode, true);
+  bool purged_any = false;
+  for (map<string, bufferlist>::iterator p = fin->omap.begin();
+       p != fin->omap.end();
+       ++p)
+    _fetched_one(p->first, p->second, snaps, fin->want_dn, got_fnode.version,
+		 &purged_any);
+
+  _fetched_finish(purged_any);
+}
+
 void CDir::_fetched(bufferlist &bl, const string& want_dn)
 {
   LogClient &clog = cache->mds->clog;
@@ -1369,19 +1576,7 @@ void CDir::_fetched(bufferlist &bl, const string& want_dn)
 
   // empty?!?
   if (bl.length() == 0) {
-    dout(0) << "_fetched missing object for " << *this << dendl;
-    clog.error() << "dir " << ino() << "." << dirfrag()
-	  << " object missing on disk; some files may be lost\n";
-
-    log_mark_dirty();
-
-    // mark complete, !fetching
-    state_set(STATE_COMPLETE);
-    state_clear(STATE_FETCHING);
-    auth_unpin(this);
-    
-    // kick waiters
-    finish_waiting(WAIT_COMPLETE, 0);
+    _fetched_missing();
     return;
   }
 
@@ -1402,7 +1597,53 @@ void CDir::_fetched(bufferlist &bl, const string& want_dn)
 	   << ", " << len << " bytes, " << n << " keys"
 	   << dendl;
   
+  const set<snapid_t> *snaps = _fetched_fnode(got_fnode, true);
+  bool purged_any = false;
+
+  //int num_new_inodes_loaded = 0;
+  for (unsigned i=0; i<n; i++) {
+    string key;
+    bufferlist dndata;
+    ::decode(key, p);
+    ::decode(dndata, p);
+    _fetched_one(key, dndata, snaps, want_dn, got_fnode.version, &purged_any);
+  }
+  if (!p.end()) {
+    clog.warn() << "dir " << dirfrag() << " has "
+	<< bl.length() - p.get_off() << " extra bytes\n";
+  }
+
+  //cache->mds->logger->inc("newin", num_new_inodes_loaded);
+  //hack_num_accessed = 0;
+
+  _fetched_finish(purged_any);
+}
 
+void CDir::_fetched_missing()
+{
+  LogClient &clog = cache->mds->clog;
+  dout(0) << "_fetched missing object for " << *this << dendl;
+  clog.error() << "dir " << ino() << "." << dirfrag()
+	       << " object missing on disk; some files may be lost\n";
+
+  log_mark_dirty();
+
+  // mark complete, !fetching
+  state_set(STATE_COMPLETE);
+  state_clear(STATE_FETCHING);
+  auth_unpin(this);
+
+  // kick waiters
+  finish_waiting(WAIT_COMPLETE, 0);
+}
+
+/*
+ * take the loaded fnode if we are a fresh CDir with no prior state,
+ * and figure out which snaps we can purge stale dentries for.  we only
+ * advance snap_purged_thru when we are about to see every dentry.
+ */
+const set<snapid_t> *CDir::_fetched_fnode(fnode_t& got_fnode, bool complete)
+{
   // take the loaded fnode?
   // only if we are a fresh CDir* with no prior state.
   if (get_version() == 0) {
@@ -1429,204 +1670,205 @@ void CDir::_fetched(bufferlist &bl, const string& want_dn)
     dout(10) << " snap_purged_thru " << fnode.snap_purged_thru
 	     << " < " << realm->get_last_destroyed()
 	     << ", snap purge based on " << *snaps << dendl;
-    fnode.snap_purged_thru = realm->get_last_destroyed();
+    if (complete)
+      fnode.snap_purged_thru = realm->get_last_destroyed();
   }
-  bool purged_any = false;
-
+  return snaps;
+}
 
-  //int num_new_inodes_loaded = 0;
-  loff_t baseoff = p.get_off();
-  for (unsigned i=0; i<n; i++) {
-    loff_t dn_offset = p.get_off() - baseoff;
+/*
+ * instantiate one on-disk dentry (key + encoded value), unless we
+ * already have it in cache.
+ */
+CDentry *CDir::_fetched_one(const string& key, bufferlist& dndata,
+			    const set<snapid_t> *snaps,
+			    const string& want_dn, version_t fnode_version,
+			    bool *purged_any)
+{
+  LogClient &clog = cache->mds->clog;
 
-    // dname
-    string dname;
-    snapid_t first, last;
-    dentry_key_t::decode_helper(p, dname, last);
-    
-    bufferlist dndata;
-    ::decode(dndata, p);
-    bufferlist::iterator q = dndata.begin();
-    ::decode(first, q);
-
-    // marker
-    char type;
-    ::decode(type, q);
-
-    dout(24) << "_fetched pos " << dn_offset << " marker '" << type << "' dname '" << dname
-	     << " [" << first << "," << last << "]"
-	     << dendl;
-
-    bool stale = false;
-    if (snaps && last != CEPH_NOSNAP) {
-      set<snapid_t>::const_iterator p = snaps->lower_bound(first);
-      if (p == snaps->end() || *p > last) {
-	dout(10) << " skipping stale dentry on [" << first << "," << last << "]" << dendl;
-	stale = true;
-	purged_any = true;
-      }
-    }
+  // dname
+  string dname;
+  snapid_t first, last;
+  dentry_key_t::decode_helper(key, dname, last);
     
-    /*
-     * look for existing dentry for _last_ snap, because unlink +
-     * create may leave a "hole" (epochs during which the dentry
-     * doesn't exist) but for which no explicit negative dentry is in
-     * the cache.
-     */
-    CDentry *dn = 0;
-    if (!stale)
-      dn = lookup(dname, last);
+  bufferlist::iterator q = dndata.begin();
+  ::decode(first, q);
 
-    if (type == 'L') {
-      // hard link
-      inodeno_t ino;
-      unsigned char d_type;
-      ::decode(ino, q);
-      ::decode(d_type, q);
+  // marker
+  char type;
+  ::decode(type, q);
 
-      if (stale)
-	continue;
+  dout(24) << "_fetched_one marker '" << type << "' dname '" << dname
+	   << " [" << first << "," << last << "]"
+	   << dendl;
 
-      if (dn) {
-        if (dn->get_linkage()->get_inode() == 0) {
-          dout(12) << "_fetched  had NEG dentry " << *dn << dendl;
-        } else {
-          dout(12) << "_fetched  had dentry " << *dn << dendl;
-        }
+  bool stale = false;
+  if (snaps && last != CEPH_NOSNAP) {
+    set<snapid_t>::const_iterator p = snaps->lower_bound(first);
+    if (p == snaps->end() || *p > last) {
+      dout(10) << " skipping stale dentry on [" << first << "," << last << "]" << dendl;
+      stale = true;
+      *purged_any = true;
+    }
+  }
+    
+  /*
+   * look for existing dentry for _last_ snap, because unlink +
+   * create may leave a "hole" (epochs during which the dentry
+   * doesn't exist) but for which no explicit negative dentry is in
+   * the cache.
+   */
+  CDentry *dn = 0;
+  if (!stale)
+    dn = lookup(dname, last);
+
+  if (type == 'L') {
+    // hard link
+    inodeno_t ino;
+    unsigned char d_type;
+    ::decode(ino, q);
+    ::decode(d_type, q);
+
+    if (stale)
+      return 0;
+
+    if (dn) {
+      if (dn->get_linkage()->get_inode() == 0) {
+	dout(12) << "_fetched  had NEG dentry " << *dn << dendl;
       } else {
-	// (remote) link
-	dn = add_remote_dentry(dname, ino, d_type, first, last);
-	
-	// link to inode?
-	CInode *in = cache->get_inode(ino);   // we may or may not have it.
-	if (in) {
-	  dn->link_remote(dn->get_linkage(), in);
-	  dout(12) << "_fetched  got remote link " << ino << " which we have " << *in << dendl;
-	} else {
-	  dout(12) << "_fetched  got remote link " << ino << " (dont' have it)" << dendl;
-	}
+	dout(12) << "_fetched  had dentry " << *dn << dendl;
       }
-    } 
-    else if (type == 'I') {
-      // inode
-      
-      // parse out inode
-      inode_t inode;
-      string symlink;
-      fragtree_t fragtree;
-      map<string, bufferptr> xattrs;
-      bufferlist snapbl;
-      map<snapid_t,old_inode_t> old_inodes;
-      ::decode(inode, q);
-      if (inode.is_symlink())
-        ::decode(symlink, q);
-      ::decode(fragtree, q);
-      ::decode(xattrs, q);
-      ::decode(snapbl, q);
-      ::decode(old_inodes, q);
+    } else {
+      // (remote) link
+      dn = add_remote_dentry(dname, ino, d_type, first, last);
       
-      if (stale)
-	continue;
+      // link to inode?
+      CInode *in = cache->get_inode(ino);   // we may or may not have it.
+      if (in) {
+	dn->link_remote(dn->get_linkage(), in);
+	dout(12) << "_fetched  got remote link " << ino << " which we have " << *in << dendl;
+      } else {
+	dout(12) << "_fetched  got remote link " << ino << " (dont' have it)" << dendl;
+      }
+    }
+  } 
+  else if (type == 'I') {
+    // inode
+    
+    // parse out inode
+    inode_t inode;
+    string symlink;
+    fragtree_t fragtree;
+    map<string, bufferptr> xattrs;
+    bufferlist snapbl;
+    map<snapid_t,old_inode_t> old_inodes;
+    ::decode(inode, q);
+    if (inode.is_symlink())
+      ::decode(symlink, q);
+    ::decode(fragtree, q);
+    ::decode(xattrs, q);
+    ::decode(snapbl, q);
+    ::decode(old_inodes, q);
+    
+    if (stale)
+      return 0;
 
-      if (dn) {
-        if (dn->get_linkage()->get_inode() == 0) {
-          dout(12) << "_fetched  had NEG dentry " << *dn << dendl;
-        } else {
-          dout(12) << "_fetched  had dentry " << *dn << dendl;
-        }
+    if (dn) {
+      if (dn->get_linkage()->get_inode() == 0) {
+	dout(12) << "_fetched  had NEG dentry " << *dn << dendl;
+      } else {
+	dout(12) << "_fetched  had dentry " << *dn << dendl;
+      }
+    } else {
+      // add inode
+      CInode *in = 0;
+      if (cache->have_inode(inode.ino, last)) {
+	in = cache->get_inode(inode.ino, last);
+	dout(0) << "_fetched  badness: got (but i already had) " << *in
+		<< " mode " << in->inode.mode
+		<< " mtime " << in->inode.mtime << dendl;
+	string dirpath, inopath;
+	this->inode->make_path_string(dirpath);
+	in->make_path_string(inopath);
+	clog.error() << "loaded dup inode " << inode.ino
+	  << " [" << first << "," << last << "] v" << inode.version
+	  << " at " << dirpath << "/" << dname
+	  << ", but inode " << in->vino() << " v" << in->inode.version
+	  << " already exists at " << inopath << "\n";
+	return 0;
       } else {
-	// add inode
-	CInode *in = 0;
-	if (cache->have_inode(inode.ino, last)) {
-	  in = cache->get_inode(inode.ino, last);
-	  dout(0) << "_fetched  badness: got (but i already had) " << *in
-		  << " mode " << in->inode.mode
-		  << " mtime " << in->inode.mtime << dendl;
-	  string dirpath, inopath;
-	  this->inode->make_path_string(dirpath);
-	  in->make_path_string(inopath);
-	  clog.error() << "loaded dup inode " << inode.ino
-	    << " [" << first << "," << last << "] v" << inode.version
-	    << " at " << dirpath << "/" << dname
-	    << ", but inode " << in->vino() << " v" << in->inode.version
-	    << " already exists at " << inopath << "\n";
-	  continue;
-	} else {
-	  // inode
-	  in = new CInode(cache, true, first, last);
-	  in->inode = inode;
-	  
-	  // symlink?
-	  if (in->is_symlink()) 
-	    in->symlink = symlink;
-	  
-	  in->dirfragtree.swap(fragtree);
-	  in->xattrs.swap(xattrs);
-	  in->decode_snap_blob(snapbl);
-	  in->old_inodes.swap(old_inodes);
-	  if (snaps)
-	    in->purge_stale_snap_data(*snaps);
-
-	  // add 
-	  cache->add_inode( in );
+	// inode
+	in = new CInode(cache, true, first, last);
+	in->inode = inode;
 	
-	  // link
-	  dn = add_primary_dentry(dname, in, first, last);
-	  dout(12) << "_fetched  got " << *dn << " " << *in << dendl;
+	// symlink?
+	if (in->is_symlink()) 
+	  in->symlink = symlink;
+	
+	in->dirfragtree.swap(fragtree);
+	in->xattrs.swap(xattrs);
+	in->decode_snap_blob(snapbl);
+	in->old_inodes.swap(old_inodes);
+	if (snaps)
+	  in->purge_stale_snap_data(*snaps);
+
+	// add 
+	cache->add_inode( in );
+      
+	// link
+	dn = add_primary_dentry(dname, in, first, last);
+	dout(12) << "_fetched  got " << *dn << " " << *in << dendl;
 
-	  if (in->inode.is_dirty_rstat())
-	    in->mark_dirty_rstat();
+	if (in->inode.is_dirty_rstat())
+	  in->mark_dirty_rstat();
 
-	  //in->hack_accessed = false;
-	  //in->hack_load_stamp = ceph_clock_now(g_ceph_context);
-	  //num_new_inodes_loaded++;
-	}
+	//in->hack_accessed = false;
+	//in->hack_load_stamp = ceph_clock_now(g_ceph_context);
+	//num_new_inodes_loaded++;
       }
-    } else {
-      dout(1) << "corrupt directory, i got tag char '" << type << "' val " << (int)(type)
-	      << " at offset " << p.get_off() << dendl;
-      assert(0);
     }
+  } else {
+    dout(1) << "corrupt directory, i got tag char '" << type << "' val " << (int)(type)
+	    << " for '" << key << "'" << dendl;
+    assert(0);
+  }
     
-    if (dn && want_dn.length() && want_dn == dname) {
-      dout(10) << " touching wanted dn " << *dn << dendl;
-      inode->mdcache->touch_dentry(dn);
-    }
-
-    /** clean underwater item?
-     * Underwater item is something that is dirty in our cache from
-     * journal replay, but was previously flushed to disk before the
-     * mds failed.
-     *
-     * We only do this is committed_version == 0. that implies either
-     * - this is a fetch after from a clean/empty CDir is created
-     *   (and has no effect, since the dn won't exist); or
-     * - this is a fetch after _recovery_, which is what we're worried 
-     *   about.  Items that are marked dirty from the journal should be
-     *   marked clean if they appear on disk.
-     */
-    if (committed_version == 0 &&     
-	dn &&
-	dn->get_version() <= got_fnode.version &&
-	dn->is_dirty()) {
-      dout(10) << "_fetched  had underwater dentry " << *dn << ", marking clean" << dendl;
-      dn->mark_clean();
+  if (dn && want_dn.length() && want_dn == dname) {
+    dout(10) << " touching wanted dn " << *dn << dendl;
+    inode->mdcache->touch_dentry(dn);
+  }
+
+  /** clean underwater item?
+   * Underwater item is something that is dirty in our cache from
+   * journal replay, but was previously flushed to disk before the
+   * mds failed.
+   *
+   * We only do this is committed_version == 0. that implies either
+   * - this is a fetch after from a clean/empty CDir is created
+   *   (and has no effect, since the dn won't exist); or
+   * - this is a fetch after _recovery_, which is what we're worried 
+   *   about.  Items that are marked dirty from the journal should be
+   *   marked clean if they appear on disk.
+   */
+  if (committed_version == 0 &&     
+      dn &&
+      dn->get_version() <= fnode_version &&
+      dn->is_dirty()) {
+    dout(10) << "_fetched  had underwater dentry " << *dn << ", marking clean" << dendl;
+    dn->mark_clean();
 
-      if (dn->get_linkage()->get_inode()) {
-	assert(dn->get_linkage()->get_inode()->get_version() <= got_fnode.version);
-	dout(10) << "_fetched  had underwater inode " << *dn->get_linkage()->get_inode() << ", marking clean" << dendl;
-	dn->get_linkage()->get_inode()->mark_clean();
-      }
+    if (dn->get_linkage()->get_inode()) {
+      assert(dn->get_linkage()->get_inode()->get_version() <= fnode_version);
+      dout(10) << "_fetched  had underwater inode " << *dn->get_linkage()->get_inode() << ", marking clean" << dendl;
+      dn->get_linkage()->get_inode()->mark_clean();
     }
   }
-  if (!p.end()) {
-    clog.warn() << "dir " << dirfrag() << " has "
-	<< bl.length() - p.get_off() << " extra bytes\n";
-  }
-
-  //cache->mds->logger->inc("newin", num_new_inodes_loaded);
-  //hack_num_accessed = 0;
+  return dn;
+}
 
+void CDir::_fetched_finish(bool purged_any)
+{
   if (purged_any)
     log_mark_dirty();
 
@@ -1687,6 +1929,19 @@ public:
   }
 };
 
+class C_Dir_OMAP_Probed : public Context {
+  CDir *dir;
+  version_t want;
+public:
+  bufferlist hdrbl;
+  int ret;
+  C_Dir_OMAP_Probed(CDir *d, version_t v) : dir(d), want(v), ret(0) { }
+  void finish(int r) {
+    if (r >= 0) r = ret;
+    dir->_probed_omap(hdrbl, r, want);
+  }
+};
+
 class C_Dir_Committed : public Context {
   CDir *dir;
   version_t version, last_renamed_version;
@@ -1703,12 +1958,19 @@ public:
  * If the bufferlist we're using exceeds max_write_size, bail out
  * and switch to _commit_partial -- it can safely break itself into
  * multiple non-atomic writes.
+ *
+ * With omap dirfrags there is no blob to replace; we (re)write every
+ * dentry's key instead, which is also how a TMAP dirfrag gets
+ * converted.
  */
 CDir::map_t::iterator CDir::_commit_full(ObjectOperation& m, const set<snapid_t> *snaps,
                                unsigned max_write_size)
 {
   dout(10) << "_commit_full" << dendl;
 
+  if (g_conf->mds_dir_omap)
+    return _commit_partial(m, snaps, max_write_size, map_t::iterator(), true);
+
   // encode
   bufferlist bl;
   __u32 n = 0;
@@ -1765,21 +2027,34 @@ CDir::map_t::iterator CDir::_commit_full(ObjectOperation& m, const set<snapid_t>
  * in only the first changeset -- our caller is responsible for making sure
  * that changeset doesn't go through until after all the others do, if it's
  * necessary.
+ *
+ * For omap dirfrags, @a all writes out clean dentries too.
  */
 CDir::map_t::iterator CDir::_commit_partial(ObjectOperation& m,
                                   const set<snapid_t> *snaps,
                                   unsigned max_write_size,
-                                  map_t::iterator last_committed_dn)
+                                  map_t::iterator last_committed_dn,
+                                  bool all)
 {
-  dout(10) << "_commit_partial" << dendl;
+  dout(10) << "_commit_partial" << (all ? " all" : "") << dendl;
+  bool omap = g_conf->mds_dir_omap;
   bufferlist finalbl;
+  map<string, bufferlist> to_set;
+  set<string> to_remove;
+  unsigned len = 0;
 
   // header
   if (last_committed_dn == map_t::iterator()) {
     bufferlist header;
     ::encode(fnode, header);
-    finalbl.append(CEPH_OSD_TMAP_HDR);
-    ::encode(header, finalbl);
+    if (omap) {
+      len += header.length();
+      m.omap_set_header(header);
+    } else {
+      finalbl.append(CEPH_OSD_TMAP_HDR);
+      ::encode(header, finalbl);
+      len = finalbl.length();
+    }
   }
 
   // updated dentries
@@ -1787,28 +2062,61 @@ CDir::map_t::iterator CDir::_commit_partial(ObjectOperation& m,
   if(last_committed_dn != map_t::iterator())
     p = last_committed_dn;
 
-  while (p != items.end() && finalbl.length() < max_write_size) {
+  while (p != items.end() && len < max_write_size) {
     CDentry *dn = p->second;
     ++p;
     
-    if (snaps && dn->last != CEPH_NOSNAP &&
-	try_trim_snap_dentry(dn, *snaps))
-      continue;
+    if (snaps && dn->last != CEPH_NOSNAP) {
+      string key;
+      if (omap)
+	key = dn->key().str();
+      if (try_trim_snap_dentry(dn, *snaps)) {
+	if (omap) {
+	  len += key.length();
+	  to_remove.insert(key);
+	}
+	continue;
+      }
+    }
 
-    if (!dn->is_dirty())
+    if (!dn->is_dirty() && (!omap || !all || dn->get_linkage()->is_null()))
       continue;  // skip clean dentries
 
     if (dn->get_linkage()->is_null()) {
       dout(10) << " rm " << dn->name << " " << *dn << dendl;
-      finalbl.append(CEPH_OSD_TMAP_RM);
-      dn->key().encode(finalbl);
+      if (omap) {
+	string key = dn->key().str();
+	len += key.length();
+	to_remove.insert(key);
+      } else {
+	finalbl.append(CEPH_OSD_TMAP_RM);
+	dn->key().encode(finalbl);
+	len = finalbl.length();
+      }
     } else {
       dout(10) << " set " << dn->name << " " << *dn << dendl;
-      finalbl.append(CEPH_OSD_TMAP_SET);
-      _encode_dentry(dn, finalbl, snaps);
+      if (omap) {
+	string key = dn->key().str();
+	bufferlist& v = to_set[key];
+	_encode_dentry_value(dn, v, snaps);
+	len += key.length() + v.length();
+      } else {
+	finalbl.append(CEPH_OSD_TMAP_SET);
+	_encode_dentry(dn, finalbl, snaps);
+	len = finalbl.length();
+      }
     }
   }
 
+  if (omap) {
+    // one key per dentry: only the delta goes over the wire
+    if (!to_set.empty())
+      m.omap_set(to_set);
+    if (!to_remove.empty())
+      m.omap_rm_keys(to_remove);
+    return p;
+  }
+
   // update the trivialmap at the osd
   m.tmap_update(finalbl);
   return p;
@@ -1817,14 +2125,18 @@ CDir::map_t::iterator CDir::_commit_partial(ObjectOperation& m,
 void CDir::_encode_dentry(CDentry *dn, bufferlist& bl,
 			  const set<snapid_t> *snaps)
 {
-  // clear dentry NEW flag, if any.  we can no longer silently drop it.
-  dn->clear_new();
-
   dn->key().encode(bl);
 
-  ceph_le32 plen = init_le32(0);
-  unsigned plen_off = bl.length();
-  ::encode(plen, bl);
+  bufferlist v;
+  _encode_dentry_value(dn, v, snaps);
+  ::encode(v, bl);
+}
+
+void CDir::_encode_dentry_value(CDentry *dn, bufferlist& bl,
+				const set<snapid_t> *snaps)
+{
+  // clear dentry NEW flag, if any.  we can no longer silently drop it.
+  dn->clear_new();
 
   ::encode(dn->first, bl);
 
@@ -1865,12 +2177,6 @@ void CDir::_encode_dentry(CDentry *dn, bufferlist& bl,
       in->purge_stale_snap_data(*snaps);
     ::encode(in->old_inodes, bl);
   }
-  
-  plen = bl.length() - plen_off - sizeof(__u32);
-
-  ceph_le32 eplen;
-  eplen = plen;
-  bl.copy_in(plen_off, sizeof(eplen), (char*)&eplen);
 }
 
 
@@ -1903,8 +2209,15 @@ void CDir::_commit(version_t want)
     return;
   }
   
+  // for omap, a partial commit is only safe once the object has been
+  // converted.  if we never read it, see whether it has a header.
+  if (!is_complete() && g_conf->mds_dir_omap && !state_test(STATE_OMAP)) {
+    _probe_omap(want);
+    return;
+  }
+
   // complete first?  (only if we're not using TMAPUP osd op)
-  if (!g_conf->mds_use_tmap && !is_complete()) {
+  if (!is_complete() && !g_conf->mds_dir_omap && !g_conf->mds_use_tmap) {
     dout(7) << "commit not complete, fetching first" << dendl;
     if (cache->mds->logger) cache->mds->logger->inc(l_mds_dir_ffc);
     fetch(new C_Dir_RetryCommit(this, want));
@@ -1944,10 +2257,21 @@ void CDir::_commit(version_t want)
   //        in that case!!
   max_write_size -= inode->encode_parent_mutation(m);
 
+  bool full = false;
+  bool converting = g_conf->mds_dir_omap && !state_test(STATE_OMAP);
   if (is_complete() &&
-      (num_dirty > (num_head_items*g_conf->mds_dir_commit_ratio))) {
+      ((num_dirty > (num_head_items*g_conf->mds_dir_commit_ratio)) ||
+       converting)) {
     fnode.snap_purged_thru = realm->get_last_destroyed();
     committed_dn = _commit_full(m, snaps, max_write_size);
+    full = g_conf->mds_dir_omap;
+    if (converting) {
+      // drop the old tmap along with the header, which goes out last.
+      // fetches only look for a tmap when there is no header.
+      m.truncate(0);
+    }
+    if (full)
+      state_set(STATE_OMAP);
   } else {
     committed_dn = _commit_partial(m, snaps, max_write_size);
   }
@@ -1968,7 +2292,7 @@ void CDir::_commit(version_t want)
 		      inode->inode.last_renamed_version));
     while (committed_dn != items.end()) {
       ObjectOperation n = ObjectOperation();
-      committed_dn = _commit_partial(n, snaps, max_write_size, committed_dn);
+      committed_dn = _commit_partial(n, snaps, max_write_size, committed_dn, full);
       cache->mds->objecter->mutate(oid, oloc, n, snapc, ceph_clock_now(g_ceph_context), 0, NULL,
                                   gather.new_sub());
     }
@@ -1989,6 +2313,44 @@ void CDir::_commit(version_t want)
 }
 
 
+/*
+ * an incomplete dir (one we only know from the journal, say) may or
+ * may not have been converted to omap yet.  rather than fetching all
+ * of it and rewriting it in full, read just the omap header: if there
+ * is one, dirty dentries can be committed as usual.  only a dirfrag
+ * that is still a TMAP has to be fetched and converted.
+ */
+void CDir::_probe_omap(version_t want)
+{
+  dout(10) << "_probe_omap on " << *this << dendl;
+  auth_pin(this);
+
+  C_Dir_OMAP_Probed *fin = new C_Dir_OMAP_Probed(this, want);
+  object_t oid = get_ondisk_object();
+  object_locator_t oloc(cache->mds->mdsmap->get_metadata_pg_pool());
+  ObjectOperation rd;
+  rd.omap_get_header(&fin->hdrbl, &fin->ret);
+  cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, fin);
+}
+
+void CDir::_probed_omap(bufferlist& hdrbl, int r, version_t want)
+{
+  dout(10) << "_probed_omap r=" << r << " header " << hdrbl.length()
+	   << " bytes on " << *this << dendl;
+  auth_unpin(this);
+
+  if (r == 0 && hdrbl.length())
+    state_set(STATE_OMAP);
+
+  if (state_test(STATE_OMAP) || is_complete()) {
+    _commit(want);
+  } else {
+    dout(7) << "_probed_omap not converted, fetching first" << dendl;
+    if (cache->mds->logger) cache->mds->logger->inc(l_mds_dir_ffc);
+    fetch(new C_Dir_RetryCommit(this, want));
+  }
+}
+
 /**
  * _committed
  *
@@ -41,6 +41,7 @@ class Context;
 class bloom_filter;
 
 class ObjectOperation;
+class C_Dir_OMAP_Fetched;
 
 ostream& operator<<(ostream& out, class CDir& dir);
 class CDir : public MDSCacheObject {
@@ -107,6 +108,7 @@ public:
   static const unsigned STATE_STICKY =        (1<<15);  // sticky pin due to inode stickydirs
   static const unsigned STATE_DNPINNEDFRAG =  (1<<16);  // dir is refragmenting
   static const unsigned STATE_ASSIMRSTAT =    (1<<17);  // assimilating inode->frag rstats
+  static const unsigned STATE_OMAP =          (1<<18);  // on-disk object is in omap format
 
   // common states
   static const unsigned STATE_CLEAN =  0;
@@ -115,7 +117,7 @@ public:
   // these state bits are preserved by an import/export
   // ...except if the directory is hashed, in which case none of them are!
   static const unsigned MASK_STATE_EXPORTED = 
-  (STATE_COMPLETE|STATE_DIRTY);
+  (STATE_COMPLETE|STATE_DIRTY|STATE_OMAP);
   static const unsigned MASK_STATE_IMPORT_KEPT = 
   (						  
    STATE_IMPORTING
@@ -274,6 +276,7 @@ protected:
   friend class MDCache;
   friend class MDiscover;
   friend class MDBalancer;
+  friend class bal_cache_tree_t;
 
   friend class CDirDiscover;
   friend class CDirExport;
@@ -319,6 +322,9 @@ protected:
     return num_dirty;
   }
 
+  // last time a client read this to the end, or readdir'd one of our
+  // subdirs after that; see Server::handle_client_readdir.
+  utime_t last_readdir_walk;
 
   // -- dentries and inodes --
  public:
@@ -473,7 +479,19 @@ private:
   }
   void fetch(Context *c, bool ignore_authpinnability=false);
   void fetch(Context *c, const string& want_dn, bool ignore_authpinnability=false);
+  void fetch_dentry(Context *c, const string& dname);
+  void _omap_fetch(C_Dir_OMAP_Fetched *fin);
+  void _omap_fetched(C_Dir_OMAP_Fetched *fin, int r);
+  void _fetched_dentry(bufferlist& hdrbl, map<string, bufferlist>& omap,
+		       const string& dname, int r, Context *c);
   void _fetched(bufferlist &bl, const string& want_dn);
+  void _fetched_missing();
+  const set<snapid_t> *_fetched_fnode(fnode_t& got_fnode, bool complete);
+  CDentry *_fetched_one(const string& key, bufferlist& dndata,
+			const set<snapid_t> *snaps,
+			const string& want_dn, version_t fnode_version,
+			bool *purged_any);
+  void _fetched_finish(bool purged_any);
 
   // -- commit --
   map<version_t, list<Context*> > waiting_for_commit;
@@ -481,12 +499,16 @@ private:
   void commit_to(version_t want);
   void commit(version_t want, Context *c, bool ignore_authpinnability=false);
   void _commit(version_t want);
+  void _probe_omap(version_t want);
+  void _probed_omap(bufferlist& hdrbl, int r, version_t want);
   map_t::iterator _commit_full(ObjectOperation& m, const set<snapid_t> *snaps,
                            unsigned max_write_size=-1);
   map_t::iterator _commit_partial(ObjectOperation& m, const set<snapid_t> *snaps,
                        unsigned max_write_size=-1,
-                       map_t::iterator last_committed_dn=map_t::iterator());
+                       map_t::iterator last_committed_dn=map_t::iterator(),
+                       bool all=false);
   void _encode_dentry(CDentry *dn, bufferlist& bl, const set<snapid_t> *snaps);
+  void _encode_dentry_value(CDentry *dn, bufferlist& bl, const set<snapid_t> *snaps);
   void _committed(version_t v, version_t last_renamed_version);
   void wait_for_commit(Context *c, version_t v=0);
 
@@ -689,8 +689,10 @@ void CInode::add_remote_parent(CDentry *p)
 void CInode::remove_remote_parent(CDentry *p) 
 {
   remote_parents.erase(p);
-  if (remote_parents.empty())
+  if (remote_parents.empty()) {
+    remote_parents.clear();
     put(PIN_REMOTEPARENT);
+  }
 }
 
 
@@ -1066,6 +1068,28 @@ void CInode::set_object_info(MDSCacheObjectInfo &info)
   info.snapid = last;
 }
 
+static bool lock_state_empty(const ceph_lock_state_t *s)
+{
+  return !s ||
+    (s->held_locks.empty() && s->waiting_locks.empty() &&
+     s->client_held_lock_counts.empty() && s->client_waiting_lock_counts.empty());
+}
+
+void CInode::_encode_file_locks(bufferlist& bl) const
+{
+  static const ceph_lock_state_t empty;
+  ::encode(fcntl_locks ? *fcntl_locks : empty, bl);
+  ::encode(flock_locks ? *flock_locks : empty, bl);
+}
+
+void CInode::_decode_file_locks(bufferlist::iterator& p)
+{
+  ::decode(*get_fcntl_lock_state(), p);
+  ::decode(*get_flock_lock_state(), p);
+  if (lock_state_empty(fcntl_locks) && lock_state_empty(flock_locks))
+    clear_file_locks();
+}
+
 void CInode::encode_lock_state(int type, bufferlist& bl)
 {
   ::encode(first, bl);
@@ -1189,8 +1213,7 @@ void CInode::encode_lock_state(int type, bufferlist& bl)
     break;
 
   case CEPH_LOCK_IFLOCK:
-    ::encode(fcntl_locks, bl);
-    ::encode(flock_locks, bl);
+    _encode_file_locks(bl);
     break;
 
   case CEPH_LOCK_IPOLICY:
@@ -1432,8 +1455,7 @@ void CInode::decode_lock_state(int type, bufferlist& bl)
     break;
 
   case CEPH_LOCK_IFLOCK:
-    ::decode(fcntl_locks, p);
-    ::decode(flock_locks, p);
+    _decode_file_locks(p);
     break;
 
   case CEPH_LOCK_IPOLICY:
@@ -2328,8 +2350,8 @@ void CInode::remove_client_cap(client_t client)
   mdcache->num_caps--;
 
   //clean up advisory locks
-  bool fcntl_removed = fcntl_locks.remove_all_from(client);
-  bool flock_removed = flock_locks.remove_all_from(client);
+  bool fcntl_removed = fcntl_locks ? fcntl_locks->remove_all_from(client) : false;
+  bool flock_removed = flock_locks ? flock_locks->remove_all_from(client) : false;
   if (fcntl_removed || flock_removed) {
     list<Context*> waiters;
     take_waiting(CInode::WAIT_FLOCK, waiters);
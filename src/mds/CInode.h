@@ -210,7 +210,7 @@ public:
   SnapRealm        *containing_realm;
   snapid_t          first, last;
   map<snapid_t, old_inode_t> old_inodes;  // key = last, value.first = first
-  set<snapid_t> dirty_old_rstats;
+  compact_set<snapid_t> dirty_old_rstats;
 
   bool is_multiversion() {
     return snaprealm ||  // other snaprealms will link to me
@@ -397,7 +397,7 @@ public:
  protected:
   // parent dentries in cache
   CDentry         *parent;             // primary link
-  set<CDentry*>    remote_parents;     // if hard linked
+  compact_set<CDentry*> remote_parents;     // if hard linked
 
   list<CDentry*>   projected_parent;   // for in-progress rename, (un)link, etc.
 
@@ -407,20 +407,44 @@ public:
 protected:
   // file capabilities
   map<client_t, Capability*> client_caps;         // client -> caps
-  map<int, int>         mds_caps_wanted;     // [auth] mds -> caps wanted
+  compact_map<int, int> mds_caps_wanted;     // [auth] mds -> caps wanted
   int                   replica_caps_wanted; // [replica] what i've requested from auth
 
-  map<int, set<client_t> > client_snap_caps;     // [auth] [snap] dirty metadata we still need from the head
+  compact_map<int, set<client_t> > client_snap_caps;     // [auth] [snap] dirty metadata we still need from the head
 public:
-  map<snapid_t, set<client_t> > client_need_snapflush;
+  compact_map<snapid_t, set<client_t> > client_need_snapflush;
 
   void add_need_snapflush(CInode *snapin, snapid_t snapid, client_t client);
   void remove_need_snapflush(CInode *snapin, snapid_t snapid, client_t client);
 
 protected:
 
-  ceph_lock_state_t fcntl_locks;
-  ceph_lock_state_t flock_locks;
+  // advisory locks; most inodes never see one, so allocate on demand
+  ceph_lock_state_t *fcntl_locks;
+  ceph_lock_state_t *flock_locks;
+
+public:
+  ceph_lock_state_t *get_fcntl_lock_state() {
+    if (!fcntl_locks)
+      fcntl_locks = new ceph_lock_state_t;
+    return fcntl_locks;
+  }
+  ceph_lock_state_t *get_flock_lock_state() {
+    if (!flock_locks)
+      flock_locks = new ceph_lock_state_t;
+    return flock_locks;
+  }
+  bool has_file_lock_state() const { return fcntl_locks || flock_locks; }
+  void clear_file_locks() {
+    delete fcntl_locks;
+    fcntl_locks = NULL;
+    delete flock_locks;
+    flock_locks = NULL;
+  }
+  void _encode_file_locks(bufferlist& bl) const;
+  void _decode_file_locks(bufferlist::iterator& p);
+
+protected:
 
   // LogSegment dlists i (may) belong to
 public:
@@ -469,6 +493,7 @@ private:
     parent(0),
     inode_auth(CDIR_AUTH_DEFAULT),
     replica_caps_wanted(0),
+    fcntl_locks(NULL), flock_locks(NULL),
     item_dirty(this), item_caps(this), item_open_file(this), item_renamed_file(this), 
     item_dirty_dirfrag_dir(this), 
     item_dirty_dirfrag_nest(this), 
@@ -498,6 +523,7 @@ private:
     g_num_inos++;
     close_dirfrags();
     close_snaprealm();
+    clear_file_locks();
   }
   
 
@@ -797,7 +823,7 @@ public:
   bool is_any_caps() { return !client_caps.empty(); }
   bool is_any_nonstale_caps() { return count_nonstale_caps(); }
 
-  map<int,int>& get_mds_caps_wanted() { return mds_caps_wanted; }
+  compact_map<int,int>& get_mds_caps_wanted() { return mds_caps_wanted; }
 
   map<client_t,Capability*>& get_client_caps() { return client_caps; }
   Capability *get_client_cap(client_t client) {
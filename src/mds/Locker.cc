@@ -1539,6 +1539,7 @@ void Locker::file_update_finish(CInode *in, Mutation *mut, bool share, client_t
       } else
 	p++;
     }
+    in->client_snap_caps.shrink();
     if (gather)
       eval_cap_gather(in, &need_issue);
   } else {
@@ -1883,8 +1884,10 @@ void Locker::handle_inode_file_caps(MInodeFileCaps *m)
 
   if (m->get_caps())
     in->mds_caps_wanted[from] = m->get_caps();
-  else
+  else {
     in->mds_caps_wanted.erase(from);
+    in->mds_caps_wanted.shrink();
+  }
 
   try_eval(in, CEPH_CAP_LOCKS);
   m->put();
@@ -2146,6 +2149,7 @@ void Locker::_do_null_snapflush(CInode *head_in, client_t client, snapid_t follo
       head_in->remove_need_snapflush(sin, snapid, client);
     }
   }
+  head_in->client_need_snapflush.shrink();
 }
 
 
@@ -2687,17 +2691,17 @@ bool Locker::_do_cap_update(CInode *in, Capability *cap,
     for ( int i=0; i < num_locks; ++i) {
       ceph_filelock decoded_lock;
       ::decode(decoded_lock, bli);
-      in->fcntl_locks.held_locks.
+      in->get_fcntl_lock_state()->held_locks.
 	insert(pair<uint64_t, ceph_filelock>(decoded_lock.start, decoded_lock));
-      ++in->fcntl_locks.client_held_lock_counts[(client_t)(decoded_lock.client)];
+      ++in->get_fcntl_lock_state()->client_held_lock_counts[(client_t)(decoded_lock.client)];
     }
     ::decode(num_locks, bli);
     for ( int i=0; i < num_locks; ++i) {
       ceph_filelock decoded_lock;
       ::decode(decoded_lock, bli);
-      in->flock_locks.held_locks.
+      in->get_flock_lock_state()->held_locks.
 	insert(pair<uint64_t, ceph_filelock>(decoded_lock.start, decoded_lock));
-      ++in->flock_locks.client_held_lock_counts[(client_t)(decoded_lock.client)];
+      ++in->get_flock_lock_state()->client_held_lock_counts[(client_t)(decoded_lock.client)];
     }
   }
 
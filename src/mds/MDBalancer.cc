@@ -15,6 +15,7 @@
 #include "mdstypes.h"
 
 #include "MDBalancer.h"
+#include "BalancerPolicy.h"
 #include "MDS.h"
 #include "mon/MonClient.h"
 #include "MDSMap.h"
@@ -29,6 +30,7 @@
 #include "messages/MMDSLoadTargets.h"
 
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <vector>
 #include <map>
@@ -99,6 +101,22 @@ void MDBalancer::tick()
     num_bal_times--;
   }
 
+  // exports held back by the migration rate limit
+  mds->mdcache->migrator->maybe_do_queued_export();
+
+  // hit trace
+  if (!trace && !g_conf->mds_bal_trace.empty()) {
+    dout(1) << "recording hit trace to " << g_conf->mds_bal_trace << dendl;
+    trace = new std::ofstream(g_conf->mds_bal_trace.c_str(), std::ios::out | std::ios::app);
+    *trace << std::fixed << std::setprecision(6);
+    traced.clear();
+  } else if (trace && g_conf->mds_bal_trace.empty()) {
+    dout(1) << "stopped recording hit trace" << dendl;
+    delete trace;
+    trace = NULL;
+    traced.clear();
+  }
+
   // hash?
   if (g_conf->mds_bal_frag && g_conf->mds_bal_fragment_interval > 0 &&
       now.sec() - last_fragment.sec() > g_conf->mds_bal_fragment_interval) {
@@ -641,6 +659,7 @@ void MDBalancer::try_rebalance()
 
 
   // do my exports!
+  scan_budget = g_conf->mds_bal_max_scan;
   set<CDir*> already_exporting;
   double total_sent = 0;
   double total_goal = 0;
@@ -767,7 +786,8 @@ void MDBalancer::try_rebalance()
     }
   }
 
-  dout(5) << "rebalance done" << dendl;
+  dout(5) << "rebalance done, looked at " << (g_conf->mds_bal_max_scan - scan_budget)
+	  << " dentries" << dendl;
   show_imports();
 }
 
@@ -830,122 +850,68 @@ bool MDBalancer::check_targets()
   return ok;
 }
 
-void MDBalancer::find_exports(CDir *dir,
-                              double amount,
-                              list<CDir*>& exports,
-                              double& have,
-                              set<CDir*>& already_exporting)
-{
-  double need = amount - have;
-  if (need < amount * g_conf->mds_bal_min_start)
-    return;   // good enough!
-  double needmax = need * g_conf->mds_bal_need_max;
-  double needmin = need * g_conf->mds_bal_need_min;
-  double midchunk = need * g_conf->mds_bal_midchunk;
-  double minchunk = need * g_conf->mds_bal_minchunk;
-
-  list<CDir*> bigger_rep, bigger_unrep;
-  multimap<double, CDir*> smaller;
-
-  double dir_pop = dir->pop_auth_subtree.meta_load(rebalance_time, mds->mdcache->decayrate);
-  dout(7) << " find_exports in " << dir_pop << " " << *dir << " need " << need << " (" << needmin << " - " << needmax << ")" << dendl;
-
-  double subdir_sum = 0;
-  for (CDir::map_t::iterator it = dir->begin();
-       it != dir->end();
-       it++) {
-    CInode *in = it->second->get_linkage()->get_inode();
-    if (!in) continue;
-    if (!in->is_dir()) continue;
-
-    list<CDir*> dfls;
-    in->get_dirfrags(dfls);
-    for (list<CDir*>::iterator p = dfls.begin();
-	 p != dfls.end();
-	 ++p) {
-      CDir *subdir = *p;
-      if (!subdir->is_auth()) continue;
-      if (already_exporting.count(subdir)) continue;
-
-      if (subdir->is_frozen()) continue;  // can't export this right now!
-
-      // how popular?
-      double pop = subdir->pop_auth_subtree.meta_load(rebalance_time, mds->mdcache->decayrate);
-      subdir_sum += pop;
-      dout(15) << "   subdir pop " << pop << " " << *subdir << dendl;
-
-      if (pop < minchunk) continue;
-
-      // lucky find?
-      if (pop > needmin && pop < needmax) {
-	exports.push_back(subdir);
-	already_exporting.insert(subdir);
-	have += pop;
-	return;
-      }
-
-      if (pop > need) {
-	if (subdir->is_rep())
-	  bigger_rep.push_back(subdir);
-	else
-	  bigger_unrep.push_back(subdir);
-      } else
-	smaller.insert(pair<double,CDir*>(pop, subdir));
-    }
-  }
-  dout(15) << "   sum " << subdir_sum << " / " << dir_pop << dendl;
-
-  // grab some sufficiently big small items
-  multimap<double,CDir*>::reverse_iterator it;
-  for (it = smaller.rbegin();
-       it != smaller.rend();
-       it++) {
-
-    if ((*it).first < midchunk)
-      break;  // try later
+/*
+ * the cache, as seen by bal_find_exports()
+ */
+class bal_cache_tree_t {
+  MDS *mds;
+  utime_t now;
+public:
+  typedef CDir* node_t;
 
-    dout(7) << "   taking smaller " << *(*it).second << dendl;
+  bal_cache_tree_t(MDS *m, utime_t n) : mds(m), now(n) {}
 
-    exports.push_back((*it).second);
-    already_exporting.insert((*it).second);
-    have += (*it).first;
-    if (have > needmin)
-      return;
+  double pop(CDir *dir) {
+    return dir->pop_auth_subtree.meta_load(now, mds->mdcache->decayrate);
   }
-
-  // apprently not enough; drill deeper into the hierarchy (if non-replicated)
-  for (list<CDir*>::iterator it = bigger_unrep.begin();
-       it != bigger_unrep.end();
-       it++) {
-    dout(15) << "   descending into " << **it << dendl;
-    find_exports(*it, amount, exports, have, already_exporting);
-    if (have > needmin)
-      return;
+  bool is_rep(CDir *dir) {
+    return dir->is_rep();
   }
-
-  // ok fine, use smaller bits
-  for (;
-       it != smaller.rend();
-       it++) {
-    dout(7) << "   taking (much) smaller " << it->first << " " << *(*it).second << dendl;
-
-    exports.push_back((*it).second);
-    already_exporting.insert((*it).second);
-    have += (*it).first;
-    if (have > needmin)
-      return;
+  int get_subdirs(CDir *dir, list<CDir*>& ls) {
+    dout(7) << " find_exports in " << pop(dir) << " " << *dir << dendl;
+    int n = 0;
+    for (CDir::map_t::iterator it = dir->begin();
+	 it != dir->end();
+	 it++) {
+      n++;
+      CInode *in = it->second->get_linkage()->get_inode();
+      if (!in) continue;
+      if (!in->is_dir()) continue;
+
+      list<CDir*> dfls;
+      in->get_dirfrags(dfls);
+      for (list<CDir*>::iterator p = dfls.begin();
+	   p != dfls.end();
+	   ++p) {
+	CDir *subdir = *p;
+	if (!subdir->is_auth()) continue;
+	if (subdir->is_frozen()) continue;  // can't export this right now!
+	dout(15) << "   subdir pop " << pop(subdir) << " " << *subdir << dendl;
+	ls.push_back(subdir);
+      }
+    }
+    return n;
   }
-
-  // ok fine, drill into replicated dirs
-  for (list<CDir*>::iterator it = bigger_rep.begin();
-       it != bigger_rep.end();
-       it++) {
-    dout(7) << "   descending into replicated " << **it << dendl;
-    find_exports(*it, amount, exports, have, already_exporting);
-    if (have > needmin)
-      return;
+  void taking(CDir *dir, double pop, const char *why) {
+    dout(7) << "   taking " << why << " " << pop << " " << *dir << dendl;
   }
+  void descending(CDir *dir) {
+    dout(15) << "   descending into " << *dir << dendl;
+  }
+};
 
+void MDBalancer::find_exports(CDir *dir,
+                              double amount,
+                              list<CDir*>& exports,
+                              double& have,
+                              set<CDir*>& already_exporting)
+{
+  bal_cache_tree_t t(mds, rebalance_time);
+  bal_export_params_t params(g_conf);
+  bal_find_exports(t, dir, amount, params, exports, have, already_exporting,
+		   scan_budget);
+  if (scan_budget <= 0)
+    dout(5) << " find_exports hit mds_bal_max_scan, going with " << have << dendl;
 }
 
 void MDBalancer::hit_inode(utime_t now, CInode *in, int type, int who)
@@ -985,8 +951,33 @@ void MDBalancer::hit_inode(utime_t now, CInode *in, int type, int who)
 */
 
 
+/*
+ * one line per hit, plus one per dirfrag (before its first hit) giving
+ * its parent, so that test/mds_balancer_sim can rebuild the tree.
+ */
+void MDBalancer::trace_hit(utime_t now, CDir *dir, int type, double amount)
+{
+  list<CDir*> path;
+  for (CDir *d = dir; d && !traced.count(d->dirfrag()); d = d->inode->get_parent_dir())
+    path.push_front(d);
+  for (list<CDir*>::iterator p = path.begin(); p != path.end(); ++p) {
+    CDir *parent = (*p)->inode->get_parent_dir();
+    *trace << "d " << (*p)->dirfrag() << " ";
+    if (parent)
+      *trace << parent->dirfrag();
+    else
+      *trace << "-";
+    *trace << "\n";
+    traced.insert((*p)->dirfrag());
+  }
+  *trace << "h " << (double)now << " " << dir->dirfrag() << " " << type << " " << amount << "\n";
+}
+
 void MDBalancer::hit_dir(utime_t now, CDir *dir, int type, int who, double amount)
 {
+  if (trace)
+    trace_hit(now, dir, type, amount);
+
   // hit me
   double v = dir->pop_me.get(type).hit(now, amount);
 
@@ -19,6 +19,7 @@
 
 #include <list>
 #include <map>
+#include <fstream>
 using std::list;
 using std::map;
 
@@ -64,6 +65,13 @@ class MDBalancer {
   map<int32_t, int> old_prev_targets;  // # iterations they _haven't_ been targets
   bool check_targets();
 
+  int scan_budget;  // dentries find_exports may still look at this rebalance
+
+  // hit trace, for the offline simulator
+  std::ofstream *trace;
+  set<dirfrag_t> traced;
+  void trace_hit(utime_t now, CDir *dir, int type, double amount);
+
   double try_match(int ex, double& maxex,
                    int im, double& maxim);
   double get_maxim(int im) {
@@ -77,7 +85,12 @@ public:
   MDBalancer(MDS *m) : 
     mds(m),
     beat_epoch(0),
-    last_epoch_under(0), last_epoch_over(0) { }
+    last_epoch_under(0), last_epoch_over(0),
+    scan_budget(0),
+    trace(NULL) { }
+  ~MDBalancer() {
+    delete trace;
+  }
   
   mds_load_t get_load(utime_t);
 
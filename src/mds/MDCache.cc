@@ -96,6 +96,7 @@ using namespace std;
 extern struct ceph_file_layout g_default_file_layout;
 
 #include "common/config.h"
+#include "common/Formatter.h"
 #include "include/assert.h"
 
 #define dout_subsys ceph_subsys_mds
@@ -6036,6 +6037,7 @@ void MDCache::inode_remove_replica(CInode *in, int from)
 {
   in->remove_replica(from);
   in->mds_caps_wanted.erase(from);
+  in->mds_caps_wanted.shrink();
   
   // note: this code calls _eval more often than it needs to!
   // fix lock
@@ -6782,7 +6784,10 @@ int MDCache::path_traverse(MDRequest *mdr, Message *req, Context *fin,     // wh
 	// directory isn't complete; reload
         dout(7) << "traverse: incomplete dir contents for " << *cur << ", fetching" << dendl;
         touch_inode(cur);
-        curdir->fetch(_get_waiter(mdr, req, fin), path[depth]);
+	if (snapid == CEPH_NOSNAP)
+	  curdir->fetch_dentry(_get_waiter(mdr, req, fin), path[depth]);
+	else
+	  curdir->fetch(_get_waiter(mdr, req, fin), path[depth]);
 	if (mds->logger) mds->logger->inc(l_mds_tdirf);
         return 1;
       }
@@ -10171,6 +10176,111 @@ void MDCache::dump_cache(const char *fn)
 }
 
 
+/*
+ * approximate bytes held by the cache, by object type.  containers are
+ * estimated as one tree node per element; this is meant for comparing
+ * configurations and spotting growth, not for exact accounting.
+ */
+void MDCache::dump_memory(ostream& ss)
+{
+  uint64_t inode_bytes = 0, inode_extra = 0;
+  uint64_t dir_count = 0, dir_bytes = 0;
+  uint64_t dn_count = 0, dn_bytes = 0, dn_name_bytes = 0;
+  uint64_t cap_count = 0;
+  uint64_t compact_bytes = 0, compact_allocated = 0;
+  uint64_t lock_states = 0;
+
+  for (hash_map<vinodeno_t,CInode*>::iterator it = inode_map.begin();
+       it != inode_map.end();
+       ++it) {
+    CInode *in = it->second;
+    inode_bytes += sizeof(CInode);
+    inode_extra += in->symlink.length();
+    for (map<string,bufferptr>::iterator p = in->xattrs.begin(); p != in->xattrs.end(); ++p)
+      inode_extra += p->first.length() + p->second.length();
+    inode_extra += in->old_inodes.size() * sizeof(old_inode_t);
+    cap_count += in->client_caps.size();
+
+    compact_bytes += in->get_compact_mem_usage() +
+      in->dirty_old_rstats.mem_usage() +
+      in->remote_parents.mem_usage() +
+      in->mds_caps_wanted.mem_usage() +
+      in->client_snap_caps.mem_usage() +
+      in->client_need_snapflush.mem_usage();
+    compact_allocated += in->get_compact_allocated() +
+      in->dirty_old_rstats.allocated() + in->remote_parents.allocated() +
+      in->mds_caps_wanted.allocated() + in->client_snap_caps.allocated() +
+      in->client_need_snapflush.allocated();
+    if (in->fcntl_locks)
+      lock_states++;
+    if (in->flock_locks)
+      lock_states++;
+
+    list<CDir*> dfs;
+    in->get_dirfrags(dfs);
+    for (list<CDir*>::iterator p = dfs.begin(); p != dfs.end(); ++p) {
+      CDir *dir = *p;
+      dir_count++;
+      dir_bytes += sizeof(CDir) + dir->items.size() * 4 * sizeof(void*);
+      compact_bytes += dir->get_compact_mem_usage();
+      compact_allocated += dir->get_compact_allocated();
+      for (CDir::map_t::iterator q = dir->items.begin(); q != dir->items.end(); ++q) {
+	CDentry *dn = q->second;
+	dn_count++;
+	dn_bytes += sizeof(CDentry);
+	dn_name_bytes += dn->name.length();
+	compact_bytes += dn->get_compact_mem_usage() + dn->client_lease_map.mem_usage();
+	compact_allocated += dn->get_compact_allocated() +
+	  dn->client_lease_map.allocated();
+      }
+    }
+  }
+
+  uint64_t interned_count = 0, interned_bytes = 0;
+  CDentry::get_interned_name_stats(&interned_count, &interned_bytes);
+  if (interned_count)
+    dn_name_bytes = interned_bytes;
+
+  uint64_t cap_bytes = cap_count * sizeof(Capability);
+  uint64_t lock_bytes = lock_states * sizeof(ceph_lock_state_t);
+  uint64_t total = inode_bytes + inode_extra + dir_bytes + dn_bytes + dn_name_bytes +
+    cap_bytes + compact_bytes + lock_bytes;
+
+  JSONFormatter jf(true);
+  jf.open_object_section("cache_memory");
+  jf.open_object_section("inodes");
+  jf.dump_unsigned("count", inode_map.size());
+  jf.dump_unsigned("bytes", inode_bytes);
+  jf.dump_unsigned("symlink_xattr_old_inode_bytes", inode_extra);
+  jf.close_section();
+  jf.open_object_section("dirfrags");
+  jf.dump_unsigned("count", dir_count);
+  jf.dump_unsigned("bytes", dir_bytes);
+  jf.close_section();
+  jf.open_object_section("dentries");
+  jf.dump_unsigned("count", dn_count);
+  jf.dump_unsigned("bytes", dn_bytes);
+  jf.dump_unsigned("name_bytes", dn_name_bytes);
+  jf.dump_unsigned("names_interned", interned_count);
+  jf.close_section();
+  jf.open_object_section("caps");
+  jf.dump_unsigned("count", cap_count);
+  jf.dump_unsigned("bytes", cap_bytes);
+  jf.close_section();
+  jf.open_object_section("compact_containers");
+  jf.dump_unsigned("allocated", compact_allocated);
+  jf.dump_unsigned("bytes", compact_bytes);
+  jf.close_section();
+  jf.open_object_section("file_lock_states");
+  jf.dump_unsigned("count", lock_states);
+  jf.dump_unsigned("bytes", lock_bytes);
+  jf.close_section();
+  jf.dump_unsigned("total_bytes", total);
+  jf.close_section();
+  jf.flush(ss);
+}
+
+
 
 C_MDS_RetryRequest::C_MDS_RetryRequest(MDCache *c, MDRequest *r)
   : cache(c), mdr(r)
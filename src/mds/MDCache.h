@@ -891,6 +891,7 @@ private:
  public:
   void show_cache();
   void dump_cache(const char *fn=0);
+  void dump_memory(ostream& ss);
   void show_subtrees(int dbl=10);
 
   CInode *hack_pick_random_inode() {
@@ -67,7 +67,16 @@ void MDLog::create_logger()
   plb.add_u64(l_mdl_expos, "expos");
   plb.add_u64(l_mdl_wrpos, "wrpos");
   plb.add_u64(l_mdl_rdpos, "rdpos");
-  plb.add_u64(l_mdl_jlat, "jlat");
+  plb.add_fl_avg(l_mdl_jlat, "jlat");
+  plb.add_u64_counter(l_mdl_jwr, "jwr");
+  plb.add_u64_counter(l_mdl_jwrbytes, "jwrbytes");
+  plb.add_u64(l_mdl_jwrbps, "jwrbps");
+  plb.add_fl_avg(l_mdl_evlat, "evlat");
+  plb.add_u64_counter(l_mdl_jrd, "jrd");
+  plb.add_u64_counter(l_mdl_jrdbytes, "jrdbytes");
+  plb.add_fl_avg(l_mdl_jrdlat, "jrdlat");
+  plb.add_u64(l_mdl_jrdahead, "jrdahead");
+  plb.add_u64_counter(l_mdl_jrdstall, "jrdstall");
 
   // logger
   logger = plb.create_perf_counters();
@@ -85,6 +94,9 @@ void MDLog::init_journaler()
 			    logger, l_mdl_jlat,
 			    &mds->timer);
   assert(journaler->is_readonly());
+  journaler->set_write_logger_keys(l_mdl_jwr, l_mdl_jwrbytes);
+  journaler->set_read_logger_keys(l_mdl_jrd, l_mdl_jrdbytes, l_mdl_jrdlat,
+				  l_mdl_jrdahead, l_mdl_jrdstall);
   journaler->set_write_error_handler(new C_MDL_WriteError(this));
 }
 
@@ -104,6 +116,23 @@ void MDLog::write_head(Context *c)
   journaler->write_head(c);
 }
 
+void MDLog::flush_logger()
+{
+  if (!logger || !journaler || journaler->is_readonly())
+    return;
+
+  // bytes/sec made safe in the journal since the last call
+  utime_t now = ceph_clock_now(g_ceph_context);
+  uint64_t pos = journaler->get_write_safe_pos();
+  if (last_rate_stamp != utime_t() && pos >= last_rate_pos) {
+    double dur = now - last_rate_stamp;
+    if (dur > 0)
+      logger->set(l_mdl_jwrbps, (uint64_t)((double)(pos - last_rate_pos) / dur));
+  }
+  last_rate_stamp = now;
+  last_rate_pos = pos;
+}
+
 uint64_t MDLog::get_read_pos()
 {
   return journaler->get_read_pos(); 
@@ -164,6 +193,30 @@ void MDLog::start_entry(LogEvent *e)
   e->set_start_off(get_write_pos());
 }
 
+class C_MDL_Safe : public Context {
+  MDLog *mdlog;
+  utime_t stamp;
+  Context *fin;
+public:
+  C_MDL_Safe(MDLog *m, utime_t s, Context *c) : mdlog(m), stamp(s), fin(c) {}
+  void finish(int r) {
+    mdlog->_event_safe(stamp);
+    if (fin) {
+      fin->finish(r);
+      delete fin;
+    }
+  }
+};
+
+void MDLog::_event_safe(utime_t stamp)
+{
+  if (logger) {
+    utime_t lat = ceph_clock_now(g_ceph_context);
+    lat -= stamp;
+    logger->finc(l_mdl_evlat, lat);
+  }
+}
+
 void MDLog::submit_entry(LogEvent *le, Context *c) 
 {
   assert(!mds->is_any_replay());
@@ -212,8 +265,10 @@ void MDLog::submit_entry(LogEvent *le, Context *c)
 
   unflushed++;
 
-  if (c)
-    journaler->wait_for_flush(c);
+  // the journaler groups whatever is appended between flushes (and
+  // while earlier writes are in flight) into a single write; time each
+  // event from submission until that write is safe.
+  journaler->wait_for_flush(new C_MDL_Safe(this, le->get_stamp(), c));
   
   // start a new segment?
   //  FIXME: should this go elsewhere?
@@ -473,85 +528,201 @@ public:
 
 
 
+// -- parallel decode --
+
+void MDLog::_replay_start_decoders()
+{
+  assert(replay_decoders.empty());
+  replay_decode_stop = false;
+  for (int i = 0; i < g_conf->mds_replay_threads; i++) {
+    ReplayDecodeThread *t = new ReplayDecodeThread(this);
+    t->create();
+    replay_decoders.push_back(t);
+  }
+  dout(10) << "_replay_start_decoders started " << replay_decoders.size() << " decode threads" << dendl;
+}
+
+void MDLog::_replay_stop_decoders()
+{
+  replay_decode_lock.Lock();
+  assert(replay_decode_queue.empty());
+  replay_decode_stop = true;
+  replay_decode_cond.SignalAll();
+  replay_decode_lock.Unlock();
+
+  for (vector<ReplayDecodeThread*>::iterator p = replay_decoders.begin();
+       p != replay_decoders.end();
+       ++p) {
+    (*p)->join();
+    delete *p;
+  }
+  replay_decoders.clear();
+}
+
+// i am one of several decode threads.  no mds_lock here!
+void MDLog::_replay_decode_thread()
+{
+  replay_decode_lock.Lock();
+  while (true) {
+    if (replay_decode_queue.empty()) {
+      if (replay_decode_stop)
+	break;
+      replay_decode_cond.Wait(replay_decode_lock);
+      continue;
+    }
+    ReplayEntry *e = replay_decode_queue.front();
+    replay_decode_queue.pop_front();
+    replay_decode_lock.Unlock();
+
+    LogEvent *le = LogEvent::decode(e->bl);
+
+    replay_decode_lock.Lock();
+    e->le = le;
+    e->decoded = true;
+    replay_decoded_cond.SignalAll();
+  }
+  replay_decode_lock.Unlock();
+}
+
+void MDLog::_replay_queue_decode(ReplayEntry *e)
+{
+  Mutex::Locker l(replay_decode_lock);
+  replay_decode_queue.push_back(e);
+  replay_decode_cond.Signal();
+}
+
+/*
+ * wait for the oldest outstanding entry to be decoded.  if no decode
+ * thread has picked it up yet, just decode it here.  we are called
+ * with mds_lock held, but drop it while we wait so that timers and
+ * messages (e.g. beacons) can still go off.
+ */
+void MDLog::_replay_wait_decoded(ReplayEntry *e)
+{
+  replay_decode_lock.Lock();
+  if (e->decoded) {
+    replay_decode_lock.Unlock();
+    return;
+  }
+  if (!replay_decode_queue.empty() && replay_decode_queue.front() == e) {
+    replay_decode_queue.pop_front();
+    replay_decode_lock.Unlock();
+    e->le = LogEvent::decode(e->bl);
+    e->decoded = true;
+    return;
+  }
+  replay_decode_lock.Unlock();
+
+  mds->mds_lock.Unlock();
+  replay_decode_lock.Lock();
+  while (!e->decoded)
+    replay_decoded_cond.Wait(replay_decode_lock);
+  replay_decode_lock.Unlock();
+  mds->mds_lock.Lock();
+}
+
+
 // i am a separate thread
 void MDLog::_replay_thread()
 {
   mds->mds_lock.Lock();
   dout(10) << "_replay_thread start" << dendl;
 
+  _replay_start_decoders();
+  utime_t start = ceph_clock_now(g_ceph_context);
+  int start_events = num_events;
+
+  // entries read from the journal but not yet replayed, in journal order
+  list<ReplayEntry*> pending;
+  unsigned max_pending = MAX(1, g_conf->mds_replay_decode_ahead);
+
   // loop
   int r = 0;
   while (1) {
-    // wait for read?
-    while (!journaler->is_readable() &&
-	   journaler->get_read_pos() < journaler->get_write_pos() &&
-	   !journaler->get_error()) {
-      journaler->wait_for_readable(new C_MDL_Replay(this));
-      replay_cond.Wait(mds->mds_lock);
-    }
-    if (journaler->get_error()) {
-      r = journaler->get_error();
-      dout(0) << "_replay journaler got error " << r << ", aborting" << dendl;
-      if (r == -EINVAL) {
-        if (journaler->get_read_pos() < journaler->get_expire_pos()) {
-          // this should only happen if you're following somebody else
-          assert(journaler->is_readonly());
-          dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
-          r = -EAGAIN;
-        } else {
-          /* re-read head and check it
-           * Given that replay happens in a separate thread and
-           * the MDS is going to either shut down or restart when
-           * we return this error, doing it synchronously is fine
-           * -- as long as we drop the main mds lock--. */
-          Mutex mylock("MDLog::_replay_thread lock");
-          Cond cond;
-          bool done = false;
-          int err = 0;
-          journaler->reread_head(new C_SafeCond(&mylock, &cond, &done, &err));
-          mds->mds_lock.Unlock();
-	  mylock.Lock();
-          while (!done)
-            cond.Wait(mylock);
-	  mylock.Unlock();
-          if (err) { // well, crap
-            dout(0) << "got error while reading head: " << cpp_strerror(err)
-                    << dendl;
-            mds->suicide();
-          }
-          mds->mds_lock.Lock();
-	  standby_trim_segments();
-          if (journaler->get_read_pos() < journaler->get_expire_pos()) {
-            dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
-            r = -EAGAIN;
-          }
-        }
+    // read ahead, handing entries off to the decoders
+    while (pending.size() < max_pending &&
+	   journaler->is_readable()) {
+      ReplayEntry *e = new ReplayEntry(journaler->get_read_pos());
+      if (!journaler->try_read_entry(e->bl)) {
+	delete e;
+	break;
       }
-      break;
+      e->end = journaler->get_read_pos();
+      pending.push_back(e);
+      _replay_queue_decode(e);
     }
-    
-    if (!journaler->is_readable() &&
-	journaler->get_read_pos() == journaler->get_write_pos())
-      break;
-    
-    assert(journaler->is_readable());
-    
-    // read it
-    uint64_t pos = journaler->get_read_pos();
-    bufferlist bl;
-    bool r = journaler->try_read_entry(bl);
-    if (!r && journaler->get_error())
+
+    // always replay what we've already read before looking at errors
+    // or waiting for more, so that read_pos matches what's replayed.
+    if (pending.empty()) {
+      // wait for read?
+      if (!journaler->is_readable() &&
+	  journaler->get_read_pos() < journaler->get_write_pos() &&
+	  !journaler->get_error()) {
+	journaler->wait_for_readable(new C_MDL_Replay(this));
+	replay_cond.Wait(mds->mds_lock);
+	continue;
+      }
+      if (journaler->get_error()) {
+	r = journaler->get_error();
+	dout(0) << "_replay journaler got error " << r << ", aborting" << dendl;
+	if (r == -EINVAL) {
+	  if (journaler->get_read_pos() < journaler->get_expire_pos()) {
+	    // this should only happen if you're following somebody else
+	    assert(journaler->is_readonly());
+	    dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
+	    r = -EAGAIN;
+	  } else {
+	    /* re-read head and check it
+	     * Given that replay happens in a separate thread and
+	     * the MDS is going to either shut down or restart when
+	     * we return this error, doing it synchronously is fine
+	     * -- as long as we drop the main mds lock--. */
+	    Mutex mylock("MDLog::_replay_thread lock");
+	    Cond cond;
+	    bool done = false;
+	    int err = 0;
+	    journaler->reread_head(new C_SafeCond(&mylock, &cond, &done, &err));
+	    mds->mds_lock.Unlock();
+	    mylock.Lock();
+	    while (!done)
+	      cond.Wait(mylock);
+	    mylock.Unlock();
+	    if (err) { // well, crap
+	      dout(0) << "got error while reading head: " << cpp_strerror(err)
+		      << dendl;
+	      mds->suicide();
+	    }
+	    mds->mds_lock.Lock();
+	    standby_trim_segments();
+	    if (journaler->get_read_pos() < journaler->get_expire_pos()) {
+	      dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
+	      r = -EAGAIN;
+	    }
+	  }
+	}
+	break;
+      }
+
+      if (!journaler->is_readable() &&
+	  journaler->get_read_pos() == journaler->get_write_pos())
+	break;
       continue;
-    assert(r);
-    
-    // unpack event
-    LogEvent *le = LogEvent::decode(bl);
+    }
+
+    ReplayEntry *e = pending.front();
+    pending.pop_front();
+    _replay_wait_decoded(e);
+
+    uint64_t pos = e->pos;
+    LogEvent *le = e->le;
     if (!le) {
-      dout(0) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
+      dout(0) << "_replay " << pos << "~" << e->bl.length() << " / " << journaler->get_write_pos() 
 	      << " -- unable to decode event" << dendl;
       dout(0) << "dump of unknown or corrupt event:\n";
-      bl.hexdump(*_dout);
+      e->bl.hexdump(*_dout);
       *_dout << dendl;
+      delete e;
 
       assert(!!"corrupt log event" == g_conf->mds_log_skip_corrupt_events);
       continue;
@@ -567,19 +738,20 @@ void MDLog::_replay_thread()
 
     // have we seen an import map yet?
     if (segments.empty()) {
-      dout(10) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
+      dout(10) << "_replay " << pos << "~" << e->bl.length() << " / " << journaler->get_write_pos() 
 	       << " " << le->get_stamp() << " -- waiting for subtree_map.  (skipping " << *le << ")" << dendl;
     } else {
-      dout(10) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
+      dout(10) << "_replay " << pos << "~" << e->bl.length() << " / " << journaler->get_write_pos() 
 	       << " " << le->get_stamp() << ": " << *le << dendl;
       le->_segment = get_current_segment();    // replay may need this
       le->_segment->num_events++;
-      le->_segment->end = journaler->get_read_pos();
+      le->_segment->end = e->end;
       num_events++;
 
       le->replay(mds);
     }
     delete le;
+    delete e;
 
     logger->set(l_mdl_rdpos, pos);
 
@@ -588,11 +760,18 @@ void MDLog::_replay_thread()
     mds->mds_lock.Lock();
   }
 
+  assert(pending.empty());
+  _replay_stop_decoders();
+
   // done!
   if (r == 0) {
     assert(journaler->get_read_pos() == journaler->get_write_pos());
+    utime_t dur = ceph_clock_now(g_ceph_context) - start;
     dout(10) << "_replay - complete, " << num_events
 	     << " events" << dendl;
+    dout(1) << "_replay replayed " << (num_events - start_events) << " events in " << dur
+	    << " s (" << (double)(num_events - start_events) / MAX((double)dur, 0.000001)
+	    << " events/sec, " << g_conf->mds_replay_threads << " decode threads)" << dendl;
 
     logger->set(l_mdl_expos, journaler->get_expire_pos());
   }
@@ -609,6 +788,11 @@ void MDLog::standby_trim_segments()
   dout(10) << "standby_trim_segments" << dendl;
   uint64_t expire_pos = journaler->get_expire_pos();
   dout(10) << " expire_pos=" << expire_pos << dendl;
+
+  // we just re-probed the journal: get the reads for the new tail going
+  // while we trim, so that the next replay pass doesn't start cold.
+  if (journaler->get_read_pos() >= journaler->get_trimmed_pos())
+    journaler->prefetch();
   LogSegment *seg = NULL;
   bool removed_segment = false;
   while ((seg = get_oldest_segment())->end <= expire_pos) {
@@ -34,6 +34,15 @@ enum {
   l_mdl_wrpos,
   l_mdl_rdpos,
   l_mdl_jlat,
+  l_mdl_jwr,
+  l_mdl_jwrbytes,
+  l_mdl_jwrbps,
+  l_mdl_evlat,
+  l_mdl_jrd,
+  l_mdl_jrdbytes,
+  l_mdl_jrdlat,
+  l_mdl_jrdahead,
+  l_mdl_jrdstall,
   l_mdl_last,
 };
 
@@ -42,10 +51,12 @@ enum {
 
 #include "common/Thread.h"
 #include "common/Cond.h"
+#include "common/Mutex.h"
 
 #include "LogSegment.h"
 
 #include <list>
+#include <vector>
 
 class Journaler;
 class LogEvent;
@@ -74,6 +85,10 @@ protected:
 
   PerfCounters *logger;
 
+  // for the journal write rate gauge
+  utime_t last_rate_stamp;
+  uint64_t last_rate_pos;
+
 
   // -- replay --
   Cond replay_cond;
@@ -97,6 +112,42 @@ protected:
   void _replay();         // old way
   void _replay_thread();  // new way
 
+  // -- parallel replay decode --
+  //  the replay thread reads entries ahead and hands them to a few
+  //  decode threads; events are still replayed one at a time, in
+  //  journal order, under mds_lock.
+  struct ReplayEntry {
+    uint64_t pos, end;
+    bufferlist bl;
+    LogEvent *le;
+    bool decoded;
+    ReplayEntry(uint64_t p) : pos(p), end(0), le(NULL), decoded(false) {}
+  };
+
+  class ReplayDecodeThread : public Thread {
+    MDLog *log;
+  public:
+    ReplayDecodeThread(MDLog *l) : log(l) {}
+    void* entry() {
+      log->_replay_decode_thread();
+      return 0;
+    }
+  };
+  friend class ReplayDecodeThread;
+
+  Mutex replay_decode_lock;
+  Cond replay_decode_cond;    // more work for the decoders
+  Cond replay_decoded_cond;   // an entry finished decoding
+  list<ReplayEntry*> replay_decode_queue;
+  bool replay_decode_stop;
+  vector<ReplayDecodeThread*> replay_decoders;
+
+  void _replay_start_decoders();
+  void _replay_stop_decoders();
+  void _replay_decode_thread();
+  void _replay_queue_decode(ReplayEntry *e);
+  void _replay_wait_decoded(ReplayEntry *e);
+
 
   // -- segments --
   map<uint64_t,LogSegment*> segments;
@@ -152,8 +203,11 @@ public:
 		  capped(false),
 		  journaler(0),
 		  logger(0),
+		  last_rate_pos(0),
 		  replay_thread(this),
 		  already_replayed(false),
+		  replay_decode_lock("MDLog::replay_decode_lock"),
+		  replay_decode_stop(false),
 		  expiring_events(0), expired_events(0),
 		  cur_event(NULL) { }		  
   ~MDLog();
@@ -191,6 +245,7 @@ private:
 public:
   void start_entry(LogEvent *e);
   void submit_entry(LogEvent *e, Context *c = 0);
+  void _event_safe(utime_t stamp);
   void start_submit_entry(LogEvent *e, Context *c = 0) {
     start_entry(e);
     submit_entry(e, c);
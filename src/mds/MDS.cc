@@ -70,6 +70,7 @@
 #include "auth/KeyRing.h"
 
 #include "common/config.h"
+#include "common/admin_socket.h"
 #include "common/errno.h"
 
 #include "perfglue/cpu_profiler.h"
@@ -82,6 +83,19 @@
 
 
 
+class MDSSocketHook : public AdminSocketHook {
+  MDS *mds;
+public:
+  MDSSocketHook(MDS *m) : mds(m) {}
+  bool call(std::string command, std::string args, bufferlist& out) {
+    stringstream ss;
+    Mutex::Locker l(mds->mds_lock);
+    mds->mdcache->dump_memory(ss);
+    out.append(ss);
+    return true;
+  }
+};
+
 // cons/des
 MDS::MDS(const std::string &n, Messenger *m, MonClient *mc) : 
   Dispatcher(m->cct),
@@ -143,9 +157,18 @@ MDS::MDS(const std::string &n, Messenger *m, MonClient *mc) :
 
   logger = 0;
   mlogger = 0;
+  asok_hook = 0;
 }
 
 MDS::~MDS() {
+  // the admin socket holds its own lock while it calls us, and the hook
+  // takes mds_lock; unregister before we take mds_lock.
+  if (asok_hook) {
+    cct->get_admin_socket()->unregister_command("dump_cache_memory");
+    delete asok_hook;
+    asok_hook = 0;
+  }
+
   Mutex::Locker lock(mds_lock);
 
   delete authorize_handler_registry;
@@ -197,6 +220,8 @@ void MDS::create_logger()
     mds_plb.add_u64_counter(l_mds_dir_c, "dir_c");
     mds_plb.add_u64_counter(l_mds_dir_sp, "dir_sp");
     mds_plb.add_u64_counter(l_mds_dir_ffc, "dir_ffc");
+    mds_plb.add_u64_counter(l_mds_dir_fk, "dir_fk");   // single dentry fetches
+    mds_plb.add_u64_counter(l_mds_dir_pf, "dir_pf");   // readdir prefetches
     //mds_plb.add_u64_counter("mkdir");
 
     /*
@@ -507,6 +532,11 @@ int MDS::init(int wanted_state)
 
   mds_lock.Unlock();
 
+  asok_hook = new MDSSocketHook(this);
+  int r = cct->get_admin_socket()->register_command("dump_cache_memory", asok_hook,
+						    "show approximate memory used by the cache, by object type");
+  assert(r == 0);
+
   return 0;
 }
 
@@ -534,6 +564,7 @@ void MDS::tick()
 
   // make sure mds log flushes, trims periodically
   mdlog->flush();
+  mdlog->flush_logger();
 
   if (is_active() || is_stopping()) {
     mdcache->trim();
@@ -48,6 +48,8 @@ enum {
   l_mds_dir_c,
   l_mds_dir_sp,
   l_mds_dir_ffc,
+  l_mds_dir_fk,
+  l_mds_dir_pf,
   l_mds_imax,
   l_mds_i,
   l_mds_itop,
@@ -142,6 +144,8 @@ class MDSTableClient;
 
 class AuthAuthorizeHandlerRegistry;
 
+class MDSSocketHook;
+
 class MDS : public Dispatcher {
  public:
   Mutex        mds_lock;
@@ -185,6 +189,7 @@ class MDS : public Dispatcher {
   MDSTableServer *get_table_server(int t);
 
   PerfCounters       *logger, *mlogger;
+  MDSSocketHook      *asok_hook;
 
   int orig_argc;
   const char **orig_argv;
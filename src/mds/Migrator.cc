@@ -303,6 +303,7 @@ void Migrator::handle_mds_failure_or_stop(int who)
       // finish clean-up?
       if (export_state.count(dir) == 0) {
 	export_peer.erase(dir);
+	export_rate_limited.erase(dir);
 	export_warning_ack_waiting.erase(dir);
 	export_notify_ack_waiting.erase(dir);
 	
@@ -562,7 +563,23 @@ void Migrator::export_dir_nicely(CDir *dir, int dest)
 void Migrator::maybe_do_queued_export()
 {
   while (!export_queue.empty() &&
-	 export_state.size() <= 4) {
+	 (int)export_state.size() < g_conf->mds_bal_max_exports_inflight) {
+    if (g_conf->mds_bal_export_max_bytes > 0) {
+      // the debt drains at the configured rate; start another export
+      // once we owe less than a second's worth.
+      double limit = g_conf->mds_bal_export_max_bytes;
+      utime_t now = ceph_clock_now(g_ceph_context);
+      export_rate_debt -= limit * (double)(now - export_rate_stamp);
+      export_rate_stamp = now;
+      if (export_rate_debt < 0)
+	export_rate_debt = 0;
+      if (export_rate_debt >= limit) {
+	dout(7) << "maybe_do_queued_export " << export_rate_debt
+		<< " bytes over the export rate limit, waiting" << dendl;
+	break;
+      }
+    }
+
     dirfrag_t df = export_queue.front().first;
     int dest = export_queue.front().second;
     export_queue.pop_front();
@@ -573,7 +590,7 @@ void Migrator::maybe_do_queued_export()
 
     dout(0) << "nicely exporting to mds." << dest << " " << *dir << dendl;
 
-    export_dir(dir, dest);
+    export_dir(dir, dest, true);
   }
 }
 
@@ -623,8 +640,9 @@ void Migrator::get_export_lock_set(CDir *dir, set<SimpleLock*>& locks)
 /** export_dir(dir, dest)
  * public method to initiate an export.
  * will fail if the directory is freezing, frozen, unpinnable, or root. 
+ * rate_limited exports (the balancer's) are charged to export_rate_debt.
  */
-void Migrator::export_dir(CDir *dir, int dest)
+void Migrator::export_dir(CDir *dir, int dest, bool rate_limited)
 {
   dout(7) << "export_dir " << *dir << " to " << dest << dendl;
   assert(dir->is_auth());
@@ -668,6 +686,8 @@ void Migrator::export_dir(CDir *dir, int dest)
   assert(export_state.count(dir) == 0);
   export_state[dir] = EXPORT_DISCOVERING;
   export_peer[dir] = dest;
+  if (rate_limited)
+    export_rate_limited.insert(dir);
 
   dir->state_set(CDir::STATE_EXPORTING);
   assert(g_conf->mds_kill_export_at != 1);
@@ -733,6 +753,7 @@ void Migrator::export_frozen(CDir *dir)
     // .. unwind ..
     export_peer.erase(dir);
     export_state.erase(dir);
+    export_rate_limited.erase(dir);
     dir->unfreeze_tree();
     dir->state_clear(CDir::STATE_EXPORTING);
 
@@ -969,6 +990,8 @@ void Migrator::export_go_synced(CDir *dir)
     req->add_export((*p)->dirfrag());
 
   // send
+  if (export_rate_limited.erase(dir))
+    export_rate_debt += req->export_data.length();
   mds->send_message_mds(req, dest);
   assert(g_conf->mds_kill_export_at != 8);
 
@@ -91,6 +91,11 @@ protected:
   
   list< pair<dirfrag_t,int> >  export_queue;
 
+  // balancer export rate limit
+  utime_t                      export_rate_stamp;
+  double                       export_rate_debt;  // bytes sent beyond the limit
+  set<CDir*>                   export_rate_limited;  // exports that count against it
+
   // -- imports --
 public:
   const static int IMPORT_DISCOVERING   = 1; // waiting for prep
@@ -124,7 +129,7 @@ protected:
 
 public:
   // -- cons --
-  Migrator(MDS *m, MDCache *c) : mds(m), cache(c) {}
+  Migrator(MDS *m, MDCache *c) : mds(m), cache(c), export_rate_debt(0) {}
 
   void dispatch(Message*);
 
@@ -186,7 +191,7 @@ public:
   // -- import/export --
   // exporter
  public:
-  void export_dir(CDir *dir, int dest);
+  void export_dir(CDir *dir, int dest, bool rate_limited=false);
   void export_empty_import(CDir *dir);
 
   void export_dir_nicely(CDir *dir, int dest);
@@ -72,6 +72,7 @@ void Server::create_logger()
   plb.add_u64_counter(l_mdss_hcsess, "hcsess");    // client session
   plb.add_u64_counter(l_mdss_dcreq, "dcreq"); // dispatch client req
   plb.add_u64_counter(l_mdss_dsreq, "dsreq"); // slave
+  plb.add_u64_counter(l_mdss_fast_stat, "fast_stat"); // stat/lookup answered without an MDRequest
   logger = plb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
 }
@@ -674,17 +675,17 @@ void Server::recover_filelocks(CInode *in, bufferlist locks, int64_t client)
   for (int i = 0; i < numlocks; ++i) {
     ::decode(lock, p);
     lock.client = client;
-    in->fcntl_locks.held_locks.insert(pair<uint64_t, ceph_filelock>
+    in->get_fcntl_lock_state()->held_locks.insert(pair<uint64_t, ceph_filelock>
 				      (lock.start, lock));
-    ++in->fcntl_locks.client_held_lock_counts[client];
+    ++in->get_fcntl_lock_state()->client_held_lock_counts[client];
   }
   ::decode(numlocks, p);
   for (int i = 0; i < numlocks; ++i) {
     ::decode(lock, p);
     lock.client = client;
-    in->flock_locks.held_locks.insert(pair<uint64_t, ceph_filelock>
+    in->get_flock_lock_state()->held_locks.insert(pair<uint64_t, ceph_filelock>
 				      (lock.start, lock));
-    ++in->flock_locks.client_held_lock_counts[client];
+    ++in->get_flock_lock_state()->client_held_lock_counts[client];
   }
 }
 
@@ -1075,6 +1076,10 @@ void Server::handle_client_request(MClientRequest *req)
     session->trim_completed_requests(req->get_oldest_client_tid());
   }
 
+  // cached stat/lookup we can answer right away?
+  if (try_fast_stat(req, session))
+    return;
+
   // register + dispatch
   MDRequest *mdr = mdcache->request_start(req);
   if (!mdr) 
@@ -1100,6 +1105,115 @@ void Server::handle_client_request(MClientRequest *req)
   return;
 }
 
+/*
+ * Answer a getattr or single-component lookup straight from cache.
+ *
+ * Everything a stat needs is usually already here: the target is
+ * cached and the locks it would rdlock are readable.  In that case
+ * taking and immediately dropping those rdlocks under mds_lock is
+ * equivalent to just checking them, so skip the MDRequest and the lock
+ * sets.  Anything unusual (snapshots, remote links, cap releases,
+ * retries, a frozen subtree, a lock we would have to wait for) returns
+ * false and the request takes the normal path, with nothing changed.
+ *
+ * This function DOES put the passed message if it returns true.
+ */
+bool Server::try_fast_stat(MClientRequest *req, Session *session)
+{
+  if (!g_conf->mds_fast_stat)
+    return false;
+  int op = req->get_op();
+  if (op != CEPH_MDS_OP_GETATTR && op != CEPH_MDS_OP_LOOKUP)
+    return false;
+  if (!session || !mds->is_active() ||
+      req->is_replay() || req->get_retry_attempt() ||
+      !req->releases.empty())
+    return false;
+
+  const filepath& path = req->get_filepath();
+  if (path.depth() != (op == CEPH_MDS_OP_LOOKUP ? 1u : 0u))
+    return false;
+
+  CInode *ref = mdcache->get_inode(path.get_ino());
+  if (!ref || ref->state_test(CInode::STATE_PURGING))
+    return false;
+
+  client_t client = req->get_source().num();
+  CDentry *dn = 0;
+  if (op == CEPH_MDS_OP_LOOKUP) {
+    const string& dname = path[0];
+    if (dname.length() == 0 ||     // snapdir
+	!ref->is_dir() ||
+	(ref->snaprealm && !ref->snaprealm->open))
+      return false;
+    CDir *dir = ref->get_dirfrag(ref->pick_dirfrag(dname));
+    if (!dir || !dir->is_auth())
+      return false;
+    dn = dir->lookup(dname);
+    if (!dn || !dn->get_linkage()->is_primary() ||
+	dn->get_projected_linkage()->get_inode() != dn->get_linkage()->get_inode() ||
+	!dn->lock.can_rdlock(client))
+      return false;
+    ref = dn->get_linkage()->get_inode();
+  }
+
+  // nothing frozen or freezing for migration, as rdlock_path_pin_ref
+  // would wait for, and the ancestor snaplocks are readable
+  if (!ref->can_auth_pin() ||
+      (dn && !dn->get_dir()->can_auth_pin()))
+    return false;
+  for (CInode *t = ref; t; ) {
+    if (!t->snaplock.can_rdlock(client))
+      return false;
+    CDentry *pdn = t->get_projected_parent_dn();
+    t = pdn ? pdn->get_dir()->get_inode() : 0;
+  }
+
+  // same rdlocks as handle_client_stat
+  int issued = 0;
+  Capability *cap = ref->get_client_cap(client);
+  if (cap)
+    issued = cap->issued();
+  int mask = req->head.args.getattr.mask;
+  if (((mask & CEPH_CAP_LINK_SHARED) && (issued & CEPH_CAP_LINK_EXCL) == 0 &&
+       !ref->linklock.can_rdlock(client)) ||
+      ((mask & CEPH_CAP_AUTH_SHARED) && (issued & CEPH_CAP_AUTH_EXCL) == 0 &&
+       !ref->authlock.can_rdlock(client)) ||
+      ((mask & CEPH_CAP_FILE_SHARED) && (issued & CEPH_CAP_FILE_EXCL) == 0 &&
+       !ref->filelock.can_rdlock(client)) ||
+      ((mask & CEPH_CAP_XATTR_SHARED) && (issued & CEPH_CAP_XATTR_EXCL) == 0 &&
+       !ref->xattrlock.can_rdlock(client)))
+    return false;
+
+  dout(10) << "try_fast_stat " << *req << " on " << *ref << dendl;
+  if (logger) logger->inc(l_mdss_fast_stat);
+
+  mds->balancer->hit_inode(ceph_clock_now(g_ceph_context), ref, META_POP_IRD,
+			   client.v);
+
+  // pinned while we encode the inodestat and issue caps
+  ref->auth_pin(req);
+  if (dn)
+    dn->get_dir()->auth_pin(req);
+
+  MClientReply *reply = new MClientReply(req, 0);
+  set_trace_dist(session, reply, ref, dn, CEPH_NOSNAP, req->get_dentry_wanted());
+  reply->set_mdsmap_epoch(mds->mdsmap->get_epoch());
+  messenger->send_message(reply, req->get_connection());
+
+  if (dn)
+    dn->get_dir()->auth_unpin(req);
+  ref->auth_unpin(req);
+
+  mds->logger->inc(l_mds_reply);
+  double lat = ceph_clock_now(g_ceph_context) - req->get_recv_stamp();
+  mds->logger->finc(l_mds_replyl, lat);
+  dout(20) << "lat " << lat << dendl;
+
+  req->put();
+  return true;
+}
+
 /* This function takes responsibility for the passed mdr*/
 void Server::dispatch_client_request(MDRequest *mdr)
 {
@@ -2690,6 +2804,10 @@ void Server::handle_client_readdir(MDRequest *mdr)
   dout(10) << "handle_client_readdir on " << *dir << dendl;
   assert(dir->is_auth());
 
+  // a client reading a fragmented dir will want the other frags next
+  if (g_conf->mds_readdir_prefetch_frags && req->get_path2().empty())
+    readdir_prefetch_frags(diri, fg);
+
   if (!dir->is_complete()) {
     // fetch
     dout(10) << " incomplete dir contents for readdir on " << *dir << ", fetching" << dendl;
@@ -2732,7 +2850,7 @@ void Server::handle_client_readdir(MDRequest *mdr)
     max = dir->get_num_any();  // whatever, something big.
   unsigned max_bytes = req->head.args.readdir.max_bytes;
   if (!max_bytes)
-    max_bytes = 512 << 10;  // 512 KB?
+    max_bytes = g_conf->mds_readdir_max_bytes;
 
   // start final blob
   bufferlist dirbl;
@@ -2744,6 +2862,24 @@ void Server::handle_client_readdir(MDRequest *mdr)
   int bytes_left = max_bytes - front_bytes;
   bytes_left -= realm->get_snap_trace().length();
 
+  // if a client recently read our parent to the end, it is probably
+  // walking the tree (find, du, backups); fetch our subdirs ahead of it.
+  // each readdir of a sibling extends the walk; once the parent goes
+  // quiet for mds_readdir_prefetch_window we stop guessing.
+  utime_t now = ceph_clock_now(g_ceph_context);
+  list<CInode*> subdirs;
+  bool walking = false;
+  if (g_conf->mds_readdir_prefetch_dirs > 0 && snapid == CEPH_NOSNAP) {
+    CDir *pdir = diri->get_parent_dir();
+    if (pdir && pdir->last_readdir_walk != utime_t()) {
+      utime_t cutoff = now;
+      cutoff -= g_conf->mds_readdir_prefetch_window;
+      walking = pdir->last_readdir_walk > cutoff;
+      if (walking)
+	pdir->last_readdir_walk = now;
+    }
+  }
+
   __u32 numfiles = 0;
   while (it != dir->end() && numfiles < max) {
     CDentry *dn = it->second;
@@ -2822,11 +2958,16 @@ void Server::handle_client_readdir(MDRequest *mdr)
     assert(r >= 0);
     numfiles++;
 
+    if (walking && in->is_dir())
+      subdirs.push_back(in);
+
     // touch dn
     mdcache->lru.lru_touch(dn);
   }
   
   __u8 end = (it == dir->end());
+  if (end)
+    dir->last_readdir_walk = now;
   __u8 complete = (end && !offset);  // FIXME: what purpose does this serve
   
   // finish final blob
@@ -2851,11 +2992,57 @@ void Server::handle_client_readdir(MDRequest *mdr)
 
   // bump popularity.  NOTE: this doesn't quite capture it.
   mds->balancer->hit_dir(ceph_clock_now(g_ceph_context), dir, META_POP_IRD, -1, numfiles);
+
+  // start reading subdirs before the client asks for them.  all the
+  // fetches go out together, so their osd reads overlap.
+  int left = g_conf->mds_readdir_prefetch_dirs;
+  for (list<CInode*>::iterator p = subdirs.begin(); p != subdirs.end() && left > 0; ++p) {
+    list<frag_t> ls;
+    (*p)->dirfragtree.get_leaves(ls);
+    for (list<frag_t>::iterator q = ls.begin(); q != ls.end() && left > 0; ++q)
+      if (readdir_prefetch(*p, *q))
+	left--;
+  }
   
   // reply
   reply_request(mdr, reply, diri);
 }
 
+/*
+ * start fetching a dirfrag nobody is waiting for yet.  returns true if
+ * we issued a read.
+ */
+bool Server::readdir_prefetch(CInode *diri, frag_t fg)
+{
+  CDir *dir = diri->get_dirfrag(fg);
+  if (!dir) {
+    if (!diri->is_auth() || diri->is_frozen_dir())
+      return false;
+    dir = diri->get_or_open_dirfrag(mdcache, fg);
+  }
+  if (!dir->is_auth() ||
+      dir->is_complete() ||
+      dir->state_test(CDir::STATE_FETCHING) ||
+      !dir->can_auth_pin())
+    return false;
+
+  dout(15) << "readdir_prefetch " << *dir << dendl;
+  if (mds->logger) mds->logger->inc(l_mds_dir_pf);
+  dir->fetch(NULL);
+  return true;
+}
+
+void Server::readdir_prefetch_frags(CInode *diri, frag_t fg)
+{
+  list<frag_t> ls;
+  diri->dirfragtree.get_leaves(ls);
+  if (ls.size() < 2)
+    return;
+  for (list<frag_t>::iterator p = ls.begin(); p != ls.end(); ++p)
+    if (*p != fg)
+      readdir_prefetch(diri, *p);
+}
+
 
 
 // ===============================================================================
@@ -2932,11 +3119,11 @@ void Server::handle_client_file_setlock(MDRequest *mdr)
   // get the appropriate lock state
   switch (req->head.args.filelock_change.rule) {
   case CEPH_LOCK_FLOCK:
-    lock_state = &cur->flock_locks;
+    lock_state = cur->get_flock_lock_state();
     break;
 
   case CEPH_LOCK_FCNTL:
-    lock_state = &cur->fcntl_locks;
+    lock_state = cur->get_fcntl_lock_state();
     break;
 
   default:
@@ -3018,11 +3205,11 @@ void Server::handle_client_file_readlock(MDRequest *mdr)
   ceph_lock_state_t *lock_state = NULL;
   switch (req->head.args.filelock_change.rule) {
   case CEPH_LOCK_FLOCK:
-    lock_state = &cur->flock_locks;
+    lock_state = cur->get_flock_lock_state();
     break;
 
   case CEPH_LOCK_FCNTL:
-    lock_state = &cur->fcntl_locks;
+    lock_state = cur->get_fcntl_lock_state();
     break;
 
   default:
@@ -33,6 +33,7 @@ enum {
   l_mdss_hcsess,
   l_mdss_dcreq,
   l_mdss_dsreq,
+  l_mdss_fast_stat,
   l_mdss_last,
 };
 
@@ -94,6 +95,7 @@ public:
 
   // -- requests --
   void handle_client_request(MClientRequest *m);
+  bool try_fast_stat(MClientRequest *req, Session *session);
 
   void journal_and_reply(MDRequest *mdr, CInode *tracei, CDentry *tracedn, 
 			 LogEvent *le, Context *fin);
@@ -145,6 +147,8 @@ public:
   void _lookup_ino_2(MDRequest *mdr, int r);
   void _lookup_ino_3(MDRequest *mdr, int r);
   void handle_client_readdir(MDRequest *mdr);
+  bool readdir_prefetch(CInode *diri, frag_t fg);
+  void readdir_prefetch_frags(CInode *diri, frag_t fg);
   void handle_client_file_setlock(MDRequest *mdr);
   void handle_client_file_readlock(MDRequest *mdr);
 
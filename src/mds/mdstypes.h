@@ -17,6 +17,7 @@ using namespace std;
 
 #include "include/frag.h"
 #include "include/xlist.h"
+#include "include/compact_map.h"
 
 #include "inode_backtrace.h"
 
@@ -676,10 +677,26 @@ struct dentry_key_t {
     bl.append("_", 1);
     bl.append(b);
   }
+  // same, as a plain string (omap key)
+  string str() const {
+    string s(name);
+    s += "_";
+    if (snapid != CEPH_NOSNAP) {
+      char b[20];
+      uint64_t val(snapid);
+      snprintf(b, sizeof(b), "%" PRIx64, val);
+      s += b;
+    } else {
+      s += "head";
+    }
+    return s;
+  }
   static void decode_helper(bufferlist::iterator& bl, string& nm, snapid_t& sn) {
     string foo;
     ::decode(foo, bl);
-
+    decode_helper(foo, nm, sn);
+  }
+  static void decode_helper(const string& foo, string& nm, snapid_t& sn) {
     int i = foo.length()-1;
     while (foo[i] != '_' && i)
       i--;
@@ -1427,7 +1444,7 @@ protected:
   // replication (across mds cluster)
  protected:
   __s16        replica_nonce; // [replica] defined on replica
-  map<int,int> replica_map;   // [auth] mds -> nonce
+  compact_map<int,int> replica_map;   // [auth] mds -> nonce
 
  public:
   bool is_replicated() { return !replica_map.empty(); }
@@ -1462,7 +1479,7 @@ protected:
   }
   map<int,int>::iterator replicas_begin() { return replica_map.begin(); }
   map<int,int>::iterator replicas_end() { return replica_map.end(); }
-  const map<int,int>& get_replicas() { return replica_map; }
+  const map<int,int>& get_replicas() { return replica_map.get(); }
   void list_replicas(set<int>& ls) {
     for (map<int,int>::const_iterator p = replica_map.begin();
 	 p != replica_map.end();
@@ -1470,6 +1487,14 @@ protected:
       ls.insert(p->first);
   }
 
+  /// heap bytes held by the (lazily allocated) replica and waiter maps
+  size_t get_compact_mem_usage() const {
+    return replica_map.mem_usage() + waiting.mem_usage();
+  }
+  int get_compact_allocated() const {
+    return replica_map.allocated() + waiting.allocated();
+  }
+
   int get_replica_nonce() { return replica_nonce;}
   void set_replica_nonce(int n) { replica_nonce = n; }
 
@@ -1477,7 +1502,7 @@ protected:
   // ---------------------------------------------
   // waiting
  protected:
-  multimap<uint64_t, Context*>  waiting;
+  compact_multimap<uint64_t, Context*>  waiting;
 
  public:
   bool is_waiter_for(uint64_t mask, uint64_t min=0) {
@@ -1524,8 +1549,10 @@ protected:
 	it++;
       }
     }
-    if (waiting.empty())
+    if (waiting.empty()) {
       put(PIN_WAITER);
+      waiting.clear();  // free it
+    }
   }
   void finish_waiting(uint64_t mask, int result = 0) {
     list<Context*> finished;
@@ -30,7 +30,7 @@ class MDentryLink : public Message {
 
   MDentryLink() :
     Message(MSG_MDS_DENTRYLINK) { }
-  MDentryLink(dirfrag_t df, string& n, bool p) :
+  MDentryLink(dirfrag_t df, const string& n, bool p) :
     Message(MSG_MDS_DENTRYLINK),
     dirfrag(df),
     dn(n),
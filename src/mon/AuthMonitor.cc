@@ -422,6 +422,47 @@ void AuthMonitor::auth_usage(stringstream& ss)
   ss << "              auth <list>" << std::endl;
 }
 
+/*
+ * if we already have a key for entity, check that it has the caps the
+ * command asks for and reply with it.  returns false if there is no key,
+ * otherwise *r is the result for the reply.
+ */
+bool AuthMonitor::get_or_create_existing(MMonCommand *m, const EntityName& entity,
+					 stringstream& ss, bufferlist& rdata, int *r)
+{
+  EntityAuth entity_auth;
+  if (!mon->key_server.get_auth(entity, entity_auth))
+    return false;
+
+  for (unsigned i=3; i + 1<m->cmd.size(); i += 2) {
+    string sys = m->cmd[i];
+    bufferlist cap;
+    ::encode(m->cmd[i+1], cap);
+    if (entity_auth.caps.count(sys) == 0 ||
+	!entity_auth.caps[sys].contents_equal(cap)) {
+      ss << "key for " << entity << " exists but cap " << sys << " does not match";
+      *r = -EINVAL;
+      return true;
+    }
+  }
+
+  get_or_create_reply(m, entity, entity_auth.key, ss, rdata);
+  *r = 0;
+  return true;
+}
+
+void AuthMonitor::get_or_create_reply(MMonCommand *m, const EntityName& entity, CryptoKey& key,
+				      stringstream& ss, bufferlist& rdata)
+{
+  if (m->cmd[1] == "get-or-create-key") {
+    ss << key;
+  } else {
+    KeyRing kr;
+    kr.add(entity, key);
+    kr.encode_plaintext(rdata);
+  }
+}
+
 bool AuthMonitor::preprocess_command(MMonCommand *m)
 {
   int r = -1;
@@ -431,8 +472,6 @@ bool AuthMonitor::preprocess_command(MMonCommand *m)
   if (m->cmd.size() > 1) {
     if (m->cmd[1] == "add" ||
         m->cmd[1] == "del" ||
-	m->cmd[1] == "get-or-create" ||
-	m->cmd[1] == "get-or-create-key" ||
 	m->cmd[1] == "caps") {
       return false;
     }
@@ -508,6 +547,16 @@ bool AuthMonitor::preprocess_command(MMonCommand *m)
       ss << auth.key;
       r = 0;      
     }
+    else if ((m->cmd[1] == "get-or-create-key" ||
+	      m->cmd[1] == "get-or-create") &&
+	     m->cmd.size() >= 3) {
+      // if the key already exists this is a read; only forward to the
+      // leader if we need to create it.
+      EntityName entity;
+      if (!entity.from_str(m->cmd[2]) ||
+	  !get_or_create_existing(m, entity, ss, rdata, &r))
+	return false;
+    }
     else if (m->cmd[1] == "list") {
       mon->key_server.list_secrets(ss);
       r = 0;
@@ -641,30 +690,8 @@ bool AuthMonitor::prepare_command(MMonCommand *m)
       }
 
       // do we have it?
-      EntityAuth entity_auth;
-      if (mon->key_server.get_auth(entity, entity_auth)) {
-	for (unsigned i=3; i + 1<m->cmd.size(); i += 2) {
-	  string sys = m->cmd[i];
-	  bufferlist cap;
-	  ::encode(m->cmd[i+1], cap);
-	  if (entity_auth.caps.count(sys) == 0 ||
-	      !entity_auth.caps[sys].contents_equal(cap)) {
-	    ss << "key for " << entity << " exists but cap " << sys << " does not match";
-	    err = -EINVAL;
-	    goto done;
-	  }
-	}
-
-	if (m->cmd[1] == "get-or-create-key") {
-	  ss << entity_auth.key;
-	} else {
-	  KeyRing kr;
-	  kr.add(entity, entity_auth.key);
-	  kr.encode_plaintext(rdata);
-	}
-	err = 0;
+      if (get_or_create_existing(m, entity, ss, rdata, &err))
 	goto done;
-      }
 
       // ...or are we about to?
       for (vector<Incremental>::iterator p = pending_auth.begin();
@@ -691,14 +718,7 @@ bool AuthMonitor::prepare_command(MMonCommand *m)
 	::encode(m->cmd[i+1], auth_inc.auth.caps[m->cmd[i]]);
 
       push_cephx_inc(auth_inc);
-
-      if (m->cmd[1] == "get-or-create-key") {
-	ss << auth_inc.auth.key;
-      } else {
-	KeyRing kr;
-	kr.add(entity, auth_inc.auth.key);
-	kr.encode_plaintext(rdata);
-      }
+      get_or_create_reply(m, entity, auth_inc.auth.key, ss, rdata);
 
       getline(ss, rs);
       paxos->wait_for_commit(new Monitor::C_Command(mon, m, 0, rs, rdata, paxos->get_version()));
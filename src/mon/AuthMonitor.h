@@ -114,6 +114,12 @@ private:
   void export_keyring(KeyRing& keyring);
   void import_keyring(KeyRing& keyring);
 
+  // auth get-or-create[-key]
+  bool get_or_create_existing(MMonCommand *m, const EntityName& entity,
+			      stringstream& ss, bufferlist& rdata, int *r);
+  void get_or_create_reply(MMonCommand *m, const EntityName& entity, CryptoKey& key,
+			   stringstream& ss, bufferlist& rdata);
+
   void push_cephx_inc(KeyServerData::Incremental& auth_inc) {
     Incremental inc;
     inc.inc_type = AUTH_DATA;
@@ -190,12 +190,6 @@ Monitor::~Monitor()
   delete mon_caps;
 }
 
-enum {
-  l_mon_first = 456000,
-  l_mon_last,
-};
-
-
 class AdminHook : public AdminSocketHook {
   Monitor *mon;
 public:
@@ -237,7 +231,20 @@ int Monitor::init()
   assert(!logger);
   {
     PerfCountersBuilder pcb(g_ceph_context, "mon", l_mon_first, l_mon_last);
-    // ...
+    pcb.add_u64_counter(l_mon_paxos_begin, "paxos_begin");
+    pcb.add_u64_counter(l_mon_paxos_begin_bytes, "paxos_begin_bytes");
+    pcb.add_u64_counter(l_mon_paxos_commit, "paxos_commit");
+    pcb.add_fl_avg(l_mon_paxos_commit_latency, "paxos_commit_latency");
+    pcb.add_fl_avg(l_mon_paxos_update_latency, "paxos_update_latency");
+    pcb.add_u64_counter(l_mon_paxos_stray_accept, "paxos_stray_accept");
+    pcb.add_u64_counter(l_mon_query_local, "query_local");
+    pcb.add_u64_counter(l_mon_query_forward, "query_forward");
+    pcb.add_u64_counter(l_mon_query_wait_readable, "query_wait_readable");
+    pcb.add_u64_counter(l_mon_osd_failure_report, "osd_failure_report");
+    pcb.add_u64_counter(l_mon_osd_failure_redundant, "osd_failure_redundant");
+    pcb.add_u64_counter(l_mon_osd_marked_down, "osd_marked_down");
+    pcb.add_u64_counter(l_mon_osd_down_batched, "osd_down_batched");
+    pcb.add_u64_counter(l_mon_osd_boot_damped, "osd_boot_damped");
     logger = pcb.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
   }
@@ -1369,6 +1376,7 @@ void Monitor::forward_request_leader(PaxosServiceMessage *req)
     MForward *forward = new MForward(rr->tid, req, rr->session->caps);
     forward->set_priority(req->get_priority());
     messenger->send_message(forward, monmap->get_inst(mon));
+    logger->inc(l_mon_query_forward);
   } else {
     dout(10) << "forward_request no session for request " << *req << dendl;
     req->put();
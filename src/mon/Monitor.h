@@ -49,6 +49,25 @@
 #define CEPH_MON_PROTOCOL     9 /* cluster internal */
 
 
+enum {
+  l_mon_first = 456000,
+  l_mon_paxos_begin,
+  l_mon_paxos_begin_bytes,
+  l_mon_paxos_commit,
+  l_mon_paxos_commit_latency,
+  l_mon_paxos_update_latency,
+  l_mon_paxos_stray_accept,
+  l_mon_query_local,
+  l_mon_query_forward,
+  l_mon_query_wait_readable,
+  l_mon_osd_failure_report,
+  l_mon_osd_failure_redundant,
+  l_mon_osd_marked_down,
+  l_mon_osd_down_batched,
+  l_mon_osd_boot_damped,
+  l_mon_last,
+};
+
 enum {
   l_cluster_first = 555000,
   l_cluster_num_mon,
@@ -495,7 +495,18 @@ bool OSDMonitor::should_propose(double& delay)
     return true;
   }
 
-  return PaxosService::should_propose(delay);
+  if (!PaxosService::should_propose(delay))
+    return false;
+
+  // give other reports from the same failure (rack, switch, ...) a chance
+  // to land in this epoch too.
+  if (pending_inc.get_net_marked_down(&osdmap) > 0 &&
+      delay < g_conf->mon_osd_down_batch_interval) {
+    dout(10) << " batching down marks for " << g_conf->mon_osd_down_batch_interval
+	     << dendl;
+    delay = g_conf->mon_osd_down_batch_interval;
+  }
+  return true;
 }
 
 
@@ -651,8 +662,20 @@ bool OSDMonitor::prepare_failure(MOSDFailure *m)
   int reporter = m->get_orig_source().num();
   assert(osdmap.is_up(target_osd));
   assert(osdmap.get_addr(target_osd) == m->get_target().addr);
+
+  mon->logger->inc(l_mon_osd_failure_report);
   
   if (m->if_osd_failed()) {
+    // already marked down in the pending epoch?
+    if (pending_inc.new_state.count(target_osd) &&
+	(pending_inc.new_state[target_osd] & CEPH_OSD_UP)) {
+      dout(10) << "osd." << target_osd << " already marked down in pending epoch "
+	       << pending_inc.epoch << dendl;
+      mon->logger->inc(l_mon_osd_failure_redundant);
+      paxos->wait_for_commit(new C_Reported(this, m));
+      return false;
+    }
+
     int reports = 0;
     int reporters = 0;
 
@@ -683,7 +706,11 @@ bool OSDMonitor::prepare_failure(MOSDFailure *m)
         (reports >= g_conf->osd_min_down_reports)) {
       dout(1) << "have enough reports/reporters to mark osd." << target_osd
               << " as down" << dendl;
+      if (pending_inc.get_net_marked_down(&osdmap) > 0)
+	mon->logger->inc(l_mon_osd_down_batched);
+      mon->logger->inc(l_mon_osd_marked_down);
       pending_inc.new_state[target_osd] = CEPH_OSD_UP;
+      note_osd_flap(target_osd, ceph_clock_now(g_ceph_context));
       paxos->wait_for_commit(new C_Reported(this, m));
       //clear out failure reports
       failed_notes.erase(failed_notes.lower_bound(target_osd),
@@ -710,6 +737,51 @@ void OSDMonitor::_reported_failure(MOSDFailure *m)
   send_latest(m, m->get_epoch());
 }
 
+void OSDMonitor::note_osd_flap(int osd, utime_t now)
+{
+  osd_flap_t& f = osd_flaps[osd];
+  if (f.count && now - f.last_down > g_conf->mon_osd_flap_window)
+    f.count = 0;
+  f.count++;
+  f.last_down = now;
+  dout(10) << "note_osd_flap osd." << osd << " marked down " << f.count
+	   << " times in a row" << dendl;
+}
+
+/*
+ * How long should we hold off marking this osd up again?  Once an osd
+ * has been marked down mon_osd_flap_threshold times, each within
+ * mon_osd_flap_window of the last, we wait mon_osd_flap_backoff seconds
+ * after the last down mark, doubling for each further flap.
+ */
+double OSDMonitor::get_boot_delay(int osd, utime_t now)
+{
+  map<int,osd_flap_t>::iterator p = osd_flaps.find(osd);
+  if (p == osd_flaps.end())
+    return 0;
+  if (now - p->second.last_down > g_conf->mon_osd_flap_window) {
+    osd_flaps.erase(p);
+    return 0;
+  }
+  if (g_conf->mon_osd_flap_threshold <= 0 ||
+      p->second.count < (unsigned)g_conf->mon_osd_flap_threshold)
+    return 0;
+
+  double backoff = g_conf->mon_osd_flap_backoff;
+  for (unsigned i = g_conf->mon_osd_flap_threshold;
+       i < p->second.count && backoff < g_conf->mon_osd_flap_backoff_max;
+       i++)
+    backoff *= 2;
+  if (backoff > g_conf->mon_osd_flap_backoff_max)
+    backoff = g_conf->mon_osd_flap_backoff_max;
+
+  utime_t until = p->second.last_down;
+  until += backoff;
+  if (until <= now)
+    return 0;
+  return (double)(until - now);
+}
+
 
 // boot --
 
@@ -801,6 +873,25 @@ bool OSDMonitor::prepare_boot(MOSDBoot *m)
     dout(7) << "prepare_boot already prepared, waiting on " << m->get_orig_source_addr() << dendl;
     paxos->wait_for_commit(new C_RetryMessage(this, m));
   } else {
+    // this boot supersedes any we are still holding for the osd
+    map<int,Context*>::iterator p = delayed_boots.find(from);
+    if (p != delayed_boots.end()) {
+      mon->timer.cancel_event(p->second);
+      delayed_boots.erase(p);
+    }
+
+    // flapping?
+    double delay = get_boot_delay(from, ceph_clock_now(g_ceph_context));
+    if (delay > 0) {
+      dout(5) << "prepare_boot osd." << from << " is flapping, delaying boot for "
+	      << delay << "s" << dendl;
+      mon->logger->inc(l_mon_osd_boot_damped);
+      Context *c = new C_DelayedBoot(this, from, m);
+      delayed_boots[from] = c;
+      mon->timer.add_event_after(delay, c);
+      return false;
+    }
+
     // mark new guy up.
     pending_inc.new_up_client[from] = m->get_orig_source_addr();
     if (!m->cluster_addr.is_blank_ip())
@@ -1652,6 +1743,32 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
       ss << "listed " << osdmap.blacklist.size() << " entries";
       r = 0;
     }
+    else if (m->cmd.size() >= 3 && m->cmd[1] == "pool" && m->cmd[2] == "get") {
+      // read-only; no need to bother the leader with this
+      if (m->cmd.size() != 5) {
+	r = -EINVAL;
+	ss << "usage: osd pool get <poolname> <field>";
+	goto out;
+      }
+      int64_t pool = osdmap.lookup_pg_pool_name(m->cmd[3].c_str());
+      if (pool < 0) {
+	ss << "unrecognized pool '" << m->cmd[3] << "'";
+	r = -ENOENT;
+	goto out;
+      }
+
+      const pg_pool_t *p = osdmap.get_pg_pool(pool);
+      if (m->cmd[4] == "pg_num") {
+	ss << "PG_NUM: " << p->get_pg_num();
+	r = 0;
+      } else if (m->cmd[4] == "pgp_num") {
+	ss << "PGP_NUM: " << p->get_pgp_num();
+	r = 0;
+      } else {
+	ss << "don't know how to get pool field " << m->cmd[4];
+	r = -EINVAL;
+      }
+    }
   }
  out:
   if (r != -1) {
@@ -2441,33 +2558,6 @@ bool OSDMonitor::prepare_command(MMonCommand *m)
 	  }
 	}
       }
-      else if (m->cmd[2] == "get") {
-	if (m->cmd.size() != 5) {
-	  err = -EINVAL;
-	  ss << "usage: osd pool get <poolname> <field>";
-	  goto out;
-	}
-	int64_t pool = osdmap.lookup_pg_pool_name(m->cmd[3].c_str());
-	if (pool < 0) {
-	  ss << "unrecognized pool '" << m->cmd[3] << "'";
-	  err = -ENOENT;
-	  goto out;
-	}
-
-	const pg_pool_t *p = osdmap.get_pg_pool(pool);
-	if (m->cmd[4] == "pg_num") {
-	  ss << "PG_NUM: " << p->get_pg_num();
-	  err = 0;
-	  goto out;
-	}
-	if (m->cmd[4] == "pgp_num") {
-	  ss << "PGP_NUM: " << p->get_pgp_num();
-	  err = 0;
-	  goto out;
-	}
-	ss << "don't know how to get pool field " << m->cmd[4];
-	goto out;
-      }
     }
     else if ((m->cmd.size() > 1) &&
 	     (m->cmd[1] == "reweight-by-utilization")) {
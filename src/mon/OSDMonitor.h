@@ -48,6 +48,18 @@ private:
   multimap<int, pair<int, int> > failed_notes; // <failed_osd, <reporter, #reports> >
   map<int,utime_t>    down_pending_out;  // osd down -> out
 
+  /// failure-driven down marks, for flap damping [leader]
+  struct osd_flap_t {
+    utime_t last_down;  ///< when we last marked it down on failure reports
+    unsigned count;     ///< consecutive down marks within mon_osd_flap_window
+    osd_flap_t() : count(0) {}
+  };
+  map<int,osd_flap_t> osd_flaps;
+  map<int,Context*> delayed_boots;  ///< pending C_DelayedBoot per osd [leader]
+
+  void note_osd_flap(int osd, utime_t now);
+  double get_boot_delay(int osd, utime_t now);
+
   map<int,double> osd_weight;
 
   // map thrashing
@@ -136,6 +148,25 @@ private:
     }
   };
 
+  /// retry a boot we held back because the osd was flapping
+  struct C_DelayedBoot : public Context {
+    OSDMonitor *cmon;
+    int osd;
+    PaxosServiceMessage *m;
+    C_DelayedBoot(OSDMonitor *cm, int o, PaxosServiceMessage *m_) :
+      cmon(cm), osd(o), m(m_) {}
+    ~C_DelayedBoot() {
+      if (m)
+	m->put();   // canceled
+    }
+    void finish(int r) {
+      cmon->delayed_boots.erase(osd);
+      PaxosServiceMessage *msg = m;
+      m = NULL;
+      cmon->dispatch(msg);
+    }
+  };
+
   struct C_ReplyMap : public Context {
     OSDMonitor *osdmon;
     PaxosServiceMessage *m;
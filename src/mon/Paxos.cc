@@ -19,6 +19,7 @@
 #include "messages/MMonPaxos.h"
 
 #include "common/config.h"
+#include "common/perf_counters.h"
 #include "include/assert.h"
 
 #define dout_subsys ceph_subsys_paxos
@@ -377,20 +378,23 @@ void Paxos::begin(bufferlist& v)
   accepted.clear();
   accepted.insert(mon->rank);
   new_value = v;
-  mon->store->put_bl_sn(new_value, machine_name, last_committed+1);
+  proposed_v = last_committed+1;
+  proposed_stamp = ceph_clock_now(g_ceph_context);
+
+  mon->logger->inc(l_mon_paxos_begin);
+  mon->logger->inc(l_mon_paxos_begin_bytes, new_value.length());
 
   if (mon->get_quorum().size() == 1) {
     // we're alone, take it easy
+    mon->store->put_bl_sn(new_value, machine_name, proposed_v);
     commit();
-    state = STATE_ACTIVE;
-    finish_contexts(g_ceph_context, waiting_for_active);
-    finish_contexts(g_ceph_context, waiting_for_commit);
-    finish_contexts(g_ceph_context, waiting_for_readable);
-    finish_contexts(g_ceph_context, waiting_for_writeable);
+    finish_update();
     return;
   }
 
   // ask others to accept it too!
+  //  (do this before we write it ourselves so that our fsync overlaps
+  //   with the round trip; we can't see any accepts until we return.)
   for (set<int>::const_iterator p = mon->get_quorum().begin();
        p != mon->get_quorum().end();
        ++p) {
@@ -399,13 +403,15 @@ void Paxos::begin(bufferlist& v)
     dout(10) << " sending begin to mon." << *p << dendl;
     MMonPaxos *begin = new MMonPaxos(mon->get_epoch(), MMonPaxos::OP_BEGIN,
 				     machine_id, ceph_clock_now(g_ceph_context));
-    begin->values[last_committed+1] = new_value;
+    begin->values[proposed_v] = new_value;
     begin->last_committed = last_committed;
     begin->pn = accepted_pn;
     
     mon->messenger->send_message(begin, mon->monmap->get_inst(*p));
   }
 
+  mon->store->put_bl_sn(new_value, machine_name, proposed_v);
+
   // set timeout event
   accept_timeout_event = new C_AcceptTimeout(this);
   mon->timer.add_event_after(g_conf->mon_accept_timeout, accept_timeout_event);
@@ -456,16 +462,19 @@ void Paxos::handle_accept(MMonPaxos *accept)
     accept->put();
     return;
   }
-  if (last_committed > 0 &&
-      accept->last_committed < last_committed-1) {
-    dout(10) << " this is from an old round, ignoring" << dendl;
+  // the peon accepted the value following its last_committed
+  if (!is_updating() ||
+      accept->last_committed + 1 != proposed_v) {
+    dout(10) << " this is for v" << accept->last_committed + 1
+	     << ", not the value we are proposing (v" << proposed_v
+	     << "), ignoring" << dendl;
+    mon->logger->inc(l_mon_paxos_stray_accept);
     accept->put();
     return;
   }
   assert(accept->last_committed == last_committed ||   // not committed
 	 accept->last_committed == last_committed-1);  // committed
 
-  assert(state == STATE_UPDATING);
   assert(accepted.count(from) == 0);
   accepted.insert(from);
   dout(10) << " now " << accepted << " have accepted" << dendl;
@@ -476,26 +485,47 @@ void Paxos::handle_accept(MMonPaxos *accept)
     // note: this may happen before the lease is reextended (below)
     dout(10) << " got majority, committing" << dendl;
     commit();
+
+    if (g_conf->paxos_pipeline && accepted != mon->get_quorum()) {
+      dout(10) << " pipelining, done with update" << dendl;
+      finish_update();
+    }
   }
 
   // done?
-  if (accepted == mon->get_quorum()) {
+  if (is_updating() && accepted == mon->get_quorum()) {
     dout(10) << " got quorum, done with update" << dendl;
-    // cancel timeout event
+    finish_update();
+  }
+  accept->put();
+}
+
+void Paxos::finish_update()
+{
+  assert(mon->is_leader());
+  assert(is_updating());
+  assert(proposed_v == last_committed);
+
+  // cancel timeout event
+  if (accept_timeout_event) {
     mon->timer.cancel_event(accept_timeout_event);
     accept_timeout_event = 0;
+  }
+
+  mon->logger->finc(l_mon_paxos_update_latency,
+		    ceph_clock_now(g_ceph_context) - proposed_stamp);
+  proposed_v = 0;
 
-    // yay!
-    state = STATE_ACTIVE;
+  // yay!
+  state = STATE_ACTIVE;
+  if (mon->get_quorum().size() > 1)
     extend_lease();
-  
-    // wake people up
-    finish_contexts(g_ceph_context, waiting_for_active);
-    finish_contexts(g_ceph_context, waiting_for_commit);
-    finish_contexts(g_ceph_context, waiting_for_readable);
-    finish_contexts(g_ceph_context, waiting_for_writeable);
-  }
-  accept->put();
+
+  // wake people up
+  finish_contexts(g_ceph_context, waiting_for_active);
+  finish_contexts(g_ceph_context, waiting_for_commit);
+  finish_contexts(g_ceph_context, waiting_for_readable);
+  finish_contexts(g_ceph_context, waiting_for_writeable);
 }
 
 void Paxos::accept_timeout()
@@ -516,16 +546,12 @@ void Paxos::commit()
   //   leader still got a majority and committed with out us.)
   lease_expire = utime_t();  // cancel lease
 
-  // commit locally
   last_committed++;
   last_commit_time = ceph_clock_now(g_ceph_context);
-  mon->store->put_int(last_committed, machine_name, "last_committed");
-  if (!first_committed) {
-    first_committed = last_committed;
-    mon->store->put_int(last_committed, machine_name, "first_committed");
-  }
 
   // tell everyone
+  //  (the value is already stable on a majority, so there is no need to
+  //   wait for our own write before sharing the news.)
   for (set<int>::const_iterator p = mon->get_quorum().begin();
        p != mon->get_quorum().end();
        ++p) {
@@ -541,6 +567,17 @@ void Paxos::commit()
     mon->messenger->send_message(commit, mon->monmap->get_inst(*p));
   }
 
+  // commit locally
+  mon->store->put_int(last_committed, machine_name, "last_committed");
+  if (!first_committed) {
+    first_committed = last_committed;
+    mon->store->put_int(last_committed, machine_name, "first_committed");
+  }
+
+  mon->logger->inc(l_mon_paxos_commit);
+  mon->logger->finc(l_mon_paxos_commit_latency,
+		    last_commit_time - proposed_stamp);
+
   // get ready for a new round.
   new_value.clear();
 }
@@ -814,6 +851,7 @@ void Paxos::leader_init()
 {
   cancel_events();
   new_value.clear();
+  proposed_v = 0;
 
   if (mon->get_quorum().size() == 1) {
     state = STATE_ACTIVE;			    
@@ -829,6 +867,7 @@ void Paxos::peon_init()
 {
   cancel_events();
   new_value.clear();
+  proposed_v = 0;
 
   state = STATE_RECOVERING;
   lease_expire = utime_t();
@@ -844,6 +883,7 @@ void Paxos::restart()
   dout(10) << "restart -- canceling timeouts" << dendl;
   cancel_events();
   new_value.clear();
+  proposed_v = 0;
 
   finish_contexts(g_ceph_context, waiting_for_commit, -1);
   finish_contexts(g_ceph_context, waiting_for_active, -1);
@@ -912,8 +952,8 @@ void Paxos::dispatch(PaxosServiceMessage *m)
 
 bool Paxos::is_readable(version_t v)
 {
-  dout(1) << "is_readable now=" << ceph_clock_now(g_ceph_context) << " lease_expire=" << lease_expire
-	  << " has v" << v << " lc " << last_committed << dendl;
+  dout(20) << "is_readable now=" << ceph_clock_now(g_ceph_context) << " lease_expire=" << lease_expire
+	   << " has v" << v << " lc " << last_committed << dendl;
   if (v > last_committed)
     return false;
   return 
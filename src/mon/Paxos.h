@@ -380,6 +380,19 @@ private:
    * that will be committed if the Peons do accept the proposal.
    */
   bufferlist new_value;
+  /**
+   * Version of the value currently being proposed.
+   *
+   * Set by Paxos::begin and reset to 0 once the update is finished. Accepts
+   * for any other version are strays (e.g., late accepts from a lagging Peon
+   * after we have already moved on with Paxos::pipeline enabled) and are
+   * ignored.
+   */
+  version_t proposed_v;
+  /**
+   * When we started proposing the current value, for latency accounting.
+   */
+  utime_t proposed_stamp;
   /**
    * Set of participants (Leader & Peons) that accepted the new proposed value.
    *
@@ -685,6 +698,21 @@ private:
    * @post Triggered fresh elections
    */
   void accept_timeout();
+  /**
+   * Finish the current update and move on to STATE_ACTIVE.
+   *
+   * This is done once the full quorum has accepted the proposed value or, if
+   * 'paxos pipeline' is set, as soon as a majority has accepted (and we have
+   * thus committed) it. In the latter case lagging Peons catch up in order,
+   * since they will always see the commit before any subsequent begin or
+   * lease, and a dead Peon will be caught by the lease ack timeout.
+   *
+   * @pre We are the Leader
+   * @pre We are on STATE_UPDATING
+   * @post We are on STATE_ACTIVE and the lease was extended
+   * @post Callbacks waiting for active, commit, readable and writeable fired
+   */
+  void finish_update();
   /**
    * @}
    */
@@ -846,6 +874,7 @@ public:
 		   lease_renew_event(0),
 		   lease_ack_timeout_event(0),
 		   lease_timeout_event(0),
+		   proposed_v(0),
 		   accept_timeout_event(0),
 		   clock_drift_warned(0) { }
 
@@ -17,6 +17,7 @@
 #include "Monitor.h"
 
 #include "common/config.h"
+#include "common/perf_counters.h"
 #include "include/assert.h"
 
 #define dout_subsys ceph_subsys_paxos
@@ -40,6 +41,7 @@ bool PaxosService::dispatch(PaxosServiceMessage *m)
   // make sure our map is readable and up to date
   if (!paxos->is_readable(m->version)) {
     dout(10) << " waiting for paxos -> readable (v" << m->version << ")" << dendl;
+    mon->logger->inc(l_mon_query_wait_readable);
     paxos->wait_for_readable(new C_RetryMessage(this, m));
     return true;
   }
@@ -48,8 +50,12 @@ bool PaxosService::dispatch(PaxosServiceMessage *m)
   update_from_paxos();
 
   // preprocess
-  if (preprocess_query(m)) 
+  //  (read-only requests are answered here, on whichever monitor the
+  //   client happens to talk to, as long as we hold a valid lease.)
+  if (preprocess_query(m)) {
+    mon->logger->inc(l_mon_query_local);
     return true;  // easy!
+  }
 
   // leader?
   if (!mon->is_leader()) {
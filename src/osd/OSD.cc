@@ -166,7 +166,9 @@ OSDService::OSDService(OSD *osd) :
   map_cache_lock("OSDService::map_lock"),
   map_cache(g_conf->osd_map_cache_size),
   map_bl_cache(g_conf->osd_map_cache_size),
-  map_bl_inc_cache(g_conf->osd_map_cache_size)
+  map_bl_inc_cache(g_conf->osd_map_cache_size),
+  past_mapping_lock("OSDService::past_mapping_lock"),
+  past_mapping_cache(g_conf->osd_past_mapping_cache_size)
 {}
 
 void OSDService::need_heartbeat_peer_update()
@@ -690,6 +692,7 @@ OSD::OSD(int id, Messenger *internal_messenger, Messenger *external_messenger,
   stat_lock("OSD::stat_lock"),
   finished_lock("OSD::finished_lock"),
   admin_ops_hook(NULL),
+  map_cache_hook(NULL),
   op_queue_len(0),
   op_wq(this, g_conf->osd_op_thread_timeout, &op_tp),
   peering_wq(this, g_conf->osd_op_thread_timeout, &op_tp, 200),
@@ -765,6 +768,18 @@ public:
   }
 };
 
+class MapCacheSocketHook : public AdminSocketHook {
+  OSD *osd;
+public:
+  MapCacheSocketHook(OSD *o) : osd(o) {}
+  bool call(std::string command, std::string args, bufferlist& out) {
+    stringstream ss;
+    osd->service.dump_map_cache(ss);
+    out.append(ss);
+    return true;
+  }
+};
+
 int OSD::init()
 {
   Mutex::Locker lock(osd_lock);
@@ -876,6 +891,10 @@ int OSD::init()
   r = admin_socket->register_command("dump_ops_in_flight", admin_ops_hook,
                                          "show the ops currently in flight");
   assert(r == 0);
+  map_cache_hook = new MapCacheSocketHook(this);
+  r = admin_socket->register_command("dump_osdmap_cache", map_cache_hook,
+				     "show memory used by cached osdmap epochs");
+  assert(r == 0);
 
   return 0;
 }
@@ -938,6 +957,9 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_map, "map_messages");           // osdmap messages
   osd_plb.add_u64_counter(l_osd_mape, "map_message_epochs");         // osdmap epochs
   osd_plb.add_u64_counter(l_osd_mape_dup, "map_message_epoch_dups"); // dup osdmap epochs
+  osd_plb.add_u64_counter(l_osd_pm_lookup, "past_mapping_lookups"); // pg mappings looked up for past_intervals
+  osd_plb.add_u64_counter(l_osd_pm_map_load, "past_mapping_map_loads"); // osdmaps loaded to fill them
+  osd_plb.add_fl_avg(l_osd_pi_gen_maps, "past_intervals_maps"); // osdmaps loaded per generate_past_intervals
 
   logger = osd_plb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
@@ -999,6 +1021,9 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("dump_ops_in_flight");
   delete admin_ops_hook;
   admin_ops_hook = NULL;
+  cct->get_admin_socket()->unregister_command("dump_osdmap_cache");
+  delete map_cache_hook;
+  map_cache_hook = NULL;
 
   recovery_tp.stop();
   dout(10) << "recovery tp stopped" << dendl;
@@ -1210,6 +1235,7 @@ PG *OSD::_open_lock_pg(
 
   assert(pg_map.count(pgid) == 0);
   pg_map[pgid] = pg;
+  service.reg_mapped_pg(pgid);
 
   if (hold_map_lock)
     pg->lock_with_map_lock_held(no_lockdep_check);
@@ -3287,10 +3313,10 @@ void OSD::handle_osd_map(MOSDMap *m)
 
       OSDMap *o = new OSDMap;
       if (e > 1) {
-	bufferlist obl;
+	// start from a shallow copy; apply_incremental copies whatever
+	// shared substructures it needs to modify.
 	OSDMapRef prev = get_map(e - 1);
-	prev->encode(obl);
-	o->decode(obl);
+	*o = *prev;
       }
 
       OSDMap::Incremental inc;
@@ -3800,6 +3826,92 @@ OSDMapRef OSDService::get_map(epoch_t epoch)
   return _add_map(map);
 }
 
+int OSDService::get_past_mapping(epoch_t e, pg_t pgid, pg_mapping_t *out)
+{
+  {
+    Mutex::Locker l(past_mapping_lock);
+    logger->inc(l_osd_pm_lookup);
+    std::tr1::shared_ptr<epoch_mapping_t> em = past_mapping_cache.lookup(e);
+    if (em) {
+      epoch_mapping_t::iterator p = em->find(pgid);
+      if (p != em->end()) {
+	*out = p->second;
+	return 0;
+      }
+    }
+  }
+
+  // load the map without blocking lookups that hit the cache
+  OSDMapRef map = get_map(e);
+  logger->inc(l_osd_pm_map_load);
+
+  Mutex::Locker l(past_mapping_lock);
+  std::tr1::shared_ptr<epoch_mapping_t> em = past_mapping_cache.lookup(e);
+  if (!em)
+    em = past_mapping_cache.add(e, new epoch_mapping_t);
+
+  // fill in every registered pg we don't have yet for this epoch
+  unsigned n = 0;
+  for (set<pg_t>::iterator p = mapped_pgs.begin(); p != mapped_pgs.end(); ++p) {
+    if (em->count(*p) || !map->have_pg_pool(p->pool()))
+      continue;
+    _map_pg(map, *p, (*em)[*p]);
+    n++;
+  }
+  dout(20) << "get_past_mapping " << e << " mapped " << n << " pgs" << dendl;
+
+  epoch_mapping_t::iterator p = em->find(pgid);
+  if (p != em->end())
+    *out = p->second;
+  else if (map->have_pg_pool(pgid.pool()))
+    _map_pg(map, pgid, *out);  // not registered (anymore), don't cache it
+  else
+    *out = pg_mapping_t();  // pool did not exist yet
+  return 1;
+}
+
+void OSDService::_map_pg(OSDMapRef map, pg_t pgid, pg_mapping_t& m)
+{
+  map->pg_to_up_acting_osds(pgid, m.up, m.acting);
+  if (m.acting.size()) {
+    m.primary_up_from = map->get_up_from(m.acting[0]);
+    m.primary_up_thru = map->get_up_thru(m.acting[0]);
+  }
+}
+
+void OSDService::dump_map_cache(ostream& ss)
+{
+  map<epoch_t, OSDMapRef> live;
+  {
+    Mutex::Locker l(map_cache_lock);
+    map_cache.get_all(&live);
+  }
+
+  // substructures shared between epochs are only counted for the first
+  // (oldest) epoch that references them, so 'bytes' is what each epoch
+  // adds on top of the ones before it.
+  set<const void*> seen;
+  uint64_t total = 0;
+  JSONFormatter jf(true);
+  jf.open_object_section("osdmap_cache");
+  jf.dump_int("num_maps", live.size());
+  jf.open_array_section("maps");
+  for (map<epoch_t, OSDMapRef>::iterator p = live.begin(); p != live.end(); ++p) {
+    uint64_t shared = 0;
+    uint64_t bytes = p->second->get_mem_usage(&shared, &seen);
+    total += bytes;
+    jf.open_object_section("map");
+    jf.dump_unsigned("epoch", p->first);
+    jf.dump_unsigned("bytes", bytes);
+    jf.dump_unsigned("shared_bytes", shared);
+    jf.close_section();
+  }
+  jf.close_section();
+  jf.dump_unsigned("total_bytes", total);
+  jf.close_section();
+  jf.flush(ss);
+}
+
 bool OSD::require_mon_peer(Message *m)
 {
   if (!m->get_connection()->peer_is_mon()) {
@@ -4729,6 +4841,7 @@ void OSD::_remove_pg(PG *pg)
   // to avoid racing with watcher cleanup in ms_handle_reset
   // and handle_notify_timeout
   pg->on_removal();
+  service.unreg_mapped_pg(pg->info.pgid);
 
   DeletingStateRef deleting = service.deleting_pgs.lookup_or_create(pg->info.pgid);
   for (vector<coll_t>::iterator i = removals.begin();
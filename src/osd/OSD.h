@@ -107,6 +107,9 @@ enum {
   l_osd_map,
   l_osd_mape,
   l_osd_mape_dup,
+  l_osd_pm_lookup,
+  l_osd_pm_map_load,
+  l_osd_pi_gen_maps,
 
   l_osd_last,
 };
@@ -128,6 +131,7 @@ class ReplicatedPG;
 class AuthAuthorizeHandlerRegistry;
 
 class OpsFlightSocketHook;
+class MapCacheSocketHook;
 
 extern const coll_t meta_coll;
 
@@ -300,6 +304,7 @@ public:
     return _get_map_bl(e, bl);
   }
   bool _get_map_bl(epoch_t e, bufferlist& bl);
+  void dump_map_cache(ostream& ss);
 
   void add_map_inc_bl(epoch_t e, bufferlist& bl) {
     Mutex::Locker l(map_cache_lock);
@@ -311,6 +316,46 @@ public:
 
   void clear_map_bl_cache_pins();
 
+  // -- past mappings --
+  /// a pg's up/acting, and the primary's up_from/up_thru, in some epoch
+  struct pg_mapping_t {
+    vector<int> up, acting;
+    epoch_t primary_up_from, primary_up_thru;
+    pg_mapping_t() : primary_up_from(0), primary_up_thru(0) {}
+    void swap(pg_mapping_t& o) {
+      up.swap(o.up);
+      acting.swap(o.acting);
+      std::swap(primary_up_from, o.primary_up_from);
+      std::swap(primary_up_thru, o.primary_up_thru);
+    }
+  };
+  typedef map<pg_t, pg_mapping_t> epoch_mapping_t;
+
+  Mutex past_mapping_lock;
+  set<pg_t> mapped_pgs;   ///< local pgs we compute mappings for
+  SharedLRU<epoch_t, epoch_mapping_t> past_mapping_cache;
+
+  void reg_mapped_pg(pg_t pgid) {
+    Mutex::Locker l(past_mapping_lock);
+    mapped_pgs.insert(pgid);
+  }
+  void unreg_mapped_pg(pg_t pgid) {
+    Mutex::Locker l(past_mapping_lock);
+    mapped_pgs.erase(pgid);
+  }
+  /**
+   * get the mapping of pgid in epoch e
+   *
+   * The first lookup in an epoch loads that OSDMap and maps every
+   * registered pg at once, so later lookups by other pgs are free.
+   * The map is loaded without past_mapping_lock held.  A pg that is
+   * not registered is mapped for the caller but not cached.
+   *
+   * @return number of OSDMaps that had to be loaded (0 or 1)
+   */
+  int get_past_mapping(epoch_t e, pg_t pgid, pg_mapping_t *out);
+  void _map_pg(OSDMapRef map, pg_t pgid, pg_mapping_t& m);
+
   void need_heartbeat_peer_update();
 
   void pg_stat_queue_enqueue(PG *pg);
@@ -526,6 +571,7 @@ private:
   void dump_ops_in_flight(ostream& ss);
   friend class OpsFlightSocketHook;
   OpsFlightSocketHook *admin_ops_hook;
+  MapCacheSocketHook *map_cache_hook;
 
   // -- op queue --
   list<PG*> op_queue;
@@ -501,6 +501,8 @@ void OSDMap::set_max_osd(int m)
     osd_weight[o] = CEPH_OSD_OUT;
   }
   osd_info.resize(m);
+  cow_addrs();
+  cow_uuid();
   osd_addrs->client_addr.resize(m);
   osd_addrs->cluster_addr.resize(m);
   osd_addrs->hb_addr.resize(m);
@@ -601,6 +603,8 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   int diff = 0;
 
   // do addrs match?
+  if (o->osd_addrs == n->osd_addrs)
+    goto addrs_done;  // already shared
   if (o->max_osd != n->max_osd)
     diff++;
   for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
@@ -624,27 +628,98 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
     // zoinks, no differences at all!
     n->osd_addrs = o->osd_addrs;
   }
+ addrs_done:
 
   // does crush match?
-  bufferlist oc, nc;
-  ::encode(*o->crush, oc);
-  ::encode(*n->crush, nc);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  if (o->crush != n->crush) {
+    bufferlist oc, nc;
+    ::encode(*o->crush, oc);
+    ::encode(*n->crush, nc);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (o->pg_temp->size() == n->pg_temp->size()) {
+  if (o->pg_temp != n->pg_temp &&
+      o->pg_temp->size() == n->pg_temp->size()) {
     if (*o->pg_temp == *n->pg_temp)
       n->pg_temp = o->pg_temp;
   }
 
   // do uuids match?
-  if (o->osd_uuid->size() == n->osd_uuid->size() &&
+  if (o->osd_uuid != n->osd_uuid &&
+      o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
 }
 
+uint64_t OSDMap::get_mem_usage(uint64_t *shared, set<const void*> *seen) const
+{
+  // rough per-node overhead for std::map/hash_map entries
+  const uint64_t node = 4 * sizeof(void*);
+
+  uint64_t own = sizeof(*this);
+  own += osd_state.capacity() * sizeof(osd_state[0]);
+  own += osd_weight.capacity() * sizeof(osd_weight[0]);
+  own += osd_info.capacity() * sizeof(osd_info_t);
+  for (map<int64_t,pg_pool_t>::const_iterator p = pools.begin(); p != pools.end(); ++p) {
+    own += node + sizeof(*p);
+    own += p->second.snaps.size() * (node + sizeof(snapid_t) + sizeof(pool_snap_info_t));
+    own += p->second.removed_snaps.num_intervals() * (node + 2 * sizeof(snapid_t));
+  }
+  for (map<int64_t,string>::const_iterator p = pool_name.begin(); p != pool_name.end(); ++p)
+    own += 2 * (node + sizeof(int64_t) + sizeof(string) + p->second.length());
+  own += blacklist.size() * (node + sizeof(entity_addr_t) + sizeof(utime_t));
+  own += cluster_snapshot.length();
+
+  // substructures that may be shared with other maps
+  uint64_t sh = 0;
+  uint64_t addrs = sizeof(addrs_s);
+  const vector<std::tr1::shared_ptr<entity_addr_t> > *av[3] = {
+    &osd_addrs->client_addr, &osd_addrs->cluster_addr, &osd_addrs->hb_addr
+  };
+  for (int i = 0; i < 3; i++) {
+    addrs += av[i]->capacity() * sizeof(std::tr1::shared_ptr<entity_addr_t>);
+    for (unsigned j = 0; j < av[i]->size(); j++) {
+      if (!(*av[i])[j])
+	continue;
+      if ((*av[i])[j].unique())
+	own += sizeof(entity_addr_t);
+      else if (!seen || seen->insert((*av[i])[j].get()).second)
+	sh += sizeof(entity_addr_t);
+    }
+  }
+  uint64_t temp = 0;
+  for (map<pg_t,vector<int> >::const_iterator p = pg_temp->begin(); p != pg_temp->end(); ++p)
+    temp += node + sizeof(*p) + p->second.capacity() * sizeof(int);
+  uint64_t uuid = osd_uuid->capacity() * sizeof(uuid_d);
+  bufferlist cbl;
+  crush->encode(cbl);
+  uint64_t cr = sizeof(CrushWrapper) + cbl.length();
+
+  struct {
+    bool unique;
+    const void *ptr;
+    uint64_t bytes;
+  } parts[4] = {
+    { osd_addrs.unique(), osd_addrs.get(), addrs },
+    { pg_temp.unique(), pg_temp.get(), temp },
+    { osd_uuid.unique(), osd_uuid.get(), uuid },
+    { crush.unique(), crush.get(), cr },
+  };
+  for (int i = 0; i < 4; i++) {
+    if (parts[i].unique)
+      own += parts[i].bytes;
+    else if (!seen || seen->insert(parts[i].ptr).second)
+      sh += parts[i].bytes;
+  }
+
+  if (shared)
+    *shared = sh;
+  return own + sh;
+}
+
 int OSDMap::apply_incremental(Incremental &inc)
 {
   if (inc.epoch == 1)
@@ -705,6 +780,13 @@ int OSDMap::apply_incremental(Incremental &inc)
   }
 
   // up/down
+  if (!inc.new_state.empty() || !inc.new_uuid.empty())
+    cow_uuid();
+  if (!inc.new_up_client.empty() || !inc.new_up_internal.empty())
+    cow_addrs();
+  if (!inc.new_pg_temp.empty())
+    cow_pg_temp();
+
   for (map<int32_t,uint8_t>::iterator i = inc.new_state.begin();
        i != inc.new_state.end();
        i++) {
@@ -1055,6 +1137,12 @@ void OSDMap::decode(bufferlist::iterator& p)
   __u16 v;
   ::decode(v, p);
 
+  // don't clobber anything we may be sharing with another map
+  osd_addrs.reset(new addrs_s);
+  pg_temp.reset(new map<pg_t,vector<int> >);
+  osd_uuid.reset(new vector<uuid_d>);
+  crush.reset(new CrushWrapper);
+
   // base
   ::decode(fsid, p);
   ::decode(epoch, p);
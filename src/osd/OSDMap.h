@@ -183,6 +183,21 @@ private:
   epoch_t cluster_snapshot_epoch;
   string cluster_snapshot;
 
+  // osd_addrs, pg_temp, osd_uuid and crush may be shared with maps for
+  // other epochs (a copied map, or see dedup()); copy before modifying.
+  void cow_addrs() {
+    if (!osd_addrs.unique())
+      osd_addrs.reset(new addrs_s(*osd_addrs));
+  }
+  void cow_pg_temp() {
+    if (!pg_temp.unique())
+      pg_temp.reset(new map<pg_t,vector<int> >(*pg_temp));
+  }
+  void cow_uuid() {
+    if (!osd_uuid.unique())
+      osd_uuid.reset(new vector<uuid_d>(*osd_uuid));
+  }
+
  public:
   std::tr1::shared_ptr<CrushWrapper> crush;       // hierarchical map
 
@@ -369,6 +384,16 @@ private:
   /// try to re-use/reference addrs in oldmap from newmap
   static void dedup(const OSDMap *oldmap, OSDMap *newmap);
 
+  /**
+   * approximate heap usage of this map
+   *
+   * @param shared [out] bytes in substructures also referenced by another map
+   * @param seen [in/out] if non-NULL, shared substructures already in this
+   *                      set are not counted at all (for totals over many maps)
+   * @return bytes
+   */
+  uint64_t get_mem_usage(uint64_t *shared=NULL, set<const void*> *seen=NULL) const;
+
   // serialize, unserialize
 private:
   void encode_client_old(bufferlist& bl) const;
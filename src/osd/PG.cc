@@ -18,6 +18,7 @@
 #include "OpRequest.h"
 
 #include "common/Timer.h"
+#include "common/perf_counters.h"
 
 #include "messages/MOSDOp.h"
 #include "messages/MOSDPGNotify.h"
@@ -775,39 +776,37 @@ void PG::generate_past_intervals()
   epoch_t cur_epoch = MAX(MAX(info.history.epoch_created,
 			      info.history.last_epoch_clean),
 			  osd->get_superblock().oldest_map);
-  OSDMapRef last_map, cur_map;
   if (cur_epoch >= end_epoch) {
     dout(10) << __func__ << " start epoch " << cur_epoch
 	     << " >= end epoch " << end_epoch
 	     << ", nothing to do" << dendl;
     return;
   }
-  vector<int> acting, up, old_acting, old_up;
 
-  cur_map = osd->get_map(cur_epoch);
-  cur_map->pg_to_up_acting_osds(get_pgid(), up, acting);
+  // Mappings come from the OSD's past mapping cache, which maps all of
+  // our local pgs the first time an epoch is needed; we only pay for
+  // decoding an OSDMap when no other pg has asked for that epoch yet.
+  OSDService::pg_mapping_t last, cur;
+  int maps_loaded = osd->get_past_mapping(cur_epoch, get_pgid(), &cur);
   epoch_t same_interval_since = cur_epoch;
   dout(10) << __func__ << " over epochs " << cur_epoch << "-"
 	   << end_epoch << dendl;
   ++cur_epoch;
   for (; cur_epoch <= end_epoch; ++cur_epoch) {
-    last_map.swap(cur_map);
-    old_up.swap(up);
-    old_acting.swap(acting);
-
-    cur_map = osd->get_map(cur_epoch);
-    cur_map->pg_to_up_acting_osds(get_pgid(), up, acting);
+    last.swap(cur);
+    maps_loaded += osd->get_past_mapping(cur_epoch, get_pgid(), &cur);
 
     std::stringstream debug;
     bool new_interval = pg_interval_t::check_new_interval(
-      old_acting,
-      acting,
-      old_up,
-      up,
+      last.acting,
+      cur.acting,
+      last.up,
+      cur.up,
       same_interval_since,
       info.history.last_epoch_clean,
-      cur_map,
-      last_map,
+      cur_epoch,
+      last.primary_up_from,
+      last.primary_up_thru,
       &past_intervals,
       &debug);
     if (new_interval) {
@@ -815,6 +814,8 @@ void PG::generate_past_intervals()
       same_interval_since = cur_epoch;
     }
   }
+  dout(10) << __func__ << " loaded " << maps_loaded << " maps" << dendl;
+  osd->logger->finc(l_osd_pi_gen_maps, maps_loaded);
 
   // record our work.
   dirty_info = true;
@@ -1431,23 +1431,47 @@ bool pg_interval_t::check_new_interval(
   OSDMapRef lastmap,
   map<epoch_t, pg_interval_t> *past_intervals,
   std::ostream *out)
+{
+  epoch_t up_from = 0, up_thru = 0;
+  if (old_acting.size()) {
+    up_from = lastmap->get_up_from(old_acting[0]);
+    up_thru = lastmap->get_up_thru(old_acting[0]);
+  }
+  return check_new_interval(old_acting, new_acting, old_up, new_up,
+			    same_interval_since, last_epoch_clean,
+			    osdmap->get_epoch(), up_from, up_thru,
+			    past_intervals, out);
+}
+
+bool pg_interval_t::check_new_interval(
+  const vector<int> &old_acting,
+  const vector<int> &new_acting,
+  const vector<int> &old_up,
+  const vector<int> &new_up,
+  epoch_t same_interval_since,
+  epoch_t last_epoch_clean,
+  epoch_t epoch,
+  epoch_t old_primary_up_from,
+  epoch_t old_primary_up_thru,
+  map<epoch_t, pg_interval_t> *past_intervals,
+  std::ostream *out)
 {
   // remember past interval
   if (new_acting != old_acting || new_up != old_up) {
     pg_interval_t& i = (*past_intervals)[same_interval_since];
     i.first = same_interval_since;
-    i.last = osdmap->get_epoch() - 1;
+    i.last = epoch - 1;
     i.acting = old_acting;
     i.up = old_up;
 
     if (i.acting.size()) {
-      if (lastmap->get_up_thru(i.acting[0]) >= i.first &&
-	  lastmap->get_up_from(i.acting[0]) <= i.first) {
+      if (old_primary_up_thru >= i.first &&
+	  old_primary_up_from <= i.first) {
 	i.maybe_went_rw = true;
 	if (out)
 	  *out << "generate_past_intervals " << i
-	       << " : primary up " << lastmap->get_up_from(i.acting[0])
-	       << "-" << lastmap->get_up_thru(i.acting[0])
+	       << " : primary up " << old_primary_up_from
+	       << "-" << old_primary_up_thru
 	       << std::endl;
       } else if (last_epoch_clean >= i.first &&
 		 last_epoch_clean <= i.last) {
@@ -1468,8 +1492,8 @@ bool pg_interval_t::check_new_interval(
 	i.maybe_went_rw = false;
 	if (out)
 	  *out << "generate_past_intervals " << i
-	       << " : primary up " << lastmap->get_up_from(i.acting[0])
-	       << "-" << lastmap->get_up_thru(i.acting[0])
+	       << " : primary up " << old_primary_up_from
+	       << "-" << old_primary_up_thru
 	       << " does not include interval"
 	       << std::endl;
       }
@@ -1119,6 +1119,24 @@ struct pg_interval_t {
     map<epoch_t, pg_interval_t> *past_intervals,///< [out] intervals
     ostream *out = 0                            ///< [out] debug ostream
     );
+
+  /**
+   * Same as above, for callers that know the new epoch and the up_from
+   * and up_thru of the old primary but do not have the maps at hand.
+   */
+  static bool check_new_interval(
+    const vector<int> &old_acting,              ///< [in] acting as of lastmap
+    const vector<int> &new_acting,              ///< [in] acting as of osdmap
+    const vector<int> &old_up,                  ///< [in] up as of lastmap
+    const vector<int> &new_up,                  ///< [in] up as of osdmap
+    epoch_t same_interval_since,                ///< [in] as of osdmap
+    epoch_t last_epoch_clean,                   ///< [in] current
+    epoch_t epoch,                              ///< [in] epoch of osdmap
+    epoch_t old_primary_up_from,                ///< [in] as of lastmap
+    epoch_t old_primary_up_thru,                ///< [in] as of lastmap
+    map<epoch_t, pg_interval_t> *past_intervals,///< [out] intervals
+    ostream *out = 0                            ///< [out] debug ostream
+    );
 };
 WRITE_CLASS_ENCODER(pg_interval_t)
 
@@ -63,8 +63,13 @@ void Journaler::set_layout(ceph_file_layout *l)
   uint64_t periods = cct->_conf->journaler_prefetch_periods;
   if (periods < 2)
     periods = 2;  // we need at least 2 periods to make progress.
-  fetch_len = layout.fl_stripe_count * layout.fl_object_size * periods;
-  prefetch_from = fetch_len / 2;
+  max_fetch_len = layout.fl_stripe_count * layout.fl_object_size * periods;
+  min_fetch_len = layout.fl_stripe_count * layout.fl_object_size * 2;
+  prefetch_from = max_fetch_len / 2;
+
+  // start small; _adjust_readahead() and wait_for_readable() grow the
+  // window if the reader keeps up with it.
+  fetch_len = min_fetch_len;
 }
 
 
@@ -394,6 +399,10 @@ void Journaler::_finish_flush(int r, uint64_t start, utime_t stamp)
   assert(!readonly);
   if (r < 0) {
     lderr(cct) << "_finish_flush got " << cpp_strerror(r) << dendl;
+    // send what was held back for this write before the error handler
+    // runs (it may shut the objecter down), so it isn't left stranded.
+    if (flush_deferred)
+      _do_flush();
     handle_write_error(r);
     return;
   }
@@ -430,6 +439,12 @@ void Journaler::_finish_flush(int r, uint64_t start, utime_t stamp)
     finish_contexts(cct, waitfor_safe.begin()->second);
     waitfor_safe.erase(waitfor_safe.begin());
   }
+
+  // send out whatever piled up while that write was in flight
+  if (flush_deferred) {
+    ldout(cct, 20) << "_finish_flush issuing deferred flush of " << write_buf.length() << " bytes" << dendl;
+    _do_flush();
+  }
 }
 
 
@@ -534,10 +549,18 @@ void Journaler::_do_flush(unsigned amount)
   // adjust pointers
   if (len == write_buf.length()) {
     write_bl.swap(write_buf);
+    flush_deferred = false;
   } else {
     write_buf.splice(0, len, &write_bl);
   }
 
+  if (logger) {
+    if (logger_key_wr >= 0)
+      logger->inc(logger_key_wr);
+    if (logger_key_wrbytes >= 0)
+      logger->inc(logger_key_wrbytes, len);
+  }
+
   filer.write(ino, &layout, snapc,
 	      flush_pos, len, write_bl, ceph_clock_now(cct),
 	      0,
@@ -589,7 +612,16 @@ void Journaler::flush(Context *onsafe)
       delete onsafe;
     }
   } else {
-    if (1) {
+    if (!pending_safe.empty() &&
+	write_buf.length() < cct->_conf->journaler_group_commit_bytes) {
+      // group commit: a write is already in flight, so hold this one
+      // until it commits and send everything queued by then as a single
+      // (larger) write.  big buffers still go out right away, so several
+      // objects can be in flight when the journal is busy.
+      ldout(cct, 20) << "flush deferring " << write_buf.length() << " bytes, "
+		     << pending_safe.size() << " writes in flight" << dendl;
+      flush_deferred = true;
+    } else {
       // maybe buffer
       if (write_buf.length() < cct->_conf->journaler_batch_max) {
 	// delay!  schedule an event.
@@ -602,9 +634,6 @@ void Journaler::flush(Context *onsafe)
 	ldout(cct, 20) << "flush not delaying flush" << dendl;
 	_do_flush();
       }
-    } else {
-      // always flush
-      _do_flush();
     }
     wait_for_flush(onsafe);
   }
@@ -706,11 +735,15 @@ void Journaler::_prezeroed(int r, uint64_t start, uint64_t len)
 class Journaler::C_Read : public Context {
   Journaler *ls;
   uint64_t offset;
+  int objects;
+  uint64_t gen;
+  utime_t stamp;
 public:
   bufferlist bl;
-  C_Read(Journaler *l, uint64_t o) : ls(l), offset(o) {}
+  C_Read(Journaler *l, uint64_t o, int n, uint64_t g, utime_t s) :
+    ls(l), offset(o), objects(n), gen(g), stamp(s) {}
   void finish(int r) {
-    ls->_finish_read(r, offset, bl);
+    ls->_finish_read(r, offset, objects, gen, stamp, bl);
   }
 };
 
@@ -724,8 +757,17 @@ public:
   }  
 };
 
-void Journaler::_finish_read(int r, uint64_t offset, bufferlist& bl)
+void Journaler::_finish_read(int r, uint64_t offset, int objects, uint64_t gen,
+			     utime_t stamp, bufferlist& bl)
 {
+  if (gen != read_gen) {
+    ldout(cct, 10) << "_finish_read " << offset << " from before reset, ignoring" << dendl;
+    return;
+  }
+
+  reads_inflight -= objects;
+  assert(reads_inflight >= 0);
+
   if (r < 0) {
     ldout(cct, 0) << "_finish_read got error " << r << dendl;
     error = r;
@@ -740,12 +782,59 @@ void Journaler::_finish_read(int r, uint64_t offset, bufferlist& bl)
   assert(r>=0);
 
   ldout(cct, 10) << "_finish_read got " << offset << "~" << bl.length() << dendl;
+
+  utime_t lat = ceph_clock_now(cct);
+  lat -= stamp;
+  if (logger) {
+    if (logger_key_rdbytes >= 0)
+      logger->inc(logger_key_rdbytes, bl.length());
+    if (logger_key_rdlat >= 0)
+      logger->finc(logger_key_rdlat, lat);
+  }
+  _adjust_readahead(lat);
+
   prefetch_buf[offset].swap(bl);
 
   _assimilate_prefetch();
   _prefetch();
 }
 
+/*
+ * size the readahead window so that what is in flight covers a read's
+ * latency at the rate the reader is consuming entries, with a factor
+ * of two to spare.  move a period at a time.
+ */
+void Journaler::_adjust_readahead(utime_t lat)
+{
+  uint64_t period = get_layout_period();
+  double l = lat;
+  read_lat = read_lat > 0 ? (read_lat * 7 + l) / 8 : l;
+
+  utime_t now = ceph_clock_now(cct);
+  if (rate_stamp != utime_t() && read_pos >= rate_pos) {
+    double dt = now - rate_stamp;
+    if (dt > 0) {
+      double r = (double)(read_pos - rate_pos) / dt;
+      consume_rate = consume_rate > 0 ? (consume_rate * 7 + r) / 8 : r;
+    }
+  }
+  rate_stamp = now;
+  rate_pos = read_pos;
+
+  uint64_t want = (uint64_t)(consume_rate * read_lat * 2.0);
+  uint64_t old = fetch_len;
+  if (want > fetch_len && fetch_len + period <= max_fetch_len)
+    fetch_len += period;
+  else if (want + period < fetch_len && fetch_len >= min_fetch_len + period)
+    fetch_len -= period;
+
+  if (fetch_len != old)
+    ldout(cct, 10) << "_adjust_readahead rate " << consume_rate << " B/s, read lat " << read_lat
+		   << "s, window " << old << " -> " << fetch_len << dendl;
+  if (logger && logger_key_rdahead >= 0)
+    logger->set(logger_key_rdahead, fetch_len);
+}
+
 void Journaler::_assimilate_prefetch()
 {
   bool was_readable = _is_readable();
@@ -819,15 +908,31 @@ void Journaler::_issue_read(uint64_t len)
   // here because it will wait for all object reads to complete before
   // giving us back any data.  this way we can process whatever bits
   // come in that are contiguous.
+  //
+  // keep at most journaler_prefetch_max_inflight objects in flight;
+  // _finish_read() will come back for the rest.
   uint64_t period = get_layout_period();
+  int max_inflight = cct->_conf->journaler_prefetch_max_inflight;
+  utime_t now = ceph_clock_now(cct);
   while (len > 0) {
+    if (max_inflight > 0 && reads_inflight > 0 &&
+	reads_inflight + (int)layout.fl_stripe_count > max_inflight) {
+      ldout(cct, 10) << "_issue_read " << reads_inflight << " objects in flight, deferring "
+		     << requested_pos << "~" << len << dendl;
+      break;
+    }
     uint64_t e = requested_pos + period;
     e -= e % period;
     uint64_t l = e - requested_pos;
     if (l > len)
       l = len;
-    C_Read *c = new C_Read(this, requested_pos);
+    int objects = MIN((uint64_t)layout.fl_stripe_count,
+		      (l + layout.fl_stripe_unit - 1) / layout.fl_stripe_unit);
+    C_Read *c = new C_Read(this, requested_pos, objects, read_gen, now);
     filer.read(ino, &layout, CEPH_NOSNAP, requested_pos, l, &c->bl, 0, c);
+    reads_inflight += objects;
+    if (logger && logger_key_rd >= 0)
+      logger->inc(logger_key_rd);
     requested_pos += l;
     len -= l;
   }
@@ -966,6 +1071,22 @@ void Journaler::wait_for_readable(Context *onreadable)
   assert(!_is_readable());
   assert(on_readable == 0);
   on_readable = onreadable;
+
+  // the reader caught up with data that is still in flight: the window
+  // is too small for the rate it is consuming at.
+  if (requested_pos > received_pos) {
+    uint64_t old = fetch_len;
+    fetch_len = MIN(MAX(fetch_len * 2, min_fetch_len), max_fetch_len);
+    ldout(cct, 10) << "wait_for_readable stalled on in-flight reads, window "
+		   << old << " -> " << fetch_len << dendl;
+    if (logger) {
+      if (logger_key_rdstall >= 0)
+	logger->inc(logger_key_rdstall);
+      if (logger_key_rdahead >= 0)
+	logger->set(logger_key_rdahead, fetch_len);
+    }
+    _prefetch();
+  }
 }
 
 
@@ -112,6 +112,9 @@ private:
 
   PerfCounters *logger;
   int logger_key_lat;
+  int logger_key_wr, logger_key_wrbytes;
+  int logger_key_rd, logger_key_rdbytes, logger_key_rdlat;
+  int logger_key_rdahead, logger_key_rdstall;
 
   SafeTimer *timer;
 
@@ -176,6 +179,7 @@ private:
   interval_set<uint64_t> pending_zero;  // non-contig bits we've zeroed
   std::set<uint64_t> pending_safe;
   std::map<uint64_t, std::list<Context*> > waitfor_safe; // when safe through given offset
+  bool flush_deferred;      // group commit: flush once an in-flight write commits
 
   void _do_flush(unsigned amount=0);
   void _finish_flush(int r, uint64_t start, utime_t stamp);
@@ -194,12 +198,25 @@ private:
   uint64_t temp_fetch_len;
   uint64_t prefetch_from; // how far from end do we read next chunk
 
+  // readahead.  fetch_len adapts between min_fetch_len and max_fetch_len
+  // to the rate the reader consumes entries, and at most
+  // journaler_prefetch_max_inflight objects are read at once.
+  uint64_t min_fetch_len, max_fetch_len;
+  int reads_inflight;     // objects
+  uint64_t read_gen;      // bumped by reset(); older read completions are dropped
+  double read_lat;        // smoothed per-read latency (seconds)
+  double consume_rate;    // smoothed bytes/sec consumed by the reader
+  uint64_t rate_pos;
+  utime_t rate_stamp;
+  void _adjust_readahead(utime_t lat);
+
   // for wait_for_readable()
   Context    *on_readable;
 
   Context    *on_write_error;
 
-  void _finish_read(int r, uint64_t offset, bufferlist &bl); // read completion callback
+  void _finish_read(int r, uint64_t offset, int objects, uint64_t gen,
+		    utime_t stamp, bufferlist &bl); // read completion callback
   void _assimilate_prefetch();
   void _issue_read(uint64_t len);  // read some more
   void _prefetch();             // maybe read ahead
@@ -244,12 +261,17 @@ public:
     cct(obj->cct), last_written(mag), last_committed(mag),
     ino(ino_), pg_pool(pool), readonly(true), magic(mag),
     objecter(obj), filer(objecter), logger(l), logger_key_lat(lkey),
+    logger_key_wr(-1), logger_key_wrbytes(-1),
+    logger_key_rd(-1), logger_key_rdbytes(-1), logger_key_rdlat(-1),
+    logger_key_rdahead(-1), logger_key_rdstall(-1),
     timer(tim), delay_flush_event(0),
     state(STATE_UNDEF), error(0),
     prezeroing_pos(0), prezero_pos(0), write_pos(0), flush_pos(0), safe_pos(0),
-    waiting_for_zero(false),
+    waiting_for_zero(false), flush_deferred(false),
     read_pos(0), requested_pos(0), received_pos(0),
     fetch_len(0), temp_fetch_len(0), prefetch_from(0),
+    min_fetch_len(0), max_fetch_len(0), reads_inflight(0), read_gen(0),
+    read_lat(0), consume_rate(0), rate_pos(0),
     on_readable(0), on_write_error(NULL),
     expire_pos(0), trimming_pos(0), trimmed_pos(0) 
   {
@@ -271,11 +293,21 @@ public:
     received_pos = 0;
     fetch_len = 0;
     prefetch_from = 0;
+    // reads still in flight will complete against the old generation
+    // and be ignored.
+    reads_inflight = 0;
+    read_gen++;
+    prefetch_buf.clear();
+    read_buf.clear();
+    read_lat = consume_rate = 0;
+    rate_pos = 0;
+    rate_stamp = utime_t();
     assert(!on_readable);
     expire_pos = 0;
     trimming_pos = 0;
     trimmed_pos = 0;
     waiting_for_zero = false;
+    flush_deferred = false;
   }
 
   // me
@@ -296,6 +328,20 @@ public:
 
   void set_layout(ceph_file_layout *l);
 
+  /// count journal writes issued and their total size in our logger
+  void set_write_logger_keys(int wr, int wrbytes) {
+    logger_key_wr = wr;
+    logger_key_wrbytes = wrbytes;
+  }
+  /// report reads, read latency, the readahead window and reader stalls
+  void set_read_logger_keys(int rd, int rdbytes, int rdlat, int rdahead, int rdstall) {
+    logger_key_rd = rd;
+    logger_key_rdbytes = rdbytes;
+    logger_key_rdlat = rdlat;
+    logger_key_rdahead = rdahead;
+    logger_key_rdstall = rdstall;
+  }
+
   void set_readonly();
   void set_writeable();
   bool is_readonly() { return readonly; }
@@ -326,6 +372,7 @@ public:
 
   bool _is_readable();
   bool is_readable();
+  void prefetch() { _prefetch(); }   // start reading ahead of read_pos
   bool try_read_entry(bufferlist& bl);
   void wait_for_readable(Context *onfinish);
   
@@ -46,6 +46,7 @@ void _usage()
   cerr << "  bucket unlink              unlink bucket from specified user\n";
   cerr << "  bucket stats               returns bucket statistics\n";
   cerr << "  bucket info                show bucket information\n";
+  cerr << "  bucket reshard             rebuild the bucket index with --num-shards shards\n";
   cerr << "  pool add                   add an existing pool for data placement\n";
   cerr << "  pool rm                    remove an existing pool from data placement set\n";
   cerr << "  pools list                 list placement active set\n";
@@ -78,6 +79,7 @@ void _usage()
   cerr << "   --start-date=<date>\n";
   cerr << "   --end-date=<date>\n";
   cerr << "   --bucket-id=<bucket-id>\n";
+  cerr << "   --num-shards=<n>          number of bucket index shards (0 for unsharded)\n";
   cerr << "   --format=<format>         specify output format for certain operations: xml,\n";
   cerr << "                             json\n";
   cerr << "   --purge-data              when specified, user removal will also purge all the\n";
@@ -124,6 +126,7 @@ enum {
   OPT_BUCKET_LINK,
   OPT_BUCKET_UNLINK,
   OPT_BUCKET_STATS,
+  OPT_BUCKET_RESHARD,
   OPT_POLICY,
   OPT_POOL_ADD,
   OPT_POOL_RM,
@@ -253,6 +256,8 @@ static int get_cmd(const char *cmd, const char *prev_cmd, bool *need_more)
       return OPT_BUCKET_UNLINK;
     if (strcmp(cmd, "stats") == 0)
       return OPT_BUCKET_STATS;
+    if (strcmp(cmd, "reshard") == 0)
+      return OPT_BUCKET_RESHARD;
   } else if (strcmp(prev_cmd, "log") == 0) {
     if (strcmp(cmd, "list") == 0)
       return OPT_LOG_LIST;
@@ -495,6 +500,7 @@ int bucket_stats(rgw_bucket& bucket, Formatter *formatter)
   formatter->dump_string("id", bucket.bucket_id);
   formatter->dump_string("marker", bucket.marker);
   formatter->dump_string("owner", bucket_info.owner);
+  formatter->dump_int("num_shards", bucket_info.num_shards);
   formatter->open_object_section("usage");
   for (iter = stats.begin(); iter != stats.end(); ++iter) {
     RGWBucketStats& s = iter->second;
@@ -587,6 +593,7 @@ int main(int argc, char **argv)
   int purge_keys = false;
   int yes_i_really_mean_it = false;
   int max_buckets = -1;
+  int num_shards = -1;
 
   std::string val;
   std::ostringstream errs;
@@ -643,6 +650,8 @@ int main(int argc, char **argv)
       auid = tmp;
     } else if (ceph_argparse_witharg(args, i, &val, "--max-buckets", (char*)NULL)) {
       max_buckets = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--num-shards", (char*)NULL)) {
+      num_shards = atoi(val.c_str());
     } else if (ceph_argparse_witharg(args, i, &val, "--date", "--time", (char*)NULL)) {
       date = val;
       if (end_date.empty())
@@ -1350,6 +1359,48 @@ next:
     cout << std::endl;
   }
 
+  if (opt_cmd == OPT_BUCKET_RESHARD) {
+    if (bucket_name.empty() && bucket_id.empty()) {
+      cerr << "bucket name or bucket-id needs to be specified" << std::endl;
+      return usage();
+    }
+    if (num_shards < 0) {
+      cerr << "--num-shards needs to be specified" << std::endl;
+      return usage();
+    }
+    RGWBucketInfo info;
+    int r = rgwstore->get_bucket_info(NULL, bucket.name, info);
+    if (r < 0) {
+      cerr << "could not get bucket info for bucket=" << bucket.name << std::endl;
+      return -r;
+    }
+
+    // the bucket is unavailable while its index is rebuilt
+    bool was_suspended = (info.flags & BUCKET_SUSPENDED);
+    vector<rgw_bucket> buckets;
+    buckets.push_back(bucket);
+    if (!was_suspended) {
+      r = rgwstore->set_buckets_enabled(buckets, false);
+      if (r < 0) {
+        cerr << "failed to suspend bucket: " << cpp_strerror(-r) << std::endl;
+        return -r;
+      }
+    }
+    r = rgwstore->reshard_bucket_index(bucket, num_shards);
+    if (r < 0)
+      cerr << "reshard failed: " << cpp_strerror(-r) << std::endl;
+    if (!was_suspended) {
+      int ret = rgwstore->set_buckets_enabled(buckets, true);
+      if (ret < 0) {
+        cerr << "failed to reenable bucket: " << cpp_strerror(-ret) << std::endl;
+        if (r >= 0)
+          r = ret;
+      }
+    }
+    if (r < 0)
+      return -r;
+  }
+
   if (opt_cmd == OPT_USER_SUSPEND || opt_cmd == OPT_USER_ENABLE) {
     string id;
     __u8 disable = (opt_cmd == OPT_USER_SUSPEND ? 1 : 0);
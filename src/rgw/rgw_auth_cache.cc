@@ -0,0 +1,233 @@
+#include "common/Clock.h"
+#include "common/config.h"
+#include "include/ceph_hash.h"
+
+#include "rgw_auth_cache.h"
+#include "rgw_user.h"
+
+#define dout_subsys ceph_subsys_rgw
+
+#define RGW_AUTH_CACHE_SHARDS 16
+
+using namespace std;
+using ceph::crypto::HMACSHA1;
+
+RGWAuthCache *rgw_auth_cache = NULL;
+
+void rgw_auth_cache_init(CephContext *cct)
+{
+  if (cct->_conf->rgw_auth_cache_ttl <= 0 || cct->_conf->rgw_auth_cache_size <= 0)
+    return;
+  if (!cct->_conf->rgw_cache_enabled) {
+    // nothing would tell us about user changes made elsewhere
+    ldout(cct, 0) << "rgw_auth_cache_ttl is set but rgw_cache_enabled is off, not caching auth" << dendl;
+    return;
+  }
+  rgw_auth_cache = new RGWAuthCache(cct);
+}
+
+void rgw_auth_cache_finalize()
+{
+  delete rgw_auth_cache;
+  rgw_auth_cache = NULL;
+}
+
+RGWAuthCache::RGWAuthCache(CephContext *_cct) : cct(_cct)
+{
+  for (int i = 0; i < RGW_AUTH_CACHE_SHARDS; i++)
+    shards.push_back(new Shard);
+  max_entries = cct->_conf->rgw_auth_cache_size / RGW_AUTH_CACHE_SHARDS;
+  if (max_entries < 1)
+    max_entries = 1;
+}
+
+RGWAuthCache::~RGWAuthCache()
+{
+  for (vector<Shard *>::iterator iter = shards.begin(); iter != shards.end(); ++iter) {
+    Shard *shard = *iter;
+    while (!shard->entries.empty())
+      remove(shard, shard->entries.begin());
+    delete shard;
+  }
+}
+
+RGWAuthCache::Shard *RGWAuthCache::get_shard(const string& key)
+{
+  return shards[ceph_str_hash_linux(key.c_str(), key.size()) % shards.size()];
+}
+
+/* called with the shard lock held */
+RGWAuthCache::Entry *RGWAuthCache::find(Shard *shard, const string& key)
+{
+  map<string, Entry>::iterator iter = shard->entries.find(key);
+  if (iter == shard->entries.end())
+    return NULL;
+  Entry& entry = iter->second;
+  if (entry.expires < ceph_clock_now(cct)) {
+    ldout(cct, 10) << "auth cache: " << key << " expired" << dendl;
+    remove(shard, iter);
+    return NULL;
+  }
+  shard->lru.splice(shard->lru.end(), shard->lru, entry.lru_iter);
+  return &entry;
+}
+
+void RGWAuthCache::insert(Shard *shard, const string& key, RGWUserInfo& info, utime_t expires)
+{
+  map<string, Entry>::iterator iter = shard->entries.find(key);
+  if (iter == shard->entries.end()) {
+    iter = shard->entries.insert(pair<string, Entry>(key, Entry())).first;
+    shard->lru.push_back(key);
+    iter->second.lru_iter = --shard->lru.end();
+  } else {
+    shard->lru.splice(shard->lru.end(), shard->lru, iter->second.lru_iter);
+  }
+  iter->second.info = info;
+  iter->second.expires = expires;
+
+  while (shard->entries.size() > max_entries) {
+    map<string, Entry>::iterator victim = shard->entries.find(shard->lru.front());
+    assert(victim != shard->entries.end());
+    remove(shard, victim);
+  }
+}
+
+void RGWAuthCache::remove(Shard *shard, map<string, Entry>::iterator iter)
+{
+  shard->lru.erase(iter->second.lru_iter);
+  delete iter->second.hmac;
+  shard->entries.erase(iter);
+}
+
+int RGWAuthCache::get_user(const string& key, string& id,
+                           int (*fetch)(string&, RGWUserInfo&), RGWUserInfo& info)
+{
+  Shard *shard = get_shard(key);
+  {
+    Mutex::Locker l(shard->lock);
+    Entry *entry = find(shard, key);
+    if (entry) {
+      info = entry->info;
+      if (perfcounter)
+        perfcounter->inc(l_rgw_auth_cache_hit);
+      return 0;
+    }
+  }
+  if (perfcounter)
+    perfcounter->inc(l_rgw_auth_cache_miss);
+
+  int gen = get_generation();
+  int r = fetch(id, info);
+  if (r < 0)
+    return r;
+
+  utime_t expires = ceph_clock_now(cct);
+  expires += cct->_conf->rgw_auth_cache_ttl;
+  Mutex::Locker l(shard->lock);
+  if (gen != get_generation())
+    return 0;  // may have read it before a change; don't keep it
+  insert(shard, key, info, expires);
+  return 0;
+}
+
+int RGWAuthCache::get_user_by_access_key(string& access_key, RGWUserInfo& info)
+{
+  return get_user("s3:" + access_key, access_key, rgw_get_user_info_by_access_key, info);
+}
+
+int RGWAuthCache::get_user_by_swift(string& swift_user, RGWUserInfo& info)
+{
+  return get_user("swift:" + swift_user, swift_user, rgw_get_user_info_by_swift, info);
+}
+
+void RGWAuthCache::calc_hmac_sha1(const string& access_key, const string& secret,
+                                  const char *msg, int msg_len, char *dest)
+{
+  string key = "s3:" + access_key;
+  Shard *shard = get_shard(key);
+  Mutex::Locker l(shard->lock);
+  Entry *entry = find(shard, key);
+  if (!entry) {
+    ::calc_hmac_sha1(secret.c_str(), secret.size(), msg, msg_len, dest);
+    return;
+  }
+  if (!entry->hmac || entry->secret != secret) {
+    delete entry->hmac;
+    entry->hmac = new HMACSHA1((const byte *)secret.c_str(), secret.size());
+    entry->secret = secret;
+  }
+  entry->hmac->Update((const byte *)msg, msg_len);
+  entry->hmac->Final((byte *)dest);
+}
+
+bool RGWAuthCache::get_token(const string& token, RGWUserInfo& info)
+{
+  string key = "token:" + token;
+  Shard *shard = get_shard(key);
+  Mutex::Locker l(shard->lock);
+  Entry *entry = find(shard, key);
+  if (!entry) {
+    if (perfcounter)
+      perfcounter->inc(l_rgw_auth_cache_miss);
+    return false;
+  }
+  info = entry->info;
+  if (perfcounter)
+    perfcounter->inc(l_rgw_auth_cache_hit);
+  return true;
+}
+
+void RGWAuthCache::put_token(const string& token, utime_t expiration, RGWUserInfo& info, int gen)
+{
+  utime_t expires = ceph_clock_now(cct);
+  expires += cct->_conf->rgw_auth_cache_ttl;
+  if (expiration < expires)
+    expires = expiration;
+
+  string key = "token:" + token;
+  Shard *shard = get_shard(key);
+  Mutex::Locker l(shard->lock);
+  if (gen != get_generation())
+    return;
+  insert(shard, key, info, expires);
+}
+
+void RGWAuthCache::remove_key(const string& key)
+{
+  generation.inc();
+  Shard *shard = get_shard(key);
+  Mutex::Locker l(shard->lock);
+  map<string, Entry>::iterator iter = shard->entries.find(key);
+  if (iter != shard->entries.end()) {
+    ldout(cct, 10) << "auth cache: invalidating " << key << dendl;
+    remove(shard, iter);
+  }
+}
+
+void RGWAuthCache::invalidate(const string& pool, const string& oid)
+{
+  if (pool == USER_INFO_POOL_NAME)
+    remove_key("s3:" + oid);
+  else if (pool == USER_INFO_SWIFT_POOL_NAME)
+    remove_key("swift:" + oid);
+  else if (pool == USER_INFO_UID_POOL_NAME)
+    invalidate_user(oid);
+}
+
+/* user changes are rare, so just look at everything */
+void RGWAuthCache::invalidate_user(const string& user_id)
+{
+  generation.inc();
+  for (vector<Shard *>::iterator siter = shards.begin(); siter != shards.end(); ++siter) {
+    Shard *shard = *siter;
+    Mutex::Locker l(shard->lock);
+    map<string, Entry>::iterator iter = shard->entries.begin();
+    while (iter != shard->entries.end()) {
+      map<string, Entry>::iterator cur = iter++;
+      if (cur->second.info.user_id == user_id) {
+        ldout(cct, 10) << "auth cache: invalidating " << cur->first << " of " << user_id << dendl;
+        remove(shard, cur);
+      }
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef CEPH_RGW_AUTH_CACHE_H
+#define CEPH_RGW_AUTH_CACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/ceph_crypto.h"
+#include "common/Mutex.h"
+#include "include/atomic.h"
+#include "include/utime.h"
+#include "rgw_common.h"
+
+/*
+ * Users by S3 access key and by swift user, and swift tokens that were
+ * already verified, kept for 'rgw auth cache ttl' seconds.  A client
+ * sending request after request then skips reading and decoding its user
+ * info, and re-checking its token, every time.  An S3 entry also keeps
+ * an HMAC-SHA1 context keyed with the user's secret, so the key pads
+ * aren't recomputed for each signature.
+ *
+ * Entries for a user are dropped when its user info objects change, here
+ * or, through the RGWCache notifications, anywhere else (radosgw-admin
+ * removing a key or suspending the user).  So the auth cache is only used
+ * along with 'rgw cache enabled'.
+ */
+class RGWAuthCache {
+  struct Entry {
+    RGWUserInfo info;
+    utime_t expires;
+    std::string secret;  // what hmac is keyed with
+    ceph::crypto::HMACSHA1 *hmac;
+    std::list<std::string>::iterator lru_iter;
+    Entry() : hmac(NULL) {}
+  };
+
+  struct Shard {
+    Mutex lock;
+    std::map<std::string, Entry> entries;
+    std::list<std::string> lru;
+    Shard() : lock("RGWAuthCache::Shard::lock") {}
+  };
+
+  CephContext *cct;
+  std::vector<Shard *> shards;
+  size_t max_entries;  // per shard
+  atomic_t generation; // bumped by every invalidation
+
+  Shard *get_shard(const std::string& key);
+  Entry *find(Shard *shard, const std::string& key);
+  void insert(Shard *shard, const std::string& key, RGWUserInfo& info, utime_t expires);
+  void remove(Shard *shard, std::map<std::string, Entry>::iterator iter);
+  void remove_key(const std::string& key);
+  int get_user(const std::string& key, std::string& id,
+               int (*fetch)(std::string&, RGWUserInfo&), RGWUserInfo& info);
+
+public:
+  RGWAuthCache(CephContext *_cct);
+  ~RGWAuthCache();
+
+  int get_user_by_access_key(std::string& access_key, RGWUserInfo& info);
+  int get_user_by_swift(std::string& swift_user, RGWUserInfo& info);
+
+  /* calc_hmac_sha1() with secret, reusing access_key's keyed context */
+  void calc_hmac_sha1(const std::string& access_key, const std::string& secret,
+                      const char *msg, int msg_len, char *dest);
+
+  /* a swift token we verified before, that hasn't expired */
+  bool get_token(const std::string& token, RGWUserInfo& info);
+  /* gen is get_generation() from before info was looked up */
+  void put_token(const std::string& token, utime_t expiration, RGWUserInfo& info, int gen);
+  int get_generation() { return generation.read(); }
+
+  /* oid in one of the user info pools changed or went away */
+  void invalidate(const std::string& pool, const std::string& oid);
+  /* drop everything cached for user_id, including its tokens */
+  void invalidate_user(const std::string& user_id);
+};
+
+/*
+ * NULL unless rgw_auth_cache_init() was called, 'rgw auth cache ttl' is set
+ * and 'rgw cache enabled' is on
+ */
+extern RGWAuthCache *rgw_auth_cache;
+
+extern void rgw_auth_cache_init(CephContext *cct);
+extern void rgw_auth_cache_finalize();
+
+#endif
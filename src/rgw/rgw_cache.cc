@@ -1,4 +1,7 @@
 #include "rgw_cache.h"
+#include "rgw_user.h"
+
+#include "include/ceph_hash.h"
 
 #include <errno.h>
 
@@ -6,49 +9,166 @@
 
 using namespace std;
 
+static const char *cache_class_name[RGW_CACHE_NUM_CLASSES] = { "bucket", "user", "obj" };
+
+ObjectCache::ObjectCache() : cct(NULL), max_entries(0), max_bytes(0)
+{
+  for (int i = 0; i < RGW_CACHE_NUM_CLASSES; i++)
+    logger[i] = NULL;
+}
+
+ObjectCache::~ObjectCache()
+{
+  for (vector<Shard *>::iterator iter = shards.begin(); iter != shards.end(); ++iter)
+    delete *iter;
+}
+
+void ObjectCache::init(CephContext *_cct)
+{
+  cct = _cct;
+
+  int num_shards = cct->_conf->rgw_cache_shards;
+  if (num_shards < 1)
+    num_shards = 1;
+  for (int i = 0; i < num_shards; i++)
+    shards.push_back(new Shard);
+  max_entries = cct->_conf->rgw_cache_lru_size / num_shards;
+  if (max_entries < 1)
+    max_entries = 1;
+  max_bytes = cct->_conf->rgw_cache_max_bytes / num_shards;
+
+  for (int i = 0; i < RGW_CACHE_NUM_CLASSES; i++) {
+    string name = "rgw_cache_";
+    name.append(cache_class_name[i]);
+    PerfCountersBuilder plb(cct, name, l_rgw_oc_first, l_rgw_oc_last);
+    plb.add_u64_counter(l_rgw_oc_hit, "hit");
+    plb.add_u64_counter(l_rgw_oc_neg_hit, "neg_hit");       // hits on a cached ENOENT
+    plb.add_u64_counter(l_rgw_oc_miss, "miss");
+    plb.add_u64_counter(l_rgw_oc_expired, "expired");
+    plb.add_u64_counter(l_rgw_oc_evict, "evict");
+    plb.add_u64_counter(l_rgw_oc_put, "put");
+    plb.add_u64_counter(l_rgw_oc_invalidate, "invalidate");
+    plb.add_u64(l_rgw_oc_entries, "entries");
+    plb.add_u64(l_rgw_oc_bytes, "bytes");
+    logger[i] = plb.create_perf_counters();
+    cct->get_perfcounters_collection()->add(logger[i]);
+  }
+}
+
+void ObjectCache::shutdown()
+{
+  for (int i = 0; i < RGW_CACHE_NUM_CLASSES; i++) {
+    if (!logger[i])
+      continue;
+    cct->get_perfcounters_collection()->remove(logger[i]);
+    delete logger[i];
+    logger[i] = NULL;
+  }
+}
+
+ObjectCache::Shard *ObjectCache::get_shard(const string& name)
+{
+  return shards[ceph_str_hash_linux(name.c_str(), name.size()) % shards.size()];
+}
+
+/* name is "<bucket>+<oid>", see RGWCache::normal_name() */
+int ObjectCache::get_class(const string& name)
+{
+  size_t pos = name.find('+');
+  string bucket = name.substr(0, pos);
+  if (bucket == RGW_ROOT_BUCKET)
+    return RGW_CACHE_CLASS_BUCKET;
+  if (bucket.compare(0, sizeof(USER_INFO_POOL_NAME) - 1, USER_INFO_POOL_NAME) == 0)
+    return RGW_CACHE_CLASS_USER;
+  return RGW_CACHE_CLASS_OBJ;
+}
+
 int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask)
 {
-  Mutex::Locker l(lock);
+  Shard *shard = get_shard(name);
+  Mutex::Locker l(shard->lock);
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+  map<string, ObjectCacheEntry>::iterator iter = shard->cache_map.find(name);
+  if (iter == shard->cache_map.end()) {
     ldout(cct, 10) << "cache get: name=" << name << " : miss" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
+    inc(get_class(name), l_rgw_oc_miss);
+    return -ENOENT;
+  }
+
+  ObjectCacheEntry& entry = iter->second;
+  if (!entry.expires.is_zero() && entry.expires < ceph_clock_now(cct)) {
+    ldout(cct, 10) << "cache get: name=" << name << " : expired" << dendl;
+    if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
+    inc(entry.cls, l_rgw_oc_miss);
+    inc(entry.cls, l_rgw_oc_expired);
+    remove_entry(shard, iter);
     return -ENOENT;
   }
 
-  touch_lru(name, iter->second.lru_iter);
+  touch_lru(shard, name, entry.lru_iter);
 
-  ObjectCacheInfo& src = iter->second.info;
-  if ((src.flags & mask) != mask) {
+  ObjectCacheInfo& src = entry.info;
+  if (src.status >= 0 && (src.flags & mask) != mask) {
     ldout(cct, 10) << "cache get: name=" << name << " : type miss (requested=" << mask << ", cached=" << src.flags << ")" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
+    inc(entry.cls, l_rgw_oc_miss);
     return -ENOENT;
   }
   ldout(cct, 10) << "cache get: name=" << name << " : hit" << dendl;
 
   info = src;
   if(perfcounter) perfcounter->inc(l_rgw_cache_hit);
+  inc(entry.cls, src.status < 0 ? l_rgw_oc_neg_hit : l_rgw_oc_hit);
 
   return 0;
 }
 
 void ObjectCache::put(string& name, ObjectCacheInfo& info)
 {
-  Mutex::Locker l(lock);
+  Shard *shard = get_shard(name);
+  Mutex::Locker l(shard->lock);
 
   ldout(cct, 10) << "cache put: name=" << name << dendl;
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end()) {
+  map<string, ObjectCacheEntry>::iterator iter = shard->cache_map.find(name);
+  if (info.status < 0 && cct->_conf->rgw_cache_negative_ttl <= 0) {
+    // not caching negative lookups; whatever we had is gone now
+    if (iter != shard->cache_map.end())
+      remove_entry(shard, iter);
+    return;
+  }
+  bool is_new = (iter == shard->cache_map.end());
+  if (is_new) {
     ObjectCacheEntry entry;
-    entry.lru_iter = lru.end();
-    cache_map.insert(pair<string, ObjectCacheEntry>(name, entry));
-    iter = cache_map.find(name);
+    entry.lru_iter = shard->lru.end();
+    entry.cls = get_class(name);
+    iter = shard->cache_map.insert(pair<string, ObjectCacheEntry>(name, entry)).first;
+    inc(entry.cls, l_rgw_oc_entries);
   }
   ObjectCacheEntry& entry = iter->second;
   ObjectCacheInfo& target = entry.info;
+  inc(entry.cls, l_rgw_oc_put);
 
-  touch_lru(name, entry.lru_iter);
+  touch_lru(shard, name, entry.lru_iter);
+
+  /*
+   * a negative entry only lives for rgw_cache_negative_ttl.  a positive
+   * one for rgw_cache_ttl, if set, from when we last saw all of it; a
+   * partial xattr update doesn't make the rest of the entry any fresher.
+   */
+  int ttl = 0;
+  if (info.status < 0)
+    ttl = cct->_conf->rgw_cache_negative_ttl;
+  else if (is_new || target.status < 0 || (info.flags & ~CACHE_FLAG_MODIFY_XATTRS))
+    ttl = cct->_conf->rgw_cache_ttl;
+  else if (!entry.expires.is_zero())
+    ttl = -1;  // keep it
+  if (ttl > 0) {
+    entry.expires = ceph_clock_now(cct);
+    entry.expires += ttl;
+  } else if (ttl == 0) {
+    entry.expires = utime_t();
+  }
 
   target.status = info.status;
 
@@ -56,6 +176,8 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info)
     target.flags = 0;
     target.xattrs.clear();
     target.data.clear();
+    charge(shard, name, entry);
+    trim(shard, name);
     return;
   }
 
@@ -86,60 +208,82 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info)
 
   if (info.flags & CACHE_FLAG_DATA)
     target.data = info.data;
+
+  charge(shard, name, entry);
+  trim(shard, name);
 }
 
 void ObjectCache::remove(string& name)
 {
-  Mutex::Locker l(lock);
+  Shard *shard = get_shard(name);
+  Mutex::Locker l(shard->lock);
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
-  if (iter == cache_map.end())
+  map<string, ObjectCacheEntry>::iterator iter = shard->cache_map.find(name);
+  if (iter == shard->cache_map.end())
     return;
 
   ldout(cct, 10) << "removing " << name << " from cache" << dendl;
 
-  remove_lru(name, iter->second.lru_iter);
-  cache_map.erase(iter);
+  inc(iter->second.cls, l_rgw_oc_invalidate);
+  remove_entry(shard, iter);
 }
 
-void ObjectCache::touch_lru(string& name, std::list<string>::iterator& lru_iter)
+/* recompute what the entry costs us */
+void ObjectCache::charge(Shard *shard, const string& name, ObjectCacheEntry& entry)
 {
-  while (lru.size() > (size_t)cct->_conf->rgw_cache_lru_size) {
-    list<string>::iterator iter = lru.begin();
-    if ((*iter).compare(name) == 0) {
-      /*
-       * if the entry we're touching happens to be at the lru end, don't remove it,
-       * lru shrinking can wait for next time
-       */
+  ObjectCacheInfo& info = entry.info;
+  uint64_t size = sizeof(entry) + 2 * name.size() + info.data.length();
+  for (map<string, bufferlist>::iterator iter = info.xattrs.begin(); iter != info.xattrs.end(); ++iter)
+    size += iter->first.size() + iter->second.length();
+
+  shard->bytes += size - entry.size;
+  inc(entry.cls, l_rgw_oc_bytes, (int64_t)size - (int64_t)entry.size);
+  entry.size = size;
+}
+
+void ObjectCache::remove_entry(Shard *shard, map<string, ObjectCacheEntry>::iterator iter)
+{
+  ObjectCacheEntry& entry = iter->second;
+  if (entry.lru_iter != shard->lru.end())
+    shard->lru.erase(entry.lru_iter);
+  shard->bytes -= entry.size;
+  inc(entry.cls, l_rgw_oc_bytes, -(int64_t)entry.size);
+  inc(entry.cls, l_rgw_oc_entries, -1);
+  shard->cache_map.erase(iter);
+}
+
+/*
+ * evict from the cold end until the shard is within its limits.  the
+ * entry we're working on (keep) stays even if it's the one at the end;
+ * shrinking can wait for next time.
+ */
+void ObjectCache::trim(Shard *shard, const string& keep)
+{
+  while (shard->lru.size() > max_entries ||
+	 (max_bytes && shard->bytes > max_bytes)) {
+    list<string>::iterator iter = shard->lru.begin();
+    if (iter == shard->lru.end() || iter->compare(keep) == 0)
       break;
-    }
-    map<string, ObjectCacheEntry>::iterator map_iter = cache_map.find(*iter);
+    map<string, ObjectCacheEntry>::iterator map_iter = shard->cache_map.find(*iter);
     ldout(cct, 10) << "removing entry: name=" << *iter << " from cache LRU" << dendl;
-    if (map_iter != cache_map.end())
-      cache_map.erase(map_iter);
-    lru.pop_front();
+    if (map_iter == shard->cache_map.end()) {
+      shard->lru.pop_front();
+      continue;
+    }
+    inc(map_iter->second.cls, l_rgw_oc_evict);
+    remove_entry(shard, map_iter);
   }
+}
 
+void ObjectCache::touch_lru(Shard *shard, const string& name, std::list<string>::iterator& lru_iter)
+{
+  list<string>& lru = shard->lru;
   if (lru_iter == lru.end()) {
     lru.push_back(name);
     lru_iter--;
     ldout(cct, 10) << "adding " << name << " to cache LRU end" << dendl;
   } else {
     ldout(cct, 10) << "moving " << name << " to cache LRU end" << dendl;
-    lru.erase(lru_iter);
-    lru.push_back(name);
-    lru_iter = lru.end();
-    --lru_iter;
+    lru.splice(lru.end(), lru, lru_iter);
   }
 }
-
-void ObjectCache::remove_lru(string& name, std::list<string>::iterator& lru_iter)
-{
-  if (lru_iter == lru.end())
-    return;
-
-  lru.erase(lru_iter);
-  lru_iter = lru.end();
-}
-
-
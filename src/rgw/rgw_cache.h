@@ -2,15 +2,42 @@
 #define CEPH_RGWCACHE_H
 
 #include "rgw_rados.h"
+#include "rgw_auth_cache.h"
 #include <string>
 #include <map>
+#include <vector>
 #include "include/types.h"
 #include "include/utime.h"
 #include "include/assert.h"
+#include "common/Cond.h"
+#include "common/perf_counters.h"
 
 enum {
   UPDATE_OBJ,
   REMOVE_OBJ,
+  BATCH_OBJ,  /* followed by an encoded list<RGWCacheNotifyInfo> */
+};
+
+/* what is cached, for the per class perf counters */
+enum {
+  RGW_CACHE_CLASS_BUCKET,  /* bucket info, in the root pool */
+  RGW_CACHE_CLASS_USER,    /* user info, in the .users* pools */
+  RGW_CACHE_CLASS_OBJ,     /* data and attrs of any other system object */
+  RGW_CACHE_NUM_CLASSES,
+};
+
+enum {
+  l_rgw_oc_first = 15100,
+  l_rgw_oc_hit,
+  l_rgw_oc_neg_hit,
+  l_rgw_oc_miss,
+  l_rgw_oc_expired,
+  l_rgw_oc_evict,
+  l_rgw_oc_put,
+  l_rgw_oc_invalidate,
+  l_rgw_oc_entries,
+  l_rgw_oc_bytes,
+  l_rgw_oc_last,
 };
 
 #define CACHE_FLAG_DATA           0x1
@@ -117,22 +144,51 @@ WRITE_CLASS_ENCODER(RGWCacheNotifyInfo)
 struct ObjectCacheEntry {
   ObjectCacheInfo info;
   std::list<string>::iterator lru_iter;
+  int cls;
+  uint64_t size;     /* bytes charged to the shard */
+  utime_t expires;   /* zero: doesn't */
+
+  ObjectCacheEntry() : cls(RGW_CACHE_CLASS_OBJ), size(0) {}
 };
 
+/*
+ * The cache is split into shards by name hash, each with its own lock,
+ * LRU and share of the entry and byte limits, so that gateway threads
+ * looking up different users and buckets don't serialize on one lock.
+ */
 class ObjectCache {
-  std::map<string, ObjectCacheEntry> cache_map;
-  std::list<string> lru;
-  Mutex lock;
-  CephContext *cct;
+  struct Shard {
+    Mutex lock;
+    std::map<string, ObjectCacheEntry> cache_map;
+    std::list<string> lru;
+    uint64_t bytes;
+
+    Shard() : lock("ObjectCache::Shard::lock"), bytes(0) {}
+  };
 
-  void touch_lru(string& name, std::list<string>::iterator& lru_iter);
-  void remove_lru(string& name, std::list<string>::iterator& lru_iter);
+  std::vector<Shard *> shards;
+  CephContext *cct;
+  size_t max_entries, max_bytes;  /* per shard */
+  PerfCounters *logger[RGW_CACHE_NUM_CLASSES];
+
+  Shard *get_shard(const string& name);
+  int get_class(const string& name);
+  void inc(int cls, int idx, int64_t v = 1) {
+    if (logger[cls])
+      logger[cls]->inc(idx, v);
+  }
+  void touch_lru(Shard *shard, const string& name, std::list<string>::iterator& lru_iter);
+  void trim(Shard *shard, const string& keep);
+  void remove_entry(Shard *shard, std::map<string, ObjectCacheEntry>::iterator iter);
+  void charge(Shard *shard, const string& name, ObjectCacheEntry& entry);
 public:
-  ObjectCache() : lock("ObjectCache"), cct(NULL) { }
+  ObjectCache();
+  ~ObjectCache();
   int get(std::string& name, ObjectCacheInfo& bl, uint32_t mask);
   void put(std::string& name, ObjectCacheInfo& bl);
   void remove(std::string& name);
-  void set_ctx(CephContext *_cct) { cct = _cct; }
+  void init(CephContext *_cct);
+  void shutdown();
 };
 
 static inline void normalize_bucket_and_obj(rgw_bucket& src_bucket, string& src_obj, rgw_bucket& dst_bucket, string& dst_obj)
@@ -151,6 +207,22 @@ class RGWCache  : public T
 {
   ObjectCache cache;
 
+  /*
+   * outgoing notifications.  while one notify is in flight, updates from
+   * other threads queue up and go out together in the next one, so that
+   * a burst of metadata changes doesn't become a burst of notifies.
+   */
+  struct NotifyWaiter {
+    RGWCacheNotifyInfo info;
+    int ret;
+    bool done;
+    NotifyWaiter() : ret(0), done(false) {}
+  };
+  Mutex notify_lock;
+  Cond notify_cond;
+  list<NotifyWaiter *> notify_queue;
+  bool notifying;
+
   int list_objects_raw_init(rgw_bucket& bucket, RGWAccessHandle *handle) {
     return T::list_objects_raw_init(bucket, handle);
   }
@@ -173,7 +245,7 @@ class RGWCache  : public T
 
   int initialize() {
     int ret;
-    cache.set_ctx(T::cct);
+    cache.init(T::cct);
     ret = T::initialize();
     if (ret < 0)
       return ret;
@@ -184,11 +256,13 @@ class RGWCache  : public T
 
   void finalize() {
     T::finalize_watch();
+    cache.shutdown();
   }
   int distribute(rgw_obj& obj, ObjectCacheInfo& obj_info, int op);
   int watch_cb(int opcode, uint64_t ver, bufferlist& bl);
+  int handle_notify(RGWCacheNotifyInfo& info);
 public:
-  RGWCache() {}
+  RGWCache() : notify_lock("RGWCache::notify_lock"), notifying(false) {}
 
   int set_attr(void *ctx, rgw_obj& obj, const char *name, bufferlist& bl);
   int set_attrs(void *ctx, rgw_obj& obj, 
@@ -458,25 +532,68 @@ done:
 template <class T>
 int RGWCache<T>::distribute(rgw_obj& obj, ObjectCacheInfo& obj_info, int op)
 {
-  RGWCacheNotifyInfo info;
+  NotifyWaiter w;
+  w.info.op = op;
+  w.info.obj_info = obj_info;
+  w.info.obj = obj;
+
+  int max_batch = T::cct->_conf->rgw_cache_notify_max_batch;
+  if (max_batch <= 1) {
+    bufferlist bl;
+    ::encode(w.info, bl);
+    return T::distribute(bl);
+  }
 
-  info.op = op;
+  Mutex::Locker l(notify_lock);
+  notify_queue.push_back(&w);
+  while (!w.done) {
+    if (notifying) {
+      notify_cond.Wait(notify_lock);
+      continue;
+    }
 
-  info.obj_info = obj_info;
-  info.obj = obj;
-  bufferlist bl;
-  ::encode(info, bl);
-  int ret = T::distribute(bl);
-  return ret;
+    /* we send the next batch; it may or may not include our own update */
+    list<NotifyWaiter *> batch;
+    while (!notify_queue.empty() && batch.size() < (size_t)max_batch) {
+      batch.push_back(notify_queue.front());
+      notify_queue.pop_front();
+    }
+    notifying = true;
+    notify_lock.Unlock();
+
+    bufferlist bl;
+    if (batch.size() == 1) {
+      ::encode(batch.front()->info, bl);  /* what older gateways understand */
+    } else {
+      RGWCacheNotifyInfo header;
+      header.op = BATCH_OBJ;
+      list<RGWCacheNotifyInfo> entries;
+      for (typename list<NotifyWaiter *>::iterator iter = batch.begin(); iter != batch.end(); ++iter)
+        entries.push_back((*iter)->info);
+      ::encode(header, bl);
+      ::encode(entries, bl);
+      mydout(10) << "distributing " << entries.size() << " cache updates in one notification" << dendl;
+    }
+    int r = T::distribute(bl);
+
+    notify_lock.Lock();
+    for (typename list<NotifyWaiter *>::iterator iter = batch.begin(); iter != batch.end(); ++iter) {
+      (*iter)->ret = r;
+      (*iter)->done = true;
+    }
+    notifying = false;
+    notify_cond.Signal();
+  }
+  return w.ret;
 }
 
 template <class T>
 int RGWCache<T>::watch_cb(int opcode, uint64_t ver, bufferlist& bl)
 {
   RGWCacheNotifyInfo info;
+  bufferlist::iterator iter = bl.begin();
 
   try {
-    bufferlist::iterator iter = bl.begin();
     ::decode(info, iter);
   } catch (buffer::end_of_buffer& err) {
     mydout(0) << "ERROR: got bad notification" << dendl;
@@ -486,11 +603,37 @@ int RGWCache<T>::watch_cb(int opcode, uint64_t ver, bufferlist& bl)
     return -EIO;
   }
 
+  if (info.op != BATCH_OBJ)
+    return handle_notify(info);
+
+  list<RGWCacheNotifyInfo> entries;
+  try {
+    ::decode(entries, iter);
+  } catch (buffer::error& err) {
+    mydout(0) << "ERROR: got bad batch notification" << dendl;
+    return -EIO;
+  }
+  mydout(10) << "got " << entries.size() << " cache updates in one notification" << dendl;
+  int ret = 0;
+  for (list<RGWCacheNotifyInfo>::iterator p = entries.begin(); p != entries.end(); ++p) {
+    int r = handle_notify(*p);
+    if (r < 0)
+      ret = r;
+  }
+  return ret;
+}
+
+template <class T>
+int RGWCache<T>::handle_notify(RGWCacheNotifyInfo& info)
+{
   rgw_bucket bucket;
   string oid;
   normalize_bucket_and_obj(info.obj.bucket, info.obj.object, bucket, oid);
   string name = normal_name(bucket, oid);
 
+  if (rgw_auth_cache)
+    rgw_auth_cache->invalidate(bucket.name, oid);
+
   switch (info.op) {
   case UPDATE_OBJ:
     cache.put(name, info.obj_info);
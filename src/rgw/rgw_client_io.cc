@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "rgw_client_io.h"
+
+int RGWClientIO::print(const char *format, ...)
+{
+#define LARGE_ENOUGH 128
+  int size = LARGE_ENOUGH;
+
+  while (1) {
+    char buf[size];
+    va_list ap;
+    va_start(ap, format);
+    int ret = vsnprintf(buf, size, format, ap);
+    va_end(ap);
+
+    if (ret < 0)
+      return ret;
+
+    if (ret < size)
+      return write(buf, ret);
+
+    size = ret + 1;
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef CEPH_RGW_CLIENT_IO_H
+#define CEPH_RGW_CLIENT_IO_H
+
+#include <stdlib.h>
+
+/*
+ * The connection a request came in on.
+ *
+ * The REST code writes a CGI style response through this (an optional
+ * "Status:" line, header lines, a blank line, then the body) and reads
+ * the request body from it, so it doesn't care whether we sit behind a
+ * FastCGI web server (RGWFCGX) or speak HTTP ourselves (RGWHTTPConn).
+ */
+class RGWClientIO {
+public:
+  virtual ~RGWClientIO() {}
+
+  /* the request as CGI environment: NULL terminated NAME=value strings */
+  virtual char **envp() = 0;
+
+  virtual int write(const char *buf, int len) = 0;
+  /* read request body; only returns short at the end of the body */
+  virtual int read(char *buf, int len) = 0;
+  virtual void flush() = 0;
+  /* answer an 'Expect: 100-continue' */
+  virtual void send_100_continue() = 0;
+
+  int print(const char *format, ...);
+};
+
+#endif
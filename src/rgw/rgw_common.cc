@@ -27,9 +27,19 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_get, "get");
   plb.add_u64_counter(l_rgw_get_b, "get_b");
   plb.add_fl_avg(l_rgw_get_lat, "get_initial_lat");
+  plb.add_fl_avg(l_rgw_get_ttfb, "get_ttfb");            // request start to first data byte
+  plb.add_fl_avg(l_rgw_get_xfer_lat, "get_xfer_lat");    // first read to last byte sent
+  plb.add_fl_avg(l_rgw_get_bw, "get_bw");                // bytes/sec per request over the transfer
   plb.add_u64_counter(l_rgw_put, "put");
   plb.add_u64_counter(l_rgw_put_b, "put_b");
   plb.add_fl_avg(l_rgw_put_lat, "put_initial_lat");
+  plb.add_fl_avg(l_rgw_put_recv_lat, "put_recv_lat");          // reading the data from the client
+  plb.add_fl_avg(l_rgw_put_hash_lat, "put_hash_lat");          // computing the etag
+  plb.add_fl_avg(l_rgw_put_hash_wait_lat, "put_hash_wait_lat"); // waiting on the hash threads at the end
+  plb.add_fl_avg(l_rgw_put_write_lat, "put_write_lat");        // submitting data writes, and throttling on them
+  plb.add_fl_avg(l_rgw_put_complete_lat, "put_complete_lat");  // writing the head and the index
+  plb.add_u64_counter(l_rgw_copy_clone, "copy_clone");         // copies done by the osds
+  plb.add_u64_counter(l_rgw_copy_stream, "copy_stream");       // copies read and written through the gateway
 
   plb.add_u64(l_rgw_qlen, "qlen");
   plb.add_u64(l_rgw_qactive, "qactive");
@@ -37,6 +47,17 @@ int rgw_perf_start(CephContext *cct)
   plb.add_u64_counter(l_rgw_cache_hit, "cache_hit");
   plb.add_u64_counter(l_rgw_cache_miss, "cache_miss");
 
+  plb.add_fl_avg(l_rgw_auth_lat, "auth_lat");
+  plb.add_u64_counter(l_rgw_auth_cache_hit, "auth_cache_hit");
+  plb.add_u64_counter(l_rgw_auth_cache_miss, "auth_cache_miss");
+
+  plb.add_u64(l_rgw_log_queued_bytes, "ops_log_queued_bytes");       // buffered or being written
+  plb.add_u64_counter(l_rgw_log_appends, "ops_log_appends");
+  plb.add_u64_counter(l_rgw_log_append_errors, "ops_log_append_errors");
+  plb.add_u64_counter(l_rgw_log_dropped, "ops_log_dropped");          // entries dropped, rgw_ops_log_drop_when_full
+  plb.add_u64_counter(l_rgw_log_blocked, "ops_log_blocked");          // requests that waited for room
+  plb.add_fl_avg(l_rgw_usage_log_flush_lat, "usage_log_flush_lat");
+
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
   return 0;
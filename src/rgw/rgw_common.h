@@ -69,8 +69,8 @@ using ceph::crypto::MD5;
 #define RGW_DEFAULT_MAX_BUCKETS 1000
 
 #define CGI_PRINTF(state, format, ...) do { \
-   int __ret = FCGX_FPrintF(state->fcgx->out, format, __VA_ARGS__); \
-   if (state->header_ended) \
+   int __ret = state->cio->print(format, __VA_ARGS__); \
+   if (state->header_ended && __ret > 0) \
      state->bytes_sent += __ret; \
    int l = 32, n; \
    while (1) { \
@@ -84,13 +84,13 @@ using ceph::crypto::MD5;
 } while (0)
 
 #define CGI_PutStr(state, buf, len) do { \
-  FCGX_PutStr(buf, len, state->fcgx->out); \
-  if (state->header_ended) \
-    state->bytes_sent += len; \
+  int __ret = state->cio->write(buf, len); \
+  if (state->header_ended && __ret > 0) \
+    state->bytes_sent += __ret; \
 } while (0)
 
 #define CGI_GetStr(state, buf, buf_len, olen) do { \
-  olen = FCGX_GetStr(buf, buf_len, state->fcgx->in); \
+  olen = state->cio->read(buf, buf_len); \
   state->bytes_received += olen; \
 } while (0)
 
@@ -142,10 +142,21 @@ enum {
   l_rgw_get,
   l_rgw_get_b,
   l_rgw_get_lat,
+  l_rgw_get_ttfb,
+  l_rgw_get_xfer_lat,
+  l_rgw_get_bw,
 
   l_rgw_put,
   l_rgw_put_b,
   l_rgw_put_lat,
+  l_rgw_put_recv_lat,
+  l_rgw_put_hash_lat,
+  l_rgw_put_hash_wait_lat,
+  l_rgw_put_write_lat,
+  l_rgw_put_complete_lat,
+
+  l_rgw_copy_clone,
+  l_rgw_copy_stream,
 
   l_rgw_qlen,
   l_rgw_qactive,
@@ -153,6 +164,17 @@ enum {
   l_rgw_cache_hit,
   l_rgw_cache_miss,
 
+  l_rgw_auth_lat,
+  l_rgw_auth_cache_hit,
+  l_rgw_auth_cache_miss,
+
+  l_rgw_log_queued_bytes,
+  l_rgw_log_appends,
+  l_rgw_log_append_errors,
+  l_rgw_log_dropped,
+  l_rgw_log_blocked,
+  l_rgw_usage_log_flush_lat,
+
   l_rgw_last,
 };
 
@@ -496,27 +518,31 @@ struct RGWBucketInfo
   rgw_bucket bucket;
   string owner;
   uint32_t flags;
+  uint32_t num_shards;  // bucket index shards; 0 = one unsharded index object
 
   void encode(bufferlist& bl) const {
-     ENCODE_START(4, 4, bl);
+     ENCODE_START(5, 4, bl);
      ::encode(bucket, bl);
      ::encode(owner, bl);
      ::encode(flags, bl);
+     ::encode(num_shards, bl);
      ENCODE_FINISH(bl);
   }
   void decode(bufferlist::iterator& bl) {
-    DECODE_START_LEGACY_COMPAT_LEN_32(4, 4, 4, bl);
+    DECODE_START_LEGACY_COMPAT_LEN_32(5, 4, 4, bl);
      ::decode(bucket, bl);
      if (struct_v >= 2)
        ::decode(owner, bl);
      if (struct_v >= 3)
        ::decode(flags, bl);
+     if (struct_v >= 5)
+       ::decode(num_shards, bl);
      DECODE_FINISH(bl);
   }
   void dump(Formatter *f) const;
   static void generate_test_instances(list<RGWBucketInfo*>& o);
 
-  RGWBucketInfo() : flags(0) {}
+  RGWBucketInfo() : flags(0), num_shards(0) {}
 };
 WRITE_CLASS_ENCODER(RGWBucketInfo)
 
@@ -531,12 +557,12 @@ struct RGWBucketStats
 struct req_state;
 
 struct RGWEnv;
-struct FCGX_Request;
+class RGWClientIO;
 
 /** Store all the state necessary to complete and respond to an HTTP request*/
 struct req_state {
    CephContext *cct;
-   FCGX_Request *fcgx;
+   RGWClientIO *cio;
    http_op op;
    bool content_started;
    int format;
@@ -244,6 +244,7 @@ void rgw_cls_list_op::generate_test_instances(list<rgw_cls_list_op*>& o)
   op->start_obj = "start_obj";
   op->num_entries = 100;
   op->filter_prefix = "filter_prefix";
+  op->delimiter = "/";
   o.push_back(op);
   o.push_back(new rgw_cls_list_op);
 }
@@ -252,6 +253,8 @@ void rgw_cls_list_op::dump(Formatter *f) const
 {
   f->dump_string("start_obj", start_obj);
   f->dump_unsigned("num_entries", num_entries);
+  f->dump_string("filter_prefix", filter_prefix);
+  f->dump_string("delimiter", delimiter);
 }
 
 void rgw_cls_list_ret::generate_test_instances(list<rgw_cls_list_ret*>& o)
@@ -265,6 +268,7 @@ void rgw_cls_list_ret::generate_test_instances(list<rgw_cls_list_ret*>& o)
     rgw_cls_list_ret *ret = new rgw_cls_list_ret;
     ret->dir = *d;
     ret->is_truncated = true;
+    ret->common_prefixes.push_back("common/");
 
     o.push_back(ret);
 
@@ -280,6 +284,10 @@ void rgw_cls_list_ret::dump(Formatter *f) const
   dir.dump(f);
   f->close_section();
   f->dump_int("is_truncated", (int)is_truncated);
+  f->open_array_section("common_prefixes");
+  for (list<string>::const_iterator iter = common_prefixes.begin(); iter != common_prefixes.end(); ++iter)
+    f->dump_string("prefix", *iter);
+  f->close_section();
 }
 
 void RGWObjManifestPart::generate_test_instances(std::list<RGWObjManifestPart*>& o)
@@ -782,6 +790,7 @@ void RGWBucketInfo::generate_test_instances(list<RGWBucketInfo*>& o)
   i->bucket = rgw_bucket("bucket", "pool", "marker", "10");
   i->owner = "owner";
   i->flags = BUCKET_SUSPENDED;
+  i->num_shards = 8;
   o.push_back(i);
   o.push_back(new RGWBucketInfo);
 }
@@ -793,6 +802,7 @@ void RGWBucketInfo::dump(Formatter *f) const
   f->close_section();
   f->dump_string("owner", owner);
   f->dump_unsigned("flags", flags);
+  f->dump_unsigned("num_shards", num_shards);
 }
 
 void RGWBucketEnt::generate_test_instances(list<RGWBucketEnt*>& o)
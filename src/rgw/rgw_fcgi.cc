@@ -0,0 +1,27 @@
+#include "rgw_fcgi.h"
+
+char **RGWFCGX::envp()
+{
+  return fcgx->envp;
+}
+
+int RGWFCGX::write(const char *buf, int len)
+{
+  return FCGX_PutStr(buf, len, fcgx->out);
+}
+
+int RGWFCGX::read(char *buf, int len)
+{
+  return FCGX_GetStr(buf, len, fcgx->in);
+}
+
+void RGWFCGX::flush()
+{
+  FCGX_FFlush(fcgx->out);
+}
+
+void RGWFCGX::send_100_continue()
+{
+  FCGX_FPrintF(fcgx->out, "Status: 100\n");
+  FCGX_FFlush(fcgx->out);
+}
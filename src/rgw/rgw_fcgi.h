@@ -0,0 +1,26 @@
+#ifndef CEPH_RGW_FCGI_H
+#define CEPH_RGW_FCGI_H
+
+#include "acconfig.h"
+#ifdef FASTCGI_INCLUDE_DIR
+# include "fastcgi/fcgiapp.h"
+#else
+# include "fcgiapp.h"
+#endif
+
+#include "rgw_client_io.h"
+
+/* a request handed to us by the web server over FastCGI */
+class RGWFCGX : public RGWClientIO {
+  FCGX_Request *fcgx;
+public:
+  RGWFCGX(FCGX_Request *_fcgx) : fcgx(_fcgx) {}
+
+  char **envp();
+  int write(const char *buf, int len);
+  int read(char *buf, int len);
+  void flush();
+  void send_100_continue();
+};
+
+#endif
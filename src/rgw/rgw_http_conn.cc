@@ -0,0 +1,721 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <map>
+
+#include "common/config.h"
+#include "common/debug.h"
+#include "common/errno.h"
+
+#include "rgw_http_conn.h"
+
+#define dout_subsys ceph_subsys_rgw
+
+using namespace std;
+
+#define RGW_HTTP_BUF_SIZE   (64 * 1024)  /* input buffer, max header size */
+#define RGW_HTTP_COALESCE   (16 * 1024)  /* smaller body writes get buffered */
+#define RGW_HTTP_MAX_DRAIN  (1024 * 1024)
+
+static const char *http_reason(int status)
+{
+  switch (status) {
+  case 100: return "Continue";
+  case 200: return "OK";
+  case 201: return "Created";
+  case 202: return "Accepted";
+  case 204: return "No Content";
+  case 206: return "Partial Content";
+  case 301: return "Moved Permanently";
+  case 304: return "Not Modified";
+  case 400: return "Bad Request";
+  case 401: return "Unauthorized";
+  case 403: return "Forbidden";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 408: return "Request Timeout";
+  case 409: return "Conflict";
+  case 411: return "Length Required";
+  case 412: return "Precondition Failed";
+  case 413: return "Request Entity Too Large";
+  case 416: return "Requested Range Not Satisfiable";
+  case 422: return "Unprocessable Entity";
+  case 500: return "Internal Server Error";
+  case 501: return "Not Implemented";
+  case 503: return "Service Unavailable";
+  }
+  return "Unknown";
+}
+
+static void trim(string& s)
+{
+  size_t b = s.find_first_not_of(" \t");
+  if (b == string::npos) {
+    s.clear();
+    return;
+  }
+  size_t e = s.find_last_not_of(" \t\r");
+  s = s.substr(b, e - b + 1);
+}
+
+/* "Content-Type" -> "CONTENT_TYPE" */
+static string header_to_env(const string& name)
+{
+  string s;
+  for (size_t i = 0; i < name.size(); i++) {
+    char c = name[i];
+    s.push_back(c == '-' ? '_' : toupper(c));
+  }
+  return s;
+}
+
+RGWHTTPConn::RGWHTTPConn(CephContext *_cct, int _fd, const string& _remote_addr)
+  : cct(_cct), fd(_fd), remote_addr(_remote_addr),
+    ipos(0), ilen(0),
+    http_minor(1), keep_alive(false), expect_100(false), sent_100(false),
+    req_chunked(false), chunk_started(false), req_left(0), req_done(true),
+    header_sent(false), resp_body(true), resp_chunked(false), resp_left(-1),
+    broken(false)
+{
+  ibuf = new char[RGW_HTTP_BUF_SIZE];
+
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  /* a stuck client can only hold a worker this long */
+  struct timeval tv;
+  tv.tv_sec = cct->_conf->rgw_http_request_timeout;
+  tv.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+RGWHTTPConn::~RGWHTTPConn()
+{
+  ::close(fd);
+  delete[] ibuf;
+}
+
+int RGWHTTPConn::fill()
+{
+  if (ipos > 0) {
+    memmove(ibuf, ibuf + ipos, ilen - ipos);
+    ilen -= ipos;
+    ipos = 0;
+  }
+  if (ilen == RGW_HTTP_BUF_SIZE)
+    return -E2BIG;
+
+  int r;
+  do {
+    r = ::recv(fd, ibuf + ilen, RGW_HTTP_BUF_SIZE - ilen, 0);
+  } while (r < 0 && errno == EINTR);
+  if (r < 0)
+    return -errno;
+  if (r == 0)
+    return -EPIPE;
+  ilen += r;
+  return r;
+}
+
+int RGWHTTPConn::read_line(string& line)
+{
+  while (1) {
+    char *p = (char *)memchr(ibuf + ipos, '\n', ilen - ipos);
+    if (p) {
+      char *start = ibuf + ipos;
+      ipos = p + 1 - ibuf;
+      if (p > start && p[-1] == '\r')
+	p--;
+      line.assign(start, p - start);
+      return 0;
+    }
+    int r = fill();
+    if (r < 0)
+      return r;
+  }
+}
+
+void RGWHTTPConn::add_env(const string& name, const string& val)
+{
+  env.push_back(name + "=" + val);
+}
+
+int RGWHTTPConn::read_request()
+{
+  method.clear();
+  http_minor = 1;
+  keep_alive = false;
+  expect_100 = sent_100 = false;
+  req_chunked = chunk_started = false;
+  req_left = 0;
+  req_done = true;
+  env.clear();
+  env_ptrs.clear();
+
+  header_sent = false;
+  header.clear();
+  obuf.clear();
+  pending.clear();
+  resp_body = true;
+  resp_chunked = false;
+  resp_left = -1;
+
+  /* find the end of the header block; empty lines before it are allowed */
+  size_t end;
+  while (1) {
+    while (ipos < ilen && (ibuf[ipos] == '\r' || ibuf[ipos] == '\n'))
+      ipos++;
+    end = 0;
+    for (size_t i = ipos; i < ilen && !end; i++) {
+      if (ibuf[i] != '\n')
+	continue;
+      if (i + 1 < ilen && ibuf[i + 1] == '\n')
+	end = i + 2;
+      else if (i + 2 < ilen && ibuf[i + 1] == '\r' && ibuf[i + 2] == '\n')
+	end = i + 3;
+    }
+    if (end)
+      break;
+    int r = fill();
+    if (r == -E2BIG) {
+      ldout(cct, 0) << "http: request header from " << remote_addr << " too long" << dendl;
+      send_error(400);
+      return r;
+    }
+    if (r < 0)
+      return r;
+  }
+
+  const char *p = ibuf + ipos;
+  ipos = end;
+  int r = parse_request(p, ibuf + end);
+  if (r < 0) {
+    ldout(cct, 0) << "http: bad request from " << remote_addr << dendl;
+    send_error(400);
+    return r;
+  }
+
+  for (vector<string>::iterator i = env.begin(); i != env.end(); ++i)
+    env_ptrs.push_back((char *)i->c_str());
+  env_ptrs.push_back(NULL);
+  return 0;
+}
+
+int RGWHTTPConn::parse_request(const char *p, const char *end)
+{
+  vector<string> lines;
+  while (p < end) {
+    const char *eol = (const char *)memchr(p, '\n', end - p);
+    string line(p, eol - p);
+    p = eol + 1;
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.resize(line.size() - 1);
+    if (line.empty())
+      break;
+    if ((line[0] == ' ' || line[0] == '\t') && lines.size() > 1) {
+      trim(line);
+      lines.back() += " " + line;   // folded header
+      continue;
+    }
+    lines.push_back(line);
+  }
+  if (lines.empty())
+    return -EINVAL;
+
+  // METHOD URI HTTP/1.x
+  const string& rl = lines[0];
+  size_t sp1 = rl.find(' ');
+  size_t sp2 = rl.rfind(' ');
+  if (sp1 == string::npos || sp2 == sp1)
+    return -EINVAL;
+  method = rl.substr(0, sp1);
+  string uri = rl.substr(sp1 + 1, sp2 - sp1 - 1);
+  string proto = rl.substr(sp2 + 1);
+  if (proto.compare(0, 7, "HTTP/1.") != 0 || uri.empty())
+    return -EINVAL;
+  http_minor = atoi(proto.c_str() + 7);
+  keep_alive = (http_minor >= 1);
+
+  map<string, string> headers;
+  for (unsigned i = 1; i < lines.size(); i++) {
+    size_t colon = lines[i].find(':');
+    if (colon == string::npos || colon == 0)
+      return -EINVAL;
+    string name = header_to_env(lines[i].substr(0, colon));
+    string val = lines[i].substr(colon + 1);
+    trim(val);
+    map<string, string>::iterator iter = headers.find(name);
+    if (iter == headers.end())
+      headers[name] = val;
+    else
+      iter->second += ", " + val;
+  }
+
+  bool have_length = false;
+  for (map<string, string>::iterator iter = headers.begin(); iter != headers.end(); ++iter) {
+    const string& name = iter->first;
+    const string& val = iter->second;
+    if (name == "CONTENT_LENGTH") {
+      char *e;
+      req_left = strtoull(val.c_str(), &e, 10);
+      if (e == val.c_str() || *e)
+	return -EINVAL;
+      have_length = true;
+      add_env(name, val);
+      continue;
+    }
+    if (name == "CONTENT_TYPE") {
+      add_env(name, val);
+      continue;
+    }
+    if (name == "CONNECTION") {
+      if (strcasestr(val.c_str(), "close"))
+	keep_alive = false;
+      else if (strcasestr(val.c_str(), "keep-alive"))
+	keep_alive = true;
+    } else if (name == "TRANSFER_ENCODING") {
+      req_chunked = (strcasestr(val.c_str(), "chunked") != NULL);
+    } else if (name == "EXPECT") {
+      expect_100 = (strcasecmp(val.c_str(), "100-continue") == 0);
+    }
+    add_env("HTTP_" + name, val);
+  }
+  if (req_chunked) {
+    req_left = 0;
+    req_done = false;
+  } else if (have_length) {
+    req_done = (req_left == 0);
+  }
+
+  size_t q = uri.find('?');
+  add_env("REQUEST_METHOD", method);
+  add_env("REQUEST_URI", uri);
+  add_env("SCRIPT_URI", uri.substr(0, q));
+  add_env("QUERY_STRING", q == string::npos ? "" : uri.substr(q + 1));
+  add_env("SERVER_PROTOCOL", proto);
+  char port[16];
+  snprintf(port, sizeof(port), "%d", (int)cct->_conf->rgw_http_port);
+  add_env("SERVER_PORT", port);
+  add_env("REMOTE_ADDR", remote_addr);
+
+  ldout(cct, 20) << "http: " << remote_addr << " " << rl << dendl;
+  return 0;
+}
+
+char **RGWHTTPConn::envp()
+{
+  return &env_ptrs[0];
+}
+
+int RGWHTTPConn::next_chunk()
+{
+  string line;
+  int r;
+  if (chunk_started) {
+    // CRLF after the previous chunk's data
+    r = read_line(line);
+    if (r < 0)
+      return r;
+    if (!line.empty())
+      return -EINVAL;
+  }
+  chunk_started = true;
+  r = read_line(line);
+  if (r < 0)
+    return r;
+  char *e;
+  uint64_t len = strtoull(line.c_str(), &e, 16);
+  if (e == line.c_str())
+    return -EINVAL;
+  if (len == 0) {
+    // skip the trailer
+    do {
+      r = read_line(line);
+      if (r < 0)
+	return r;
+    } while (!line.empty());
+    req_done = true;
+    return 0;
+  }
+  req_left = len;
+  return 0;
+}
+
+int RGWHTTPConn::read(char *buf, int len)
+{
+  int total = 0;
+  while (total < len && !req_done && !broken) {
+    if (req_chunked && req_left == 0) {
+      int r = next_chunk();
+      if (r < 0) {
+	ldout(cct, 0) << "http: bad request body from " << remote_addr << ": " << cpp_strerror(r) << dendl;
+	broken = true;
+      }
+      continue;
+    }
+    uint64_t n = len - total;
+    if (n > req_left)
+      n = req_left;
+    if (ipos < ilen) {
+      if (n > ilen - ipos)
+	n = ilen - ipos;
+      memcpy(buf + total, ibuf + ipos, n);
+      ipos += n;
+    } else {
+      int r;
+      do {
+	r = ::recv(fd, buf + total, n, 0);
+      } while (r < 0 && errno == EINTR);
+      if (r <= 0) {
+	ldout(cct, 0) << "http: short request body from " << remote_addr << dendl;
+	broken = true;
+	break;
+      }
+      n = r;
+    }
+    total += n;
+    req_left -= n;
+    if (!req_chunked && req_left == 0)
+      req_done = true;
+  }
+  return total;
+}
+
+int RGWHTTPConn::send_iov(struct iovec *iov, int n)
+{
+  if (broken)
+    return -EPIPE;
+  while (n > 0) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    ssize_t r = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (r < 0) {
+      if (errno == EINTR)
+	continue;
+      r = -errno;
+      ldout(cct, 1) << "http: send to " << remote_addr << " failed: " << cpp_strerror(r) << dendl;
+      broken = true;
+      return r;
+    }
+    while (n > 0 && (size_t)r >= iov->iov_len) {
+      r -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + r;
+      iov->iov_len -= r;
+    }
+  }
+  return 0;
+}
+
+int RGWHTTPConn::send_out()
+{
+  if (obuf.empty())
+    return 0;
+  struct iovec iov;
+  iov.iov_base = (void *)obuf.data();
+  iov.iov_len = obuf.size();
+  int r = send_iov(&iov, 1);
+  obuf.clear();
+  return r;
+}
+
+void RGWHTTPConn::send_error(int status)
+{
+  char buf[128];
+  snprintf(buf, sizeof(buf), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+	   status, http_reason(status));
+  obuf = buf;
+  send_out();
+  keep_alive = false;
+}
+
+void RGWHTTPConn::send_100_continue()
+{
+  if (!expect_100 || sent_100 || http_minor < 1)
+    return;
+  sent_100 = true;
+  obuf = "HTTP/1.1 100 Continue\r\n\r\n";
+  send_out();
+}
+
+/*
+ * we have the whole CGI header in 'header'; turn it into an HTTP one in
+ * obuf.  it goes out together with the first piece of the body.
+ */
+void RGWHTTPConn::send_header()
+{
+  int status = 200;
+  string reason;
+  string out;
+  size_t pos = 0;
+  while (pos < header.size()) {
+    size_t eol = header.find('\n', pos);
+    if (eol == string::npos)
+      eol = header.size();
+    string line = header.substr(pos, eol - pos);
+    pos = eol + 1;
+    trim(line);
+    if (line.empty())
+      continue;
+    size_t colon = line.find(':');
+    if (colon == string::npos)
+      continue;
+    string name = line.substr(0, colon);
+    string val = line.substr(colon + 1);
+    trim(val);
+    if (strcasecmp(name.c_str(), "Status") == 0) {
+      char *e;
+      status = strtol(val.c_str(), &e, 10);
+      reason = e;
+      trim(reason);
+      continue;
+    }
+    if (strcasecmp(name.c_str(), "Connection") == 0 ||
+	strcasecmp(name.c_str(), "Transfer-Encoding") == 0)
+      continue;
+    if (strcasecmp(name.c_str(), "Content-Length") == 0)
+      resp_left = strtoll(val.c_str(), NULL, 10);
+    out += name + ": " + val + "\r\n";
+  }
+
+  resp_body = !(method == "HEAD" || status < 200 || status == 204 || status == 304);
+  if (resp_body && resp_left < 0) {
+    if (http_minor >= 1) {
+      resp_chunked = true;
+      out += "Transfer-Encoding: chunked\r\n";
+    } else {
+      keep_alive = false;  // the end of the body is when we close
+    }
+  }
+  if (!resp_body)
+    resp_left = -1;
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "HTTP/1.1 %d ", status);
+  obuf = buf;
+  obuf += reason.empty() ? http_reason(status) : reason;
+  obuf += "\r\n";
+  obuf += out;
+  obuf += keep_alive ? "Connection: Keep-Alive\r\n\r\n" : "Connection: close\r\n\r\n";
+  header_sent = true;
+  header.clear();
+}
+
+int RGWHTTPConn::write(const char *buf, int len)
+{
+  if (header_sent) {
+    write_body(buf, len);
+    return broken ? -EPIPE : len;
+  }
+
+  size_t old = header.size();
+  header.append(buf, len);
+  size_t start = (old > 2 ? old - 2 : 0);
+  size_t nn = header.find("\n\n", start);
+  size_t nrn = header.find("\n\r\n", start);
+  size_t end;
+  if (nn != string::npos && (nrn == string::npos || nn < nrn))
+    end = nn + 2;
+  else if (nrn != string::npos)
+    end = nrn + 3;
+  else
+    return len;
+
+  string rest = header.substr(end);
+  header.resize(end);
+  send_header();
+  if (!rest.empty())
+    write_body(rest.data(), rest.size());
+  return broken ? -EPIPE : len;
+}
+
+void RGWHTTPConn::frame_pending()
+{
+  if (pending.empty())
+    return;
+  if (resp_chunked) {
+    char hdr[32];
+    snprintf(hdr, sizeof(hdr), "%x\r\n", (unsigned)pending.size());
+    obuf += hdr;
+    obuf += pending;
+    obuf += "\r\n";
+  } else {
+    obuf += pending;
+  }
+  pending.clear();
+}
+
+void RGWHTTPConn::write_body(const char *buf, int len)
+{
+  if (!resp_body || len <= 0)
+    return;
+  if (resp_left > 0)
+    resp_left -= (len < resp_left ? len : resp_left);
+
+  if (len < RGW_HTTP_COALESCE) {
+    pending.append(buf, len);
+    if (pending.size() >= RGW_HTTP_COALESCE) {
+      frame_pending();
+      send_out();
+    }
+    return;
+  }
+
+  // big enough to go out on its own, straight from the caller's buffer
+  frame_pending();
+  struct iovec iov[4];
+  int n = 0;
+  char hdr[32];
+  if (!obuf.empty()) {
+    iov[n].iov_base = (void *)obuf.data();
+    iov[n++].iov_len = obuf.size();
+  }
+  if (resp_chunked) {
+    iov[n].iov_base = hdr;
+    iov[n++].iov_len = snprintf(hdr, sizeof(hdr), "%x\r\n", (unsigned)len);
+  }
+  iov[n].iov_base = (void *)buf;
+  iov[n++].iov_len = len;
+  if (resp_chunked) {
+    iov[n].iov_base = (void *)"\r\n";
+    iov[n++].iov_len = 2;
+  }
+  send_iov(iov, n);
+  obuf.clear();
+}
+
+void RGWHTTPConn::flush()
+{
+  if (!header_sent)
+    return;
+  frame_pending();
+  send_out();
+}
+
+bool RGWHTTPConn::complete()
+{
+  if (!header_sent) {
+    // the response never finished its header
+    if (header.empty())
+      header = "Status: 500\n";
+    send_header();
+  }
+  frame_pending();
+  if (resp_chunked)
+    obuf += "0\r\n\r\n";
+  send_out();
+
+  if (resp_left > 0) {
+    // we sent less than we promised; the client can only tell by EOF
+    keep_alive = false;
+  }
+
+  if (!req_done && keep_alive) {
+    if (expect_100 && !sent_100) {
+      // the client may or may not send the body now
+      keep_alive = false;
+    } else {
+      // skip what's left of the request body so we can read the next one
+      char buf[RGW_HTTP_COALESCE];
+      int drained = 0;
+      while (!req_done && !broken && drained < RGW_HTTP_MAX_DRAIN) {
+	int r = read(buf, sizeof(buf));
+	if (r <= 0)
+	  break;
+	drained += r;
+      }
+      if (!req_done)
+	keep_alive = false;
+    }
+  }
+  return keep_alive && !broken;
+}
+
+int rgw_http_listen(CephContext *cct, int backlog)
+{
+  const string& addr = cct->_conf->rgw_http_addr;
+  char port[16];
+  snprintf(port, sizeof(port), "%d", (int)cct->_conf->rgw_http_port);
+
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  int r = getaddrinfo(addr.empty() ? NULL : addr.c_str(), port, &hints, &res);
+  if (r != 0) {
+    ldout(cct, 0) << "ERROR: http: can't resolve '" << addr << "': " << gai_strerror(r) << dendl;
+    return -EINVAL;
+  }
+
+  int fd = -1;
+  r = -EADDRNOTAVAIL;
+  for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+    fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      r = -errno;
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+	::listen(fd, backlog) == 0)
+      break;
+    r = -errno;
+    ::close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0) {
+    ldout(cct, 0) << "ERROR: http: can't listen on " << addr << ":" << port << ": " << cpp_strerror(r) << dendl;
+    return r;
+  }
+
+  // the accept loop drains the backlog without blocking
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+  ldout(cct, 0) << "http: listening on " << addr << ":" << port << dendl;
+  return fd;
+}
+
+int rgw_http_accept(CephContext *cct, int lfd, RGWHTTPConn **conn)
+{
+  struct sockaddr_storage ss;
+  socklen_t slen = sizeof(ss);
+  int fd;
+  do {
+    fd = ::accept(lfd, (struct sockaddr *)&ss, &slen);
+  } while (fd < 0 && errno == EINTR);
+  if (fd < 0) {
+    int r = -errno;
+    if (r == -EWOULDBLOCK)
+      r = -EAGAIN;
+    return r;
+  }
+  // don't let the listener's O_NONBLOCK carry over
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+  ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  char host[NI_MAXHOST];
+  if (getnameinfo((struct sockaddr *)&ss, slen, host, sizeof(host), NULL, 0, NI_NUMERICHOST) != 0)
+    host[0] = '\0';
+
+  *conn = new RGWHTTPConn(cct, fd, host);
+  ldout(cct, 10) << "http: accepted connection from " << host << dendl;
+  return 0;
+}
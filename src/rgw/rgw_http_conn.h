@@ -0,0 +1,98 @@
+#ifndef CEPH_RGW_HTTP_CONN_H
+#define CEPH_RGW_HTTP_CONN_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
+#include "rgw_client_io.h"
+
+class CephContext;
+
+/*
+ * A client connection to the embedded HTTP/1.1 server ('rgw http port').
+ *
+ * read_request() reads the next request off the connection and turns it
+ * into the CGI environment the REST code expects.  The CGI style response
+ * it writes back is translated into HTTP: the Status: line becomes the
+ * status line, and a body of unknown length goes out chunked so that the
+ * connection can stay open.  Request bodies, plain or chunked, are read
+ * straight off the socket into the caller's buffer.
+ *
+ * Connections aren't tied to a thread: between requests the front end
+ * polls them, and a worker only picks one up once a request arrives.
+ */
+class RGWHTTPConn : public RGWClientIO {
+  CephContext *cct;
+  int fd;
+  std::string remote_addr;
+
+  // input buffer; request headers must fit in it
+  char *ibuf;
+  size_t ipos, ilen;
+
+  // current request
+  std::string method;
+  int http_minor;
+  bool keep_alive;
+  bool expect_100, sent_100;
+  bool req_chunked, chunk_started;
+  uint64_t req_left;   // body left to read (of the current chunk, if chunked)
+  bool req_done;
+  std::vector<std::string> env;
+  std::vector<char *> env_ptrs;
+
+  // response
+  bool header_sent;
+  std::string header;  // CGI header, until we have all of it
+  std::string obuf;    // ready to go out on the wire
+  std::string pending; // small body writes, not yet framed
+  bool resp_body;
+  bool resp_chunked;
+  int64_t resp_left;   // of Content-Length, -1 if there was none
+  bool broken;
+
+  int fill();
+  int read_line(std::string& line);
+  int next_chunk();
+  int parse_request(const char *p, const char *end);
+  void add_env(const std::string& name, const std::string& val);
+
+  int send_iov(struct iovec *iov, int n);
+  int send_out();
+  void send_error(int status);
+  void send_header();
+  void write_body(const char *buf, int len);
+  void frame_pending();
+
+public:
+  RGWHTTPConn(CephContext *_cct, int _fd, const std::string& _remote_addr);
+  ~RGWHTTPConn();
+
+  int get_fd() { return fd; }
+  /* a pipelined request is already waiting in our buffer */
+  bool has_buffered_input() { return ipos < ilen; }
+
+  /*
+   * read the next request's headers.  returns 0, or <0 if the client
+   * went away or sent garbage (and the connection should be closed).
+   */
+  int read_request();
+  /* finish the response; returns true if the connection can be reused */
+  bool complete();
+
+  char **envp();
+  int write(const char *buf, int len);
+  int read(char *buf, int len);
+  void flush();
+  void send_100_continue();
+};
+
+/* open the listening socket for 'rgw http addr' : 'rgw http port' */
+int rgw_http_listen(CephContext *cct, int backlog);
+/* accept a connection on it; -EAGAIN if there is none */
+int rgw_http_accept(CephContext *cct, int lfd, RGWHTTPConn **conn);
+
+#endif
@@ -1,6 +1,8 @@
 #include "common/Clock.h"
 #include "common/Timer.h"
 #include "common/utf8.h"
+#include "common/errno.h"
+#include "include/atomic.h"
 
 #include "rgw_log.h"
 #include "rgw_acl.h"
@@ -96,12 +98,24 @@ class UsageLogger {
     }
   };
 
+  /* a flush asked for by insert(), done on the timer thread */
+  class C_UsageLogFlush : public Context {
+    UsageLogger *logger;
+  public:
+    C_UsageLogFlush(UsageLogger *_l) : logger(_l) {}
+    void finish(int r) {
+      logger->flush_queued = false;
+      logger->flush();
+    }
+  };
+  bool flush_queued;
+
   void set_timer() {
     timer.add_event_after(cct->_conf->rgw_usage_log_tick_interval, new C_UsageLogTimeout(this));
   }
 public:
 
-  UsageLogger(CephContext *_cct) : cct(_cct), lock("UsageLogger"), num_entries(0), timer_lock("UsageLogger::timer_lock"), timer(cct, timer_lock) {
+  UsageLogger(CephContext *_cct) : cct(_cct), lock("UsageLogger"), num_entries(0), timer_lock("UsageLogger::timer_lock"), timer(cct, timer_lock), flush_queued(false) {
     timer.init();
     Mutex::Locker l(timer_lock);
     set_timer();
@@ -133,8 +147,12 @@ public:
     bool need_flush = (num_entries > cct->_conf->rgw_usage_log_flush_threshold);
     lock.Unlock();
     if (need_flush) {
+      // don't hold up the request on the write
       Mutex::Locker l(timer_lock);
-      flush();
+      if (!flush_queued) {
+        flush_queued = true;
+        timer.add_event_after(0, new C_UsageLogFlush(this));
+      }
     }
   }
 
@@ -145,7 +163,15 @@ public:
     num_entries = 0;
     lock.Unlock();
 
-    rgwstore->log_usage(old_map);
+    if (old_map.empty())
+      return;
+
+    utime_t start = ceph_clock_now(cct);
+    int r = rgwstore->log_usage(old_map);
+    if (r < 0)
+      ldout(cct, 0) << "ERROR: failed to write usage log: " << cpp_strerror(-r) << dendl;
+    if (perfcounter)
+      perfcounter->finc(l_rgw_usage_log_flush_lat, ceph_clock_now(cct) - start);
   }
 };
 
@@ -162,6 +188,205 @@ void rgw_log_usage_finalize()
   usage_logger = NULL;
 }
 
+/*
+ * ops log writer
+ *
+ * Entries are encoded on the request thread and added to one of
+ * RGW_OPS_LOG_BATCHES batches; a thread always uses the same batch, so
+ * threads rarely contend for a lock.  A batch goes out once it holds
+ * rgw_ops_log_batch_bytes, or on the next tick, as one aio append per
+ * log object.  With rgw_ops_log_shards > 1 each log object is split into
+ * "<name>.<shard>" objects, by batch, so that one busy bucket doesn't make
+ * one hot object.  Data buffered or in flight is limited to
+ * rgw_ops_log_max_pending_bytes; past that a request waits for room, or
+ * with rgw_ops_log_drop_when_full its entry is dropped.
+ */
+#define RGW_OPS_LOG_BATCHES 16
+
+static __thread int t_ops_log_batch = -1;
+
+class OpsLogWriter {
+  CephContext *cct;
+
+  struct Batch {
+    Mutex lock;
+    map<string, bufferlist> pending;  // log object -> entries
+    uint64_t bytes;
+    Batch() : lock("OpsLogWriter::Batch::lock"), bytes(0) {}
+  };
+  vector<Batch *> batches;
+  atomic_t next_batch;
+
+  Mutex lock;
+  Cond cond;
+  uint64_t queued;  // bytes buffered or in flight
+
+  Mutex timer_lock;
+  SafeTimer timer;
+
+  class C_OpsLogTick : public Context {
+    OpsLogWriter *writer;
+  public:
+    C_OpsLogTick(OpsLogWriter *_w) : writer(_w) {}
+    void finish(int r) {
+      writer->flush();
+      writer->set_timer();
+    }
+  };
+
+  class C_OpsLogAppended : public Context {
+    OpsLogWriter *writer;
+    uint64_t len;
+  public:
+    C_OpsLogAppended(OpsLogWriter *_w, uint64_t _len) : writer(_w), len(_len) {}
+    void finish(int r) {
+      writer->appended(len, r);
+    }
+  };
+
+  void set_timer() {
+    timer.add_event_after(cct->_conf->rgw_ops_log_flush_interval, new C_OpsLogTick(this));
+  }
+
+  bool reserve(uint64_t len) {
+    Mutex::Locker l(lock);
+    uint64_t max = cct->_conf->rgw_ops_log_max_pending_bytes;
+    if (queued > 0 && queued + len > max) {
+      if (cct->_conf->rgw_ops_log_drop_when_full) {
+        if (perfcounter)
+          perfcounter->inc(l_rgw_log_dropped);
+        return false;
+      }
+      if (perfcounter)
+        perfcounter->inc(l_rgw_log_blocked);
+      // what's still buffered won't drain until it's sent
+      lock.Unlock();
+      flush();
+      lock.Lock();
+      while (queued > 0 && queued + len > max)
+        cond.Wait(lock);
+    }
+    queued += len;
+    if (perfcounter)
+      perfcounter->set(l_rgw_log_queued_bytes, queued);
+    return true;
+  }
+
+  void appended(uint64_t len, int r) {
+    if (r < 0) {
+      ldout(cct, 0) << "ERROR: failed to write ops log: " << cpp_strerror(-r) << dendl;
+      if (perfcounter)
+        perfcounter->inc(l_rgw_log_append_errors);
+    }
+    Mutex::Locker l(lock);
+    queued -= len;
+    if (perfcounter)
+      perfcounter->set(l_rgw_log_queued_bytes, queued);
+    cond.Signal();
+  }
+
+  void write(string oid, bufferlist& bl) {
+    rgw_obj obj(log_bucket, oid);
+    uint64_t len = bl.length();
+    Context *c = new C_OpsLogAppended(this, len);
+    int r = rgwstore->append_async(obj, len, bl, c);
+    if (r == -ENOENT) {
+      string id;
+      map<std::string, bufferlist> attrs;
+      r = rgwstore->create_bucket(id, log_bucket, attrs, true);
+      if (r >= 0 || r == -EEXIST)
+        r = rgwstore->append_async(obj, len, bl, c);
+    }
+    if (r < 0) {
+      c->complete(r);
+      return;
+    }
+    if (perfcounter)
+      perfcounter->inc(l_rgw_log_appends);
+  }
+
+  void flush_batch(Batch *b) {
+    map<string, bufferlist> m;
+    b->lock.Lock();
+    m.swap(b->pending);
+    b->bytes = 0;
+    b->lock.Unlock();
+
+    for (map<string, bufferlist>::iterator iter = m.begin(); iter != m.end(); ++iter)
+      write(iter->first, iter->second);
+  }
+
+public:
+  OpsLogWriter(CephContext *_cct) : cct(_cct), lock("OpsLogWriter::lock"), queued(0),
+                                     timer_lock("OpsLogWriter::timer_lock"), timer(cct, timer_lock) {
+    for (int i = 0; i < RGW_OPS_LOG_BATCHES; i++)
+      batches.push_back(new Batch);
+    timer.init();
+    Mutex::Locker l(timer_lock);
+    set_timer();
+  }
+
+  ~OpsLogWriter() {
+    timer_lock.Lock();
+    timer.cancel_all_events();
+    timer.shutdown();
+    timer_lock.Unlock();
+
+    flush();
+    lock.Lock();
+    while (queued > 0)
+      cond.Wait(lock);
+    lock.Unlock();
+
+    for (vector<Batch *>::iterator iter = batches.begin(); iter != batches.end(); ++iter)
+      delete *iter;
+  }
+
+  void flush() {
+    for (vector<Batch *>::iterator iter = batches.begin(); iter != batches.end(); ++iter)
+      flush_batch(*iter);
+  }
+
+  void log(const string& name, bufferlist& bl) {
+    uint64_t len = bl.length();
+    if (!reserve(len))
+      return;
+
+    if (t_ops_log_batch < 0)
+      t_ops_log_batch = next_batch.inc();
+    int shards = cct->_conf->rgw_ops_log_shards;
+    string oid = name;
+    if (shards > 1) {
+      char buf[16];
+      snprintf(buf, sizeof(buf), ".%d", t_ops_log_batch % shards);
+      oid.append(buf);
+    }
+
+    Batch *b = batches[t_ops_log_batch % batches.size()];
+    b->lock.Lock();
+    b->pending[oid].claim_append(bl);
+    b->bytes += len;
+    bool need_flush = (b->bytes >= (uint64_t)cct->_conf->rgw_ops_log_batch_bytes);
+    b->lock.Unlock();
+
+    if (need_flush)
+      flush_batch(b);
+  }
+};
+
+static OpsLogWriter *ops_log_writer = NULL;
+
+void rgw_log_ops_init(CephContext *cct)
+{
+  ops_log_writer = new OpsLogWriter(cct);
+}
+
+void rgw_log_ops_finalize()
+{
+  delete ops_log_writer;
+  ops_log_writer = NULL;
+}
+
 static void log_usage(struct req_state *s)
 {
   if (!usage_logger)
@@ -264,6 +489,11 @@ int rgw_log_op(struct req_state *s)
   string oid = render_log_object_name(s->cct->_conf->rgw_log_object_name, &bdt,
 				      s->bucket.bucket_id, entry.bucket.c_str());
 
+  if (ops_log_writer) {
+    ops_log_writer->log(oid, bl);
+    return 0;
+  }
+
   rgw_obj obj(log_bucket, oid);
 
   int ret = rgwstore->append_async(obj, bl.length(), bl);
@@ -121,6 +121,8 @@ int rgw_log_op(struct req_state *s);
 int rgw_log_intent(struct req_state *s, rgw_obj& obj, RGWIntentEvent intent);
 void rgw_log_usage_init(CephContext *cct);
 void rgw_log_usage_finalize();
+void rgw_log_ops_init(CephContext *cct);
+void rgw_log_ops_finalize();
 
 #endif
 
@@ -7,16 +7,10 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <poll.h>
 
 #include <curl/curl.h>
 
-#include "acconfig.h"
-#ifdef FASTCGI_INCLUDE_DIR
-# include "fastcgi/fcgiapp.h"
-#else
-# include "fcgiapp.h"
-#endif
-
 #include "common/ceph_argparse.h"
 #include "global/global_init.h"
 #include "global/signal_handler.h"
@@ -33,7 +27,11 @@
 #include "rgw_rest.h"
 #include "rgw_swift.h"
 #include "rgw_log.h"
+#include "rgw_put_hash.h"
+#include "rgw_auth_cache.h"
 #include "rgw_tools.h"
+#include "rgw_fcgi.h"
+#include "rgw_http_conn.h"
 
 #include <map>
 #include <string>
@@ -55,9 +53,12 @@ static sighandler_t sighandler_term;
 
 #define SOCKET_BACKLOG 1024
 
+static volatile sig_atomic_t http_shutdown = 0;
+
 static void godown_handler(int signum)
 {
   FCGX_ShutdownPending();
+  http_shutdown = 1;
   signal(signum, sighandler_usr1);
   alarm(5);
 }
@@ -69,7 +70,6 @@ static void godown_alarm(int signum)
 
 struct RGWRequest
 {
-  FCGX_Request fcgx;
   uint64_t id;
   struct req_state *s;
   string req_str;
@@ -79,9 +79,17 @@ struct RGWRequest
   RGWRequest() : id(0), s(NULL), op(NULL) {
   }
 
-  ~RGWRequest() {
+  virtual ~RGWRequest() {
     delete s;
   }
+
+  /* read the request off the connection; <0 if there isn't one */
+  virtual int read_request() { return 0; }
+  virtual RGWClientIO *get_client_io() = 0;
+  /* the response is complete */
+  virtual void finish() = 0;
+  /* there was no request to respond to */
+  virtual void abort() = 0;
  
   req_state *init_state(CephContext *cct, RGWEnv *env) { 
     s = new req_state(cct, env);
@@ -120,6 +128,31 @@ struct RGWRequest
   }
 };
 
+struct RGWFCGXRequest : public RGWRequest {
+  FCGX_Request fcgx;
+  RGWFCGX cio;
+
+  RGWFCGXRequest() : cio(&fcgx) {}
+
+  RGWClientIO *get_client_io() { return &cio; }
+  void finish() { FCGX_Finish_r(&fcgx); }
+  void abort() { FCGX_Finish_r(&fcgx); }
+};
+
+class RGWProcess;
+
+struct RGWHTTPRequest : public RGWRequest {
+  RGWProcess *process;
+  RGWHTTPConn *conn;
+
+  RGWHTTPRequest(RGWProcess *p, RGWHTTPConn *c) : process(p), conn(c) {}
+
+  int read_request() { return conn->read_request(); }
+  RGWClientIO *get_client_io() { return conn; }
+  void finish();
+  void abort() { delete conn; }
+};
+
 class RGWProcess {
   deque<RGWRequest *> m_req_queue;
   ThreadPool m_tp;
@@ -157,6 +190,7 @@ class RGWProcess {
       perfcounter->inc(l_rgw_qactive);
       process->handle_request(req);
       process->req_throttle.put(1);
+      process->wake_http();   // a connection may be waiting for the throttle
       perfcounter->inc(l_rgw_qactive, -1);
     }
     void _dump_queue() {
@@ -177,18 +211,50 @@ class RGWProcess {
 
   uint64_t max_req_id;
 
+  /*
+   * embedded http: idle connections are polled by the front end thread,
+   * and handed back to it by the workers once they're done with them.
+   */
+  Mutex conn_lock;
+  list<RGWHTTPConn *> returned_conns;
+  int wake_fds[2];
+
+  void run_fcgi();
+  void run_http();
+  bool dispatch_http(RGWHTTPConn *conn);
+  void wake_http();
+
 public:
   RGWProcess(CephContext *cct, int num_threads)
     : m_tp(cct, "RGWProcess::m_tp", num_threads),
       req_throttle(cct, "rgw_ops", num_threads * 2),
       req_wq(this, g_conf->rgw_op_thread_timeout,
 	     g_conf->rgw_op_thread_suicide_timeout, &m_tp),
-      max_req_id(0) {}
+      max_req_id(0), conn_lock("RGWProcess::conn_lock") {
+    wake_fds[0] = wake_fds[1] = -1;
+  }
   void run();
   void handle_request(RGWRequest *req);
+  void return_conn(RGWHTTPConn *conn);
 };
 
+void RGWHTTPRequest::finish()
+{
+  if (conn->complete())
+    process->return_conn(conn);
+  else
+    delete conn;
+}
+
 void RGWProcess::run()
+{
+  if (g_conf->rgw_http_port > 0)
+    run_http();
+  else
+    run_fcgi();
+}
+
+void RGWProcess::run_fcgi()
 {
   int s = 0;
   if (!g_conf->rgw_socket_path.empty()) {
@@ -221,7 +287,7 @@ void RGWProcess::run()
   m_tp.start();
 
   for (;;) {
-    RGWRequest *req = new RGWRequest;
+    RGWFCGXRequest *req = new RGWFCGXRequest;
     req->id = ++max_req_id;
     dout(10) << "allocated request req=" << hex << req << dec << dendl;
     FCGX_InitRequest(&req->fcgx, s, 0);
@@ -236,6 +302,142 @@ void RGWProcess::run()
   m_tp.stop();
 }
 
+/*
+ * queue a request for conn, unless the workers are all busy: the poll
+ * thread must not block on the throttle.  returns false if the caller
+ * should hold on to conn and try again after the next wakeup.
+ */
+bool RGWProcess::dispatch_http(RGWHTTPConn *conn)
+{
+  if (!req_throttle.get_or_fail(1))
+    return false;
+  RGWHTTPRequest *req = new RGWHTTPRequest(this, conn);
+  req->id = ++max_req_id;
+  dout(10) << "allocated request req=" << hex << req << dec << " fd=" << conn->get_fd() << dendl;
+  req_wq.queue(req);
+  return true;
+}
+
+void RGWProcess::wake_http()
+{
+  if (wake_fds[1] < 0)
+    return;
+  // if the pipe is full a wakeup is pending anyway
+  char c = 0;
+  int r = ::write(wake_fds[1], &c, 1);
+  (void)r;
+}
+
+void RGWProcess::return_conn(RGWHTTPConn *conn)
+{
+  conn_lock.Lock();
+  returned_conns.push_back(conn);
+  conn_lock.Unlock();
+  wake_http();
+}
+
+void RGWProcess::run_http()
+{
+  int lfd = rgw_http_listen(g_ceph_context, SOCKET_BACKLOG);
+  if (lfd < 0)
+    return;
+  if (pipe(wake_fds) < 0) {
+    int err = errno;
+    dout(0) << "ERROR: pipe() failed: " << cpp_strerror(err) << dendl;
+    ::close(lfd);
+    return;
+  }
+  for (int i = 0; i < 2; i++)
+    fcntl(wake_fds[i], F_SETFL, fcntl(wake_fds[i], F_GETFL) | O_NONBLOCK);
+
+  m_tp.start();
+
+  map<RGWHTTPConn *, utime_t> idle;
+  list<RGWHTTPConn *> ready;   // have a request, waiting for the throttle
+  vector<struct pollfd> fds;
+  vector<RGWHTTPConn *> polled;
+  utime_t timeout(g_conf->rgw_http_keepalive_timeout, 0);
+
+  while (!http_shutdown) {
+    fds.resize(2 + idle.size());
+    fds[0].fd = lfd;
+    fds[1].fd = wake_fds[0];
+    polled.clear();
+    for (map<RGWHTTPConn *, utime_t>::iterator iter = idle.begin(); iter != idle.end(); ++iter) {
+      fds[2 + polled.size()].fd = iter->first->get_fd();
+      polled.push_back(iter->first);
+    }
+    for (unsigned i = 0; i < fds.size(); i++) {
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+    }
+
+    int r = poll(&fds[0], fds.size(), 1000);
+    if (r < 0) {
+      int err = errno;
+      if (err == EINTR)
+	continue;
+      dout(0) << "ERROR: poll() failed: " << cpp_strerror(err) << dendl;
+      break;
+    }
+    utime_t now = ceph_clock_now(g_ceph_context);
+
+    for (unsigned i = 0; i < polled.size(); i++) {
+      RGWHTTPConn *conn = polled[i];
+      if (fds[2 + i].revents) {
+	// a request, or the client closed; the worker will find out which
+	idle.erase(conn);
+	ready.push_back(conn);
+      } else if (now - idle[conn] > timeout) {
+	dout(10) << "closing idle connection fd=" << conn->get_fd() << dendl;
+	idle.erase(conn);
+	delete conn;
+      }
+    }
+
+    if (fds[1].revents) {
+      char buf[128];
+      while (::read(wake_fds[0], buf, sizeof(buf)) > 0) ;
+      list<RGWHTTPConn *> ls;
+      conn_lock.Lock();
+      ls.swap(returned_conns);
+      conn_lock.Unlock();
+      for (list<RGWHTTPConn *>::iterator iter = ls.begin(); iter != ls.end(); ++iter) {
+	if ((*iter)->has_buffered_input())
+	  ready.push_back(*iter);   // pipelined
+	else
+	  idle[*iter] = now;
+      }
+    }
+
+    if (fds[0].revents) {
+      RGWHTTPConn *conn;
+      while ((r = rgw_http_accept(g_ceph_context, lfd, &conn)) == 0)
+	idle[conn] = now;
+      if (r != -EAGAIN)
+	dout(0) << "ERROR: accept() failed: " << cpp_strerror(r) << dendl;
+    }
+
+    // in order; the rest wait for a worker to finish and wake us
+    while (!ready.empty() && dispatch_http(ready.front()))
+      ready.pop_front();
+  }
+
+  ::close(lfd);
+  req_wq.drain();
+  m_tp.stop();
+
+  for (map<RGWHTTPConn *, utime_t>::iterator iter = idle.begin(); iter != idle.end(); ++iter)
+    delete iter->first;
+  for (list<RGWHTTPConn *>::iterator iter = ready.begin(); iter != ready.end(); ++iter)
+    delete *iter;
+  for (list<RGWHTTPConn *>::iterator iter = returned_conns.begin(); iter != returned_conns.end(); ++iter)
+    delete *iter;
+  returned_conns.clear();
+  ::close(wake_fds[0]);
+  ::close(wake_fds[1]);
+}
+
 static int call_log_intent(void *ctx, rgw_obj& obj, RGWIntentEvent intent)
 {
   struct req_state *s = (struct req_state *)ctx;
@@ -244,17 +446,26 @@ static int call_log_intent(void *ctx, rgw_obj& obj, RGWIntentEvent intent)
 
 void RGWProcess::handle_request(RGWRequest *req)
 {
-  FCGX_Request *fcgx = &req->fcgx;
+  RGWClientIO *cio = req->get_client_io();
   RGWRESTMgr rest;
   int ret;
   RGWEnv rgw_env;
+  utime_t auth_start;
+
+  ret = req->read_request();
+  if (ret < 0) {
+    dout(10) << "no request on connection req=" << hex << req << dec << " ret=" << ret << dendl;
+    req->abort();
+    delete req;
+    return;
+  }
 
   req->log_init();
 
   dout(1) << "====== starting new request req=" << hex << req << dec << " =====" << dendl;
   perfcounter->inc(l_rgw_req);
 
-  rgw_env.init(g_ceph_context, fcgx->envp);
+  rgw_env.init(g_ceph_context, cio->envp());
 
   struct req_state *s = req->init_state(g_ceph_context, &rgw_env);
   s->obj_ctx = rgwstore->create_context(s);
@@ -264,7 +475,7 @@ void RGWProcess::handle_request(RGWRequest *req)
 
   RGWOp *op = NULL;
   int init_error = 0;
-  RGWHandler *handler = rest.get_handler(s, fcgx, &init_error);
+  RGWHandler *handler = rest.get_handler(s, cio, &init_error);
   if (init_error != 0) {
     abort_early(s, init_error);
     goto done;
@@ -279,7 +490,9 @@ void RGWProcess::handle_request(RGWRequest *req)
   req->op = op;
 
   req->log(s, "authorizing");
+  auth_start = ceph_clock_now(s->cct);
   ret = handler->authorize();
+  perfcounter->finc(l_rgw_auth_lat, ceph_clock_now(s->cct) - auth_start);
   if (ret < 0) {
     dout(10) << "failed to authorize request" << dendl;
     abort_early(s, ret);
@@ -326,7 +539,7 @@ done:
 
   handler->put_op(op);
   rgwstore->destroy_context(s->obj_ctx);
-  FCGX_Finish_r(fcgx);
+  req->finish();
   delete req;
 
   dout(1) << "====== req done req=" << hex << req << dec << " http_status=" << http_ret << " ======" << dendl;
@@ -369,8 +582,8 @@ int main(int argc, const char **argv)
 
   pid_t childpid = 0;
   if (g_conf->daemonize) {
-    if (g_conf->rgw_socket_path.empty()) {
-      cerr << "radosgw: must specify 'rgw socket path' to run as a daemon" << std::endl;
+    if (g_conf->rgw_socket_path.empty() && g_conf->rgw_http_port <= 0) {
+      cerr << "radosgw: must specify 'rgw socket path' or 'rgw http port' to run as a daemon" << std::endl;
       exit(1);
     }
 
@@ -436,10 +649,16 @@ int main(int argc, const char **argv)
     return 1;
 
   rgw_log_usage_init(g_ceph_context);
+  rgw_log_ops_init(g_ceph_context);
+  rgw_auth_cache_init(g_ceph_context);
+  rgw_put_hash_init(g_ceph_context);
 
   RGWProcess process(g_ceph_context, g_conf->rgw_thread_pool_size);
   process.run();
 
+  rgw_put_hash_finalize();
+  rgw_auth_cache_finalize();
+  rgw_log_ops_finalize();
   rgw_log_usage_finalize();
 
   rgw_perf_stop(g_ceph_context);
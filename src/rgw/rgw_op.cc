@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include <sstream>
+#include <deque>
 
 #include "common/Clock.h"
 #include "common/armor.h"
@@ -17,12 +18,9 @@
 #include "rgw_user.h"
 #include "rgw_log.h"
 #include "rgw_multi.h"
+#include "rgw_put_hash.h"
 
-#ifdef FASTCGI_INCLUDE_DIR
-# include "fastcgi/fcgiapp.h"
-#else
-# include "fcgiapp.h"
-#endif
+#include "rgw_client_io.h"
 
 #define dout_subsys ceph_subsys_rgw
 
@@ -314,10 +312,95 @@ int RGWGetObj::verify_permission()
   return 0;
 }
 
+int RGWGetObj::send_data(bufferlist& bl)
+{
+  if (!sent_data) {
+    perfcounter->finc(l_rgw_get_ttfb, ceph_clock_now(s->cct) - s->time);
+    sent_data = true;
+  }
+  return send_response(bl);
+}
+
+struct RGWGetObjChunk {
+  bufferlist bl;
+  void *aio;
+  uint64_t len;
+
+  RGWGetObjChunk() : aio(NULL), len(0) {}
+};
+
+/*
+ * keep up to window bytes of reads in flight, and send each chunk as
+ * soon as it arrives, so that rados reads overlap with writing to the
+ * client.  ofs is advanced past what we sent.  returns -ECANCELED if
+ * the object was replaced under us.
+ */
+int RGWGetObj::read_window(void **handle, uint64_t window)
+{
+  deque<RGWGetObjChunk> chunks;  // deque: push_back keeps the other bufferlists in place
+  uint64_t in_flight = 0;
+  off_t next = ofs;
+  utime_t start_time = s->time;
+  int r = 0;
+
+  while (next <= end || !chunks.empty()) {
+    while (next <= end && (chunks.empty() || in_flight < window)) {
+      chunks.push_back(RGWGetObjChunk());
+      RGWGetObjChunk& c = chunks.back();
+      r = rgwstore->aio_get_obj(s->obj_ctx, handle, obj, c.bl, next, end, &c.aio);
+      if (r <= 0) {
+        chunks.pop_back();
+        if (r == 0)
+          r = -EIO;
+        break;
+      }
+      c.len = r;
+      next += r;
+      in_flight += r;
+      r = 0;
+    }
+    if (r < 0)
+      break;
+
+    RGWGetObjChunk& c = chunks.front();
+    if (c.aio) {
+      r = rgwstore->aio_wait(c.aio);
+      c.aio = NULL;
+      if (r < 0)
+        break;
+      r = 0;
+    }
+    if (c.bl.length() < c.len) {
+      ldout(s->cct, 0) << "ERROR: short read of " << obj << " at " << ofs << ": got "
+                       << c.bl.length() << " of " << c.len << dendl;
+      r = -EIO;
+      break;
+    }
+
+    perfcounter->finc(l_rgw_get_lat,
+                     (ceph_clock_now(s->cct) - start_time));
+    send_data(c.bl);
+    ofs += c.len;
+    in_flight -= c.len;
+    chunks.pop_front();
+    start_time = ceph_clock_now(s->cct);
+  }
+
+  // the reads still in flight write into these buffers
+  for (deque<RGWGetObjChunk>::iterator iter = chunks.begin(); iter != chunks.end(); ++iter) {
+    if (iter->aio)
+      rgwstore->aio_wait(iter->aio);
+  }
+  return r;
+}
+
 void RGWGetObj::execute()
 {
   void *handle = NULL;
   utime_t start_time = s->time;
+  utime_t xfer_start;
+  double xfer_time;
+  uint64_t window = s->cct->_conf->rgw_get_obj_window_size;
   bufferlist bl;
 
   perfcounter->inc(l_rgw_get);
@@ -341,6 +424,18 @@ void RGWGetObj::execute()
     goto done;
 
   perfcounter->inc(l_rgw_get_b, end - ofs);
+  xfer_start = ceph_clock_now(s->cct);
+
+  if (window > 0) {
+    ret = read_window(&handle, window);
+    if (ret == -ECANCELED) {
+      ldout(s->cct, 0) << "NOTICE: " << obj << " was replaced while reading, continuing without read ahead" << dendl;
+      ret = 0;
+    } else if (ret < 0) {
+      goto done;
+    }
+    start_time = ceph_clock_now(s->cct);
+  }
 
   while (ofs <= end) {
     ret = rgwstore->get_obj(s->obj_ctx, &handle, obj, bl, ofs, end);
@@ -353,11 +448,16 @@ void RGWGetObj::execute()
 
     perfcounter->finc(l_rgw_get_lat,
                      (ceph_clock_now(s->cct) - start_time));
-    send_response(bl);
+    send_data(bl);
     bl.clear();
     start_time = ceph_clock_now(s->cct);
   }
 
+  xfer_time = (double)(ceph_clock_now(s->cct) - xfer_start);
+  perfcounter->finc(l_rgw_get_xfer_lat, xfer_time);
+  if (xfer_time > 0)
+    perfcounter->finc(l_rgw_get_bw, (double)(ofs - start) / xfer_time);
+  rgwstore->finish_get_obj(&handle);
   return;
 
 done:
@@ -928,10 +1028,11 @@ void RGWPutObj::execute()
   char supplied_md5[CEPH_CRYPTO_MD5_DIGESTSIZE * 2 + 1];
   char calc_md5[CEPH_CRYPTO_MD5_DIGESTSIZE * 2 + 1];
   unsigned char m[CEPH_CRYPTO_MD5_DIGESTSIZE];
-  MD5 hash;
+  RGWPutHash hash;
   bufferlist bl, aclbl;
   map<string, bufferlist> attrs;
   int len;
+  utime_t start, recv_lat, write_lat, hash_wait_lat, complete_lat;
 
 
   perfcounter->inc(l_rgw_put);
@@ -970,7 +1071,9 @@ void RGWPutObj::execute()
 
   do {
     bufferlist data;
+    start = ceph_clock_now(s->cct);
     len = get_data(data);
+    recv_lat += ceph_clock_now(s->cct) - start;
     if (len < 0) {
       ret = len;
       goto done;
@@ -979,15 +1082,18 @@ void RGWPutObj::execute()
       break;
 
     void *handle;
-    const unsigned char *data_ptr = (const unsigned char *)data.c_str();
+    bufferlist hash_data(data);  // the atomic processor claims the first chunk
 
+    start = ceph_clock_now(s->cct);
     ret = processor->handle_data(data, ofs, &handle);
     if (ret < 0)
       goto done;
 
-    hash.Update(data_ptr, len);
+    /* hashed by a hash thread, if there are any, while the write is in flight */
+    hash.update(hash_data);
 
     ret = processor->throttle_data(handle);
+    write_lat += ceph_clock_now(s->cct) - start;
     if (ret < 0)
       goto done;
 
@@ -1001,7 +1107,7 @@ void RGWPutObj::execute()
   s->obj_size = ofs;
   perfcounter->inc(l_rgw_put_b, s->obj_size);
 
-  hash.Final(m);
+  hash.final(m, &hash_wait_lat);
 
   buf_to_hex(m, CEPH_CRYPTO_MD5_DIGESTSIZE, calc_md5);
 
@@ -1029,7 +1135,17 @@ void RGWPutObj::execute()
 
   rgw_get_request_metadata(s, attrs);
 
+  start = ceph_clock_now(s->cct);
   ret = processor->complete(etag, attrs);
+  complete_lat = ceph_clock_now(s->cct) - start;
+  if (ret < 0)
+    goto done;
+
+  perfcounter->finc(l_rgw_put_recv_lat, recv_lat);
+  perfcounter->finc(l_rgw_put_write_lat, write_lat);
+  perfcounter->finc(l_rgw_put_hash_lat, hash.get_hash_time());
+  perfcounter->finc(l_rgw_put_hash_wait_lat, hash_wait_lat);
+  perfcounter->finc(l_rgw_put_complete_lat, complete_lat);
 done:
   dispose_processor(processor);
   perfcounter->finc(l_rgw_put_lat,
@@ -1476,17 +1592,121 @@ int RGWCompleteMultipart::verify_permission()
   return 0;
 }
 
+/*
+ * Check the parts the client listed against what was uploaded, and
+ * build the manifest and etag of the assembled object from them.  The
+ * part info is in the upload's omap.  We get all its keys first (they're
+ * small), then the values rgw_multipart_part_batch at a time with up to
+ * rgw_multipart_aio reads in flight; each batch goes into the manifest
+ * as soon as it's in, in part order.
+ */
+struct RGWMultipartBatch {
+  map<int, string>::iterator first, last;
+  set<string> keys;
+  map<string, bufferlist> vals;
+  void *handle;
+};
+
+static int build_multipart_manifest(struct req_state *s, RGWMPObj& mp, rgw_obj& meta_obj,
+                                    map<int, string>& req_parts, map<string, bufferlist>& attrs,
+                                    RGWObjManifest& manifest, MD5& hash)
+{
+  set<string> keys;
+  int ret = rgwstore->omap_get_keys(meta_obj, keys, &attrs);
+  if (ret < 0)
+    return ret;
+
+  map<int, string> part_keys;
+  for (set<string>::iterator kiter = keys.begin(); kiter != keys.end(); ++kiter) {
+    if (kiter->compare(0, 5, "part.") == 0)
+      part_keys[atoi(kiter->c_str() + 5)] = *kiter;
+  }
+  if (part_keys.size() != req_parts.size()) {
+    ldout(s->cct, 0) << "NOTICE: " << req_parts.size() << " parts requested, " << part_keys.size() << " uploaded" << dendl;
+    return -ERR_INVALID_PART;
+  }
+
+  int batch_size = max(1, (int)s->cct->_conf->rgw_multipart_part_batch);
+  int window = max(1, (int)s->cct->_conf->rgw_multipart_aio);
+  list<RGWMultipartBatch> pending;
+  map<int, string>::iterator next = req_parts.begin();
+  off_t ofs = 0;
+
+  while (!pending.empty() || (ret == 0 && next != req_parts.end())) {
+    while (ret == 0 && next != req_parts.end() && (int)pending.size() < window) {
+      pending.push_back(RGWMultipartBatch());
+      RGWMultipartBatch& b = pending.back();
+      b.first = next;
+      for (int i = 0; i < batch_size && next != req_parts.end(); ++i, ++next) {
+        map<int, string>::iterator kiter = part_keys.find(next->first);
+        if (kiter == part_keys.end()) {
+          ldout(s->cct, 0) << "NOTICE: requested part " << next->first << " was not uploaded" << dendl;
+          ret = -ERR_INVALID_PART;
+          break;
+        }
+        b.keys.insert(kiter->second);
+      }
+      b.last = next;
+      if (ret == 0)
+        ret = rgwstore->aio_omap_get_vals_by_keys(meta_obj, b.keys, &b.vals, &b.handle);
+      if (ret < 0)
+        pending.pop_back();
+    }
+    if (pending.empty())
+      break;
+
+    RGWMultipartBatch& b = pending.front();
+    int r = rgwstore->aio_wait(b.handle);
+    if (ret == 0 && r < 0)
+      ret = r;
+    for (map<int, string>::iterator iter = b.first; ret == 0 && iter != b.last; ++iter) {
+      map<string, bufferlist>::iterator viter = b.vals.find(part_keys[iter->first]);
+      if (viter == b.vals.end()) {
+        ldout(s->cct, 0) << "NOTICE: part " << iter->first << " went away" << dendl;
+        ret = -ERR_INVALID_PART;
+        break;
+      }
+      RGWUploadPartInfo info;
+      try {
+        bufferlist::iterator bli = viter->second.begin();
+        ::decode(info, bli);
+      } catch (buffer::error& err) {
+        ldout(s->cct, 0) << "ERROR: could not decode part info, caught buffer::error" << dendl;
+        ret = -EIO;
+        break;
+      }
+      if (iter->second.compare(info.etag) != 0) {
+        ldout(s->cct, 0) << "NOTICE: etag mismatch: part: " << iter->first << " etag: " << iter->second << dendl;
+        ret = -ERR_INVALID_PART;
+        break;
+      }
+
+      char etag[CEPH_CRYPTO_MD5_DIGESTSIZE];
+      hex_to_buf(info.etag.c_str(), etag, CEPH_CRYPTO_MD5_DIGESTSIZE);
+      hash.Update((const byte *)etag, sizeof(etag));
+
+      string oid = mp.get_part(info.num);
+      RGWObjManifestPart& part = manifest.objs[ofs];
+      part.loc.init_ns(s->bucket, oid, mp_ns);
+      part.loc_ofs = 0;
+      part.size = info.size;
+      ofs += part.size;
+    }
+    pending.pop_front();
+  }
+  if (ret < 0)
+    return ret;
+
+  manifest.obj_size = ofs;
+  return 0;
+}
+
 void RGWCompleteMultipart::execute()
 {
   RGWMultiCompleteUpload *parts;
-  map<int, string>::iterator iter;
   RGWMultiXMLParser parser;
   string meta_oid;
-  map<uint32_t, RGWUploadPartInfo> obj_parts;
-  map<uint32_t, RGWUploadPartInfo>::iterator obj_iter;
-  RGWAccessControlPolicy policy(s->cct);
   map<string, bufferlist> attrs;
-  off_t ofs = 0;
   MD5 hash;
   char final_etag[CEPH_CRYPTO_MD5_DIGESTSIZE];
   char final_etag_str[CEPH_CRYPTO_MD5_DIGESTSIZE * 2 + 16];
@@ -1523,33 +1743,14 @@ void RGWCompleteMultipart::execute()
 
   mp.init(s->object_str, upload_id);
   meta_oid = mp.get_meta();
+  meta_obj.init_ns(s->bucket, meta_oid, mp_ns);
 
-  ret = get_multiparts_info(s, meta_oid, obj_parts, policy, attrs);
+  ret = build_multipart_manifest(s, mp, meta_obj, parts->parts, attrs, manifest, hash);
   if (ret == -ENOENT)
     ret = -ERR_NO_SUCH_UPLOAD;
-  if (parts->parts.size() != obj_parts.size())
-    ret = -ERR_INVALID_PART;
   if (ret < 0)
     goto done;
 
-  for (iter = parts->parts.begin(), obj_iter = obj_parts.begin();
-       iter != parts->parts.end() && obj_iter != obj_parts.end();
-       ++iter, ++obj_iter) {
-    char etag[CEPH_CRYPTO_MD5_DIGESTSIZE];
-    if (iter->first != (int)obj_iter->first) {
-      ldout(s->cct, 0) << "NOTICE: parts num mismatch: next requested: " << iter->first << " next uploaded: " << obj_iter->first << dendl;
-      ret = -ERR_INVALID_PART;
-      goto done;
-    }
-    if (iter->second.compare(obj_iter->second.etag) != 0) {
-      ldout(s->cct, 0) << "NOTICE: etag mismatch: part: " << iter->first << " etag: " << iter->second << dendl;
-      ret = -ERR_INVALID_PART;
-      goto done;
-    }
-
-    hex_to_buf(obj_iter->second.etag.c_str(), etag, CEPH_CRYPTO_MD5_DIGESTSIZE);
-    hash.Update((const byte *)etag, sizeof(etag));
-  }
   hash.Final((byte *)final_etag);
 
   buf_to_hex((unsigned char *)final_etag, sizeof(final_etag), final_etag_str);
@@ -1563,35 +1764,13 @@ void RGWCompleteMultipart::execute()
 
   target_obj.init(s->bucket, s->object_str);
   rgwstore->set_atomic(s->obj_ctx, target_obj);
-  ret = rgwstore->put_obj_meta(s->obj_ctx, target_obj, 0, NULL, attrs, RGW_OBJ_CATEGORY_MAIN, false, NULL, NULL, NULL);
-  if (ret < 0)
-    goto done;
-  
-  for (obj_iter = obj_parts.begin(); obj_iter != obj_parts.end(); ++obj_iter) {
-    string oid = mp.get_part(obj_iter->second.num);
-    rgw_obj src_obj;
-    src_obj.init_ns(s->bucket, oid, mp_ns);
-
-    RGWObjManifestPart& part = manifest.objs[ofs];
-
-    part.loc = src_obj;
-    part.loc_ofs = 0;
-    part.size = obj_iter->second.size;
-
-    ofs += part.size;
-  }
-
-  manifest.obj_size = ofs;
 
-  rgwstore->set_atomic(s->obj_ctx, target_obj);
-
-  ret = rgwstore->put_obj_meta(s->obj_ctx, target_obj, ofs, NULL, attrs,
+  ret = rgwstore->put_obj_meta(s->obj_ctx, target_obj, manifest.obj_size, NULL, attrs,
                                RGW_OBJ_CATEGORY_MAIN, false, NULL, NULL, &manifest);
   if (ret < 0)
     goto done;
 
   // remove the upload obj
-  meta_obj.init_ns(s->bucket, meta_oid, mp_ns);
   rgwstore->delete_obj(s->obj_ctx, meta_obj);
 
 done:
@@ -1724,13 +1903,13 @@ done:
   send_response();
 }
 
-int RGWHandler::init(struct req_state *_s, FCGX_Request *fcgx)
+int RGWHandler::init(struct req_state *_s, RGWClientIO *cio)
 {
   s = _s;
 
   if (s->cct->_conf->subsys.should_gather(ceph_subsys_rgw, 20)) {
     char *p;
-    for (int i=0; (p = fcgx->envp[i]); ++i) {
+    for (int i=0; (p = cio->envp()[i]); ++i) {
       ldout(s->cct, 20) << p << dendl;
     }
   }
@@ -67,8 +67,11 @@ protected:
   bool get_data;
   bool partial_content;
   rgw_obj obj;
+  bool sent_data;
 
   int init_common();
+  int read_window(void **handle, uint64_t window);
+  int send_data(bufferlist& bl);
 public:
   RGWGetObj() {}
 
@@ -93,6 +96,7 @@ public:
     unmod_ptr = NULL;
     attrs.clear();
     partial_content = false;
+    sent_data = false;
     ret = 0;
 
     /* get_data should not be initialized here! */
@@ -673,7 +677,7 @@ protected:
 public:
   RGWHandler() {}
   virtual ~RGWHandler() {}
-  virtual int init(struct req_state *_s, FCGX_Request *fcgx);
+  virtual int init(struct req_state *_s, RGWClientIO *cio);
 
   virtual RGWOp *get_op() = 0;
   virtual void put_op(RGWOp *op) = 0;
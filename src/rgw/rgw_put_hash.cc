@@ -0,0 +1,114 @@
+#include <vector>
+
+#include "common/Clock.h"
+#include "common/Finisher.h"
+#include "common/config.h"
+#include "include/atomic.h"
+
+#include "rgw_put_hash.h"
+
+#define dout_subsys ceph_subsys_rgw
+
+using namespace std;
+
+/*
+ * each request sticks to one finisher, which keeps its chunks in order;
+ * requests are spread over the finishers round robin.
+ */
+static CephContext *hash_cct = NULL;
+static vector<Finisher *> hash_finishers;
+static atomic_t next_finisher;
+
+void rgw_put_hash_init(CephContext *cct)
+{
+  hash_cct = cct;
+  int n = cct->_conf->rgw_put_hash_threads;
+  for (int i = 0; i < n; i++) {
+    Finisher *f = new Finisher(cct);
+    f->start();
+    hash_finishers.push_back(f);
+  }
+}
+
+void rgw_put_hash_finalize()
+{
+  for (vector<Finisher *>::iterator iter = hash_finishers.begin(); iter != hash_finishers.end(); ++iter) {
+    (*iter)->stop();
+    delete *iter;
+  }
+  hash_finishers.clear();
+}
+
+class C_PutHashChunk : public Context {
+  RGWPutHash *ph;
+  bufferlist bl;
+public:
+  C_PutHashChunk(RGWPutHash *_ph, bufferlist& _bl) : ph(_ph), bl(_bl) {}
+  void finish(int r) {
+    utime_t start = ceph_clock_now(hash_cct);
+    ph->hash_data(bl);
+    ph->chunk_done(ceph_clock_now(hash_cct) - start);
+  }
+};
+
+RGWPutHash::RGWPutHash() : finisher(NULL), lock("RGWPutHash::lock"), pending(0)
+{
+  if (!hash_finishers.empty())
+    finisher = hash_finishers[next_finisher.inc() % hash_finishers.size()];
+}
+
+RGWPutHash::~RGWPutHash()
+{
+  // queued chunks point at us
+  wait();
+}
+
+void RGWPutHash::hash_data(bufferlist& bl)
+{
+  for (list<bufferptr>::const_iterator iter = bl.buffers().begin();
+       iter != bl.buffers().end(); ++iter)
+    hash.Update((const byte *)iter->c_str(), iter->length());
+}
+
+void RGWPutHash::chunk_done(utime_t t)
+{
+  Mutex::Locker l(lock);
+  hash_time += t;
+  pending--;
+  cond.Signal();
+}
+
+void RGWPutHash::wait(int max)
+{
+  Mutex::Locker l(lock);
+  while (pending > max)
+    cond.Wait(lock);
+}
+
+void RGWPutHash::update(bufferlist& bl)
+{
+  if (!finisher) {
+    utime_t start = ceph_clock_now(hash_cct);
+    hash_data(bl);
+    hash_time += ceph_clock_now(hash_cct) - start;
+    return;
+  }
+  // don't let the client get too far ahead of the hash threads; every
+  // queued chunk pins its data.
+  int max = hash_cct->_conf->rgw_put_hash_max_pending;
+  if (max > 0)
+    wait(max - 1);
+  lock.Lock();
+  pending++;
+  lock.Unlock();
+  finisher->queue(new C_PutHashChunk(this, bl));
+}
+
+void RGWPutHash::final(byte *digest, utime_t *wait_time)
+{
+  utime_t start = ceph_clock_now(hash_cct);
+  wait();
+  if (wait_time)
+    *wait_time = ceph_clock_now(hash_cct) - start;
+  hash.Final(digest);
+}
@@ -0,0 +1,50 @@
+#ifndef CEPH_RGW_PUT_HASH_H
+#define CEPH_RGW_PUT_HASH_H
+
+#include "common/ceph_crypto.h"
+#include "common/Mutex.h"
+#include "common/Cond.h"
+#include "include/buffer.h"
+#include "include/utime.h"
+
+class CephContext;
+class Finisher;
+
+/*
+ * The MD5 of a PUT's data, computed off the request thread.
+ *
+ * Chunks handed to update() are hashed in order by one of the
+ * 'rgw put hash threads' hash threads, while the request thread goes on
+ * reading the next chunk from the client and writing to rados.  The
+ * chunk's buffers are shared with the caller, not copied, so update()
+ * waits once 'rgw put hash max pending' chunks are queued.  Without hash
+ * threads (or before rgw_put_hash_init()) update() hashes inline.
+ */
+class RGWPutHash {
+  ceph::crypto::MD5 hash;
+  Finisher *finisher;
+  Mutex lock;
+  Cond cond;
+  int pending;
+  utime_t hash_time;
+
+  void hash_data(bufferlist& bl);
+  void chunk_done(utime_t t);
+  void wait(int max=0);  // until no more than max chunks are queued
+
+  friend class C_PutHashChunk;
+public:
+  RGWPutHash();
+  ~RGWPutHash();
+
+  void update(bufferlist& bl);
+  /* waits for the chunks still queued; wait_time is how long that took */
+  void final(byte *digest, utime_t *wait_time);
+  /* time spent hashing, on whichever thread */
+  utime_t get_hash_time() { return hash_time; }
+};
+
+extern void rgw_put_hash_init(CephContext *cct);
+extern void rgw_put_hash_finalize();
+
+#endif
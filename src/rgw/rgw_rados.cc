@@ -26,6 +26,8 @@ using namespace librados;
 
 #include "rgw_log.h"
 
+#include "include/ceph_hash.h"
+
 #define dout_subsys ceph_subsys_rgw
 
 using namespace std;
@@ -46,6 +48,32 @@ static string avail_pools = ".pools.avail";
 
 static rgw_bucket pi_buckets_rados = RGW_ROOT_BUCKET;
 
+/*
+ * bucket index objects.  an unsharded bucket keeps its whole index in
+ * .dir.<marker>.  a bucket with n shards spreads it over
+ * .dir.<marker>.<n>.<i> (i < n) by a hash of the entry name; the shard
+ * count is part of the name so that a reshard can build the new index
+ * next to the old one.
+ */
+static void get_bucket_index_oid(rgw_bucket& bucket, uint32_t num_shards, uint32_t shard,
+                                 string& oid)
+{
+  oid = dir_oid_prefix;
+  oid.append(bucket.marker);
+  if (num_shards) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), ".%u.%u", num_shards, shard);
+    oid.append(buf);
+  }
+}
+
+static uint32_t get_bucket_index_shard(const string& name, uint32_t num_shards)
+{
+  if (!num_shards)
+    return 0;
+  return ceph_str_hash_linux(name.c_str(), name.size()) % num_shards;
+}
+
 
 static RGWObjCategory shadow_category = RGW_OBJ_CATEGORY_SHADOW;
 static RGWObjCategory main_category = RGW_OBJ_CATEGORY_MAIN;
@@ -490,11 +518,12 @@ int RGWRados::decode_policy(bufferlist& bl, ACLOwner *owner)
 /** 
  * get listing of the objects in a bucket.
  * bucket: bucket to list contents of
- * max: maximum number of results to return
+ * max: maximum number of results to return, counting common prefixes
  * prefix: only return results that match this prefix
  * delim: do not include results that match this string.
  *     Any skipped results will have the matching portion of their name
- *     inserted in common_prefixes with a "true" mark.
+ *     inserted in common_prefixes with a "true" mark.  Unless there is a
+ *     filter, the bucket index does this and skips over the rest of them.
  * marker: if filled in, begin the listing with this object.
  * result: the objects are put in here.
  * common_prefixes: if delim is filled in, any matching prefixes are placed
@@ -505,7 +534,6 @@ int RGWRados::list_objects(rgw_bucket& bucket, int max, string& prefix, string&
 			   bool get_content_type, string& ns, bool *is_truncated, RGWAccessListFilter *filter)
 {
   int count = 0;
-  string cur_marker = marker;
   bool truncated;
 
   if (bucket_is_system(bucket)) {
@@ -513,13 +541,49 @@ int RGWRados::list_objects(rgw_bucket& bucket, int max, string& prefix, string&
   }
   result.clear();
 
+  /* the index is keyed by the namespace mangled names */
+  rgw_obj prefix_obj;
+  prefix_obj.init_ns(bucket, prefix, ns);
+  string raw_prefix = prefix_obj.object;
+  string cur_marker;
+  if (!marker.empty()) {
+    rgw_obj marker_obj;
+    marker_obj.init_ns(bucket, marker, ns);
+    cur_marker = marker_obj.object;
+  }
+
+  /*
+   * the index can collapse common prefixes for us, unless the filter
+   * needs to see every name under them.  mangling only adds to the front
+   * of the name, so the delimiter is found at the same place past the
+   * prefix either way.  the exception is listing the default namespace
+   * with no prefix: there a delimiter starting with '_' would match the
+   * '_' that escapes names (and starts other namespaces), so the gateway
+   * collapses those itself.
+   */
+  string index_delim;
+  if (!filter && !(raw_prefix.empty() && delim.size() && delim[0] == '_'))
+    index_delim = delim;
+
   do {
     std::map<string, RGWObjEnt> ent_map;
-    int r = cls_bucket_list(bucket, cur_marker, prefix, max - count, ent_map,
-                            &truncated, &cur_marker);
+    map<string, bool> raw_prefixes;
+    int r = cls_bucket_list(bucket, cur_marker, raw_prefix, index_delim, max - count, ent_map,
+                            &raw_prefixes, &truncated, &cur_marker);
     if (r < 0)
       return r;
 
+    map<string, bool>::iterator piter;
+    for (piter = raw_prefixes.begin(); piter != raw_prefixes.end(); ++piter) {
+      string common = piter->first;
+      if (!rgw_obj::translate_raw_obj_to_obj_in_ns(common, ns))
+        continue;
+      if (common_prefixes.find(common) == common_prefixes.end()) {
+        common_prefixes[common] = true;
+        count++;
+      }
+    }
+
     std::map<string, RGWObjEnt>::iterator eiter;
     for (eiter = ent_map.begin(); eiter != ent_map.end(); ++eiter) {
       string obj = eiter->first;
@@ -538,7 +602,13 @@ int RGWRados::list_objects(rgw_bucket& bucket, int max, string& prefix, string&
         int delim_pos = obj.find(delim, prefix.size());
 
         if (delim_pos >= 0) {
-          common_prefixes[obj.substr(0, delim_pos + 1)] = true;
+          string common = obj.substr(0, delim_pos + delim.size());
+          /* as in the index, a prefix the marker is in was returned already */
+          if (common_prefixes.find(common) == common_prefixes.end() &&
+              marker.compare(0, common.size(), common) != 0) {
+            common_prefixes[common] = true;
+            count++;
+          }
           continue;
         }
       }
@@ -618,18 +688,24 @@ int RGWRados::create_bucket(string& owner, rgw_bucket& bucket,
     bucket.marker = buf;
     bucket.bucket_id = bucket.marker;
 
-    string dir_oid =  dir_oid_prefix;
-    dir_oid.append(bucket.marker);
-
-    librados::ObjectWriteOperation op;
-    op.create(true);
-    r = cls_rgw_init_index(io_ctx, op, dir_oid);
-    if (r < 0 && r != -EEXIST)
-      return r;
+    uint32_t num_shards = 0;
+    if (cct->_conf->rgw_bucket_index_shards > 0)
+      num_shards = cct->_conf->rgw_bucket_index_shards;
+    for (uint32_t i = 0; i < max(num_shards, 1u); i++) {
+      string dir_oid;
+      get_bucket_index_oid(bucket, num_shards, i, dir_oid);
+
+      librados::ObjectWriteOperation op;
+      op.create(true);
+      r = cls_rgw_init_index(io_ctx, op, dir_oid);
+      if (r < 0 && r != -EEXIST)
+        return r;
+    }
 
     RGWBucketInfo info;
     info.bucket = bucket;
     info.owner = owner;
+    info.num_shards = num_shards;
     ret = store_bucket_info(info, &attrs, exclusive);
     if (ret == -EEXIST)
       return ret;
@@ -1027,6 +1103,38 @@ int RGWRados::aio_put_obj_data(void *ctx, rgw_obj& obj, bufferlist& bl,
   return 0;
 }
 
+int RGWRados::aio_clone_range(rgw_obj& dst_obj, rgw_obj& src_obj, off_t src_ofs,
+                              uint64_t len, void **handle, bufferlist *src_tag)
+{
+  rgw_bucket bucket;
+  std::string dst_oid, dst_key, src_oid, src_key;
+  get_obj_bucket_and_oid_key(dst_obj, bucket, dst_oid, dst_key);
+  get_obj_bucket_and_oid_key(src_obj, bucket, src_oid, src_key);
+  librados::IoCtx io_ctx;
+
+  int r = open_bucket_ctx(bucket, io_ctx);
+  if (r < 0)
+    return r;
+
+  io_ctx.locator_set_key(dst_key);
+
+  ObjectWriteOperation op;
+  op.create(true);
+  if (src_tag)
+    op.src_cmpxattr(src_oid, RGW_ATTR_ID_TAG, LIBRADOS_CMPXATTR_OP_EQ, *src_tag);
+  op.clone_range(0, src_oid, src_ofs, len);
+
+  AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+  r = io_ctx.aio_operate(dst_oid, c, &op);
+  if (r < 0) {
+    c->release();
+    return r;
+  }
+  *handle = c;
+
+  return 0;
+}
+
 int RGWRados::aio_wait(void *handle)
 {
   AioCompletion *c = (AioCompletion *)handle;
@@ -1041,6 +1149,120 @@ bool RGWRados::aio_completed(void *handle)
   AioCompletion *c = (AioCompletion *)handle;
   return c->is_complete();
 }
+/*
+ * Have the osds copy the data of src_obj for a copy into dest_obj, so that
+ * it doesn't go through the gateway.  clone_range only works within a
+ * placement group, so each part of the source is cloned into a new shadow
+ * object that shares that part's locator, and manifest is filled in with
+ * those.  The head of dest_obj is left for the caller to write.  Returns
+ * -EXDEV if the data isn't in dest_obj's pool, and -ECANCELED if the head
+ * of src_obj was overwritten since its state was read.
+ */
+int RGWRados::clone_obj_parts(void *ctx, rgw_obj& dest_obj, rgw_obj& src_obj,
+                              map<string, bufferlist>& src_attrs, uint64_t obj_size,
+                              RGWObjManifest& manifest)
+{
+  RGWObjManifest src_manifest;
+  map<string, bufferlist>::iterator iter = src_attrs.find(RGW_ATTR_MANIFEST);
+  if (iter != src_attrs.end() && iter->second.length()) {
+    bufferlist::iterator bli = iter->second.begin();
+    try {
+      ::decode(src_manifest, bli);
+    } catch (buffer::error& err) {
+      ldout(cct, 0) << "ERROR: couldn't decode manifest of " << src_obj << dendl;
+      return -EIO;
+    }
+  } else {
+    /* all of the data is in the head */
+    RGWObjManifestPart& part = src_manifest.objs[0];
+    part.loc = src_obj;
+    part.loc_ofs = 0;
+    part.size = obj_size;
+  }
+
+  /*
+   * the head is rewritten in place by an overwrite, so cloning from it is
+   * guarded by its tag, as reads of it are (see append_atomic_test()).
+   * the other parts are never rewritten.
+   */
+  bufferlist *head_tag = NULL;
+  RGWRadosCtx *rctx = (RGWRadosCtx *)ctx;
+  if (rctx) {
+    RGWObjState *state = rctx->get_state(src_obj);
+    if (state->is_atomic && state->obj_tag.length())
+      head_tag = &state->obj_tag;
+  }
+
+  string prefix;
+  append_rand_alpha(cct, dest_obj.object, prefix, 32);
+
+  int window = max(1, (int)cct->_conf->rgw_copy_obj_clone_aio);
+  list<void *> handles;
+  int r = 0;
+  int i = 0;
+  map<uint64_t, RGWObjManifestPart>::iterator miter;
+  for (miter = src_manifest.objs.begin(); miter != src_manifest.objs.end(); ++miter, ++i) {
+    RGWObjManifestPart& src_part = miter->second;
+    if (!src_part.size)
+      continue;
+    if (src_part.loc.bucket.pool.compare(dest_obj.bucket.pool) != 0) {
+      r = -EXDEV;
+      break;
+    }
+
+    char buf[16];
+    snprintf(buf, sizeof(buf), ".%d", i);
+    string oid = prefix;
+    oid.append(buf);
+    /* an empty key means the oid is the locator */
+    string key = (src_part.loc.key.empty() ? src_part.loc.object : src_part.loc.key);
+
+    RGWObjManifestPart& part = manifest.objs[miter->first];
+    part.loc.init_ns(src_part.loc.bucket, oid, shadow_ns);
+    part.loc.set_key(key);
+    part.loc_ofs = 0;
+    part.size = src_part.size;
+
+    ldout(cct, 20) << "cloning " << src_part.loc << " ofs=" << src_part.loc_ofs << " size=" << src_part.size
+                   << " to " << part.loc << dendl;
+    void *handle;
+    r = aio_clone_range(part.loc, src_part.loc, src_part.loc_ofs, src_part.size, &handle,
+                        (src_part.loc == src_obj ? head_tag : NULL));
+    if (r < 0) {
+      manifest.objs.erase(miter->first);
+      break;
+    }
+    handles.push_back(handle);
+    if ((int)handles.size() >= window) {
+      r = aio_wait(handles.front());
+      handles.pop_front();
+      if (r < 0)
+        break;
+    }
+  }
+  while (!handles.empty()) {
+    int ret = aio_wait(handles.front());
+    if (r >= 0 && ret < 0)
+      r = ret;
+    handles.pop_front();
+  }
+  if (r < 0) {
+    remove_manifest_parts(manifest);
+    manifest.objs.clear();
+    return r;
+  }
+
+  manifest.obj_size = obj_size;
+  return 0;
+}
+
+void RGWRados::remove_manifest_parts(RGWObjManifest& manifest)
+{
+  map<uint64_t, RGWObjManifestPart>::iterator iter;
+  for (iter = manifest.objs.begin(); iter != manifest.objs.end(); ++iter)
+    delete_obj(NULL, iter->second.loc, false);
+}
+
 /**
  * Copy an object.
  * dest_obj: the object to copy into
@@ -1085,6 +1307,50 @@ int RGWRados::copy_obj(void *ctx,
   if (ret < 0)
     return ret;
 
+  if (cct->_conf->rgw_copy_obj_clone && obj_size > 0 &&
+      src_obj.bucket.pool.compare(dest_obj.bucket.pool) == 0) {
+    RGWObjManifest clone_manifest;
+    ret = clone_obj_parts(ctx, dest_obj, src_obj, attrset, obj_size, clone_manifest);
+    if (ret >= 0) {
+      if (replace_attrs) {
+        attrset = attrs;
+      }
+      /* the data is all in the clones, the head only carries the metadata */
+      bufferlist empty;
+      ret = rgwstore->put_obj_meta(ctx, dest_obj, obj_size, NULL, attrset, category, false, NULL, &empty, &clone_manifest);
+      if (ret < 0) {
+        remove_manifest_parts(clone_manifest);
+      } else {
+        if (perfcounter)
+          perfcounter->inc(l_rgw_copy_clone);
+        if (mtime)
+          obj_stat(ctx, dest_obj, NULL, mtime, NULL, NULL);
+      }
+      finish_get_obj(&handle);
+      return ret;
+    }
+    if (ret == -ECANCELED) {
+      /* the source was overwritten while we cloned it; copy the new version */
+      ldout(cct, 5) << src_obj << " changed while cloning it, starting over" << dendl;
+      finish_get_obj(&handle);
+      RGWRadosCtx *rctx = (RGWRadosCtx *)ctx;
+      if (rctx) {
+        rctx->objs_state.erase(src_obj);
+        rctx->set_atomic(src_obj);
+      }
+      attrset.clear();
+      ofs = 0;
+      end = -1;
+      ret = prepare_get_obj(ctx, src_obj, &ofs, &end, &attrset,
+                    mod_ptr, unmod_ptr, &lastmod, if_match, if_nomatch, &total_len, &obj_size, &handle, err);
+      if (ret < 0)
+        return ret;
+    }
+    ldout(cct, 5) << "couldn't clone " << src_obj << " on the osds (r=" << ret << "), copying it through the gateway" << dendl;
+  }
+  if (perfcounter)
+    perfcounter->inc(l_rgw_copy_stream);
+
   bufferlist first_chunk;
   RGWObjManifest manifest;
   RGWObjManifestPart *first_part;
@@ -1155,7 +1421,8 @@ done_err:
 int RGWRados::delete_bucket(rgw_bucket& bucket)
 {
   librados::IoCtx list_ctx;
-  int r = open_bucket_ctx(bucket, list_ctx);
+  vector<string> index_oids;
+  int r = open_bucket_index(bucket, list_ctx, index_oids);
   if (r < 0)
     return r;
 
@@ -1186,15 +1453,15 @@ int RGWRados::delete_bucket(rgw_bucket& bucket)
   if (r < 0)
     return r;
 
-  ObjectWriteOperation op;
-  op.remove();
-  string oid = dir_oid_prefix;
-  oid.append(bucket.marker);
-  librados::AioCompletion *completion = rados->aio_create_completion(NULL, NULL, NULL);
-  r = list_ctx.aio_operate(oid, completion, &op);
-  completion->release();
-  if (r < 0)
-    return r;
+  for (vector<string>::iterator iter = index_oids.begin(); iter != index_oids.end(); ++iter) {
+    ObjectWriteOperation op;
+    op.remove();
+    librados::AioCompletion *completion = rados->aio_create_completion(NULL, NULL, NULL);
+    r = list_ctx.aio_operate(*iter, completion, &op);
+    completion->release();
+    if (r < 0)
+      return r;
+  }
 
   return 0;
 }
@@ -2164,6 +2431,94 @@ done_ret:
   return r;
 }
 
+int RGWRados::aio_get_obj(void *ctx, void **handle, rgw_obj& obj,
+                          bufferlist& bl, off_t ofs, off_t end, void **aio_handle)
+{
+  rgw_bucket bucket;
+  std::string oid, key;
+  rgw_obj read_obj = obj;
+  uint64_t read_ofs = ofs;
+  uint64_t len;
+  RGWRadosCtx *rctx = (RGWRadosCtx *)ctx;
+  RGWRadosCtx *new_ctx = NULL;
+  bool reading_from_head = true;
+  ObjectReadOperation op;
+  AioCompletion *c;
+
+  GetObjState *state = *(GetObjState **)handle;
+  RGWObjState *astate = NULL;
+
+  *aio_handle = NULL;
+
+  get_obj_bucket_and_oid_key(obj, bucket, oid, key);
+
+  if (!rctx) {
+    new_ctx = new RGWRadosCtx();
+    rctx = new_ctx;
+  }
+
+  int r = get_obj_state(rctx, obj, state->io_ctx, oid, &astate);
+  if (r < 0)
+    goto done_ret;
+
+  if (end < 0)
+    len = 0;
+  else
+    len = end - ofs + 1;
+
+  if (astate->has_manifest) {
+    map<uint64_t, RGWObjManifestPart>::iterator iter = astate->manifest.objs.upper_bound(ofs);
+    if (iter != astate->manifest.objs.begin()) {
+      --iter;
+    }
+
+    RGWObjManifestPart& part = iter->second;
+    uint64_t part_ofs = iter->first;
+    read_obj = part.loc;
+    len = min(len, part.size - (ofs - part_ofs));
+    read_ofs = part.loc_ofs + (ofs - part_ofs);
+    reading_from_head = (read_obj == obj);
+
+    if (!reading_from_head) {
+      get_obj_bucket_and_oid_key(read_obj, bucket, oid, key);
+    }
+  }
+
+  if (len > RGW_MAX_CHUNK_SIZE)
+    len = RGW_MAX_CHUNK_SIZE;
+
+  state->io_ctx.locator_set_key(key);
+
+  if (reading_from_head) {
+    r = append_atomic_test(rctx, read_obj, state->io_ctx, oid, op, &astate);
+    if (r < 0)
+      goto done_ret;
+  }
+
+  if (!ofs && astate && astate->data.length() >= len) {
+    bl.substr_of(astate->data, 0, len);
+    r = len;
+    goto done_ret;
+  }
+
+  ldout(cct, 20) << "rados->aio_read obj-ofs=" << ofs << " read_ofs=" << read_ofs << " read_len=" << len << dendl;
+  op.read(read_ofs, len, &bl, NULL);
+
+  c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+  r = state->io_ctx.aio_operate(oid, c, &op, NULL);
+  if (r < 0) {
+    c->release();
+    goto done_ret;
+  }
+  *aio_handle = c;
+  r = len;
+
+done_ret:
+  delete new_ctx;
+
+  return r;
+}
+
 void RGWRados::finish_get_obj(void **handle)
 {
   if (*handle) {
@@ -2328,6 +2683,59 @@ int RGWRados::omap_get_all(rgw_obj& obj, bufferlist& header, std::map<string, bu
  
 }
 
+/*
+ * all of the omap keys, and optionally the xattrs, in one round trip
+ */
+int RGWRados::omap_get_keys(rgw_obj& obj, std::set<string>& keys, map<string, bufferlist> *attrs)
+{
+  librados::IoCtx io_ctx;
+  rgw_bucket bucket;
+  std::string oid, key;
+  get_obj_bucket_and_oid_key(obj, bucket, oid, key);
+  int r = open_bucket_ctx(bucket, io_ctx);
+  if (r < 0)
+    return r;
+
+  io_ctx.locator_set_key(key);
+
+  ObjectReadOperation op;
+  if (attrs)
+    op.getxattrs(attrs, NULL);
+  op.omap_get_keys("", (uint64_t)-1, &keys, NULL);
+
+  return io_ctx.operate(oid, &op, NULL);
+}
+
+/*
+ * start reading the values of the given omap keys; wait for them with
+ * aio_wait(*handle).  keys that don't exist are just left out of m.
+ */
+int RGWRados::aio_omap_get_vals_by_keys(rgw_obj& obj, std::set<string>& keys,
+                                        std::map<string, bufferlist> *m, void **handle)
+{
+  librados::IoCtx io_ctx;
+  rgw_bucket bucket;
+  std::string oid, key;
+  get_obj_bucket_and_oid_key(obj, bucket, oid, key);
+  int r = open_bucket_ctx(bucket, io_ctx);
+  if (r < 0)
+    return r;
+
+  io_ctx.locator_set_key(key);
+
+  ObjectReadOperation op;
+  op.omap_get_vals_by_keys(keys, m, NULL);
+
+  AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+  r = io_ctx.aio_operate(oid, c, &op, NULL);
+  if (r < 0) {
+    c->release();
+    return r;
+  }
+  *handle = c;
+  return 0;
+}
+
 int RGWRados::omap_set(rgw_obj& obj, std::string& key, bufferlist& bl)
 {
   rgw_bucket bucket;
@@ -2435,6 +2843,30 @@ int RGWRados::append_async(rgw_obj& obj, size_t size, bufferlist& bl)
   return r;
 }
 
+static void append_async_cb(librados::completion_t cb, void *arg)
+{
+  Context *oncomplete = (Context *)arg;
+  oncomplete->complete(rados_aio_get_return_value(cb));
+}
+
+int RGWRados::append_async(rgw_obj& obj, size_t size, bufferlist& bl, Context *oncomplete)
+{
+  rgw_bucket bucket;
+  std::string oid, key;
+  get_obj_bucket_and_oid_key(obj, bucket, oid, key);
+  librados::IoCtx io_ctx;
+  int r = open_bucket_ctx(bucket, io_ctx);
+  if (r < 0)
+    return r;
+  librados::AioCompletion *completion = rados->aio_create_completion(oncomplete, append_async_cb, NULL);
+
+  io_ctx.locator_set_key(key);
+
+  r = io_ctx.aio_append(oid, completion, bl, size);
+  completion->release();
+  return r;
+}
+
 int RGWRados::distribute(bufferlist& bl)
 {
   ldout(cct, 10) << "distributing notification oid=" << notify_oid << " bl.length()=" << bl.length() << dendl;
@@ -2507,13 +2939,11 @@ int RGWRados::cls_obj_prepare_op(rgw_bucket& bucket, uint8_t op, string& tag,
   }
 
   librados::IoCtx io_ctx;
-  int r = open_bucket_ctx(bucket, io_ctx);
+  string oid;
+  int r = open_bucket_index_shard(bucket, name, io_ctx, oid);
   if (r < 0)
     return r;
 
-  string oid = dir_oid_prefix;
-  oid.append(bucket.marker);
-
   bufferlist in, out;
   struct rgw_cls_obj_prepare_op call;
   call.op = op;
@@ -2536,13 +2966,11 @@ int RGWRados::cls_obj_complete_op(rgw_bucket& bucket, uint8_t op, string& tag, u
   }
 
   librados::IoCtx io_ctx;
-  int r = open_bucket_ctx(bucket, io_ctx);
+  string oid;
+  int r = open_bucket_index_shard(bucket, ent.name, io_ctx, oid);
   if (r < 0)
     return r;
 
-  string oid = dir_oid_prefix;
-  oid.append(bucket.marker);
-
   bufferlist in;
   struct rgw_cls_obj_complete_op call;
   call.op = op;
@@ -2582,53 +3010,195 @@ int RGWRados::cls_obj_complete_cancel(rgw_bucket& bucket, string& tag, string& n
   return cls_obj_complete_op(bucket, CLS_RGW_OP_ADD, tag, 0, ent, RGW_OBJ_CATEGORY_NONE);
 }
 
-int RGWRados::cls_bucket_list(rgw_bucket& bucket, string start, string prefix,
-		              uint32_t num, map<string, RGWObjEnt>& m,
-			      bool *is_truncated, string *last_entry)
+int RGWRados::open_bucket_index(rgw_bucket& bucket, librados::IoCtx& io_ctx,
+                                vector<string>& oids)
 {
-  ldout(cct, 10) << "cls_bucket_list " << bucket << " start " << start << " num " << num << dendl;
+  if (bucket.marker.empty()) {
+    ldout(cct, 0) << "ERROR: empty marker for cls_rgw bucket operation" << dendl;
+    return -EIO;
+  }
 
-  librados::IoCtx io_ctx;
-  int r = open_bucket_ctx(bucket, io_ctx);
+  uint32_t num_shards;
+  int r = get_bucket_index_shards(bucket, &num_shards);
+  if (r < 0)
+    return r;
+
+  r = open_bucket_ctx(bucket, io_ctx);
   if (r < 0)
     return r;
 
+  oids.resize(max(num_shards, 1u));
+  for (uint32_t i = 0; i < oids.size(); i++)
+    get_bucket_index_oid(bucket, num_shards, i, oids[i]);
+  return 0;
+}
+
+int RGWRados::open_bucket_index_shard(rgw_bucket& bucket, const string& name,
+                                      librados::IoCtx& io_ctx, string& oid)
+{
   if (bucket.marker.empty()) {
     ldout(cct, 0) << "ERROR: empty marker for cls_rgw bucket operation" << dendl;
     return -EIO;
   }
 
-  string oid = dir_oid_prefix;
-  oid.append(bucket.marker);
+  uint32_t num_shards;
+  int r = get_bucket_index_shards(bucket, &num_shards);
+  if (r < 0)
+    return r;
 
-  bufferlist in, out;
+  r = open_bucket_ctx(bucket, io_ctx);
+  if (r < 0)
+    return r;
+
+  get_bucket_index_oid(bucket, num_shards, get_bucket_index_shard(name, num_shards), oid);
+  return 0;
+}
+
+/*
+ * the shard count lives in the bucket info, which is cached.  an
+ * instance that doesn't match (the bucket was removed and recreated
+ * under us) is treated as unsharded.
+ */
+int RGWRados::get_bucket_index_shards(rgw_bucket& bucket, uint32_t *num_shards)
+{
+  *num_shards = 0;
+  if (bucket_is_system(bucket))
+    return 0;
+
+  RGWBucketInfo info;
+  int r = get_bucket_info(NULL, bucket.name, info);
+  if (r < 0)
+    return r;
+  if (info.bucket.marker == bucket.marker)
+    *num_shards = info.num_shards;
+  return 0;
+}
+
+/*
+ * send the same cls_rgw call to every index shard in parallel.
+ */
+int RGWRados::cls_bucket_index_exec(librados::IoCtx& io_ctx, vector<string>& oids, const char *method,
+                                    bufferlist& in, vector<bufferlist>& out)
+{
+  vector<AioCompletion *> c(oids.size());
+  out.resize(oids.size());
+  int ret = 0;
+  for (size_t i = 0; i < oids.size(); i++) {
+    c[i] = librados::Rados::aio_create_completion(NULL, NULL, NULL);
+    int r = io_ctx.aio_exec(oids[i], c[i], "rgw", method, in, &out[i]);
+    if (r < 0) {
+      c[i]->release();
+      c[i] = NULL;
+      ret = r;
+    }
+  }
+  for (size_t i = 0; i < oids.size(); i++) {
+    if (!c[i])
+      continue;
+    c[i]->wait_for_complete();
+    int r = c[i]->get_return_value();
+    c[i]->release();
+    if (r < 0 && ret == 0)
+      ret = r;
+  }
+  return ret;
+}
+
+/*
+ * with a delimiter the index collapses the entries that share a prefix up
+ * to it (after prefix) and returns just the prefix, in common_prefixes.
+ * each of those counts as one of the num entries.
+ */
+int RGWRados::cls_bucket_list(rgw_bucket& bucket, string start, string prefix, string delim,
+		              uint32_t num, map<string, RGWObjEnt>& m,
+			      map<string, bool> *common_prefixes,
+			      bool *is_truncated, string *last_entry)
+{
+  ldout(cct, 10) << "cls_bucket_list " << bucket << " start " << start << " prefix " << prefix
+                 << " delim " << delim << " num " << num << dendl;
+
+  librados::IoCtx io_ctx;
+  vector<string> oids;
+  int r = open_bucket_index(bucket, io_ctx, oids);
+  if (r < 0)
+    return r;
+
+  bufferlist in;
+  vector<bufferlist> out;
   struct rgw_cls_list_op call;
   call.start_obj = start;
   call.filter_prefix = prefix;
+  call.delimiter = delim;
   call.num_entries = num;
   ::encode(call, in);
-  r = io_ctx.exec(oid, "rgw", "bucket_list", in, out);
+  r = cls_bucket_index_exec(io_ctx, oids, "bucket_list", in, out);
   if (r < 0)
     return r;
 
-  struct rgw_cls_list_ret ret;
-  try {
-    bufferlist::iterator iter = out.begin();
-    ::decode(ret, iter);
-  } catch (buffer::error& err) {
-    ldout(cct, 0) << "ERROR: failed to decode bucket_list returned buffer" << dendl;
-    return -EIO;
+  vector<struct rgw_cls_list_ret> rets(oids.size());
+  for (size_t i = 0; i < oids.size(); i++) {
+    try {
+      bufferlist::iterator iter = out[i].begin();
+      ::decode(rets[i], iter);
+    } catch (buffer::error& err) {
+      ldout(cct, 0) << "ERROR: failed to decode bucket_list returned buffer" << dendl;
+      return -EIO;
+    }
   }
 
-  if (is_truncated != NULL)
-    *is_truncated = ret.is_truncated;
+  /*
+   * every shard returned its first num entries after start; the first
+   * num of the merged listing are among them.  we're truncated if any
+   * shard was, or if we leave some of what they returned for next time.
+   */
+  typedef map<string, struct rgw_bucket_dir_entry>::iterator dir_iter;
+  vector<dir_iter> pos(oids.size());
+  vector<list<string>::iterator> prefix_pos(oids.size());
+  bool truncated = false;
+  for (size_t i = 0; i < oids.size(); i++) {
+    pos[i] = rets[i].dir.m.begin();
+    prefix_pos[i] = rets[i].common_prefixes.begin();
+    if (rets[i].is_truncated)
+      truncated = true;
+  }
+
+  vector<bufferlist> updates(oids.size());
+  string last;
+  uint32_t count = 0;
+  while (count < num) {
+    int shard = -1;
+    const string *next = NULL;
+    bool is_prefix = false;
+    for (size_t i = 0; i < oids.size(); i++) {
+      if (pos[i] != rets[i].dir.m.end() && (!next || pos[i]->first < *next)) {
+        shard = i;
+        next = &pos[i]->first;
+        is_prefix = false;
+      }
+      if (prefix_pos[i] != rets[i].common_prefixes.end() && (!next || *prefix_pos[i] < *next)) {
+        shard = i;
+        next = &*prefix_pos[i];
+        is_prefix = true;
+      }
+    }
+    if (shard < 0)
+      break;
+    last = *next;
+
+    if (is_prefix) {
+      ++prefix_pos[shard];
+      /* other shards may have collapsed the same prefix */
+      if (common_prefixes && common_prefixes->find(last) == common_prefixes->end()) {
+        (*common_prefixes)[last] = true;
+        count++;
+      }
+      continue;
+    }
+    count++;
+    rgw_bucket_dir_entry& dirent = pos[shard]->second;
+    ++pos[shard];
 
-  struct rgw_bucket_dir& dir = ret.dir;
-  map<string, struct rgw_bucket_dir_entry>::iterator miter;
-  bufferlist updates;
-  for (miter = dir.m.begin(); miter != dir.m.end(); ++miter) {
     RGWObjEnt e;
-    rgw_bucket_dir_entry& dirent = miter->second;
 
     // fill it in with initial values; we may correct later
     e.name = dirent.name;
@@ -2650,7 +3220,7 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, string start, string prefix,
        * and if the tags are old we need to do cleanup as well. */
       librados::IoCtx sub_ctx;
       sub_ctx.dup(io_ctx);
-      r = check_disk_state(sub_ctx, bucket, dirent, e, updates);
+      r = check_disk_state(sub_ctx, bucket, dirent, e, updates[shard]);
       if (r < 0) {
         if (r == -ENOENT)
           continue;
@@ -2661,15 +3231,21 @@ int RGWRados::cls_bucket_list(rgw_bucket& bucket, string start, string prefix,
     m[e.name] = e;
     ldout(cct, 10) << "RGWRados::cls_bucket_list: got " << e.name << dendl;
   }
+  for (size_t i = 0; i < oids.size(); i++)
+    if (pos[i] != rets[i].dir.m.end() || prefix_pos[i] != rets[i].common_prefixes.end())
+      truncated = true;
 
-  if (dir.m.size()) {
-    *last_entry = dir.m.rbegin()->first;
-  }
+  if (is_truncated != NULL)
+    *is_truncated = truncated;
+  if (last_entry && !last.empty())
+    *last_entry = last;
 
-  if (updates.length()) {
+  for (size_t i = 0; i < oids.size(); i++) {
+    if (!updates[i].length())
+      continue;
     // we don't care if we lose suggested updates, send them off blindly
     AioCompletion *c = librados::Rados::aio_create_completion(NULL, NULL, NULL);
-    r = io_ctx.aio_exec(oid, c, "rgw", "dir_suggest_changes", updates, NULL);
+    r = io_ctx.aio_exec(oids[i], c, "rgw", "dir_suggest_changes", updates[i], NULL);
     c->release();
   }
   return m.size();
@@ -2802,37 +3378,146 @@ int RGWRados::check_disk_state(librados::IoCtx io_ctx,
 int RGWRados::cls_bucket_head(rgw_bucket& bucket, struct rgw_bucket_dir_header& header)
 {
   librados::IoCtx io_ctx;
-  int r = open_bucket_ctx(bucket, io_ctx);
+  vector<string> oids;
+  int r = open_bucket_index(bucket, io_ctx, oids);
   if (r < 0)
     return r;
 
-  if (bucket.marker.empty()) {
-    ldout(cct, 0) << "ERROR: empty marker for cls_rgw bucket operation" << dendl;
-    return -EIO;
-  }
-
-  string oid = dir_oid_prefix;
-  oid.append(bucket.marker);
-
-  bufferlist in, out;
+  bufferlist in;
+  vector<bufferlist> out;
   struct rgw_cls_list_op call;
   call.num_entries = 0;
   ::encode(call, in);
-  r = io_ctx.exec(oid, "rgw", "bucket_list", in, out);
+  r = cls_bucket_index_exec(io_ctx, oids, "bucket_list", in, out);
   if (r < 0)
     return r;
 
-  struct rgw_cls_list_ret ret;
-  try {
-    bufferlist::iterator iter = out.begin();
-    ::decode(ret, iter);
-  } catch (buffer::error& err) {
-    ldout(cct, 0) << "ERROR: failed to decode bucket_list returned buffer" << dendl;
-    return -EIO;
+  // sum up the shards
+  header.stats.clear();
+  for (size_t i = 0; i < oids.size(); i++) {
+    struct rgw_cls_list_ret ret;
+    try {
+      bufferlist::iterator iter = out[i].begin();
+      ::decode(ret, iter);
+    } catch (buffer::error& err) {
+      ldout(cct, 0) << "ERROR: failed to decode bucket_list returned buffer" << dendl;
+      return -EIO;
+    }
+
+    map<uint8_t, struct rgw_bucket_category_stats>::iterator iter;
+    for (iter = ret.dir.header.stats.begin(); iter != ret.dir.header.stats.end(); ++iter) {
+      struct rgw_bucket_category_stats& s = header.stats[iter->first];
+      s.total_size += iter->second.total_size;
+      s.total_size_rounded += iter->second.total_size_rounded;
+      s.num_entries += iter->second.num_entries;
+    }
   }
 
-  header = ret.dir.header;
+  return 0;
+}
+
+/*
+ * rebuild the index of bucket with num_shards shards (0 for a single
+ * unsharded index object).  the bucket must be suspended: ops that
+ * are in flight against the old index when we switch are lost from
+ * the listing.
+ */
+int RGWRados::reshard_bucket_index(rgw_bucket& bucket, uint32_t num_shards)
+{
+  RGWBucketInfo info;
+  map<string, bufferlist> attrs;
+  int r = get_bucket_info(NULL, bucket.name, info, &attrs);
+  if (r < 0)
+    return r;
+  if (info.bucket.marker != bucket.marker || bucket.marker.empty())
+    return -ENOENT;
+  if (!(info.flags & BUCKET_SUSPENDED))
+    return -EBUSY;
+  if (info.num_shards == num_shards)
+    return 0;
 
+  librados::IoCtx io_ctx;
+  vector<string> old_oids;
+  r = open_bucket_index(bucket, io_ctx, old_oids);
+  if (r < 0)
+    return r;
+
+  vector<string> new_oids(max(num_shards, 1u));
+  for (uint32_t i = 0; i < new_oids.size(); i++) {
+    get_bucket_index_oid(bucket, num_shards, i, new_oids[i]);
+    io_ctx.remove(new_oids[i]);  // leftovers from an interrupted reshard
+
+    librados::ObjectWriteOperation op;
+    op.create(true);
+    r = cls_rgw_init_index(io_ctx, op, new_oids[i]);
+    if (r < 0)
+      return r;
+  }
+
+  // copy every committed entry.  dir_suggest_changes on an entry the
+  // new index doesn't have yet adds it and accounts for it.
+  ldout(cct, 1) << "resharding index of " << bucket << " from " << info.num_shards
+                << " to " << num_shards << " shards" << dendl;
+  uint64_t count = 0;
+  for (vector<string>::iterator oiter = old_oids.begin(); oiter != old_oids.end(); ++oiter) {
+    string marker;
+    bool truncated;
+    do {
+      bufferlist in, out;
+      struct rgw_cls_list_op call;
+      call.start_obj = marker;
+      call.num_entries = 1000;
+      ::encode(call, in);
+      r = io_ctx.exec(*oiter, "rgw", "bucket_list", in, out);
+      if (r < 0)
+        return r;
+
+      struct rgw_cls_list_ret ret;
+      try {
+        bufferlist::iterator iter = out.begin();
+        ::decode(ret, iter);
+      } catch (buffer::error& err) {
+        ldout(cct, 0) << "ERROR: failed to decode bucket_list returned buffer" << dendl;
+        return -EIO;
+      }
+      truncated = ret.is_truncated;
+
+      vector<bufferlist> updates(new_oids.size());
+      map<string, struct rgw_bucket_dir_entry>::iterator iter;
+      for (iter = ret.dir.m.begin(); iter != ret.dir.m.end(); ++iter) {
+        marker = iter->first;
+        rgw_bucket_dir_entry& entry = iter->second;
+        if (!entry.exists)
+          continue;
+        entry.pending_map.clear();
+        uint32_t shard = get_bucket_index_shard(iter->first, num_shards);
+        __u8 op = CEPH_RGW_UPDATE;
+        ::encode(op, updates[shard]);
+        ::encode(entry, updates[shard]);
+        count++;
+      }
+      for (uint32_t i = 0; i < new_oids.size(); i++) {
+        if (!updates[i].length())
+          continue;
+        bufferlist out;
+        r = io_ctx.exec(new_oids[i], "rgw", "dir_suggest_changes", updates[i], out);
+        if (r < 0)
+          return r;
+      }
+    } while (truncated);
+  }
+
+  info.num_shards = num_shards;
+  r = store_bucket_info(info, &attrs, false);
+  if (r < 0)
+    return r;
+  ldout(cct, 1) << "resharded index of " << bucket << ", " << count << " entries" << dendl;
+
+  for (vector<string>::iterator oiter = old_oids.begin(); oiter != old_oids.end(); ++oiter) {
+    r = io_ctx.remove(*oiter);
+    if (r < 0 && r != -ENOENT)
+      ldout(cct, 0) << "WARNING: failed to remove old index object " << *oiter << " r=" << r << dendl;
+  }
   return 0;
 }
 
@@ -2990,19 +3675,20 @@ int RGWRados::process_intent_log(rgw_bucket& bucket, string& oid,
         break;
       } else {
         librados::IoCtx io_ctx;
-        int r = open_bucket_ctx(entry.obj.bucket, io_ctx);
+        vector<string> oids;
+        int r = open_bucket_index(entry.obj.bucket, io_ctx, oids);
         if (r < 0)
           return r;
-        ObjectWriteOperation op;
-        op.remove();
-        string oid = dir_oid_prefix;
-        oid.append(entry.obj.bucket.marker);
-        librados::AioCompletion *completion = rados->aio_create_completion(NULL, NULL, NULL);
-        r = io_ctx.aio_operate(oid, completion, &op);
-        completion->release();
-        if (r < 0 && r != -ENOENT) {
-          cerr << "failed to remove pool: " << entry.obj.bucket.pool << std::endl;
-          complete = false;
+        for (vector<string>::iterator oiter = oids.begin(); oiter != oids.end(); ++oiter) {
+          ObjectWriteOperation op;
+          op.remove();
+          librados::AioCompletion *completion = rados->aio_create_completion(NULL, NULL, NULL);
+          r = io_ctx.aio_operate(*oiter, completion, &op);
+          completion->release();
+          if (r < 0 && r != -ENOENT) {
+            cerr << "failed to remove pool: " << entry.obj.bucket.pool << std::endl;
+            complete = false;
+          }
         }
       }
       break;
@@ -269,6 +269,10 @@ class RGWRados
     v.push_back(info);
     return clone_objs(ctx, dst_obj, v, attrs, category, pmtime, true, false);
   }
+  int clone_obj_parts(void *ctx, rgw_obj& dest_obj, rgw_obj& src_obj,
+                      map<string, bufferlist>& src_attrs, uint64_t obj_size,
+                      RGWObjManifest& manifest);
+  void remove_manifest_parts(RGWObjManifest& manifest);
   int delete_obj_impl(void *ctx, rgw_obj& src_obj, bool sync);
   int complete_atomic_overwrite(RGWRadosCtx *rctx, RGWObjState *state, rgw_obj& obj);
 
@@ -364,6 +368,10 @@ public:
               off_t ofs, size_t len, bool exclusive);
   virtual int aio_put_obj_data(void *ctx, rgw_obj& obj, bufferlist& bl,
                                off_t ofs, bool exclusive, void **handle);
+  /* have the osds copy a range of src_obj into a new dst_obj; both must have the same locator.
+   * with src_tag, the clone fails with -ECANCELED unless src_obj still has that tag. */
+  virtual int aio_clone_range(rgw_obj& dst_obj, rgw_obj& src_obj, off_t src_ofs,
+                              uint64_t len, void **handle, bufferlist *src_tag = NULL);
   /* note that put_obj doesn't set category on an object, only use it for none user objects */
   int put_obj(void *ctx, rgw_obj& obj, const char *data, size_t len, bool exclusive,
               time_t *mtime, map<std::string, bufferlist>& attrs) {
@@ -502,6 +510,18 @@ public:
   virtual int get_obj(void *ctx, void **handle, rgw_obj& obj,
                       bufferlist& bl, off_t ofs, off_t end);
 
+  /**
+   * start reading the next chunk of obj at ofs, like get_obj(), but
+   * don't wait for it.  returns the number of bytes the read covers;
+   * *aio_handle is then either NULL (bl is already filled in) or to be
+   * passed to aio_wait() before bl is used.  the handle from
+   * prepare_get_obj() stays valid until finish_get_obj().  if the head
+   * object was replaced under us, aio_wait() returns -ECANCELED and
+   * the caller should fall back to get_obj().
+   */
+  virtual int aio_get_obj(void *ctx, void **handle, rgw_obj& obj,
+                          bufferlist& bl, off_t ofs, off_t end, void **aio_handle);
+
   virtual void finish_get_obj(void **handle);
 
  /**
@@ -513,11 +533,19 @@ public:
 
   virtual bool supports_omap() { return true; }
   virtual int omap_get_all(rgw_obj& obj, bufferlist& header, std::map<string, bufferlist>& m);
+  virtual int omap_get_keys(rgw_obj& obj, std::set<string>& keys, map<string, bufferlist> *attrs);
+  virtual int aio_omap_get_vals_by_keys(rgw_obj& obj, std::set<string>& keys,
+                                        std::map<string, bufferlist> *m, void **handle);
   virtual int omap_set(rgw_obj& obj, std::string& key, bufferlist& bl);
   virtual int omap_set(rgw_obj& obj, map<std::string, bufferlist>& m);
   virtual int omap_del(rgw_obj& obj, std::string& key);
   virtual int update_containers_stats(map<string, RGWBucketEnt>& m);
   virtual int append_async(rgw_obj& obj, size_t size, bufferlist& bl);
+  /*
+   * as above, and complete oncomplete with the result once the append is
+   * done.  if this returns an error, oncomplete is left to the caller.
+   */
+  virtual int append_async(rgw_obj& obj, size_t size, bufferlist& bl, Context *oncomplete);
 
   virtual int init_watch();
   virtual void finalize_watch();
@@ -560,10 +588,17 @@ public:
   int cls_obj_complete_add(rgw_bucket& bucket, string& tag, uint64_t epoch, RGWObjEnt& ent, RGWObjCategory category);
   int cls_obj_complete_del(rgw_bucket& bucket, string& tag, uint64_t epoch, string& name);
   int cls_obj_complete_cancel(rgw_bucket& bucket, string& tag, string& name);
+  int cls_bucket_list(rgw_bucket& bucket, string start, string prefix, string delim,
+                      uint32_t num, map<string, RGWObjEnt>& m,
+                      map<string, bool> *common_prefixes, bool *is_truncated,
+                      string *last_entry = NULL);
   int cls_bucket_list(rgw_bucket& bucket, string start, string prefix, uint32_t num,
                       map<string, RGWObjEnt>& m, bool *is_truncated,
-                      string *last_entry = NULL);
+                      string *last_entry = NULL) {
+    return cls_bucket_list(bucket, start, prefix, string(), num, m, NULL, is_truncated, last_entry);
+  }
   int cls_bucket_head(rgw_bucket& bucket, struct rgw_bucket_dir_header& header);
+  int reshard_bucket_index(rgw_bucket& bucket, uint32_t num_shards);
   int prepare_update_index(RGWObjState *state, rgw_bucket& bucket,
                            rgw_obj& oid, string& tag);
   int complete_update_index(rgw_bucket& bucket, string& oid, string& tag, uint64_t epoch, uint64_t size,
@@ -586,6 +621,12 @@ public:
  private:
   int process_intent_log(rgw_bucket& bucket, string& oid,
 			 time_t epoch, int flags, bool purge);
+  int get_bucket_index_shards(rgw_bucket& bucket, uint32_t *num_shards);
+  int open_bucket_index(rgw_bucket& bucket, librados::IoCtx& io_ctx, vector<string>& oids);
+  int open_bucket_index_shard(rgw_bucket& bucket, const string& name,
+                              librados::IoCtx& io_ctx, string& oid);
+  int cls_bucket_index_exec(librados::IoCtx& io_ctx, vector<string>& oids, const char *method,
+                            bufferlist& in, vector<bufferlist>& out);
   /**
    * Check the actual on-disk state of the object specified
    * by list_state, and fill in the time and size of object.
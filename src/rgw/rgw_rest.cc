@@ -13,11 +13,7 @@
 
 #include "rgw_formats.h"
 
-#ifdef FASTCGI_INCLUDE_DIR
-# include "fastcgi/fcgiapp.h"
-#else
-# include "fcgiapp.h"
-#endif
+#include "rgw_client_io.h"
 
 #define dout_subsys ceph_subsys_rgw
 
@@ -249,8 +245,7 @@ void abort_early(struct req_state *s, int err_no)
 
 void dump_continue(struct req_state *s)
 {
-  dump_status(s, "100");
-  FCGX_FFlush(s->fcgx->out);
+  s->cio->send_100_continue();
 }
 
 void dump_range(struct req_state *s, off_t ofs, off_t end, size_t total)
@@ -631,7 +626,7 @@ static int init_auth_info(struct req_state *s)
 
   s->x_meta_map.clear();
 
-  for (int i=0; (p = s->fcgx->envp[i]); ++i) {
+  for (int i=0; (p = s->cio->envp()[i]); ++i) {
     const char *prefix;
     for (int prefix_num = 0; (prefix = meta_prefixes[prefix_num].str) != NULL; prefix_num++) {
       int len = meta_prefixes[prefix_num].len;
@@ -779,11 +774,11 @@ static int validate_object_name(const char *object)
   return 0;
 }
 
-int RGWHandler_REST::preprocess(struct req_state *s, FCGX_Request *fcgx)
+int RGWHandler_REST::preprocess(struct req_state *s, RGWClientIO *cio)
 {
   int ret = 0;
 
-  s->fcgx = fcgx;
+  s->cio = cio;
   s->request_uri = s->env->get("REQUEST_URI");
   int pos = s->request_uri.find('?');
   if (pos >= 0) {
@@ -932,12 +927,12 @@ RGWRESTMgr::~RGWRESTMgr()
   delete m_s3_handler;
 }
 
-RGWHandler *RGWRESTMgr::get_handler(struct req_state *s, FCGX_Request *fcgx,
+RGWHandler *RGWRESTMgr::get_handler(struct req_state *s, RGWClientIO *cio,
 				    int *init_error)
 {
   RGWHandler *handler;
 
-  *init_error = RGWHandler_REST::preprocess(s, fcgx);
+  *init_error = RGWHandler_REST::preprocess(s, cio);
 
   if (s->prot_flags & RGW_REST_SWIFT)
     handler = m_os_handler;
@@ -946,7 +941,7 @@ RGWHandler *RGWRESTMgr::get_handler(struct req_state *s, FCGX_Request *fcgx,
   else
     handler = m_s3_handler;
 
-  handler->init(s, fcgx);
+  handler->init(s, cio);
 
   return handler;
 }
@@ -158,7 +158,7 @@ public:
   RGWOp *get_op();
   void put_op(RGWOp *op);
 
-  static int preprocess(struct req_state *s, FCGX_Request *fcgx);
+  static int preprocess(struct req_state *s, RGWClientIO *cio);
   virtual int authorize() = 0;
 };
 
@@ -174,7 +174,7 @@ class RGWRESTMgr {
 public:
   RGWRESTMgr();
   ~RGWRESTMgr();
-  RGWHandler *get_handler(struct req_state *s, FCGX_Request *fcgx,
+  RGWHandler *get_handler(struct req_state *s, RGWClientIO *cio,
 			  int *init_error);
 };
 
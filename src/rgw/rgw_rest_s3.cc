@@ -7,14 +7,11 @@
 #include "rgw_rest.h"
 #include "rgw_rest_s3.h"
 #include "rgw_acl.h"
+#include "rgw_auth_cache.h"
 
 #include "common/armor.h"
 
-#ifdef FASTCGI_INCLUDE_DIR
-# include "fastcgi/fcgiapp.h"
-#else
-# include "fcgiapp.h"
-#endif
+#include "rgw_client_io.h"
 
 #define dout_subsys ceph_subsys_rgw
 
@@ -635,7 +632,7 @@ RGWOp *RGWHandler_REST_S3::get_post_op()
   return NULL;
 }
 
-int RGWHandler_REST_S3::init(struct req_state *state, FCGX_Request *fcgx)
+int RGWHandler_REST_S3::init(struct req_state *state, RGWClientIO *cio)
 {
   const char *cacl = state->env->get("HTTP_X_AMZ_ACL");
   if (cacl)
@@ -645,7 +642,7 @@ int RGWHandler_REST_S3::init(struct req_state *state, FCGX_Request *fcgx)
 
   state->dialect = "s3";
 
-  return RGWHandler_REST::init(state, fcgx);
+  return RGWHandler_REST::init(state, cio);
 }
 
 /*
@@ -810,7 +807,12 @@ int RGWHandler_REST_S3::authorize()
   }
 
   /* first get the user info */
-  if (rgw_get_user_info_by_access_key(auth_id, s->user) < 0) {
+  int r;
+  if (rgw_auth_cache)
+    r = rgw_auth_cache->get_user_by_access_key(auth_id, s->user);
+  else
+    r = rgw_get_user_info_by_access_key(auth_id, s->user);
+  if (r < 0) {
     dout(5) << "error reading user info, uid=" << auth_id << " can't authenticate" << dendl;
     return -EPERM;
   }
@@ -853,7 +855,10 @@ int RGWHandler_REST_S3::authorize()
     s->perm_mask = RGW_PERM_FULL_CONTROL;
 
   char hmac_sha1[CEPH_CRYPTO_HMACSHA1_DIGESTSIZE];
-  calc_hmac_sha1(key, key_len, auth_hdr.c_str(), auth_hdr.size(), hmac_sha1);
+  if (rgw_auth_cache)
+    rgw_auth_cache->calc_hmac_sha1(auth_id, k.key, auth_hdr.c_str(), auth_hdr.size(), hmac_sha1);
+  else
+    calc_hmac_sha1(key, key_len, auth_hdr.c_str(), auth_hdr.size(), hmac_sha1);
 
   char b64[64]; /* 64 is really enough */
   int ret = ceph_armor(b64, b64 + 64, hmac_sha1,
@@ -4,11 +4,7 @@
 #include "rgw_rest_swift.h"
 #include "rgw_acl_swift.h"
 
-#ifdef FASTCGI_INCLUDE_DIR
-# include "fastcgi/fcgiapp.h"
-#else
-# include "fcgiapp.h"
-#endif
+#include "rgw_client_io.h"
 
 #include <sstream>
 
@@ -571,11 +567,11 @@ int RGWHandler_REST_SWIFT::authorize()
   return 0;
 }
 
-int RGWHandler_REST_SWIFT::init(struct req_state *state, FCGX_Request *fcgx)
+int RGWHandler_REST_SWIFT::init(struct req_state *state, RGWClientIO *cio)
 {
   state->copy_source = state->env->get("HTTP_X_COPY_FROM");
 
   state->dialect = "swift";
 
-  return RGWHandler_REST::init(state, fcgx);
+  return RGWHandler_REST::init(state, cio);
 }
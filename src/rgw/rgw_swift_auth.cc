@@ -6,11 +6,8 @@
 
 #include "auth/Crypto.h"
 
-#ifdef FASTCGI_INCLUDE_DIR
-# include "fastcgi/fcgiapp.h"
-#else
-# include "fcgiapp.h"
-#endif
+#include "rgw_client_io.h"
+#include "rgw_auth_cache.h"
 
 #define dout_subsys ceph_subsys_rgw
 
@@ -67,6 +64,10 @@ int rgw_swift_verify_signed_token(CephContext *cct, const char *token, RGWUserIn
   if (strncmp(token, "AUTH_rgwtk", 10) != 0)
     return -EINVAL;
 
+  if (rgw_auth_cache && rgw_auth_cache->get_token(token, info))
+    return 0;
+  const char *full_token = token;
+
   token += 10;
 
   int len = strlen(token);
@@ -103,7 +104,14 @@ int rgw_swift_verify_signed_token(CephContext *cct, const char *token, RGWUserIn
     return -EPERM;
   }
 
-  if ((ret = rgw_get_user_info_by_swift(swift_user, info)) < 0)
+  int gen = 0;
+  if (rgw_auth_cache) {
+    gen = rgw_auth_cache->get_generation();
+    ret = rgw_auth_cache->get_user_by_swift(swift_user, info);
+  } else {
+    ret = rgw_get_user_info_by_swift(swift_user, info);
+  }
+  if (ret < 0)
     return ret;
 
   dout(10) << "swift_user=" << swift_user << dendl;
@@ -130,6 +138,9 @@ int rgw_swift_verify_signed_token(CephContext *cct, const char *token, RGWUserIn
     return -EPERM;
   }
 
+  if (rgw_auth_cache)
+    rgw_auth_cache->put_token(full_token, expiration, info, gen);
+
   return 0;
 }
 
@@ -224,11 +235,11 @@ done:
   end_header(s);
 }
 
-int RGWHandler_SWIFT_Auth::init(struct req_state *state, FCGX_Request *fcgx)
+int RGWHandler_SWIFT_Auth::init(struct req_state *state, RGWClientIO *cio)
 {
   state->dialect = "swift-auth";
 
-  return RGWHandler::init(state, fcgx);
+  return RGWHandler::init(state, cio);
 }
 
 int RGWHandler_SWIFT_Auth::authorize()
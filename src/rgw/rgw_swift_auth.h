@@ -24,7 +24,7 @@ public:
   RGWOp *get_op();
   void put_op(RGWOp *op);
 
-  int init(struct req_state *state, FCGX_Request *fcgx);
+  int init(struct req_state *state, RGWClientIO *cio);
   int authorize();
   int read_permissions(RGWOp *op) { return 0; }
 
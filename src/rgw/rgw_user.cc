@@ -6,6 +6,7 @@
 #include "common/errno.h"
 #include "rgw_rados.h"
 #include "rgw_acl.h"
+#include "rgw_auth_cache.h"
 
 #include "include/types.h"
 #include "rgw_user.h"
@@ -80,6 +81,9 @@ int rgw_store_user_info(RGWUserInfo& info, bool exclusive)
   ::encode(ui, uid_bl);
   ::encode(info, uid_bl);
 
+  if (rgw_auth_cache)
+    rgw_auth_cache->invalidate_user(info.user_id);
+
   ret = rgw_put_obj(info.user_id, ui_uid_bucket, info.user_id, uid_bl.c_str(), uid_bl.length(), exclusive);
   if (ret < 0)
     return ret;
@@ -347,6 +351,8 @@ int rgw_remove_key_index(RGWAccessKey& access_key)
 {
   rgw_obj obj(ui_key_bucket, access_key.id);
   int ret = rgwstore->delete_obj(NULL, obj);
+  if (rgw_auth_cache)
+    rgw_auth_cache->invalidate(ui_key_bucket.name, access_key.id);
   return ret;
 }
 
@@ -354,6 +360,8 @@ int rgw_remove_uid_index(string& uid)
 {
   rgw_obj obj(ui_uid_bucket, uid);
   int ret = rgwstore->delete_obj(NULL, obj);
+  if (rgw_auth_cache)
+    rgw_auth_cache->invalidate(ui_uid_bucket.name, uid);
   return ret;
 }
 
@@ -368,6 +376,8 @@ int rgw_remove_swift_name_index(string& swift_name)
 {
   rgw_obj obj(ui_swift_bucket, swift_name);
   int ret = rgwstore->delete_obj(NULL, obj);
+  if (rgw_auth_cache)
+    rgw_auth_cache->invalidate(ui_swift_bucket.name, swift_name);
   return ret;
 }
 
@@ -383,6 +393,9 @@ int rgw_delete_user(RGWUserInfo& info) {
   if (ret < 0)
     return ret;
 
+  if (rgw_auth_cache)
+    rgw_auth_cache->invalidate_user(info.user_id);
+
   map<string, RGWBucketEnt>& buckets = user_buckets.get_buckets();
   vector<rgw_bucket> buckets_vec;
   for (map<string, RGWBucketEnt>::iterator i = buckets.begin();
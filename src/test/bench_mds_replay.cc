@@ -0,0 +1,223 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Measure how fast a captured MDS journal can be decoded for replay.
+ *
+ * Capture a journal with the Dumper, then decode it here with a varying
+ * number of threads:
+ *
+ *   ./ceph-mds -c ceph.conf -i a --dump-journal 0 journal.bin
+ *   ./bench_mds_replay journal.bin -t 0 -t 1 -t 2 -t 4
+ *
+ * -t 0 decodes in the calling thread, which is what replay did before
+ * 'mds replay threads'.  To time a full replay of the same journal,
+ * load it back into a test cluster with the Dumper, restart the mds
+ * with 'debug mds = 1' and look for the "_replay replayed N events in"
+ * line in its log:
+ *
+ *   ./ceph-mds -c ceph.conf -i a --undump-journal 0 journal.bin
+ *
+ * (use --reset-journal 0 afterwards to get an empty journal back.)
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "include/types.h"
+#include "include/utime.h"
+#include "common/Clock.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "global/global_init.h"
+#include "mds/LogEvent.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Decoder : public Thread {
+  vector<bufferlist>& entries;
+  Mutex& lock;
+  unsigned& next;
+  uint64_t failed;
+  Decoder(vector<bufferlist>& e, Mutex& l, unsigned& n)
+    : entries(e), lock(l), next(n), failed(0) {}
+
+  void *entry() {
+    while (true) {
+      unsigned i;
+      {
+	Mutex::Locker l(lock);
+	if (next == entries.size())
+	  break;
+	i = next++;
+      }
+      LogEvent *le = LogEvent::decode(entries[i]);
+      if (!le)
+	failed++;
+      delete le;
+    }
+    return 0;
+  }
+};
+
+static int read_dump(const char *fn, vector<bufferlist>& entries, uint64_t *bytes)
+{
+  int fd = ::open(fn, O_RDONLY);
+  if (fd < 0) {
+    int err = errno;
+    cerr << "couldn't open " << fn << ": " << cpp_strerror(err) << std::endl;
+    return -err;
+  }
+
+  // see Dumper::dump()
+  char buf[200];
+  int r = safe_read_exact(fd, buf, sizeof(buf));
+  if (r < 0) {
+    cerr << "couldn't read header from " << fn << ": " << cpp_strerror(r) << std::endl;
+    ::close(fd);
+    return r;
+  }
+  buf[sizeof(buf) - 1] = 0;
+  const char *ps = strstr(buf, "start offset");
+  const char *pl = strstr(buf, "length");
+  long long unsigned start, len;
+  if (!ps || !pl ||
+      sscanf(ps, "start offset %llu", &start) != 1 ||
+      sscanf(pl, "length %llu", &len) != 1) {
+    cerr << fn << " does not look like a journal dump" << std::endl;
+    ::close(fd);
+    return -EINVAL;
+  }
+
+  bufferptr bp(len);
+  r = safe_pread_exact(fd, bp.c_str(), len, start);
+  ::close(fd);
+  if (r < 0) {
+    cerr << "couldn't read " << start << "~" << len << " from " << fn
+	 << ": " << cpp_strerror(r) << std::endl;
+    return r;
+  }
+  bufferlist bl;
+  bl.push_back(bp);
+
+  // split into entries, the same way Journaler::try_read_entry() does
+  uint64_t off = 0;
+  while (off + sizeof(uint32_t) <= bl.length()) {
+    uint32_t s;
+    bufferlist::iterator p = bl.begin();
+    p.seek(off);
+    ::decode(s, p);
+    if (s == 0 || off + sizeof(s) + s > bl.length())
+      break;
+    bufferlist e;
+    e.substr_of(bl, off + sizeof(s), s);
+    entries.push_back(e);
+    off += sizeof(s) + s;
+  }
+  *bytes = off;
+  cout << "journal " << start << "~" << len << ": " << entries.size()
+       << " events in " << off << " bytes" << std::endl;
+  return 0;
+}
+
+static void usage()
+{
+  cout << "usage: bench_mds_replay <journal dump> [options]\n"
+       << "  -t <threads>     decode threads, may be repeated (default 0 and "
+       << "'mds replay threads')\n"
+       << "  -n <passes>      passes over the journal per setting (default 3)\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  const char *fn = NULL;
+  vector<int> thread_counts;
+  int passes = 3;
+  for (unsigned i = 0; i < args.size(); i++) {
+    if (strcmp(args[i], "--help") == 0 || strcmp(args[i], "-h") == 0) {
+      usage();
+      return 0;
+    }
+    if (strcmp(args[i], "-t") == 0 && i + 1 < args.size())
+      thread_counts.push_back(atoi(args[++i]));
+    else if (strcmp(args[i], "-n") == 0 && i + 1 < args.size())
+      passes = atoi(args[++i]);
+    else
+      fn = args[i];
+  }
+  if (!fn) {
+    usage();
+    return 1;
+  }
+  if (thread_counts.empty()) {
+    thread_counts.push_back(0);
+    thread_counts.push_back(g_conf->mds_replay_threads);
+  }
+
+  vector<bufferlist> entries;
+  uint64_t bytes;
+  int r = read_dump(fn, entries, &bytes);
+  if (r < 0)
+    return 1;
+  if (entries.empty())
+    return 0;
+
+  for (unsigned t = 0; t < thread_counts.size(); t++) {
+    int threads = thread_counts[t];
+    uint64_t failed = 0;
+    utime_t start = ceph_clock_now(g_ceph_context);
+    for (int pass = 0; pass < passes; pass++) {
+      Mutex lock("bench_mds_replay::lock");
+      unsigned next = 0;
+      if (threads <= 0) {
+	Decoder d(entries, lock, next);
+	d.entry();
+	failed += d.failed;
+	continue;
+      }
+      list<Decoder*> ls;
+      for (int i = 0; i < threads; i++) {
+	Decoder *d = new Decoder(entries, lock, next);
+	d->create();
+	ls.push_back(d);
+      }
+      while (!ls.empty()) {
+	Decoder *d = ls.front();
+	ls.pop_front();
+	d->join();
+	failed += d->failed;
+	delete d;
+      }
+    }
+    double dur = ceph_clock_now(g_ceph_context) - start;
+    uint64_t events = (uint64_t)entries.size() * passes;
+    cout << threads << " threads: " << events << " events in " << dur << " s, "
+	 << (double)events / dur << " events/sec, "
+	 << (double)bytes * passes / dur / 1048576.0 << " MB/sec";
+    if (failed)
+      cout << " (" << failed << " failed to decode)";
+    cout << std::endl;
+  }
+  return 0;
+}
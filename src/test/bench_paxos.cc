@@ -0,0 +1,195 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Measure monitor update throughput and latency.
+ *
+ * Each thread allocates and releases self-managed snapshot ids in a loop.
+ * Every one of those is a pool op that the OSDMonitor only acks once the
+ * resulting map update has been committed by paxos, so the op rate bounds
+ * the commit rate and the op latency is the proposal latency seen by a
+ * client.  Run it against a local multi-monitor cluster, e.g.
+ *
+ *   CEPH_NUM_MON=3 CEPH_NUM_OSD=1 CEPH_NUM_MDS=0 ./vstart.sh -n -d
+ *   ./bench_paxos -c ceph.conf -t 16 -n 200
+ *
+ * and compare 'paxos propose interval', 'paxos min wait' and
+ * 'paxos pipeline' settings.  The mon perf counters (paxos_commit,
+ * paxos_commit_latency, paxos_update_latency) give the number of actual
+ * paxos rounds behind the ops:
+ *
+ *   ./ceph --admin-daemon out/mon.a.asok perfcounters_dump
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "include/rados/librados.hpp"
+#include "include/utime.h"
+#include "common/Clock.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "common/ceph_argparse.h"
+#include "common/errno.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Stats {
+  Mutex lock;
+  uint64_t ops;
+  uint64_t errors;
+  double lat_sum;
+  double lat_min, lat_max;
+  Stats() : lock("bench_paxos::Stats::lock"),
+	    ops(0), errors(0), lat_sum(0), lat_min(0), lat_max(0) {}
+
+  void add(double lat) {
+    Mutex::Locker l(lock);
+    if (!ops || lat < lat_min)
+      lat_min = lat;
+    if (lat > lat_max)
+      lat_max = lat;
+    lat_sum += lat;
+    ops++;
+  }
+  void error() {
+    Mutex::Locker l(lock);
+    errors++;
+  }
+};
+
+struct T : public Thread {
+  librados::IoCtx& io_ctx;
+  int num;
+  Stats& stats;
+  T(librados::IoCtx& ioc, int n, Stats& s) : io_ctx(ioc), num(n), stats(s) {}
+
+  void *entry() {
+    while (num-- > 0) {
+      uint64_t snapid;
+      utime_t start = ceph_clock_now(NULL);
+      int r = io_ctx.selfmanaged_snap_create(&snapid);
+      if (r < 0) {
+	stats.error();
+	continue;
+      }
+      utime_t mid = ceph_clock_now(NULL);
+      stats.add(mid - start);
+
+      r = io_ctx.selfmanaged_snap_remove(snapid);
+      if (r < 0) {
+	stats.error();
+	continue;
+      }
+      stats.add(ceph_clock_now(NULL) - mid);
+    }
+    return 0;
+  }
+};
+
+static void usage()
+{
+  cout << "usage: bench_paxos [options]\n"
+       << "  -t <threads>     number of concurrent clients (default 1)\n"
+       << "  -n <num>         snap create/remove pairs per thread (default 100)\n"
+       << "  --pool <name>    pool to use (default bench_paxos, created if needed)\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  int threads = 1;
+  int num = 100;
+  string pool_name = "bench_paxos";
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  for (unsigned i = 0; i < args.size(); i++) {
+    if (strcmp(args[i], "--help") == 0 || strcmp(args[i], "-h") == 0) {
+      usage();
+      return 0;
+    }
+    if (i + 1 >= args.size())
+      break;
+    if (strcmp(args[i], "-t") == 0)
+      threads = atoi(args[i+1]);
+    else if (strcmp(args[i], "-n") == 0)
+      num = atoi(args[i+1]);
+    else if (strcmp(args[i], "--pool") == 0)
+      pool_name = args[i+1];
+  }
+
+  librados::Rados rados;
+  int r = rados.init(NULL);
+  if (r < 0) {
+    cerr << "error during init: " << cpp_strerror(r) << std::endl;
+    return 1;
+  }
+  rados.conf_parse_argv(argc, argv);
+  rados.conf_parse_env(NULL);
+  r = rados.conf_read_file(NULL);
+  if (r < 0) {
+    cerr << "error reading config: " << cpp_strerror(r) << std::endl;
+    return 1;
+  }
+  r = rados.connect();
+  if (r < 0) {
+    cerr << "error connecting: " << cpp_strerror(r) << std::endl;
+    return 1;
+  }
+
+  r = rados.pool_create(pool_name.c_str());
+  if (r < 0 && r != -EEXIST) {
+    cerr << "error creating pool " << pool_name << ": " << cpp_strerror(r)
+	 << std::endl;
+    return 1;
+  }
+  librados::IoCtx io_ctx;
+  r = rados.ioctx_create(pool_name.c_str(), io_ctx);
+  if (r < 0) {
+    cerr << "error opening pool " << pool_name << ": " << cpp_strerror(r)
+	 << std::endl;
+    return 1;
+  }
+
+  cout << threads << " threads, " << num << " snap create/remove pairs per thread"
+       << std::endl;
+
+  Stats stats;
+  utime_t start = ceph_clock_now(NULL);
+
+  list<T*> ls;
+  for (int i=0; i<threads; i++) {
+    T *t = new T(io_ctx, num, stats);
+    t->create();
+    ls.push_back(t);
+  }
+  while (!ls.empty()) {
+    T *t = ls.front();
+    ls.pop_front();
+    t->join();
+    delete t;
+  }
+
+  utime_t dur = ceph_clock_now(NULL) - start;
+
+  cout << "ops:      " << stats.ops << " (" << stats.errors << " errors)\n"
+       << "duration: " << dur << " s\n"
+       << "ops/sec:  " << (double)stats.ops / (double)dur << "\n";
+  if (stats.ops)
+    cout << "latency:  min " << stats.lat_min
+	 << " avg " << stats.lat_sum / (double)stats.ops
+	 << " max " << stats.lat_max << std::endl;
+
+  io_ctx.close();
+  rados.shutdown();
+  return stats.errors ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * The CPU side of rgw request authentication.
+ *
+ * Times signing an S3 string to sign with a new HMAC-SHA1 context each
+ * time, as calc_hmac_sha1() does, against reusing one keyed context, and
+ * checking a swift token against the auth cache.  Nothing here talks to
+ * the cluster:
+ *
+ *   bench_rgw_auth -n 1000000
+ *   bench_rgw_auth -n 1000000 -l 1024
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "include/types.h"
+#include "common/Clock.h"
+#include "common/ceph_argparse.h"
+#include "common/ceph_crypto.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "global/global_init.h"
+#include "rgw/rgw_auth_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using ceph::crypto::HMACSHA1;
+
+static void report(const char *what, int n, utime_t start)
+{
+  double elapsed = (double)(ceph_clock_now(g_ceph_context) - start);
+  cout << what << ": " << n << " in " << elapsed << " s, "
+       << (double)n / elapsed << "/sec, " << elapsed / n * 1000000.0 << " us each" << std::endl;
+}
+
+static void usage()
+{
+  cout << "usage: bench_rgw_auth [options] [ceph options]\n"
+       << "  -n <count>        iterations of each test (default 100000)\n"
+       << "  -l <bytes>        length of the string to sign (default 200)\n"
+       << "  -u <users>        distinct tokens in the cache (default 1000)\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  int count = 100000;
+  int len = 200;
+  int users = 1000;
+  string val;
+  for (vector<const char*>::iterator i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "-n", (char*)NULL)) {
+      count = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "-l", (char*)NULL)) {
+      len = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "-u", (char*)NULL)) {
+      users = atoi(val.c_str());
+    } else {
+      cerr << "unrecognized arg " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (count < 1 || len < 1 || users < 1) {
+    usage();
+    return 1;
+  }
+
+  string secret = "kf3Ju8Dq/3Ez1vWbD1hPYB8Ee2j1ZsJz6JHG0Dmg";
+  string msg(len, 'x');
+  char dest[CEPH_CRYPTO_HMACSHA1_DIGESTSIZE];
+
+  utime_t start = ceph_clock_now(g_ceph_context);
+  for (int i = 0; i < count; i++)
+    calc_hmac_sha1(secret.c_str(), secret.size(), msg.c_str(), msg.size(), dest);
+  report("hmac, new context", count, start);
+
+  HMACSHA1 hmac((const byte *)secret.c_str(), secret.size());
+  start = ceph_clock_now(g_ceph_context);
+  for (int i = 0; i < count; i++) {
+    hmac.Update((const byte *)msg.c_str(), msg.size());
+    hmac.Final((byte *)dest);
+  }
+  report("hmac, reused context", count, start);
+
+  RGWAuthCache cache(g_ceph_context);
+  vector<string> tokens;
+  utime_t expiration = ceph_clock_now(g_ceph_context);
+  expiration += 3600;
+  for (int i = 0; i < users; i++) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "AUTH_rgwtk%032x", i);
+    tokens.push_back(buf);
+    RGWUserInfo info;
+    info.user_id = buf + 10;
+    cache.put_token(tokens.back(), expiration, info, cache.get_generation());
+  }
+  start = ceph_clock_now(g_ceph_context);
+  int hits = 0;
+  for (int i = 0; i < count; i++) {
+    RGWUserInfo info;
+    if (cache.get_token(tokens[i % users], info))
+      hits++;
+  }
+  report("cached token lookup", count, start);
+  if (hits != count)
+    cout << "  (" << count - hits << " misses; raise rgw_auth_cache_size?)" << std::endl;
+  return 0;
+}
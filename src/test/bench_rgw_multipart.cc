@@ -0,0 +1,327 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Completing synthetic multipart uploads.
+ *
+ * Each upload gets -p parts: a part object of -s bytes and its entry in
+ * the upload's omap, as an upload part request leaves them.  We then time
+ * what completing the upload costs: looking up the part info (all of the
+ * omap in one read, as rgw used to, and the batched, pipelined lookup it
+ * does now), and writing the head object with the manifest.  Try the
+ * lookup with different batch sizes and depths:
+ *
+ *   bench_rgw_multipart -p 10000
+ *   bench_rgw_multipart -p 10000 --rgw-multipart-part-batch 100 --rgw-multipart-aio 16
+ *
+ * Each run creates a new bucket (bench-mp-<time>); remove it with
+ * radosgw-admin when done.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "include/types.h"
+#include "common/Clock.h"
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "rgw/rgw_rados.h"
+#include "rgw/rgw_op.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static string mp_ns = "multipart";
+
+struct Stat {
+  const char *name;
+  double sum, max;
+  Stat(const char *n) : name(n), sum(0), max(0) {}
+  void add(double t) {
+    sum += t;
+    if (t > max)
+      max = t;
+  }
+  void dump(int n) {
+    cout << name << ": avg " << (n ? sum / n * 1000.0 : 0) << " ms"
+	 << " max " << max * 1000.0 << " ms" << std::endl;
+  }
+};
+
+static double since(utime_t start)
+{
+  return (double)(ceph_clock_now(g_ceph_context) - start);
+}
+
+/* the part objects and omap entries an upload of num_parts leaves */
+static int make_upload(rgw_bucket& bucket, RGWMPObj& mp, int num_parts, size_t size)
+{
+  string meta_oid = mp.get_meta();
+  rgw_obj meta_obj;
+  meta_obj.init_ns(bucket, meta_oid, mp_ns);
+  map<string, bufferlist> attrs;
+  int r = rgwstore->put_obj_meta(NULL, meta_obj, 0, NULL, attrs, RGW_OBJ_CATEGORY_MULTIMETA,
+				 true, NULL, NULL, NULL);
+  if (r < 0)
+    return r;
+
+  bufferlist data;
+  data.append_zero(size);
+  list<void *> handles;
+  map<string, bufferlist> entries;
+  for (int i = 1; i <= num_parts && r >= 0; i++) {
+    string oid = mp.get_part(i);
+    rgw_obj obj;
+    obj.init_ns(bucket, oid, mp_ns);
+    void *handle;
+    r = rgwstore->aio_put_obj_data(NULL, obj, data, -1, false, &handle);
+    if (r < 0)
+      break;
+    handles.push_back(handle);
+    if (handles.size() >= 64) {
+      r = rgwstore->aio_wait(handles.front());
+      handles.pop_front();
+    }
+
+    RGWUploadPartInfo info;
+    info.num = i;
+    info.etag = "d41d8cd98f00b204e9800998ecf8427e";
+    info.size = size;
+    info.modified = ceph_clock_now(g_ceph_context);
+    char key[32];
+    snprintf(key, sizeof(key), "part.%d", i);
+    ::encode(info, entries[key]);
+    if (entries.size() >= 1000 || i == num_parts) {
+      int ret = rgwstore->omap_set(meta_obj, entries);
+      if (ret < 0)
+	r = ret;
+      entries.clear();
+    }
+  }
+  while (!handles.empty()) {
+    int ret = rgwstore->aio_wait(handles.front());
+    if (r >= 0 && ret < 0)
+      r = ret;
+    handles.pop_front();
+  }
+  return r;
+}
+
+/* the whole omap in one read */
+static int lookup_all(rgw_obj& meta_obj, map<uint32_t, RGWUploadPartInfo>& parts)
+{
+  bufferlist header;
+  map<string, bufferlist> m;
+  int r = rgwstore->omap_get_all(meta_obj, header, m);
+  if (r < 0)
+    return r;
+  for (map<string, bufferlist>::iterator iter = m.begin(); iter != m.end(); ++iter) {
+    RGWUploadPartInfo info;
+    bufferlist::iterator bli = iter->second.begin();
+    ::decode(info, bli);
+    parts[info.num] = info;
+  }
+  return 0;
+}
+
+struct Batch {
+  set<string> keys;
+  map<string, bufferlist> vals;
+  void *handle;
+};
+
+/* keys first, then the values in batches, as RGWCompleteMultipart does */
+static int lookup_batched(rgw_obj& meta_obj, map<uint32_t, RGWUploadPartInfo>& parts)
+{
+  set<string> keys;
+  map<string, bufferlist> attrs;
+  int r = rgwstore->omap_get_keys(meta_obj, keys, &attrs);
+  if (r < 0)
+    return r;
+
+  int batch_size = max(1, (int)g_conf->rgw_multipart_part_batch);
+  int window = max(1, (int)g_conf->rgw_multipart_aio);
+  list<Batch> pending;
+  set<string>::iterator next = keys.begin();
+  while (!pending.empty() || (r >= 0 && next != keys.end())) {
+    while (r >= 0 && next != keys.end() && (int)pending.size() < window) {
+      pending.push_back(Batch());
+      Batch& b = pending.back();
+      for (int i = 0; i < batch_size && next != keys.end(); ++i, ++next)
+	b.keys.insert(*next);
+      r = rgwstore->aio_omap_get_vals_by_keys(meta_obj, b.keys, &b.vals, &b.handle);
+      if (r < 0)
+	pending.pop_back();
+    }
+    if (pending.empty())
+      break;
+    Batch& b = pending.front();
+    int ret = rgwstore->aio_wait(b.handle);
+    if (r >= 0 && ret < 0)
+      r = ret;
+    for (map<string, bufferlist>::iterator iter = b.vals.begin(); r >= 0 && iter != b.vals.end(); ++iter) {
+      RGWUploadPartInfo info;
+      bufferlist::iterator bli = iter->second.begin();
+      ::decode(info, bli);
+      parts[info.num] = info;
+    }
+    pending.pop_front();
+  }
+  return r;
+}
+
+static int complete(rgw_bucket& bucket, RGWMPObj& mp, string& name,
+		    map<uint32_t, RGWUploadPartInfo>& parts)
+{
+  RGWObjManifest manifest;
+  off_t ofs = 0;
+  for (map<uint32_t, RGWUploadPartInfo>::iterator iter = parts.begin(); iter != parts.end(); ++iter) {
+    string oid = mp.get_part(iter->first);
+    RGWObjManifestPart& part = manifest.objs[ofs];
+    part.loc.init_ns(bucket, oid, mp_ns);
+    part.loc_ofs = 0;
+    part.size = iter->second.size;
+    ofs += part.size;
+  }
+  manifest.obj_size = ofs;
+
+  rgw_obj obj(bucket, name);
+  map<string, bufferlist> attrs;
+  return rgwstore->put_obj_meta(NULL, obj, ofs, NULL, attrs, RGW_OBJ_CATEGORY_MAIN,
+				false, NULL, NULL, &manifest);
+}
+
+static void usage()
+{
+  cout << "usage: bench_rgw_multipart [options] [ceph options]\n"
+       << "  -p <parts>        parts per upload (default 1000)\n"
+       << "  -n <uploads>      uploads to complete (default 5)\n"
+       << "  -s <bytes>        part size (default 0)\n"
+       << "  --uid <user>      bucket owner (default bench)\n"
+       << "  --rgw-multipart-part-batch <n>  parts per lookup\n"
+       << "  --rgw-multipart-aio <n>         lookups in flight\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  int num_parts = 1000;
+  int uploads = 5;
+  size_t size = 0;
+  string owner = "bench";
+  string val;
+  for (vector<const char*>::iterator i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "-p", (char*)NULL)) {
+      num_parts = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "-n", (char*)NULL)) {
+      uploads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "-s", (char*)NULL)) {
+      size = strtoul(val.c_str(), NULL, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--uid", (char*)NULL)) {
+      owner = val;
+    } else {
+      cerr << "unrecognized arg " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (num_parts < 1 || uploads < 1) {
+    usage();
+    return 1;
+  }
+
+  RGWStoreManager store_manager;
+  if (!store_manager.init(g_ceph_context)) {
+    cerr << "couldn't init storage provider" << std::endl;
+    return 1;
+  }
+
+  char name[40];
+  snprintf(name, sizeof(name), "bench-mp-%llu",
+	   (unsigned long long)ceph_clock_now(g_ceph_context).sec());
+  rgw_bucket bucket;
+  bucket.name = name;
+  map<string, bufferlist> attrs;
+  int r = rgwstore->create_bucket(owner, bucket, attrs, false, true);
+  if (r < 0) {
+    cerr << "couldn't create bucket " << name << ": " << cpp_strerror(-r) << std::endl;
+    return 1;
+  }
+  cout << "bucket " << bucket << ", " << uploads << " uploads of " << num_parts
+       << " parts of " << size << " bytes; part batch " << g_conf->rgw_multipart_part_batch
+       << ", " << g_conf->rgw_multipart_aio << " in flight" << std::endl;
+
+  Stat setup("setup"), all("lookup, one read"), batched("lookup, batched"), put("put manifest");
+  for (int i = 0; i < uploads; i++) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "obj.%d", i);
+    string obj_name = buf;
+    snprintf(buf, sizeof(buf), "bench.%d", i);
+    string upload_id = buf;
+    RGWMPObj mp(obj_name, upload_id);
+    string meta_oid = mp.get_meta();
+    rgw_obj meta_obj;
+    meta_obj.init_ns(bucket, meta_oid, mp_ns);
+
+    utime_t start = ceph_clock_now(g_ceph_context);
+    r = make_upload(bucket, mp, num_parts, size);
+    if (r < 0) {
+      cerr << "creating upload " << upload_id << ": " << cpp_strerror(-r) << std::endl;
+      return 1;
+    }
+    setup.add(since(start));
+
+    map<uint32_t, RGWUploadPartInfo> parts_all, parts;
+    start = ceph_clock_now(g_ceph_context);
+    r = lookup_all(meta_obj, parts_all);
+    all.add(since(start));
+    if (r >= 0) {
+      start = ceph_clock_now(g_ceph_context);
+      r = lookup_batched(meta_obj, parts);
+      batched.add(since(start));
+    }
+    if (r >= 0 && parts.size() != parts_all.size())
+      r = -EIO;
+    if (r < 0) {
+      cerr << "looking up parts of " << upload_id << ": " << cpp_strerror(-r) << std::endl;
+      return 1;
+    }
+
+    start = ceph_clock_now(g_ceph_context);
+    r = complete(bucket, mp, obj_name, parts);
+    if (r < 0) {
+      cerr << "completing " << upload_id << ": " << cpp_strerror(-r) << std::endl;
+      return 1;
+    }
+    put.add(since(start));
+    rgwstore->delete_obj(NULL, meta_obj);
+  }
+
+  setup.dump(uploads);
+  all.dump(uploads);
+  batched.dump(uploads);
+  put.dump(uploads);
+  return 0;
+}
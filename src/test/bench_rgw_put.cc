@@ -0,0 +1,175 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Concurrent PUTs into one rgw bucket.
+ *
+ * Every PUT updates the bucket index, so this is a measure of how many
+ * writes a single bucket takes.  Compare an unsharded index with a
+ * sharded one:
+ *
+ *   bench_rgw_put -t 32 -d 30
+ *   bench_rgw_put -t 32 -d 30 --rgw-bucket-index-shards 16
+ *
+ * Each run creates a new bucket (bench-put-<time>); remove it with
+ * radosgw-admin when done.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "include/types.h"
+#include "common/Clock.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "common/errno.h"
+#include "global/global_init.h"
+#include "rgw/rgw_rados.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct PutThread : public Thread {
+  rgw_bucket bucket;
+  int id;
+  size_t size;
+  utime_t stop;
+
+  int err;
+  uint64_t ops;
+  double lat_sum, lat_max;
+
+  PutThread(rgw_bucket& b, int i, size_t s, utime_t st)
+    : bucket(b), id(i), size(s), stop(st), err(0), ops(0), lat_sum(0), lat_max(0) {}
+
+  void *entry() {
+    bufferlist data;
+    data.append_zero(size);
+    map<string, bufferlist> attrs;
+    char name[40];
+    while (ceph_clock_now(g_ceph_context) < stop) {
+      snprintf(name, sizeof(name), "obj.%d.%llu", id, (unsigned long long)ops);
+      rgw_obj obj(bucket, name);
+      utime_t start = ceph_clock_now(g_ceph_context);
+      int r = rgwstore->put_obj_meta(NULL, obj, size, NULL, attrs, RGW_OBJ_CATEGORY_MAIN,
+				     false, NULL, &data, NULL);
+      if (r < 0) {
+	err = r;
+	break;
+      }
+      double lat = (double)(ceph_clock_now(g_ceph_context) - start);
+      ops++;
+      lat_sum += lat;
+      if (lat > lat_max)
+	lat_max = lat;
+    }
+    return 0;
+  }
+};
+
+static void usage()
+{
+  cout << "usage: bench_rgw_put [options] [ceph options]\n"
+       << "  -t <threads>      concurrent PUTs (default 16)\n"
+       << "  -d <seconds>      run time (default 10)\n"
+       << "  -s <bytes>        object size (default 0)\n"
+       << "  --uid <user>      bucket owner (default bench)\n"
+       << "  --rgw-bucket-index-shards <n>   index shards for the new bucket\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  int threads = 16;
+  double duration = 10;
+  size_t size = 0;
+  string owner = "bench";
+  string val;
+  for (vector<const char*>::iterator i = args.begin(); i != args.end(); ) {
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "-t", (char*)NULL)) {
+      threads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "-d", (char*)NULL)) {
+      duration = atof(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "-s", (char*)NULL)) {
+      size = strtoul(val.c_str(), NULL, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--uid", (char*)NULL)) {
+      owner = val;
+    } else {
+      cerr << "unrecognized arg " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (threads < 1) {
+    usage();
+    return 1;
+  }
+
+  RGWStoreManager store_manager;
+  if (!store_manager.init(g_ceph_context)) {
+    cerr << "couldn't init storage provider" << std::endl;
+    return 1;
+  }
+
+  char name[40];
+  snprintf(name, sizeof(name), "bench-put-%llu",
+	   (unsigned long long)ceph_clock_now(g_ceph_context).sec());
+  rgw_bucket bucket;
+  bucket.name = name;
+  map<string, bufferlist> attrs;
+  int r = rgwstore->create_bucket(owner, bucket, attrs, false, true);
+  if (r < 0) {
+    cerr << "couldn't create bucket " << name << ": " << cpp_strerror(-r) << std::endl;
+    return 1;
+  }
+  cout << "bucket " << bucket << ", " << g_conf->rgw_bucket_index_shards << " index shards, "
+       << threads << " threads, " << size << " byte objects" << std::endl;
+
+  utime_t start = ceph_clock_now(g_ceph_context);
+  utime_t stop = start;
+  stop += duration;
+  vector<PutThread*> ts;
+  for (int i = 0; i < threads; i++) {
+    ts.push_back(new PutThread(bucket, i, size, stop));
+    ts.back()->create();
+  }
+  uint64_t ops = 0;
+  double lat_sum = 0, lat_max = 0;
+  for (int i = 0; i < threads; i++) {
+    ts[i]->join();
+    if (ts[i]->err)
+      cerr << "thread " << i << ": " << cpp_strerror(-ts[i]->err) << std::endl;
+    ops += ts[i]->ops;
+    lat_sum += ts[i]->lat_sum;
+    if (ts[i]->lat_max > lat_max)
+      lat_max = ts[i]->lat_max;
+    delete ts[i];
+  }
+  double elapsed = (double)(ceph_clock_now(g_ceph_context) - start);
+
+  cout << ops << " puts in " << elapsed << " s, " << (double)ops / elapsed << " puts/sec, "
+       << "lat avg " << (ops ? lat_sum / ops * 1000.0 : 0) << " ms"
+       << " max " << lat_max * 1000.0 << " ms" << std::endl;
+  return 0;
+}
@@ -17,6 +17,7 @@
     bucket unlink              unlink bucket from specified user
     bucket stats               returns bucket statistics
     bucket info                show bucket information
+    bucket reshard             rebuild the bucket index with --num-shards shards
     pool add                   add an existing pool for data placement
     pool rm                    remove an existing pool from data placement set
     pools list                 list placement active set
@@ -49,6 +50,7 @@
      --start-date=<date>
      --end-date=<date>
      --bucket-id=<bucket-id>
+     --num-shards=<n>          number of bucket index shards (0 for unsharded)
      --format=<format>         specify output format for certain operations: xml,
                                json
      --purge-data              when specified, user removal will also purge all the
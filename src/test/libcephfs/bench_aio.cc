@@ -0,0 +1,351 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Queue depth vs iops for libcephfs aio.
+ *
+ * One thread keeps -q requests in flight with ceph_aio_read/write,
+ * resubmitting from the completion callback, and we report iops and
+ * latency for each depth.  A run with plain ceph_read/ceph_write is
+ * done first as the baseline:
+ *
+ *   bench_libcephfs_aio -q 1 -q 4 -q 16 -q 64
+ *   bench_libcephfs_aio -m randwrite -q 16 --client-oc false
+ *
+ * Any other arguments (-c ceph.conf, --client-oc-size ...) go to the
+ * client configuration.
+ */
+
+#include "include/cephfs/libcephfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+struct bench_opts_t {
+  uint64_t file_size;
+  uint64_t block_size;
+  bool write;
+  double duration;
+  vector<int> depths;
+  string path;
+
+  bench_opts_t()
+    : file_size(64 << 20), block_size(4096), write(false),
+      duration(10), path("/bench_libcephfs_aio") {}
+};
+
+struct bench_run_t;
+
+struct bench_slot_t {
+  bench_run_t *run;
+  char *buf;
+  double start;
+};
+
+struct bench_run_t {
+  struct ceph_mount_info *cmount;
+  const bench_opts_t *opts;
+  int fd;
+  double stop;
+  unsigned seed;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int inflight;
+  int err;
+  uint64_t ops;
+  double lat_sum, lat_max;
+
+  bench_run_t(struct ceph_mount_info *c, const bench_opts_t *o, int f)
+    : cmount(c), opts(o), fd(f), stop(0), seed(1),
+      inflight(0), err(0), ops(0), lat_sum(0), lat_max(0) {
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+  }
+  ~bench_run_t() {
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+  }
+
+  uint64_t next_offset() {
+    uint64_t blocks = opts->file_size / opts->block_size;
+    uint64_t b = (((uint64_t)rand_r(&seed) << 31) ^ rand_r(&seed)) % blocks;
+    return b * opts->block_size;
+  }
+};
+
+static void bench_complete(struct ceph_aio_completion *c, void *arg);
+
+// call with run->lock held
+static int bench_submit(bench_slot_t *s)
+{
+  bench_run_t *run = s->run;
+  const bench_opts_t *o = run->opts;
+  uint64_t off = run->next_offset();
+  struct ceph_aio_completion *c;
+  ceph_aio_create_completion(s, bench_complete, &c);
+  s->start = now();
+  run->inflight++;
+  int r;
+  if (o->write)
+    r = ceph_aio_write(run->cmount, run->fd, s->buf, o->block_size, off, c);
+  else
+    r = ceph_aio_read(run->cmount, run->fd, s->buf, o->block_size, off, c);
+  if (r < 0) {
+    run->inflight--;
+    ceph_aio_release(c);
+  }
+  return r;
+}
+
+static void bench_complete(struct ceph_aio_completion *c, void *arg)
+{
+  bench_slot_t *s = (bench_slot_t *)arg;
+  bench_run_t *run = s->run;
+  int r = ceph_aio_get_return_value(c);
+  ceph_aio_release(c);
+  double lat = now() - s->start;
+
+  pthread_mutex_lock(&run->lock);
+  run->inflight--;
+  if (r < 0) {
+    if (!run->err)
+      run->err = r;
+  } else {
+    run->ops++;
+    run->lat_sum += lat;
+    if (lat > run->lat_max)
+      run->lat_max = lat;
+    if (!run->err && now() < run->stop) {
+      r = bench_submit(s);
+      if (r < 0)
+	run->err = r;
+    }
+  }
+  pthread_cond_signal(&run->cond);
+  pthread_mutex_unlock(&run->lock);
+}
+
+static void report(const bench_opts_t& o, const char *what, bench_run_t& run, double elapsed)
+{
+  if (run.err)
+    cerr << what << " failed: " << strerror(-run.err) << std::endl;
+  cout << what << ": " << run.ops << " ops in " << elapsed << " s, "
+       << (double)run.ops / elapsed << " iops, "
+       << (double)(run.ops * o.block_size) / elapsed / 1048576.0 << " MB/sec, "
+       << "lat avg " << (run.ops ? run.lat_sum / run.ops * 1000.0 : 0) << " ms"
+       << " max " << run.lat_max * 1000.0 << " ms" << std::endl;
+}
+
+static void run_sync(struct ceph_mount_info *cmount, const bench_opts_t& o, int fd)
+{
+  bench_run_t run(cmount, &o, fd);
+  char *buf = new char[o.block_size];
+  memset(buf, 'a', o.block_size);
+  double start = now();
+  run.stop = start + o.duration;
+  while (now() < run.stop) {
+    uint64_t off = run.next_offset();
+    double t = now();
+    int r;
+    if (o.write)
+      r = ceph_write(cmount, fd, buf, o.block_size, off);
+    else
+      r = ceph_read(cmount, fd, buf, o.block_size, off);
+    if (r < 0) {
+      run.err = r;
+      break;
+    }
+    double lat = now() - t;
+    run.ops++;
+    run.lat_sum += lat;
+    if (lat > run.lat_max)
+      run.lat_max = lat;
+  }
+  report(o, "sync", run, now() - start);
+  delete[] buf;
+}
+
+static void run_aio(struct ceph_mount_info *cmount, const bench_opts_t& o, int fd, int depth)
+{
+  bench_run_t run(cmount, &o, fd);
+  vector<bench_slot_t> slots(depth);
+  double start = now();
+  run.stop = start + o.duration;
+
+  pthread_mutex_lock(&run.lock);
+  for (int i = 0; i < depth; i++) {
+    slots[i].run = &run;
+    slots[i].buf = new char[o.block_size];
+    memset(slots[i].buf, 'a' + i % 26, o.block_size);
+    int r = bench_submit(&slots[i]);
+    if (r < 0) {
+      run.err = r;
+      break;
+    }
+  }
+  while (run.inflight > 0)
+    pthread_cond_wait(&run.cond, &run.lock);
+  pthread_mutex_unlock(&run.lock);
+  double elapsed = now() - start;
+
+  char what[20];
+  snprintf(what, sizeof(what), "qd %d", depth);
+  report(o, what, run, elapsed);
+  for (int i = 0; i < depth; i++)
+    delete[] slots[i].buf;
+}
+
+static int prepare_file(struct ceph_mount_info *cmount, const bench_opts_t& o, int *fdp)
+{
+  int fd = ceph_open(cmount, o.path.c_str(), O_CREAT|O_RDWR, 0644);
+  if (fd < 0) {
+    cerr << "open " << o.path << " failed: " << strerror(-fd) << std::endl;
+    return fd;
+  }
+  // reads need the data to be there
+  if (!o.write) {
+    uint64_t chunk = 4 << 20;
+    char *buf = new char[chunk];
+    memset(buf, 'x', chunk);
+    for (uint64_t off = 0; off < o.file_size; off += chunk) {
+      uint64_t len = o.file_size - off < chunk ? o.file_size - off : chunk;
+      int r = ceph_write(cmount, fd, buf, len, off);
+      if (r < 0) {
+	cerr << "prefill " << o.path << " failed: " << strerror(-r) << std::endl;
+	delete[] buf;
+	ceph_close(cmount, fd);
+	return r;
+      }
+    }
+    delete[] buf;
+    ceph_fsync(cmount, fd, 0);
+  }
+  *fdp = fd;
+  return 0;
+}
+
+static void usage()
+{
+  cout << "usage: bench_libcephfs_aio [options] [ceph options]\n"
+       << "  -q <depth>          queue depth to test; repeat for several (default 1 4 16 64)\n"
+       << "  -m <mode>           randread or randwrite (default randread)\n"
+       << "  -b <bytes>          block size (default 4096)\n"
+       << "  -s <MB>             file size (default 64)\n"
+       << "  -d <seconds>        run time of each test (default 10)\n"
+       << "  --path <path>       file to use (default /bench_libcephfs_aio)\n"
+       << "  --no-sync           skip the synchronous baseline\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  bench_opts_t o;
+  bool sync = true;
+  vector<const char*> rest;
+  rest.push_back(argv[0]);
+  for (int i = 1; i < argc; i++) {
+    string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "-h" || a == "--help") {
+      usage();
+      return 0;
+    } else if (a == "-q" && more) {
+      o.depths.push_back(atoi(argv[++i]));
+    } else if (a == "-b" && more) {
+      o.block_size = strtoull(argv[++i], NULL, 10);
+    } else if (a == "-s" && more) {
+      o.file_size = strtoull(argv[++i], NULL, 10) << 20;
+    } else if (a == "-d" && more) {
+      o.duration = atof(argv[++i]);
+    } else if (a == "--path" && more) {
+      o.path = argv[++i];
+    } else if (a == "--no-sync") {
+      sync = false;
+    } else if (a == "-m" && more) {
+      string m = argv[++i];
+      if (m == "randread") o.write = false;
+      else if (m == "randwrite") o.write = true;
+      else {
+	usage();
+	return 1;
+      }
+    } else {
+      rest.push_back(argv[i]);
+    }
+  }
+  if (o.depths.empty()) {
+    o.depths.push_back(1);
+    o.depths.push_back(4);
+    o.depths.push_back(16);
+    o.depths.push_back(64);
+  }
+  for (unsigned i = 0; i < o.depths.size(); i++)
+    if (o.depths[i] < 1) {
+      usage();
+      return 1;
+    }
+  if (o.block_size == 0 || o.file_size < o.block_size) {
+    usage();
+    return 1;
+  }
+
+  struct ceph_mount_info *cmount;
+  int r = ceph_create(&cmount, NULL);
+  if (r == 0)
+    r = ceph_conf_read_file(cmount, NULL);
+  if (r == 0)
+    r = ceph_conf_parse_argv(cmount, rest.size(), &rest[0]);
+  if (r == 0)
+    r = ceph_mount(cmount, "/");
+  if (r < 0) {
+    cerr << "couldn't mount: " << strerror(-r) << std::endl;
+    return 1;
+  }
+
+  int fd;
+  r = prepare_file(cmount, o, &fd);
+  if (r < 0) {
+    ceph_shutdown(cmount);
+    return 1;
+  }
+
+  cout << (o.write ? "randwrite" : "randread") << ", "
+       << o.block_size << " byte blocks" << std::endl;
+  if (sync)
+    run_sync(cmount, o, fd);
+  for (unsigned i = 0; i < o.depths.size(); i++)
+    run_aio(cmount, o, fd, o.depths[i]);
+
+  ceph_close(cmount, fd);
+  ceph_shutdown(cmount);
+  return 0;
+}
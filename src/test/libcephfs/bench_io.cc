@@ -0,0 +1,296 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * fio-style multi-threaded I/O through libcephfs.
+ *
+ * Each thread does block-sized reads or writes on its own file (or all
+ * on one file with --shared) for a fixed time, and we report bandwidth,
+ * iops and latency.  Run it with increasing -t to see how well I/O on
+ * different files overlaps inside one client:
+ *
+ *   bench_libcephfs_io -t 1 -m randread
+ *   bench_libcephfs_io -t 8 -m randread
+ *
+ * Any other arguments (-c ceph.conf, --client-oc-size ...) go to the
+ * client configuration.
+ */
+
+#include "include/cephfs/libcephfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+enum { MODE_READ, MODE_WRITE, MODE_RANDREAD, MODE_RANDWRITE, MODE_RANDRW };
+
+struct bench_opts_t {
+  int threads;
+  uint64_t file_size;
+  uint64_t block_size;
+  int mode;
+  double duration;
+  int fsync_every;
+  bool shared;
+  string dir;
+
+  bench_opts_t()
+    : threads(1), file_size(64 << 20), block_size(4096), mode(MODE_RANDREAD),
+      duration(10), fsync_every(0), shared(false), dir("/bench_libcephfs_io") {}
+};
+
+struct bench_thread_t {
+  struct ceph_mount_info *cmount;
+  const bench_opts_t *opts;
+  int id;
+  int fd;
+  pthread_t tid;
+  double stop;
+
+  // results
+  int err;
+  uint64_t ops, bytes;
+  double lat_sum, lat_max;
+
+  bench_thread_t()
+    : cmount(NULL), opts(NULL), id(0), fd(-1), stop(0),
+      err(0), ops(0), bytes(0), lat_sum(0), lat_max(0) {}
+};
+
+static void *bench_entry(void *arg)
+{
+  bench_thread_t *t = (bench_thread_t *)arg;
+  const bench_opts_t *o = t->opts;
+  uint64_t blocks = o->file_size / o->block_size;
+  char *buf = new char[o->block_size];
+  memset(buf, 'a' + t->id % 26, o->block_size);
+  unsigned seed = t->id + 1;
+  uint64_t next = 0;
+
+  while (now() < t->stop) {
+    uint64_t block;
+    bool write;
+    switch (o->mode) {
+    case MODE_READ:
+    case MODE_WRITE:
+      block = next++ % blocks;
+      write = o->mode == MODE_WRITE;
+      break;
+    default:
+      block = (((uint64_t)rand_r(&seed) << 31) ^ rand_r(&seed)) % blocks;
+      write = o->mode == MODE_RANDWRITE ||
+	(o->mode == MODE_RANDRW && (rand_r(&seed) & 1));
+    }
+
+    double start = now();
+    int r;
+    if (write)
+      r = ceph_write(t->cmount, t->fd, buf, o->block_size, block * o->block_size);
+    else
+      r = ceph_read(t->cmount, t->fd, buf, o->block_size, block * o->block_size);
+    if (r >= 0 && write && o->fsync_every && (t->ops + 1) % o->fsync_every == 0)
+      r = ceph_fsync(t->cmount, t->fd, 1);
+    double lat = now() - start;
+    if (r < 0) {
+      t->err = r;
+      break;
+    }
+    t->ops++;
+    t->bytes += o->block_size;
+    t->lat_sum += lat;
+    if (lat > t->lat_max)
+      t->lat_max = lat;
+  }
+  delete[] buf;
+  return NULL;
+}
+
+static int prepare_file(struct ceph_mount_info *cmount, const string& fn,
+			const bench_opts_t& o, int *fdp)
+{
+  int fd = ceph_open(cmount, fn.c_str(), O_CREAT|O_RDWR, 0644);
+  if (fd < 0) {
+    cerr << "open " << fn << " failed: " << strerror(-fd) << std::endl;
+    return fd;
+  }
+  // reads need the data to be there
+  if (o.mode != MODE_WRITE && o.mode != MODE_RANDWRITE) {
+    uint64_t chunk = 4 << 20;
+    char *buf = new char[chunk];
+    memset(buf, 'x', chunk);
+    for (uint64_t off = 0; off < o.file_size; off += chunk) {
+      uint64_t len = o.file_size - off < chunk ? o.file_size - off : chunk;
+      int r = ceph_write(cmount, fd, buf, len, off);
+      if (r < 0) {
+	cerr << "prefill " << fn << " failed: " << strerror(-r) << std::endl;
+	delete[] buf;
+	ceph_close(cmount, fd);
+	return r;
+      }
+    }
+    delete[] buf;
+    ceph_fsync(cmount, fd, 0);
+  }
+  *fdp = fd;
+  return 0;
+}
+
+static void usage()
+{
+  cout << "usage: bench_libcephfs_io [options] [ceph options]\n"
+       << "  -t <threads>        concurrent threads (default 1)\n"
+       << "  -m <mode>           read, write, randread, randwrite or randrw (default randread)\n"
+       << "  -b <bytes>          block size (default 4096)\n"
+       << "  -s <MB>             size of each file (default 64)\n"
+       << "  -d <seconds>        run time (default 10)\n"
+       << "  --fsync <n>         fsync every n writes (default never)\n"
+       << "  --shared            all threads use one file\n"
+       << "  --dir <path>        where to put the files (default /bench_libcephfs_io)\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  bench_opts_t o;
+  vector<const char*> rest;
+  rest.push_back(argv[0]);
+  for (int i = 1; i < argc; i++) {
+    string a = argv[i];
+    bool more = i + 1 < argc;
+    if (a == "-h" || a == "--help") {
+      usage();
+      return 0;
+    } else if (a == "-t" && more) {
+      o.threads = atoi(argv[++i]);
+    } else if (a == "-b" && more) {
+      o.block_size = strtoull(argv[++i], NULL, 10);
+    } else if (a == "-s" && more) {
+      o.file_size = strtoull(argv[++i], NULL, 10) << 20;
+    } else if (a == "-d" && more) {
+      o.duration = atof(argv[++i]);
+    } else if (a == "--fsync" && more) {
+      o.fsync_every = atoi(argv[++i]);
+    } else if (a == "--shared") {
+      o.shared = true;
+    } else if (a == "--dir" && more) {
+      o.dir = argv[++i];
+    } else if (a == "-m" && more) {
+      string m = argv[++i];
+      if (m == "read") o.mode = MODE_READ;
+      else if (m == "write") o.mode = MODE_WRITE;
+      else if (m == "randread") o.mode = MODE_RANDREAD;
+      else if (m == "randwrite") o.mode = MODE_RANDWRITE;
+      else if (m == "randrw") o.mode = MODE_RANDRW;
+      else {
+	usage();
+	return 1;
+      }
+    } else {
+      rest.push_back(argv[i]);
+    }
+  }
+  if (o.threads < 1 || o.block_size == 0 || o.file_size < o.block_size) {
+    usage();
+    return 1;
+  }
+
+  struct ceph_mount_info *cmount;
+  int r = ceph_create(&cmount, NULL);
+  if (r == 0)
+    r = ceph_conf_read_file(cmount, NULL);
+  if (r == 0)
+    r = ceph_conf_parse_argv(cmount, rest.size(), &rest[0]);
+  if (r == 0)
+    r = ceph_mount(cmount, "/");
+  if (r < 0) {
+    cerr << "couldn't mount: " << strerror(-r) << std::endl;
+    return 1;
+  }
+  r = ceph_mkdirs(cmount, o.dir.c_str(), 0755);
+  if (r < 0 && r != -EEXIST) {
+    cerr << "mkdirs " << o.dir << " failed: " << strerror(-r) << std::endl;
+    ceph_shutdown(cmount);
+    return 1;
+  }
+
+  vector<bench_thread_t> threads(o.threads);
+  int shared_fd = -1;
+  for (int i = 0; i < o.threads; i++) {
+    bench_thread_t& t = threads[i];
+    t.cmount = cmount;
+    t.opts = &o;
+    t.id = i;
+    if (o.shared && shared_fd >= 0) {
+      t.fd = shared_fd;
+      continue;
+    }
+    char fn[20];
+    snprintf(fn, sizeof(fn), "/file.%d", o.shared ? 0 : i);
+    r = prepare_file(cmount, o.dir + fn, o, &t.fd);
+    if (r < 0) {
+      ceph_shutdown(cmount);
+      return 1;
+    }
+    shared_fd = t.fd;
+  }
+
+  double start = now();
+  for (int i = 0; i < o.threads; i++) {
+    threads[i].stop = start + o.duration;
+    pthread_create(&threads[i].tid, NULL, bench_entry, &threads[i]);
+  }
+  uint64_t ops = 0, bytes = 0;
+  double lat_sum = 0, lat_max = 0;
+  for (int i = 0; i < o.threads; i++) {
+    bench_thread_t& t = threads[i];
+    pthread_join(t.tid, NULL);
+    if (t.err)
+      cerr << "thread " << i << " failed: " << strerror(-t.err) << std::endl;
+    ops += t.ops;
+    bytes += t.bytes;
+    lat_sum += t.lat_sum;
+    if (t.lat_max > lat_max)
+      lat_max = t.lat_max;
+  }
+  double elapsed = now() - start;
+
+  for (int i = 0; i < o.threads; i++)
+    if (!o.shared || i == 0)
+      ceph_close(cmount, threads[i].fd);
+  ceph_shutdown(cmount);
+
+  cout << o.threads << " threads, " << o.block_size << " byte blocks: "
+       << ops << " ops in " << elapsed << " s, "
+       << (double)ops / elapsed << " iops, "
+       << (double)bytes / elapsed / 1048576.0 << " MB/sec, "
+       << "lat avg " << (ops ? lat_sum / ops * 1000.0 : 0) << " ms"
+       << " max " << lat_max * 1000.0 << " ms" << std::endl;
+  return 0;
+}
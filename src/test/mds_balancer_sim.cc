@@ -0,0 +1,329 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Replay a recorded MDS hit trace against a simulated cluster of
+ * metadata servers, to compare balancer settings offline.
+ *
+ * Record a trace on a (single) active mds:
+ *
+ *   ceph mds tell 0 injectargs '--mds-bal-trace /tmp/hits'
+ *   ... run the workload ...
+ *   ceph mds tell 0 injectargs '--mds-bal-trace ""'
+ *
+ * then replay it, splitting the load across N ranks:
+ *
+ *   ./mds_balancer_sim /tmp/hits -n 4
+ *   ./mds_balancer_sim /tmp/hits -n 4 --mds-bal-need-min .5 --mds-bal-max-scan 1000
+ *
+ * Everything starts out on rank 0.  Every 'mds bal interval' seconds of
+ * trace time each overloaded rank picks exports with the same code the
+ * mds uses (mds/BalancerPolicy.h) and hands them to the least loaded
+ * ranks.  We print the per-rank load after each round, and at the end
+ * the average imbalance (max load / mean load), how many subtrees were
+ * moved, and how many dentries the balancer looked at.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "include/types.h"
+#include "include/utime.h"
+#include "common/Clock.h"
+#include "common/DecayCounter.h"
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "global/global_init.h"
+#include "mds/mdstypes.h"
+#include "mds/BalancerPolicy.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define MIN_OFFLOAD 10   // as in MDBalancer.cc
+
+struct SimDir {
+  string name;
+  SimDir *parent;
+  list<SimDir*> children;
+  int auth;     // -1 = same as parent
+  dirfrag_load_vec_t pop;
+
+  SimDir(const string& n, SimDir *p)
+    : name(n), parent(p), auth(p ? -1 : 0), pop(utime_t()) {}
+
+  bool is_subtree_root() const { return auth >= 0; }
+  int get_auth() const {
+    const SimDir *d = this;
+    while (d->auth < 0)
+      d = d->parent;
+    return d->auth;
+  }
+};
+
+struct sim_tree_t {
+  typedef SimDir* node_t;
+  utime_t now;
+  DecayRate& rate;
+  int rank;
+  bool verbose;
+
+  sim_tree_t(utime_t n, DecayRate& r, int k, bool v)
+    : now(n), rate(r), rank(k), verbose(v) {}
+
+  double pop(SimDir *d) {
+    return d->pop.meta_load(now, rate);
+  }
+  bool is_rep(SimDir *d) {
+    return false;
+  }
+  int get_subdirs(SimDir *d, list<SimDir*>& ls) {
+    for (list<SimDir*>::iterator p = d->children.begin(); p != d->children.end(); ++p)
+      if (!(*p)->is_subtree_root())
+	ls.push_back(*p);
+    return d->children.size();
+  }
+  void taking(SimDir *d, double pop, const char *why) {
+    if (verbose)
+      cout << "    mds." << rank << " taking " << why << " " << pop << " " << d->name << std::endl;
+  }
+  void descending(SimDir *d) {
+    if (verbose)
+      cout << "    mds." << rank << " descending into " << d->name << std::endl;
+  }
+};
+
+struct Sim {
+  map<string, SimDir*> dirs;
+  int num_mds;
+  DecayRate rate;
+  bool verbose;
+
+  // totals
+  int rounds;
+  double imbalance_sum;
+  uint64_t exports;
+  uint64_t scanned;
+  double select_time;
+
+  Sim(int n, bool v)
+    : num_mds(n), rate(g_conf->mds_decay_halflife), verbose(v),
+      rounds(0), imbalance_sum(0), exports(0), scanned(0), select_time(0) {}
+
+  SimDir *get_dir(const string& name, SimDir *parent) {
+    map<string, SimDir*>::iterator p = dirs.find(name);
+    if (p != dirs.end())
+      return p->second;
+    SimDir *d = new SimDir(name, parent);
+    if (parent)
+      parent->children.push_back(d);
+    dirs[name] = d;
+    return d;
+  }
+
+  // as MDBalancer::hit_dir does for pop_auth_subtree
+  void hit(utime_t now, SimDir *d, int type, double amount) {
+    while (d) {
+      d->pop.get(type).hit(now, rate, amount);
+      if (d->is_subtree_root())
+	break;
+      d = d->parent;
+    }
+  }
+
+  void move(utime_t now, SimDir *d, int to) {
+    for (SimDir *a = d->parent; a; a = a->parent) {
+      a->pop.sub(now, rate, d->pop);
+      if (a->is_subtree_root())
+	break;
+    }
+    d->auth = to;
+  }
+
+  void get_loads(utime_t now, vector<double>& load, multimap<int,SimDir*>& roots) {
+    load.assign(num_mds, 0);
+    for (map<string, SimDir*>::iterator p = dirs.begin(); p != dirs.end(); ++p) {
+      SimDir *d = p->second;
+      if (!d->is_subtree_root())
+	continue;
+      roots.insert(pair<int,SimDir*>(d->auth, d));
+      load[d->auth] += d->pop.meta_load(now, rate);
+    }
+  }
+
+  void rebalance(utime_t now) {
+    vector<double> load;
+    multimap<int,SimDir*> roots;
+    get_loads(now, load, roots);
+
+    double total = 0, max = 0;
+    for (int i = 0; i < num_mds; i++) {
+      total += load[i];
+      if (load[i] > max)
+	max = load[i];
+    }
+    double target = total / num_mds;
+
+    bal_export_params_t params(g_conf);
+    int budget = params.max_scan;
+    int moved = 0;
+    utime_t start = ceph_clock_now(g_ceph_context);
+
+    for (int ex = 0; ex < num_mds; ex++) {
+      if (load[ex] < target * (1.0 + g_conf->mds_bal_min_rebalance))
+	continue;
+      set<SimDir*> already_exporting;
+      int inflight = 0;
+      for (int im = 0; im < num_mds && inflight < g_conf->mds_bal_max_exports_inflight; im++) {
+	if (load[im] >= target)
+	  continue;
+	double amount = MIN(load[ex] - target, target - load[im]);
+	if (amount < MIN_OFFLOAD || amount / target < .2)
+	  continue;
+
+	sim_tree_t t(now, rate, ex, verbose);
+	list<SimDir*> ls;
+	double have = 0;
+	pair<multimap<int,SimDir*>::iterator, multimap<int,SimDir*>::iterator> r =
+	  roots.equal_range(ex);
+	for (multimap<int,SimDir*>::iterator p = r.first; p != r.second; ++p) {
+	  bal_find_exports(t, p->second, amount, params, ls, have, already_exporting, budget);
+	  if (have > amount - MIN_OFFLOAD)
+	    break;
+	}
+	for (list<SimDir*>::iterator p = ls.begin();
+	     p != ls.end() && inflight < g_conf->mds_bal_max_exports_inflight;
+	     ++p) {
+	  double pop = (*p)->pop.meta_load(now, rate);
+	  if (verbose)
+	    cout << "  mds." << ex << " -> mds." << im << " " << pop << " " << (*p)->name << std::endl;
+	  move(now, *p, im);
+	  load[ex] -= pop;
+	  load[im] += pop;
+	  moved++;
+	  inflight++;
+	}
+      }
+    }
+
+    select_time += (double)(ceph_clock_now(g_ceph_context) - start);
+    scanned += params.max_scan - budget;
+    exports += moved;
+    rounds++;
+    double imbalance = target > 0 ? max / target : 1.0;
+    imbalance_sum += imbalance;
+
+    cout << "t " << now << " load";
+    for (int i = 0; i < num_mds; i++)
+      cout << " " << (int)load[i];
+    cout << " imbalance " << imbalance << " moved " << moved
+	 << " scanned " << (params.max_scan - budget) << std::endl;
+  }
+
+  int run(istream& in) {
+    utime_t next;
+    double interval = g_conf->mds_bal_interval > 0 ? g_conf->mds_bal_interval : 10;
+    uint64_t hits = 0;
+    string line;
+    while (getline(in, line)) {
+      istringstream ss(line);
+      string what;
+      ss >> what;
+      if (what == "d") {
+	string name, parent;
+	ss >> name >> parent;
+	SimDir *p = NULL;
+	if (parent != "-")
+	  p = get_dir(parent, NULL);
+	get_dir(name, p);
+      } else if (what == "h") {
+	double t;
+	string name;
+	int type;
+	double amount;
+	ss >> t >> name >> type >> amount;
+	if (ss.fail() || type < 0 || type >= dirfrag_load_vec_t::NUM) {
+	  cerr << "bad line: " << line << std::endl;
+	  continue;
+	}
+	utime_t now;
+	now.set_from_double(t);
+	if (next == utime_t()) {
+	  next = now;
+	  next += interval;
+	}
+	while (now >= next) {
+	  rebalance(next);
+	  next += interval;
+	}
+	hit(now, get_dir(name, NULL), type, amount);
+	hits++;
+      }
+    }
+    if (next != utime_t())
+      rebalance(next);
+
+    cout << hits << " hits on " << dirs.size() << " dirfrags, " << rounds << " rounds" << std::endl;
+    if (rounds)
+      cout << "average imbalance " << imbalance_sum / rounds
+	   << ", " << exports << " exports"
+	   << ", " << scanned << " dentries scanned"
+	   << ", " << select_time << " s choosing exports" << std::endl;
+    return 0;
+  }
+};
+
+static void usage()
+{
+  cout << "usage: mds_balancer_sim <trace> [options]\n"
+       << "  -n <ranks>       simulated active mds count (default 2)\n"
+       << "  -v               show every export decision\n"
+       << "  --mds-bal-...    any balancer option, e.g. --mds-bal-need-min .5\n"
+       << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  const char *fn = NULL;
+  int num_mds = 2;
+  bool verbose = false;
+  for (unsigned i = 0; i < args.size(); i++) {
+    if (strcmp(args[i], "--help") == 0 || strcmp(args[i], "-h") == 0) {
+      usage();
+      return 0;
+    }
+    if (strcmp(args[i], "-n") == 0 && i + 1 < args.size())
+      num_mds = atoi(args[++i]);
+    else if (strcmp(args[i], "-v") == 0)
+      verbose = true;
+    else
+      fn = args[i];
+  }
+  if (!fn || num_mds < 1) {
+    usage();
+    return 1;
+  }
+
+  ifstream in(fn);
+  if (!in.is_open()) {
+    cerr << "couldn't open " << fn << std::endl;
+    return 1;
+  }
+  Sim sim(num_mds, verbose);
+  return sim.run(in);
+}
@@ -0,0 +1,250 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Request parsing and response framing of the embedded HTTP front end,
+ * over a socketpair.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "rgw/rgw_http_conn.h"
+#include "test/unit.h"
+
+using namespace std;
+
+class HTTPConnTest : public ::testing::Test {
+protected:
+  int client;
+  RGWHTTPConn *conn;
+
+  void SetUp() {
+    int sv[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    client = sv[1];
+    conn = new RGWHTTPConn(g_ceph_context, sv[0], "127.0.0.1");
+  }
+  void TearDown() {
+    delete conn;
+    ::close(client);
+  }
+
+  void send(const string& s) {
+    ASSERT_EQ((ssize_t)s.size(), ::write(client, s.data(), s.size()));
+  }
+  /* whatever the server has written so far */
+  string received() {
+    string out;
+    char buf[4096];
+    int r;
+    while ((r = ::recv(client, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      out.append(buf, r);
+    return out;
+  }
+  string env(const char *name) {
+    size_t len = strlen(name);
+    for (char **p = conn->envp(); *p; p++) {
+      if (strncmp(*p, name, len) == 0 && (*p)[len] == '=')
+	return *p + len + 1;
+    }
+    return "(unset)";
+  }
+  void respond(const char *body) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "Status: 200\nContent-Length: %d\n\n", (int)strlen(body));
+    conn->write(buf, strlen(buf));
+    conn->write(body, strlen(body));
+  }
+};
+
+TEST_F(HTTPConnTest, Basic)
+{
+  send("GET /bucket/obj?acl HTTP/1.1\r\n"
+       "Host: example.com\r\n"
+       "Content-Type: text/plain\r\n"
+       "X-Amz-Meta-Foo: bar\r\n"
+       "\r\n");
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("GET", env("REQUEST_METHOD"));
+  ASSERT_EQ("/bucket/obj?acl", env("REQUEST_URI"));
+  ASSERT_EQ("/bucket/obj", env("SCRIPT_URI"));
+  ASSERT_EQ("acl", env("QUERY_STRING"));
+  ASSERT_EQ("example.com", env("HTTP_HOST"));
+  ASSERT_EQ("text/plain", env("CONTENT_TYPE"));
+  ASSERT_EQ("bar", env("HTTP_X_AMZ_META_FOO"));
+
+  respond("hi");
+  ASSERT_TRUE(conn->complete());
+  string r = received();
+  ASSERT_EQ(0u, r.find("HTTP/1.1 200 OK\r\n"));
+  ASSERT_NE(string::npos, r.find("Content-Length: 2\r\n"));
+  ASSERT_NE(string::npos, r.find("Connection: Keep-Alive\r\n"));
+  ASSERT_EQ(r.size() - 2, r.find("\r\n\r\nhi") + 4);
+}
+
+TEST_F(HTTPConnTest, Pipelined)
+{
+  send("GET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+       "GET /b HTTP/1.1\r\nHost: x\r\n\r\n"
+       "HEAD /c HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("/a", env("REQUEST_URI"));
+  respond("a");
+  ASSERT_TRUE(conn->complete());
+  ASSERT_TRUE(conn->has_buffered_input());
+
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("/b", env("REQUEST_URI"));
+  respond("b");
+  ASSERT_TRUE(conn->complete());
+  ASSERT_TRUE(conn->has_buffered_input());
+
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("HEAD", env("REQUEST_METHOD"));
+  respond("c");
+  ASSERT_FALSE(conn->complete());   // Connection: close
+  ASSERT_FALSE(conn->has_buffered_input());
+
+  string r = received();
+  size_t a = r.find("\r\n\r\na");
+  size_t b = r.find("\r\n\r\nb");
+  ASSERT_NE(string::npos, a);
+  ASSERT_NE(string::npos, b);
+  ASSERT_LT(a, b);
+  // no body for HEAD
+  ASSERT_EQ(r.size() - 4, r.rfind("\r\n\r\n"));
+  ASSERT_NE(string::npos, r.find("Connection: close\r\n"));
+}
+
+TEST_F(HTTPConnTest, ChunkedRequest)
+{
+  send("PUT /bucket/obj HTTP/1.1\r\n"
+       "Transfer-Encoding: chunked\r\n"
+       "\r\n"
+       "5\r\nhello\r\n"
+       "6;ext=1\r\n world\r\n"
+       "0\r\n"
+       "Trailer: x\r\n"
+       "\r\n"
+       "GET /next HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("chunked", env("HTTP_TRANSFER_ENCODING"));
+
+  char buf[64];
+  int r = conn->read(buf, 3);
+  ASSERT_EQ(3, r);
+  r = conn->read(buf + 3, sizeof(buf) - 3);
+  ASSERT_EQ(8, r);
+  ASSERT_EQ("hello world", string(buf, 11));
+  ASSERT_EQ(0, conn->read(buf, sizeof(buf)));
+
+  respond("");
+  ASSERT_TRUE(conn->complete());
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("/next", env("REQUEST_URI"));
+}
+
+TEST_F(HTTPConnTest, ChunkedRequestUnread)
+{
+  // a body the handler didn't read is skipped before the next request
+  send("PUT /a HTTP/1.1\r\n"
+       "Transfer-Encoding: chunked\r\n"
+       "\r\n"
+       "3\r\nabc\r\n0\r\n\r\n"
+       "GET /b HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(0, conn->read_request());
+  respond("");
+  ASSERT_TRUE(conn->complete());
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("/b", env("REQUEST_URI"));
+}
+
+TEST_F(HTTPConnTest, BadChunk)
+{
+  send("PUT /a HTTP/1.1\r\n"
+       "Transfer-Encoding: chunked\r\n"
+       "\r\n"
+       "zz\r\nabc\r\n");
+  ASSERT_EQ(0, conn->read_request());
+  char buf[16];
+  ASSERT_EQ(0, conn->read(buf, sizeof(buf)));
+  respond("");
+  ASSERT_FALSE(conn->complete());
+}
+
+TEST_F(HTTPConnTest, ChunkedResponse)
+{
+  send("GET /a HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(0, conn->read_request());
+  const char *hdr = "Status: 200\nContent-Type: text/plain\n\n";
+  conn->write(hdr, strlen(hdr));
+  conn->write("abc", 3);
+  ASSERT_TRUE(conn->complete());
+  string r = received();
+  ASSERT_NE(string::npos, r.find("Transfer-Encoding: chunked\r\n"));
+  ASSERT_EQ(r.size() - 13, r.find("\r\n\r\n3\r\nabc\r\n0\r\n\r\n") + 4);
+}
+
+TEST_F(HTTPConnTest, Expect100)
+{
+  send("PUT /a HTTP/1.1\r\n"
+       "Content-Length: 5\r\n"
+       "Expect: 100-continue\r\n"
+       "\r\n");
+  ASSERT_EQ(0, conn->read_request());
+  ASSERT_EQ("5", env("CONTENT_LENGTH"));
+  ASSERT_EQ("", received());   // nothing until we ask for the body
+
+  conn->send_100_continue();
+  ASSERT_EQ("HTTP/1.1 100 Continue\r\n\r\n", received());
+  conn->send_100_continue();   // only once
+  ASSERT_EQ("", received());
+
+  send("hello");
+  char buf[16];
+  ASSERT_EQ(5, conn->read(buf, sizeof(buf)));
+  ASSERT_EQ("hello", string(buf, 5));
+  respond("");
+  ASSERT_TRUE(conn->complete());
+  ASSERT_EQ(0u, received().find("HTTP/1.1 200 OK\r\n"));
+}
+
+TEST_F(HTTPConnTest, Expect100Refused)
+{
+  // we answer without asking for the body: the client may or may not
+  // send it, so the connection can't be reused
+  send("PUT /a HTTP/1.1\r\n"
+       "Content-Length: 5\r\n"
+       "Expect: 100-continue\r\n"
+       "\r\n");
+  ASSERT_EQ(0, conn->read_request());
+  const char *hdr = "Status: 403\nContent-Length: 0\n\n";
+  conn->write(hdr, strlen(hdr));
+  ASSERT_FALSE(conn->complete());
+  ASSERT_EQ(0u, received().find("HTTP/1.1 403 Forbidden\r\n"));
+}
+
+TEST_F(HTTPConnTest, BadRequest)
+{
+  send("GARBAGE\r\n\r\n");
+  ASSERT_GT(0, conn->read_request());
+  ASSERT_EQ(0u, received().find("HTTP/1.1 400 Bad Request\r\n"));
+}
+
+TEST_F(HTTPConnTest, Closed)
+{
+  send("GET /a HTTP/1.1\r\n");
+  ::shutdown(client, SHUT_WR);
+  ASSERT_EQ(-EPIPE, conn->read_request());
+}
@@ -0,0 +1,271 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Bucket index tests.  These need a running cluster, and create (and
+ * remove) their own buckets as user 'test'.
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+#include "include/types.h"
+#include "common/Clock.h"
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "common/config.h"
+#include "global/global_init.h"
+#include "rgw/rgw_rados.h"
+
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int create_bucket(const char *what, rgw_bucket& bucket)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "test-rgw-%s-%llu-%d", what,
+	   (unsigned long long)ceph_clock_now(g_ceph_context).sec(), (int)getpid());
+  bucket = rgw_bucket();
+  bucket.name = name;
+  string owner = "test";
+  map<string, bufferlist> attrs;
+  int r = rgwstore->create_bucket(owner, bucket, attrs, false, true);
+  if (r < 0)
+    return r;
+
+  RGWBucketInfo info;
+  r = rgwstore->get_bucket_info(NULL, bucket.name, info);
+  if (r < 0)
+    return r;
+  bucket = info.bucket;
+  return 0;
+}
+
+static int put(rgw_bucket& bucket, string name, size_t size)
+{
+  rgw_obj obj(bucket, name);
+  bufferlist bl;
+  bl.append_zero(size);
+  map<string, bufferlist> attrs;
+  return rgwstore->put_obj_meta(NULL, obj, size, NULL, attrs, RGW_OBJ_CATEGORY_MAIN,
+				false, NULL, &bl, NULL);
+}
+
+static void remove_bucket(rgw_bucket& bucket, list<string>& names)
+{
+  for (list<string>::iterator iter = names.begin(); iter != names.end(); ++iter) {
+    rgw_obj obj(bucket, *iter);
+    rgwstore->delete_obj(NULL, obj);
+  }
+  rgwstore->delete_bucket(bucket);
+}
+
+static void expect_same_stats(map<RGWObjCategory, RGWBucketStats>& a,
+			      map<RGWObjCategory, RGWBucketStats>& b)
+{
+  ASSERT_EQ(a.size(), b.size());
+  map<RGWObjCategory, RGWBucketStats>::iterator ai, bi;
+  for (ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi) {
+    ASSERT_EQ(ai->first, bi->first);
+    ASSERT_EQ(ai->second.num_objects, bi->second.num_objects);
+    ASSERT_EQ(ai->second.num_kb, bi->second.num_kb);
+    ASSERT_EQ(ai->second.num_kb_rounded, bi->second.num_kb_rounded);
+  }
+}
+
+TEST(rgw_index, reshard_stats)
+{
+  rgw_bucket bucket;
+  ASSERT_EQ(0, create_bucket("reshard", bucket));
+
+  list<string> names;
+  uint64_t total = 0;
+  for (int i = 0; i < 100; i++) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "obj.%d", i);
+    names.push_back(buf);
+    ASSERT_EQ(0, put(bucket, buf, i * 100));
+    total += i * 100;
+  }
+
+  map<RGWObjCategory, RGWBucketStats> before, after;
+  ASSERT_EQ(0, rgwstore->get_bucket_stats(bucket, before));
+  ASSERT_EQ(100u, before[RGW_OBJ_CATEGORY_MAIN].num_objects);
+  ASSERT_EQ((total + 1023) / 1024, before[RGW_OBJ_CATEGORY_MAIN].num_kb);
+
+  vector<rgw_bucket> buckets(1, bucket);
+  ASSERT_EQ(0, rgwstore->set_buckets_enabled(buckets, false));
+
+  ASSERT_EQ(0, rgwstore->reshard_bucket_index(bucket, 4));
+  ASSERT_EQ(0, rgwstore->get_bucket_stats(bucket, after));
+  expect_same_stats(before, after);
+
+  ASSERT_EQ(0, rgwstore->reshard_bucket_index(bucket, 0));
+  ASSERT_EQ(0, rgwstore->get_bucket_stats(bucket, after));
+  expect_same_stats(before, after);
+
+  ASSERT_EQ(0, rgwstore->set_buckets_enabled(buckets, true));
+  remove_bucket(bucket, names);
+}
+
+/* list all of it, max entries (and prefixes) at a time */
+static void list_all(rgw_bucket& bucket, string prefix, string delim, int max,
+		     set<string>& names, set<string>& prefixes)
+{
+  string marker;
+  string ns;
+  bool truncated = true;
+  int calls = 0;
+  while (truncated) {
+    vector<RGWObjEnt> result;
+    map<string, bool> common;
+    ASSERT_EQ(0, rgwstore->list_objects(bucket, max, prefix, delim, marker, result, common,
+					false, ns, &truncated, NULL));
+    ASSERT_GE(max, (int)(result.size() + common.size()));
+    for (vector<RGWObjEnt>::iterator iter = result.begin(); iter != result.end(); ++iter) {
+      ASSERT_TRUE(names.insert(iter->name).second);
+      if (iter->name > marker)
+	marker = iter->name;
+    }
+    for (map<string, bool>::iterator iter = common.begin(); iter != common.end(); ++iter) {
+      ASSERT_TRUE(prefixes.insert(iter->first).second);
+      if (iter->first > marker)
+	marker = iter->first;
+    }
+    ASSERT_GT(100, ++calls);
+  }
+}
+
+TEST(rgw_index, list_delimiter)
+{
+  rgw_bucket bucket;
+  ASSERT_EQ(0, create_bucket("list", bucket));
+
+  const char *objs[] = { "a", "dir1/x", "dir1/y", "dir1/sub/z", "dir2/x", "e",
+			 "_u_x", "_u_y", "_v", NULL };
+  list<string> names;
+  for (int i = 0; objs[i]; i++) {
+    names.push_back(objs[i]);
+    ASSERT_EQ(0, put(bucket, objs[i], 1));
+  }
+
+  set<string> expect_names, expect_prefixes;
+  for (int max = 1; max <= 10; max += 3) {
+    set<string> got_names, got_prefixes;
+    list_all(bucket, "", "/", max, got_names, got_prefixes);
+    expect_names.clear();
+    expect_names.insert("a");
+    expect_names.insert("e");
+    expect_names.insert("_u_x");
+    expect_names.insert("_u_y");
+    expect_names.insert("_v");
+    expect_prefixes.clear();
+    expect_prefixes.insert("dir1/");
+    expect_prefixes.insert("dir2/");
+    ASSERT_EQ(expect_names, got_names);
+    ASSERT_EQ(expect_prefixes, got_prefixes);
+
+    got_names.clear();
+    got_prefixes.clear();
+    list_all(bucket, "dir1/", "/", max, got_names, got_prefixes);
+    expect_names.clear();
+    expect_names.insert("dir1/x");
+    expect_names.insert("dir1/y");
+    expect_prefixes.clear();
+    expect_prefixes.insert("dir1/sub/");
+    ASSERT_EQ(expect_names, got_names);
+    ASSERT_EQ(expect_prefixes, got_prefixes);
+
+    // a delimiter that is also the escape for names starting with '_'
+    got_names.clear();
+    got_prefixes.clear();
+    list_all(bucket, "", "_", max, got_names, got_prefixes);
+    expect_names.clear();
+    expect_names.insert("a");
+    expect_names.insert("dir1/x");
+    expect_names.insert("dir1/y");
+    expect_names.insert("dir1/sub/z");
+    expect_names.insert("dir2/x");
+    expect_names.insert("e");
+    expect_prefixes.clear();
+    expect_prefixes.insert("_");
+    ASSERT_EQ(expect_names, got_names);
+    ASSERT_EQ(expect_prefixes, got_prefixes);
+
+    got_names.clear();
+    got_prefixes.clear();
+    list_all(bucket, "_u", "_", max, got_names, got_prefixes);
+    expect_names.clear();
+    expect_prefixes.clear();
+    expect_prefixes.insert("_u_");
+    ASSERT_EQ(expect_names, got_names);
+    ASSERT_EQ(expect_prefixes, got_prefixes);
+  }
+
+  remove_bucket(bucket, names);
+}
+
+/*
+ * pseudo-dirs with more entries than the index reads after skipping a
+ * prefix, and runs of plain names between them longer than that.
+ */
+TEST(rgw_index, list_delimiter_batches)
+{
+  rgw_bucket bucket;
+  ASSERT_EQ(0, create_bucket("listbatch", bucket));
+
+  list<string> names;
+  set<string> expect_names, expect_prefixes;
+  for (int d = 0; d < 5; d++) {
+    char buf[32];
+    for (int i = 0; i < 20; i++) {
+      snprintf(buf, sizeof(buf), "d%d/o%02d", d, i);
+      names.push_back(buf);
+      ASSERT_EQ(0, put(bucket, buf, 1));
+      snprintf(buf, sizeof(buf), "d%d_p%02d", d, i);
+      names.push_back(buf);
+      expect_names.insert(buf);
+      ASSERT_EQ(0, put(bucket, buf, 1));
+    }
+    snprintf(buf, sizeof(buf), "d%d/", d);
+    expect_prefixes.insert(buf);
+  }
+
+  int maxes[] = { 3, 7, 30, 1000, 0 };
+  for (int i = 0; maxes[i]; i++) {
+    set<string> got_names, got_prefixes;
+    list_all(bucket, "", "/", maxes[i], got_names, got_prefixes);
+    ASSERT_EQ(expect_names, got_names);
+    ASSERT_EQ(expect_prefixes, got_prefixes);
+  }
+
+  remove_bucket(bucket, names);
+}
+
+int main(int argc, char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+  env_to_vec(args);
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  RGWStoreManager store_manager;
+  if (!store_manager.init(g_ceph_context)) {
+    cerr << "couldn't init storage provider" << std::endl;
+    return 1;
+  }
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,164 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "include/types.h"
+#include "include/compact_map.h"
+#include "gtest/gtest.h"
+
+TEST(compact_map, empty)
+{
+  compact_map<int,int> m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_FALSE(m.allocated());
+  ASSERT_EQ(0u, m.size());
+  ASSERT_TRUE(m.begin() == m.end());
+  ASSERT_TRUE(m.find(1) == m.end());
+  ASSERT_EQ(0u, m.count(1));
+  ASSERT_EQ(0u, m.erase(1));
+  ASSERT_EQ(0u, m.mem_usage());
+}
+
+TEST(compact_map, insert_find)
+{
+  compact_map<int,int> m;
+  ASSERT_TRUE(m.insert(make_pair(2, 20)).second);
+  ASSERT_TRUE(m.allocated());
+  ASSERT_FALSE(m.insert(make_pair(2, 21)).second);
+  m[1] = 10;
+  m[3] = 30;
+  ASSERT_EQ(3u, m.size());
+  ASSERT_EQ(1u, m.count(2));
+  compact_map<int,int>::iterator p = m.find(2);
+  ASSERT_TRUE(p != m.end());
+  ASSERT_EQ(20, p->second);
+  ASSERT_TRUE(m.find(4) == m.end());
+  ASSERT_EQ(3, m.lower_bound(3)->first);
+  ASSERT_TRUE(m.upper_bound(3) == m.end());
+}
+
+TEST(compact_map, order)
+{
+  compact_map<int,int> m;
+  m[5] = 0;
+  m[1] = 0;
+  m[3] = 0;
+  m[2] = 0;
+  m[4] = 0;
+  int expect = 1;
+  for (compact_map<int,int>::iterator p = m.begin(); p != m.end(); ++p)
+    ASSERT_EQ(expect++, p->first);
+  ASSERT_EQ(6, expect);
+  for (compact_map<int,int>::reverse_iterator p = m.rbegin(); p != m.rend(); ++p)
+    ASSERT_EQ(--expect, p->first);
+  ASSERT_EQ(1, expect);
+}
+
+TEST(compact_map, erase)
+{
+  compact_map<int,int> m;
+  m[1] = 10;
+  m[2] = 20;
+  ASSERT_EQ(1u, m.erase(1));
+  ASSERT_EQ(0u, m.erase(1));
+  ASSERT_EQ(1u, m.size());
+
+  // the last erase keeps the memory until shrink()
+  m.erase(m.find(2));
+  ASSERT_TRUE(m.empty());
+  ASSERT_TRUE(m.allocated());
+  ASSERT_TRUE(m.begin() == m.end());
+  m.shrink();
+  ASSERT_FALSE(m.allocated());
+  m.shrink();
+  ASSERT_FALSE(m.allocated());
+
+  // shrink() leaves a non-empty one alone
+  m[3] = 30;
+  m.shrink();
+  ASSERT_TRUE(m.allocated());
+  ASSERT_EQ(1u, m.erase(3));
+  m.clear();
+  ASSERT_FALSE(m.allocated());
+
+  // erase everything while iterating
+  for (int i = 0; i < 10; i++)
+    m[i] = i;
+  compact_map<int,int>::iterator p = m.begin();
+  int n = 0;
+  while (p != m.end()) {
+    m.erase(p++);
+    n++;
+  }
+  ASSERT_EQ(10, n);
+  ASSERT_TRUE(m.empty());
+  m.shrink();
+  ASSERT_FALSE(m.allocated());
+}
+
+TEST(compact_map, copy_encode)
+{
+  compact_map<int,int> m;
+  compact_map<int,int> e(m);
+  ASSERT_FALSE(e.allocated());
+
+  m[1] = 10;
+  m[2] = 20;
+  compact_map<int,int> c(m);
+  ASSERT_TRUE(c == m);
+  c[3] = 30;
+  ASSERT_TRUE(c != m);
+  c = e;
+  ASSERT_FALSE(c.allocated());
+
+  bufferlist bl;
+  ::encode(m, bl);
+  compact_map<int,int> d;
+  bufferlist::iterator q = bl.begin();
+  ::decode(d, q);
+  ASSERT_TRUE(d == m);
+
+  // an empty one decodes without allocating
+  bl.clear();
+  ::encode(e, bl);
+  q = bl.begin();
+  ::decode(d, q);
+  ASSERT_FALSE(d.allocated());
+}
+
+TEST(compact_set, insert_erase)
+{
+  compact_set<int> s;
+  ASSERT_TRUE(s.insert(2).second);
+  ASSERT_TRUE(s.insert(1).second);
+  ASSERT_FALSE(s.insert(2).second);
+  ASSERT_EQ(1, *s.begin());
+  ASSERT_EQ(1u, s.erase(1));
+  ASSERT_EQ(1u, s.erase(2));
+  s.shrink();
+  ASSERT_FALSE(s.allocated());
+}
+
+TEST(compact_multimap, insert_erase)
+{
+  compact_multimap<int,int> m;
+  m.insert(make_pair(1, 1));
+  m.insert(make_pair(1, 2));
+  m.insert(make_pair(0, 0));
+  ASSERT_EQ(3u, m.size());
+  ASSERT_EQ(2u, m.count(1));
+  ASSERT_EQ(0, m.begin()->first);
+  ASSERT_EQ(2u, m.erase(1));
+  ASSERT_EQ(1u, m.size());
+  m.erase(m.begin());
+  m.shrink();
+  ASSERT_FALSE(m.allocated());
+}
@@ -0,0 +1,119 @@
+#!/bin/bash -x
+
+#
+# Store a directory as TMAP, then turn on 'mds dir omap' and check that
+# it is converted on the next commit, and that a dirfrag bigger than
+# 'mds dir omap fetch max' reads back whole.
+#
+
+# Includes
+source "`dirname $0`/test_common.sh"
+
+NUM_FILES=250
+FETCH_MAX=100
+
+setup() {
+        export CEPH_NUM_MDS=1
+        export CEPH_NUM_OSD=1
+
+        # Start ceph
+        ./stop.sh
+
+        ./vstart.sh -d -n
+}
+
+# (re)start mds.a with a cold cache and the given options.  short log
+# segments make it commit dirfrags soon after they are dirtied.
+restart_mds() {
+        pkill -f 'ceph-mds -i a'
+        sleep 2
+        ./ceph-mds -i a -c ./ceph.conf --mds_log_events_per_segment=50 "$@" || die "failed to start mds"
+        sleep 5
+        # (poll_cmd returns 1 once the string shows up)
+        poll_cmd "./ceph -c ./ceph.conf mds stat" "up:active" 2 60 && die "mds not active"
+}
+
+mount_fs() {
+        mkdir -p $TEMPDIR/mnt
+        ./ceph-fuse -c ./ceph.conf $TEMPDIR/mnt || die "ceph-fuse failed"
+        sleep 2
+}
+
+umount_fs() {
+        fusermount -u $TEMPDIR/mnt || die "umount failed"
+}
+
+# the dirfrag object of a directory in the metadata pool
+dir_object() {
+        printf "%x.00000000" `stat -c %i $TEMPDIR/mnt/$1`
+}
+
+# generate enough log events to expire the segments that dirtied a dir
+churn() {
+        mkdir -p $TEMPDIR/mnt/scratch
+        for i in `seq 1 200`; do
+                touch $TEMPDIR/mnt/scratch/x$i
+        done
+        rm -rf $TEMPDIR/mnt/scratch
+}
+
+# run a command until it succeeds, for up to a minute
+wait_for() {
+        for i in `seq 1 60`; do
+                eval "$1" && return 0
+                sleep 1
+        done
+        return 1
+}
+
+has_header() {
+        ./rados -c ./ceph.conf -p metadata getomapheader $1 > $TEMPDIR/hdr && [ -s $TEMPDIR/hdr ]
+}
+
+dir_omap_impl() {
+        restart_mds --mds_dir_omap=false
+        mount_fs
+        mkdir $TEMPDIR/mnt/d || die "mkdir failed"
+        for i in `seq 1 $NUM_FILES`; do
+                touch $TEMPDIR/mnt/d/f$i || die "touch failed"
+        done
+        obj=`dir_object d`
+        churn
+        wait_for "./rados -c ./ceph.conf -p metadata stat $obj" || die "dirfrag $obj never committed"
+        umount_fs
+        has_header $obj && die "dirfrag $obj already has an omap header"
+
+        # read it from tmap, convert it on commit
+        restart_mds --mds_dir_omap=true --mds_dir_omap_fetch_max=$FETCH_MAX
+        mount_fs
+        [ `ls $TEMPDIR/mnt/d | wc -l` -eq $NUM_FILES ] || die "wrong entry count from tmap"
+        touch $TEMPDIR/mnt/d/new || die "touch failed"
+        churn
+        wait_for "has_header $obj" || die "dirfrag $obj was not converted"
+        umount_fs
+        nkeys=`./rados -c ./ceph.conf -p metadata listomapkeys $obj | wc -l`
+        [ $nkeys -eq $((NUM_FILES + 1)) ] || die "expected $((NUM_FILES + 1)) keys, got $nkeys"
+        ./rados -c ./ceph.conf -p metadata stat $obj | grep -q 'size 0$' || die "tmap was not truncated"
+
+        # a cold fetch now takes several omap reads
+        restart_mds --mds_dir_omap=true --mds_dir_omap_fetch_max=$FETCH_MAX
+        mount_fs
+        [ `ls $TEMPDIR/mnt/d | wc -l` -eq $((NUM_FILES + 1)) ] || die "wrong entry count from omap"
+        [ -e $TEMPDIR/mnt/d/f$NUM_FILES ] || die "lost the last entry"
+        umount_fs
+
+        # success
+        return 0
+}
+
+dir_omap() {
+        setup
+        dir_omap_impl
+}
+
+run() {
+        dir_omap || die "test failed"
+}
+
+init
+$@
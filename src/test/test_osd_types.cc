@@ -122,3 +122,77 @@ TEST(pg_t, split)
   ASSERT_TRUE(s.count(pg_t(7, 0, -1)));
 
 }
+
+TEST(pg_interval_t, check_new_interval)
+{
+  vector<int> old_acting, new_acting, old_up, new_up;
+  old_acting.push_back(0);
+  old_acting.push_back(1);
+  old_up = old_acting;
+  new_acting = old_acting;
+  new_up = old_up;
+  map<epoch_t, pg_interval_t> past_intervals;
+
+  // same acting and up: no new interval
+  ASSERT_FALSE(pg_interval_t::check_new_interval(old_acting, new_acting,
+						 old_up, new_up,
+						 10, 5, 20, 1, 15,
+						 &past_intervals));
+  ASSERT_TRUE(past_intervals.empty());
+
+  // primary was up through the start of the interval
+  new_acting[1] = 2;
+  ASSERT_TRUE(pg_interval_t::check_new_interval(old_acting, new_acting,
+						old_up, new_up,
+						10, 5, 20, 1, 15,
+						&past_intervals));
+  ASSERT_EQ(1u, past_intervals.size());
+  pg_interval_t& i = past_intervals[10];
+  ASSERT_EQ(10u, i.first);
+  ASSERT_EQ(19u, i.last);
+  ASSERT_EQ(old_acting, i.acting);
+  ASSERT_EQ(old_up, i.up);
+  ASSERT_TRUE(i.maybe_went_rw);
+
+  // primary up_thru before the interval
+  past_intervals.clear();
+  ASSERT_TRUE(pg_interval_t::check_new_interval(old_acting, new_acting,
+						old_up, new_up,
+						10, 5, 20, 1, 9,
+						&past_intervals));
+  ASSERT_FALSE(past_intervals[10].maybe_went_rw);
+
+  // primary came up after the interval started
+  past_intervals.clear();
+  ASSERT_TRUE(pg_interval_t::check_new_interval(old_acting, new_acting,
+						old_up, new_up,
+						10, 5, 20, 11, 15,
+						&past_intervals));
+  ASSERT_FALSE(past_intervals[10].maybe_went_rw);
+
+  // last_epoch_clean falls in the interval
+  past_intervals.clear();
+  ASSERT_TRUE(pg_interval_t::check_new_interval(old_acting, new_acting,
+						old_up, new_up,
+						10, 12, 20, 1, 9,
+						&past_intervals));
+  ASSERT_TRUE(past_intervals[10].maybe_went_rw);
+
+  // a change in up alone closes the interval too
+  past_intervals.clear();
+  new_up[1] = 2;
+  ASSERT_TRUE(pg_interval_t::check_new_interval(old_acting, old_acting,
+						old_up, new_up,
+						10, 5, 20, 1, 15,
+						&past_intervals));
+  ASSERT_EQ(1u, past_intervals.size());
+
+  // empty acting never went rw
+  past_intervals.clear();
+  vector<int> empty;
+  ASSERT_TRUE(pg_interval_t::check_new_interval(empty, new_acting,
+						empty, new_up,
+						10, 12, 20, 0, 0,
+						&past_intervals));
+  ASSERT_FALSE(past_intervals[10].maybe_went_rw);
+}